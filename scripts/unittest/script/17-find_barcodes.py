@@ -2,4 +2,6 @@ def unittest(data_path, temp_path):
     import image
     img = image.Image("unittest/data/barcode.pgm", copy_to_fb=True)
     codes = img.find_barcodes()
-    return len(codes) == 1 and codes[0][0:] == (61, 46, 514, 39, 'https://openmv.io/', 15, 0.0, 40)
+    fast_codes = img.find_barcodes(fast=True)
+    return len(codes) == 1 and codes[0][0:] == (61, 46, 514, 39, 'https://openmv.io/', 15, 0.0, 40) and \
+        len(fast_codes) == 1 and fast_codes[0][4:6] == ('https://openmv.io/', 15)
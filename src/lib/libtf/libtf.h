@@ -60,6 +60,8 @@ typedef void (*libtf_output_data_callback_t)(void *callback_data,
 
 // Returns 0 on success and 1 on failure.
 // Errors are printed to stdout.
+// The interpreter is built inside tensor_arena on each call so the same arena may be
+// kept allocated and passed to every invoke of the same model.
 int libtf_invoke_default(const unsigned char *model_data, // TensorFlow Lite binary model (8-bit quant).
                          unsigned char *tensor_arena, // As big as you can make it scratch buffer.
                          libtf_parameters_t *params, // Struct with model parameters.
@@ -16,11 +16,6 @@
 extern char _fballoc;
 static char *pointer = &_fballoc;
 
-#if defined(FB_ALLOC_STATS)
-static uint32_t alloc_bytes;
-static uint32_t alloc_bytes_peak;
-#endif
-
 #if defined(OMV_FB_OVERLAY_MEMORY)
 #define FB_OVERLAY_MEMORY_FLAG    0x1
 extern char _fballoc_overlay_end, _fballoc_overlay_start;
@@ -31,6 +26,190 @@ static char *pointer_overlay = &_fballoc_overlay_end;
 // Use fb_alloc_free_till_mark_permanent() instead.
 #define FB_PERMANENT_FLAG         0x2
 
+#if defined(FB_ALLOC_STATS)
+#define FB_ALLOC_CALLER()         __builtin_return_address(0)
+#define FB_ALLOC_STATS_DEPTH      (256)
+#define FB_ALLOC_STATS_MARKS      (16)
+#define FB_ALLOC_STATS_NO_SITE    (0xFF)
+#if defined(OMV_FB_OVERLAY_MEMORY)
+#define FB_ALLOC_STATS_FAST(p)    (*((uint32_t *) (p)) & FB_OVERLAY_MEMORY_FLAG)
+#else
+#define FB_ALLOC_STATS_FAST(p)    (false)
+#endif
+
+static fb_alloc_stats_t stats;
+
+// Site index of each block on the stack so frees can be attributed. Blocks deeper than
+// FB_ALLOC_STATS_DEPTH are counted but not tracked.
+static uint8_t stats_stack[FB_ALLOC_STATS_DEPTH];
+static uint32_t stats_stack_depth;
+
+// Open mark frames and the lowest stack pointer reached inside of them.
+typedef struct fb_alloc_stats_mark {
+    uint8_t site;
+    char *base;
+    char *low;
+} fb_alloc_stats_mark_t;
+
+static fb_alloc_stats_mark_t stats_marks[FB_ALLOC_STATS_MARKS];
+static uint32_t stats_marks_depth;
+
+static int fb_alloc_stats_site(void *site, bool mark) {
+    for (int i = 0; i < FB_ALLOC_STATS_SITES; i++) {
+        fb_alloc_site_stats_t *s = &stats.sites[i];
+        if ((!s->site) || ((s->site == site) && (s->mark == mark))) {
+            s->site = site;
+            s->mark = mark;
+            return i;
+        }
+    }
+
+    stats.dropped += 1;
+    return FB_ALLOC_STATS_NO_SITE;
+}
+
+// size is the size of the block excluding its size word (zero for marks).
+static void fb_alloc_stats_push(void *site, bool mark, uint32_t size, int hints, bool fast) {
+    int index = fb_alloc_stats_site(site, mark);
+
+    if (index != FB_ALLOC_STATS_NO_SITE) {
+        fb_alloc_site_stats_t *s = &stats.sites[index];
+        s->allocs += 1;
+        s->bytes += size;
+        s->max_bytes = IM_MAX(s->max_bytes, size);
+        s->live_bytes += size;
+        if (fast) {
+            s->fast_allocs += 1;
+        }
+        #if defined(OMV_FB_OVERLAY_MEMORY)
+        else if ((!mark) && (hints & FB_ALLOC_PREFER_SPEED)) {
+            s->slow_allocs += 1;
+        }
+        #endif
+    }
+
+    if (stats_stack_depth < FB_ALLOC_STATS_DEPTH) {
+        stats_stack[stats_stack_depth] = index;
+    }
+
+    stats_stack_depth += 1;
+
+    if (mark) {
+        if (stats_marks_depth < FB_ALLOC_STATS_MARKS) {
+            stats_marks[stats_marks_depth].site = index;
+            stats_marks[stats_marks_depth].base = pointer;
+            stats_marks[stats_marks_depth].low = pointer;
+        }
+
+        stats_marks_depth += 1;
+    } else {
+        stats.allocs += 1;
+    }
+
+    if (stats_marks_depth) {
+        fb_alloc_stats_mark_t *m = &stats_marks[IM_MIN(stats_marks_depth, (uint32_t) FB_ALLOC_STATS_MARKS) - 1];
+        if (pointer < m->low) {
+            m->low = pointer;
+        }
+    }
+
+    stats.peak = IM_MAX(stats.peak, (uint32_t) (&_fballoc - pointer));
+    #if defined(OMV_FB_OVERLAY_MEMORY)
+    stats.overlay_peak = IM_MAX(stats.overlay_peak, (uint32_t) (&_fballoc_overlay_end - pointer_overlay));
+    #endif
+}
+
+// size is the size of the block including its size word with the flags removed.
+static void fb_alloc_stats_pop(uint32_t size) {
+    if (!stats_stack_depth) {
+        return;
+    }
+
+    stats_stack_depth -= 1;
+
+    int index = (stats_stack_depth < FB_ALLOC_STATS_DEPTH)
+        ? stats_stack[stats_stack_depth] : FB_ALLOC_STATS_NO_SITE;
+
+    if (size != sizeof(uint32_t)) {
+        if (index != FB_ALLOC_STATS_NO_SITE) {
+            stats.sites[index].live_bytes -= size - sizeof(uint32_t);
+        }
+    } else if (stats_marks_depth) {
+        stats_marks_depth -= 1;
+
+        if (stats_marks_depth < FB_ALLOC_STATS_MARKS) {
+            fb_alloc_stats_mark_t *m = &stats_marks[stats_marks_depth];
+
+            if (m->site != FB_ALLOC_STATS_NO_SITE) {
+                fb_alloc_site_stats_t *s = &stats.sites[m->site];
+                s->frame_peak = IM_MAX(s->frame_peak, (uint32_t) (m->base - m->low));
+            }
+
+            if (stats_marks_depth && (m->low < stats_marks[stats_marks_depth - 1].low)) {
+                stats_marks[stats_marks_depth - 1].low = m->low;
+            }
+        }
+    }
+}
+
+static void fb_alloc_stats_fail(void *site, uint32_t size) {
+    stats.fails += 1;
+    stats.fail_site = site;
+    stats.fail_bytes = size;
+}
+
+const fb_alloc_stats_t *fb_alloc_stats() {
+    return &stats;
+}
+
+void fb_alloc_stats_reset() {
+    // Sites stay in place as blocks still on the stack reference them.
+    for (int i = 0; i < FB_ALLOC_STATS_SITES; i++) {
+        fb_alloc_site_stats_t *s = &stats.sites[i];
+        s->allocs = 0;
+        s->bytes = 0;
+        s->max_bytes = 0;
+        s->fast_allocs = 0;
+        s->slow_allocs = 0;
+        s->frame_peak = 0;
+    }
+
+    stats.peak = &_fballoc - pointer;
+    #if defined(OMV_FB_OVERLAY_MEMORY)
+    stats.overlay_peak = &_fballoc_overlay_end - pointer_overlay;
+    #endif
+    stats.allocs = 0;
+    stats.dropped = 0;
+    stats.fails = 0;
+    stats.fail_site = NULL;
+    stats.fail_bytes = 0;
+}
+
+void fb_alloc_stats_print() {
+    printf("fb_alloc peak: %lu overlay peak: %lu allocs: %lu dropped: %lu\n",
+           stats.peak, stats.overlay_peak, stats.allocs, stats.dropped);
+
+    if (stats.fails) {
+        printf("fb_alloc fails: %lu last: %p (%lu bytes)\n", stats.fails, stats.fail_site, stats.fail_bytes);
+    }
+
+    for (int i = 0; i < FB_ALLOC_STATS_SITES; i++) {
+        fb_alloc_site_stats_t *s = &stats.sites[i];
+        if (!s->site) {
+            break;
+        }
+        if (s->mark) {
+            printf("%p mark frames: %lu peak: %lu\n", s->site, s->allocs, s->frame_peak);
+        } else {
+            printf("%p allocs: %lu bytes: %lu max: %lu live: %lu fast: %lu slow: %lu\n",
+                   s->site, s->allocs, s->bytes, s->max_bytes, s->live_bytes, s->fast_allocs, s->slow_allocs);
+        }
+    }
+}
+#else
+#define FB_ALLOC_CALLER()         NULL
+#endif
+
 char *fb_alloc_stack_pointer() {
     return pointer;
 }
@@ -44,6 +223,11 @@ void fb_alloc_init0() {
     #if defined(OMV_FB_OVERLAY_MEMORY)
     pointer_overlay = &_fballoc_overlay_end;
     #endif
+    #if defined(FB_ALLOC_STATS)
+    memset(&stats, 0, sizeof(stats));
+    stats_stack_depth = 0;
+    stats_marks_depth = 0;
+    #endif
 }
 
 uint32_t fb_avail() {
@@ -56,6 +240,9 @@ void fb_alloc_mark() {
 
     // Check if allocation overwrites the framebuffer pixels
     if (new_pointer < framebuffer_get_buffers_end()) {
+        #if defined(FB_ALLOC_STATS)
+        fb_alloc_stats_fail(FB_ALLOC_CALLER(), 0);
+        #endif
         nlr_jump(MP_OBJ_TO_PTR(mp_obj_new_exception_msg(&mp_type_MemoryError,
                                                         MP_ERROR_TEXT("Out of fast frame buffer stack memory"))));
     }
@@ -66,8 +253,7 @@ void fb_alloc_mark() {
     *((uint32_t *) new_pointer) = sizeof(uint32_t); // Save size.
     pointer = new_pointer;
     #if defined(FB_ALLOC_STATS)
-    alloc_bytes = 0;
-    alloc_bytes_peak = 0;
+    fb_alloc_stats_push(FB_ALLOC_CALLER(), true, 0, FB_ALLOC_NO_HINT, false);
     #endif
 }
 
@@ -92,14 +278,14 @@ static void int_fb_alloc_free_till_mark(bool free_permanent) {
             pointer_overlay += size - sizeof(uint32_t);
         }
         #endif
+        #if defined(FB_ALLOC_STATS)
+        fb_alloc_stats_pop(size);
+        #endif
         pointer += size; // Get size and pop.
         if (size == sizeof(uint32_t)) {
             break;                           // Break on first marker.
         }
     }
-    #if defined(FB_ALLOC_STATS)
-    printf("fb_alloc peak memory: %lu\n", alloc_bytes_peak);
-    #endif
 }
 
 void fb_alloc_free_till_mark() {
@@ -116,8 +302,7 @@ void fb_alloc_free_till_mark_past_mark_permanent() {
     int_fb_alloc_free_till_mark(true);
 }
 
-// returns null pointer without error if size==0
-void *fb_alloc(uint32_t size, int hints) {
+static void *int_fb_alloc(uint32_t size, int hints, void *site) {
     if (!size) {
         return NULL;
     }
@@ -134,6 +319,9 @@ void *fb_alloc(uint32_t size, int hints) {
 
     // Check if allocation overwrites the framebuffer pixels
     if (new_pointer < framebuffer_get_buffers_end()) {
+        #if defined(FB_ALLOC_STATS)
+        fb_alloc_stats_fail(site, size);
+        #endif
         fb_alloc_fail();
     }
 
@@ -141,14 +329,6 @@ void *fb_alloc(uint32_t size, int hints) {
     *((uint32_t *) new_pointer) = size + sizeof(uint32_t); // Save size.
     pointer = new_pointer;
 
-    #if defined(FB_ALLOC_STATS)
-    alloc_bytes += size;
-    if (alloc_bytes > alloc_bytes_peak) {
-        alloc_bytes_peak = alloc_bytes;
-    }
-    printf("fb_alloc %lu bytes\n", size);
-    #endif
-
     #if defined(OMV_FB_OVERLAY_MEMORY)
     if ((!(hints & FB_ALLOC_PREFER_SIZE))
         && (((uint32_t) (pointer_overlay - &_fballoc_overlay_start)) >= size)) {
@@ -159,6 +339,10 @@ void *fb_alloc(uint32_t size, int hints) {
     }
     #endif
 
+    #if defined(FB_ALLOC_STATS)
+    fb_alloc_stats_push(site, false, size, hints, FB_ALLOC_STATS_FAST(new_pointer));
+    #endif
+
     if (hints & FB_ALLOC_CACHE_ALIGN) {
         int offset = ((uint32_t) result) % OMV_ALLOC_ALIGNMENT;
         if (offset) {
@@ -169,14 +353,19 @@ void *fb_alloc(uint32_t size, int hints) {
     return result;
 }
 
+// returns null pointer without error if size==0
+void *fb_alloc(uint32_t size, int hints) {
+    return int_fb_alloc(size, hints, FB_ALLOC_CALLER());
+}
+
 // returns null pointer without error if passed size==0
 void *fb_alloc0(uint32_t size, int hints) {
-    void *mem = fb_alloc(size, hints);
+    void *mem = int_fb_alloc(size, hints, FB_ALLOC_CALLER());
     memset(mem, 0, size); // does nothing if size is zero.
     return mem;
 }
 
-void *fb_alloc_all(uint32_t *size, int hints) {
+static void *int_fb_alloc_all(uint32_t *size, int hints, void *site) {
     uint32_t temp = pointer - framebuffer_get_buffers_end() - sizeof(uint32_t);
 
     if (temp < sizeof(uint32_t)) {
@@ -200,14 +389,6 @@ void *fb_alloc_all(uint32_t *size, int hints) {
     *((uint32_t *) new_pointer) = *size + sizeof(uint32_t); // Save size.
     pointer = new_pointer;
 
-    #if defined(FB_ALLOC_STATS)
-    alloc_bytes += *size;
-    if (alloc_bytes > alloc_bytes_peak) {
-        alloc_bytes_peak = alloc_bytes;
-    }
-    printf("fb_alloc_all %lu bytes\n", *size);
-    #endif
-
     #if defined(OMV_FB_OVERLAY_MEMORY)
     if (!(hints & FB_ALLOC_PREFER_SIZE)) {
         // Return overlay memory instead.
@@ -217,6 +398,10 @@ void *fb_alloc_all(uint32_t *size, int hints) {
     }
     #endif
 
+    #if defined(FB_ALLOC_STATS)
+    fb_alloc_stats_push(site, false, *size, hints, FB_ALLOC_STATS_FAST(new_pointer));
+    #endif
+
     if (hints & FB_ALLOC_CACHE_ALIGN) {
         int offset = ((uint32_t) result) % OMV_ALLOC_ALIGNMENT;
         if (offset) {
@@ -231,9 +416,13 @@ void *fb_alloc_all(uint32_t *size, int hints) {
     return result;
 }
 
+void *fb_alloc_all(uint32_t *size, int hints) {
+    return int_fb_alloc_all(size, hints, FB_ALLOC_CALLER());
+}
+
 // returns null pointer without error if returned size==0
 void *fb_alloc0_all(uint32_t *size, int hints) {
-    void *mem = fb_alloc_all(size, hints);
+    void *mem = int_fb_alloc_all(size, hints, FB_ALLOC_CALLER());
     memset(mem, 0, *size); // does nothing if size is zero.
     return mem;
 }
@@ -250,7 +439,7 @@ void fb_free() {
         }
         #endif
         #if defined(FB_ALLOC_STATS)
-        alloc_bytes -= size;
+        fb_alloc_stats_pop(size);
         #endif
         pointer += size; // Get size and pop.
     }
@@ -268,7 +457,7 @@ void fb_free_all() {
         }
         #endif
         #if defined(FB_ALLOC_STATS)
-        alloc_bytes -= size;
+        fb_alloc_stats_pop(size);
         #endif
         pointer += size; // Get size and pop.
     }
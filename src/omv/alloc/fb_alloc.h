@@ -48,10 +48,18 @@
  *                          flag is set then fb_alloc_all() will use the SDRAM (default).
  * - FB_ALLOC_CACHE_ALIGN - Aligns the starting address returned to a cache line and makes sure
  *                          the amount of memory allocated is padded to the end of a cache line.
+ *
+ * Building with FB_ALLOC_STATS=1 enables instrumentation. Every fb_alloc() and fb_alloc_mark() is
+ * attributed to its call site (the caller's return address, resolve it with addr2line against the
+ * firmware elf). Per site the stats record the number of allocs, the bytes requested, the bytes
+ * still held (leaks once the stack unwinds), the allocs served from the fast overlay memory and the
+ * FB_ALLOC_PREFER_SPEED allocs that fell back to the main stack. Marks also record the deepest
+ * stack usage reached inside their frame. The stats accumulate until fb_alloc_stats_reset().
  */
 #ifndef __FB_ALLOC_H__
 #define __FB_ALLOC_H__
 #include <stdint.h>
+#include <stdbool.h>
 #define FB_ALLOC_NO_HINT         0
 #define FB_ALLOC_PREFER_SPEED    1
 #define FB_ALLOC_PREFER_SIZE     2
@@ -70,4 +78,34 @@ void *fb_alloc_all(uint32_t *size, int hints); // returns pointer and sets size
 void *fb_alloc0_all(uint32_t *size, int hints); // returns pointer and sets size
 void fb_free();
 void fb_free_all();
+
+#if defined(FB_ALLOC_STATS)
+#define FB_ALLOC_STATS_SITES    (32)
+typedef struct fb_alloc_site_stats {
+    void *site;
+    bool mark;
+    uint32_t allocs;
+    uint32_t bytes;
+    uint32_t max_bytes;
+    uint32_t live_bytes;
+    uint32_t fast_allocs;
+    uint32_t slow_allocs;
+    uint32_t frame_peak;
+} fb_alloc_site_stats_t;
+
+typedef struct fb_alloc_stats {
+    uint32_t peak;
+    uint32_t overlay_peak;
+    uint32_t allocs;
+    uint32_t dropped; // allocs from sites that did not fit in the table
+    uint32_t fails;
+    void *fail_site;
+    uint32_t fail_bytes;
+    fb_alloc_site_stats_t sites[FB_ALLOC_STATS_SITES];
+} fb_alloc_stats_t;
+
+const fb_alloc_stats_t *fb_alloc_stats();
+void fb_alloc_stats_reset();
+void fb_alloc_stats_print();
+#endif
 #endif /* __FF_ALLOC_H__ */
@@ -236,6 +236,40 @@ typedef enum {
 typedef void (*vsync_cb_t) (uint32_t vsync);
 typedef void (*frame_cb_t) ();
 
+// Per-line operations done on each line while it's copied to the frame buffer.
+#define SENSOR_LINE_OPS_MAX_BUFFERS   (3)
+
+typedef enum {
+    SENSOR_LINE_OP_HISTOGRAM  = (1 << 0), // 256-bin luminance histogram.
+    SENSOR_LINE_OP_STATISTICS = (1 << 1), // Luminance sum, min and max of each line.
+    SENSOR_LINE_OP_THRESHOLD  = (1 << 2), // Binary image of the pixels within a luminance range.
+    SENSOR_LINE_OP_DOWNSCALE  = (1 << 3), // Grayscale image box filtered down by an integer scale.
+} sensor_line_op_t;
+
+typedef struct sensor_line_stats {
+    uint32_t sum;
+    uint8_t min, max;
+} sensor_line_stats_t;
+
+typedef struct sensor_line_result {
+    bool valid;                     // Set once all lines of the frame were processed.
+    uint32_t *histogram;            // 256 bins.
+    sensor_line_stats_t *stats;     // One entry per line.
+    uint32_t *binary;               // BINARY image of w x h.
+    uint8_t *downscaled;            // GRAYSCALE image of (w / scale) x (h / scale).
+} sensor_line_result_t;
+
+typedef struct sensor_line_ops {
+    uint32_t ops;                   // Bitmask of sensor_line_op_t.
+    uint16_t w, h;                  // Frame size the results are computed for.
+    uint8_t threshold_min, threshold_max;
+    uint8_t scale;                  // Downscale factor.
+    uint8_t n_results;              // Number of allocated result sets.
+    uint16_t line;                  // Next line expected (used to drop partial frames).
+    uint16_t *downscale_acc;        // Column sums of the downscaled row in progress.
+    sensor_line_result_t results[SENSOR_LINE_OPS_MAX_BUFFERS]; // One per frame buffer.
+} sensor_line_ops_t;
+
 typedef struct _sensor sensor_t;
 typedef struct _sensor {
     union {
@@ -266,6 +300,7 @@ typedef struct _sensor {
 
     vsync_cb_t vsync_callback;  // VSYNC callback.
     frame_cb_t frame_callback;  // Frame callback.
+    sensor_line_ops_t *line_ops; // Per-line operations (NULL if disabled).
     polarity_t pwdn_pol;        // PWDN polarity (TODO move to hw_flags)
     polarity_t reset_pol;       // Reset polarity (TODO move to hw_flags)
 
@@ -474,6 +509,12 @@ int sensor_set_vsync_callback(vsync_cb_t vsync_cb);
 // Set frame callback function.
 int sensor_set_frame_callback(frame_cb_t vsync_cb);
 
+// Set per-line operations (NULL disables them).
+int sensor_set_line_ops(sensor_line_ops_t *line_ops);
+
+// Get the per-line operations results of the current frame (NULL if there are none).
+sensor_line_result_t *sensor_get_line_result();
+
 // Set color palette
 int sensor_set_color_palette(const uint16_t *color_palette);
 
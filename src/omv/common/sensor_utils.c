@@ -131,6 +131,9 @@ __weak int sensor_reset() {
     sensor.vsync_callback = NULL;
     sensor.frame_callback = NULL;
 
+    // Disable per-line operations.
+    sensor.line_ops = NULL;
+
     // Reset default color palette.
     sensor.color_palette = rainbow_table;
 
@@ -1153,6 +1156,38 @@ __weak int sensor_set_frame_callback(frame_cb_t vsync_cb) {
     return 0;
 }
 
+__weak int sensor_set_line_ops(sensor_line_ops_t *line_ops) {
+    // Disable any ongoing frame capture.
+    sensor_abort(true, false);
+
+    if (line_ops) {
+        if (sensor.transpose) {
+            return SENSOR_ERROR_INVALID_ARGUMENT;
+        }
+
+        line_ops->line = 0;
+        for (int i = 0; i < SENSOR_LINE_OPS_MAX_BUFFERS; i++) {
+            line_ops->results[i].valid = false;
+        }
+    }
+
+    sensor.line_ops = line_ops;
+    return 0;
+}
+
+__weak sensor_line_result_t *sensor_get_line_result() {
+    sensor_line_ops_t *ops = sensor.line_ops;
+
+    // Results are only meaningful for the frame size they were computed for.
+    if ((ops == NULL) || (MAIN_FB()->u != ops->w) || (MAIN_FB()->v != ops->h)
+        || (MAIN_FB()->head >= ops->n_results)) {
+        return NULL;
+    }
+
+    sensor_line_result_t *result = &ops->results[MAIN_FB()->head];
+    return result->valid ? result : NULL;
+}
+
 __weak int sensor_set_color_palette(const uint16_t *color_palette) {
     sensor.color_palette = color_palette;
     return 0;
@@ -1268,17 +1303,133 @@ __weak int sensor_auto_crop_framebuffer() {
         dstp += h;                                         \
     }
 
+#define sensor_line_ops_loop(luma)                                                       \
+    for (uint32_t x = 0; x < w; x++) {                                                   \
+        uint32_t y = (luma);                                                             \
+        sum += y;                                                                        \
+        min = IM_MIN(min, y);                                                            \
+        max = IM_MAX(max, y);                                                            \
+        if (histogram) {                                                                 \
+            histogram[y] += 1;                                                           \
+        }                                                                                \
+        if (binary) {                                                                    \
+            IMAGE_PUT_BINARY_PIXEL_FAST(binary, x, (lo <= y) && (y <= hi));              \
+        }                                                                                \
+        if (acc) {                                                                       \
+            acc[acc_x] += y;                                                             \
+            if (++acc_n == scale) {                                                      \
+                acc_n = 0;                                                               \
+                acc_x += 1;                                                              \
+            }                                                                            \
+        }                                                                                \
+    }
+
+// Runs the per-line operations on a line that was just copied to the frame buffer. This
+// saves a second pass over the frame (and the cache misses that come with it) for simple
+// statistics that would otherwise be computed after the frame is captured.
+static void sensor_run_line_ops(sensor_line_ops_t *ops, uint8_t *dst) {
+    uint32_t w = ops->w;
+    uint32_t h = ops->h;
+
+    if ((MAIN_FB()->u != w) || (MAIN_FB()->v != h)) {
+        return;
+    }
+
+    // Find the frame buffer and line the destination belongs to.
+    uint32_t bpp = ((sensor.pixformat == PIXFORMAT_RGB565) || (sensor.pixformat == PIXFORMAT_YUV422)) ? 2 : 1;
+    uint32_t size = framebuffer_get_buffer_size();
+    sensor_line_result_t *result = NULL;
+    uint32_t line = 0;
+
+    for (int32_t i = 0, ii = IM_MIN(ops->n_results, framebuffer->n_buffers); i < ii; i++) {
+        uint8_t *data = framebuffer_get_buffer(i)->data;
+        if ((data <= dst) && (dst < (data + size))) {
+            result = &ops->results[i];
+            line = (dst - data) / (w * bpp);
+            break;
+        }
+    }
+
+    if ((result == NULL) || (line >= h)) {
+        return;
+    }
+
+    if (line == 0) {
+        result->valid = false;
+        if (result->histogram) {
+            memset(result->histogram, 0, 256 * sizeof(uint32_t));
+        }
+        if (ops->downscale_acc) {
+            memset(ops->downscale_acc, 0, ((w / ops->scale) + 1) * sizeof(uint16_t));
+        }
+    } else if (line != ops->line) {
+        // Started in the middle of a frame or a line was dropped.
+        return;
+    }
+
+    ops->line = line + 1;
+
+    uint32_t *histogram = result->histogram;
+    uint32_t *binary = result->binary ? (result->binary + (((w + UINT32_T_MASK) >> UINT32_T_SHIFT) * line)) : NULL;
+    uint16_t *acc = ops->downscale_acc;
+    uint32_t lo = ops->threshold_min, hi = ops->threshold_max;
+    uint32_t scale = ops->scale, acc_x = 0, acc_n = 0;
+    uint32_t sum = 0, min = 255, max = 0;
+
+    switch (sensor.pixformat) {
+        case PIXFORMAT_BAYER:
+        case PIXFORMAT_GRAYSCALE:
+            sensor_line_ops_loop(dst[x]);
+            break;
+        case PIXFORMAT_RGB565:
+            sensor_line_ops_loop(COLOR_RGB565_TO_Y(((uint16_t *) dst)[x]));
+            break;
+        case PIXFORMAT_YUV422:
+            sensor_line_ops_loop(((uint16_t *) dst)[x] & 0xff);
+            break;
+        default:
+            return;
+    }
+
+    if (result->stats) {
+        result->stats[line].sum = sum;
+        result->stats[line].min = min;
+        result->stats[line].max = max;
+    }
+
+    if (acc && ((line % scale) == (scale - 1))) {
+        uint32_t dw = w / scale;
+        uint32_t row = line / scale;
+        uint32_t area = scale * scale;
+
+        if (row < (h / scale)) {
+            uint8_t *downscaled = result->downscaled + (dw * row);
+            for (uint32_t x = 0; x < dw; x++) {
+                downscaled[x] = acc[x] / area;
+            }
+        }
+
+        memset(acc, 0, (dw + 1) * sizeof(uint16_t));
+    }
+
+    if (line == (h - 1)) {
+        result->valid = true;
+    }
+}
+
 __weak int sensor_copy_line(void *dma, uint8_t *src, uint8_t *dst) {
     uint16_t *src16 = (uint16_t *) src;
     uint16_t *dst16 = (uint16_t *) dst;
     #if OMV_CSI_DMA_MEMCPY_ENABLE
     extern int sensor_dma_memcpy(void *dma, void *dst, void *src, int bpp, bool transposed);
+    // The per-line operations need the line to be copied by the CPU.
+    bool dma_memcpy = (sensor.line_ops == NULL);
     #endif
 
     switch (sensor.pixformat) {
         case PIXFORMAT_BAYER:
             #if OMV_CSI_DMA_MEMCPY_ENABLE
-            if (!sensor_dma_memcpy(dma, dst, src, sizeof(uint8_t), sensor.transpose)) {
+            if (dma_memcpy && !sensor_dma_memcpy(dma, dst, src, sizeof(uint8_t), sensor.transpose)) {
                 break;
             }
             #endif
@@ -1290,7 +1441,7 @@ __weak int sensor_copy_line(void *dma, uint8_t *src, uint8_t *dst) {
             break;
         case PIXFORMAT_GRAYSCALE:
             #if OMV_CSI_DMA_MEMCPY_ENABLE
-            if (!sensor_dma_memcpy(dma, dst, src, sizeof(uint8_t), sensor.transpose)) {
+            if (dma_memcpy && !sensor_dma_memcpy(dma, dst, src, sizeof(uint8_t), sensor.transpose)) {
                 break;
             }
             #endif
@@ -1313,7 +1464,7 @@ __weak int sensor_copy_line(void *dma, uint8_t *src, uint8_t *dst) {
         case PIXFORMAT_RGB565:
         case PIXFORMAT_YUV422:
             #if OMV_CSI_DMA_MEMCPY_ENABLE
-            if (!sensor_dma_memcpy(dma, dst16, src16, sizeof(uint16_t), sensor.transpose)) {
+            if (dma_memcpy && !sensor_dma_memcpy(dma, dst16, src16, sizeof(uint16_t), sensor.transpose)) {
                 break;
             }
             #endif
@@ -1338,6 +1489,11 @@ __weak int sensor_copy_line(void *dma, uint8_t *src, uint8_t *dst) {
         default:
             break;
     }
+
+    if (sensor.line_ops && !sensor.transpose) {
+        sensor_run_line_ops(sensor.line_ops, dst);
+    }
+
     return 0;
 }
 
@@ -5201,6 +5201,13 @@ struct apriltag_detector
     // quad_decimate = 1.
     int refine_edges;
 
+    // Detection of quads can be done on a lower-resolution image,
+    // improving speed at a cost of pose accuracy and a slight
+    // decrease in detection rate. Decoding the binary payload is
+    // still done at full resolution. Only integer factors are
+    // supported.
+    int quad_decimate;
+
     // when non-zero, detections are refined in a way intended to
     // increase the number of detected tags. Especially effective for
     // very small tags near the resolution threshold (e.g. 10px on a
@@ -10583,6 +10590,39 @@ image_u8_t *threshold(apriltag_detector_t *td, image_u8_t *im)
     return threshim;
 }
 
+// Box filters and subsamples the image by an integer factor, any remainder
+// rows/columns are dropped. The result is fb_alloc()ed (image then buffer).
+static image_u8_t *image_u8_decimate(image_u8_t *im, int factor)
+{
+    int w = im->width / factor, h = im->height / factor;
+    int div = factor * factor;
+
+    image_u8_t *decim = fb_alloc(sizeof(image_u8_t), FB_ALLOC_NO_HINT);
+    decim->width = w;
+    decim->height = h;
+    decim->stride = w;
+    decim->buf = fb_alloc(w * h, FB_ALLOC_NO_HINT);
+
+    for (int y = 0; y < h; y++) {
+        uint8_t *src = im->buf + (y * factor * im->stride);
+        uint8_t *dst = decim->buf + (y * decim->stride);
+
+        for (int x = 0; x < w; x++, src += factor) {
+            int acc = 0;
+
+            for (int j = 0; j < factor; j++) {
+                for (int i = 0; i < factor; i++) {
+                    acc += src[(j * im->stride) + i];
+                }
+            }
+
+            dst[x] = acc / div;
+        }
+    }
+
+    return decim;
+}
+
 zarray_t *apriltag_quad_thresh(apriltag_detector_t *td, image_u8_t *im, bool overrideMode)
 {
     ////////////////////////////////////////////////////////
@@ -10602,10 +10642,12 @@ zarray_t *apriltag_quad_thresh(apriltag_detector_t *td, image_u8_t *im, bool ove
         do_unionfind_line(uf, threshim, h, w, ts, y);
     }
 
-    uint32_t nclustermap;
-    struct uint32_zarray_entry **clustermap = fb_alloc0_all(&nclustermap, FB_ALLOC_PREFER_SPEED);
-    nclustermap /= sizeof(struct uint32_zarray_entry*);
+    // One bucket per 4 pixels (the w*h*1 hash table budgeted by the callers). Taking all the
+    // free memory instead makes every call pay for zeroing and walking it regardless of w*h.
+    uint32_t nclustermap = IM_MIN((uint32_t) IM_MAX((w * h) / 4, 1), fb_avail() / sizeof(struct uint32_zarray_entry*));
     if (!nclustermap) fb_alloc_fail();
+    struct uint32_zarray_entry **clustermap = fb_alloc0(nclustermap * sizeof(struct uint32_zarray_entry*),
+                                                        FB_ALLOC_PREFER_SPEED);
 
     for (int y = 1; y < h-1; y++) {
         for (int x = 1; x < w-1; x++) {
@@ -11113,6 +11155,7 @@ apriltag_detector_t *apriltag_detector_create()
     td->tag_families = zarray_create(sizeof(apriltag_family_t*));
 
     td->refine_edges = 1;
+    td->quad_decimate = 1;
     td->refine_pose = 0;
     td->refine_decode = 0;
 
@@ -11582,7 +11625,7 @@ static void refine_edges(apriltag_detector_t *td, image_u8_t *im_orig, struct qu
             // search on another pixel in the first place. Likewise,
             // for very small tags, we don't want the range to be too
             // big.
-            float range = 1.0 + 1;
+            float range = td->quad_decimate + 1;
 
             // XXX tunable step size.
             for (float n = -range; n <= range; n +=  0.25) {
@@ -11716,7 +11759,32 @@ zarray_t *apriltag_detector_detect(apriltag_detector_t *td, image_u8_t *im_orig)
     // and blurring parameters.
 
 //    zarray_t *quads = apriltag_quad_gradient(td, im_orig);
-    zarray_t *quads = apriltag_quad_thresh(td, im_orig, false);
+    zarray_t *quads;
+
+    if (td->quad_decimate > 1) {
+        image_u8_t *im_quads = image_u8_decimate(im_orig, td->quad_decimate);
+        quads = apriltag_quad_thresh(td, im_quads, false);
+        fb_free(); // im_quads->buf
+        fb_free(); // im_quads
+
+        // Map the corners back to the full resolution image. A decimated
+        // pixel is the average of a factor x factor block so its center
+        // is (factor - 1) / 2 pixels into the block. refine_edges() then
+        // snaps the edges to the full resolution gradients.
+        float offset = (td->quad_decimate - 1) * 0.5f;
+
+        for (int i = 0; i < zarray_size(quads); i++) {
+            struct quad *q;
+            zarray_get_volatile(quads, i, &q);
+
+            for (int j = 0; j < 4; j++) {
+                q->p[j][0] = (q->p[j][0] * td->quad_decimate) + offset;
+                q->p[j][1] = (q->p[j][1] * td->quad_decimate) + offset;
+            }
+        }
+    } else {
+        quads = apriltag_quad_thresh(td, im_orig, false);
+    }
 
     zarray_t *detections = zarray_create(sizeof(apriltag_detection_t*));
 
@@ -11947,16 +12015,19 @@ void apriltag_detections_destroy(zarray_t *detections)
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void imlib_find_apriltags(list_t *out, image_t *ptr, rectangle_t *roi, apriltag_families_t families,
-                          float fx, float fy, float cx, float cy)
+                          float fx, float fy, float cx, float cy, int quad_decimate, image_planes_t *planes)
 {
     // Frame Buffer Memory Usage...
     // -> GRAYSCALE Input Image = w*h*1
-    // -> GRAYSCALE Threhsolded Image = w*h*1
-    // -> UnionFind = w*h*2 (+w*h*1 for hash table)
+    // -> GRAYSCALE Decimated Image = (w/d)*(h/d)*1 (when quad_decimate > 1)
+    // -> GRAYSCALE Threhsolded Image = (w/d)*(h/d)*1
+    // -> UnionFind = (w/d)*(h/d)*2 (+(w/d)*(h/d)*1 for hash table)
     size_t resolution = roi->w * roi->h;
-    size_t fb_alloc_need = resolution * (1 + 1 + 2 + 1); // read above...
+    size_t quad_resolution = (roi->w / quad_decimate) * (roi->h / quad_decimate);
+    size_t fb_alloc_need = resolution + (quad_resolution * (((quad_decimate > 1) ? 1 : 0) + 1 + 2 + 1)); // read above...
     umm_init_x(((fb_avail() - fb_alloc_need) / resolution) * resolution);
     apriltag_detector_t *td = apriltag_detector_create();
+    td->quad_decimate = quad_decimate;
 
     if (families & TAG16H5) {
         apriltag_detector_add_family(td, (apriltag_family_t *) &tag16h5);
@@ -11987,7 +12058,7 @@ void imlib_find_apriltags(list_t *out, image_t *ptr, rectangle_t *roi, apriltag_
     img.h = roi->h;
     img.pixfmt = PIXFORMAT_GRAYSCALE;
     img.data = fb_alloc(image_size(&img), FB_ALLOC_NO_HINT);
-    imlib_draw_image(&img, ptr, 0, 0, 1.f, 1.f, roi, -1, 256, NULL, NULL, 0, NULL, NULL, NULL);
+    imlib_planes_grayscale_roi(planes, ptr, roi, img.data);
 
     image_u8_t im;
     im.width = roi->w;
@@ -12075,7 +12146,7 @@ void imlib_find_apriltags(list_t *out, image_t *ptr, rectangle_t *roi, apriltag_
 }
 
 #ifdef IMLIB_ENABLE_FIND_RECTS
-void imlib_find_rects(list_t *out, image_t *ptr, rectangle_t *roi, uint32_t threshold)
+void imlib_find_rects(list_t *out, image_t *ptr, rectangle_t *roi, uint32_t threshold, image_planes_t *planes)
 {
     // Frame Buffer Memory Usage...
     // -> GRAYSCALE Input Image = w*h*1
@@ -12091,7 +12162,7 @@ void imlib_find_rects(list_t *out, image_t *ptr, rectangle_t *roi, uint32_t thre
     img.h = roi->h;
     img.pixfmt = PIXFORMAT_GRAYSCALE;
     img.data = fb_alloc(image_size(&img), FB_ALLOC_NO_HINT);
-    imlib_draw_image(&img, ptr, 0, 0, 1.f, 1.f, roi, -1, 256, NULL, NULL, 0, NULL, NULL, NULL);
+    imlib_planes_grayscale_roi(planes, ptr, roi, img.data);
 
     image_u8_t im;
     im.width = roi->w;
@@ -118,55 +118,71 @@ void imlib_mask_line_op(int x, int x_end, int y_row, imlib_draw_row_data_t *data
     }
 }
 
-void imlib_binary(image_t *out, image_t *img, list_t *thresholds, bool invert, bool zero, image_t *mask) {
+void imlib_binary(image_t *out, image_t *img, list_t *thresholds, color_thresholds_bitmap_t *bitmap,
+                  bool invert, bool zero, image_t *mask) {
     image_t bmp;
     bmp.w = img->w;
     bmp.h = img->h;
     bmp.pixfmt = PIXFORMAT_BINARY;
     bmp.data = fb_alloc0(image_size(&bmp), FB_ALLOC_NO_HINT);
 
-    list_for_each(it, thresholds) {
-        color_thresholds_list_lnk_data_t *lnk_data = list_get_data(it);
-
-        switch (img->pixfmt) {
-            case PIXFORMAT_BINARY: {
-                for (int y = 0, yy = img->h; y < yy; y++) {
-                    uint32_t *old_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y);
-                    uint32_t *bmp_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
-                    for (int x = 0, xx = img->w; x < xx; x++) {
-                        if (COLOR_THRESHOLD_BINARY(IMAGE_GET_BINARY_PIXEL_FAST(old_row_ptr, x), lnk_data, invert)) {
-                            IMAGE_SET_BINARY_PIXEL_FAST(bmp_row_ptr, x);
-                        }
-                    }
+    if (bitmap && bitmap->count && (img->pixfmt == PIXFORMAT_RGB565)) {
+        // A pixel is set if it matches any threshold, or with invert, if it fails any threshold
+        // which is the same as not matching all of them. So one lookup covers all thresholds.
+        uint32_t *bits = invert ? bitmap->all : bitmap->any;
+        for (int y = 0, yy = img->h; y < yy; y++) {
+            uint16_t *old_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y);
+            uint32_t *bmp_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
+            for (int x = 0, xx = img->w; x < xx; x++) {
+                if (COLOR_THRESHOLD_BITMAP(IMAGE_GET_RGB565_PIXEL_FAST(old_row_ptr, x), bits, invert)) {
+                    IMAGE_SET_BINARY_PIXEL_FAST(bmp_row_ptr, x);
                 }
-                break;
             }
-            case PIXFORMAT_GRAYSCALE: {
-                for (int y = 0, yy = img->h; y < yy; y++) {
-                    uint8_t *old_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y);
-                    uint32_t *bmp_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
-                    for (int x = 0, xx = img->w; x < xx; x++) {
-                        if (COLOR_THRESHOLD_GRAYSCALE(IMAGE_GET_GRAYSCALE_PIXEL_FAST(old_row_ptr, x), lnk_data, invert)) {
-                            IMAGE_SET_BINARY_PIXEL_FAST(bmp_row_ptr, x);
+        }
+    } else {
+        list_for_each(it, thresholds) {
+            color_thresholds_list_lnk_data_t *lnk_data = list_get_data(it);
+
+            switch (img->pixfmt) {
+                case PIXFORMAT_BINARY: {
+                    for (int y = 0, yy = img->h; y < yy; y++) {
+                        uint32_t *old_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y);
+                        uint32_t *bmp_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
+                        for (int x = 0, xx = img->w; x < xx; x++) {
+                            if (COLOR_THRESHOLD_BINARY(IMAGE_GET_BINARY_PIXEL_FAST(old_row_ptr, x), lnk_data, invert)) {
+                                IMAGE_SET_BINARY_PIXEL_FAST(bmp_row_ptr, x);
+                            }
                         }
                     }
-                }
-                break;
-            }
-            case PIXFORMAT_RGB565: {
-                for (int y = 0, yy = img->h; y < yy; y++) {
-                    uint16_t *old_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y);
-                    uint32_t *bmp_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
-                    for (int x = 0, xx = img->w; x < xx; x++) {
-                        if (COLOR_THRESHOLD_RGB565(IMAGE_GET_RGB565_PIXEL_FAST(old_row_ptr, x), lnk_data, invert)) {
-                            IMAGE_SET_BINARY_PIXEL_FAST(bmp_row_ptr, x);
+                    break;
+                }
+                case PIXFORMAT_GRAYSCALE: {
+                    for (int y = 0, yy = img->h; y < yy; y++) {
+                        uint8_t *old_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y);
+                        uint32_t *bmp_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
+                        for (int x = 0, xx = img->w; x < xx; x++) {
+                            if (COLOR_THRESHOLD_GRAYSCALE(IMAGE_GET_GRAYSCALE_PIXEL_FAST(old_row_ptr, x), lnk_data, invert)) {
+                                IMAGE_SET_BINARY_PIXEL_FAST(bmp_row_ptr, x);
+                            }
+                        }
+                    }
+                    break;
+                }
+                case PIXFORMAT_RGB565: {
+                    for (int y = 0, yy = img->h; y < yy; y++) {
+                        uint16_t *old_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y);
+                        uint32_t *bmp_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
+                        for (int x = 0, xx = img->w; x < xx; x++) {
+                            if (COLOR_THRESHOLD_RGB565(IMAGE_GET_RGB565_PIXEL_FAST(old_row_ptr, x), lnk_data, invert)) {
+                                IMAGE_SET_BINARY_PIXEL_FAST(bmp_row_ptr, x);
+                            }
                         }
                     }
+                    break;
+                }
+                default: {
+                    break;
                 }
-                break;
-            }
-            default: {
-                break;
             }
         }
     }
@@ -899,7 +915,192 @@ void imlib_b_xnor(image_t *img, const char *path, image_t *other, int scalar, im
     imlib_image_operation(img, path, other, scalar, imlib_b_xnor_line_op, mask);
 }
 
+// Returns the 32 bits of a bit row starting at bit p. Bits outside of the row are fill.
+static inline uint32_t morph_row_bits(uint32_t *row, int words, int p, uint32_t fill) {
+    int i = (p >= 0) ? (p >> UINT32_T_SHIFT) : -((UINT32_T_MASK - p) >> UINT32_T_SHIFT);
+    int b = p & UINT32_T_MASK;
+    uint32_t lo = ((i >= 0) && (i < words)) ? row[i] : fill;
+
+    if (!b) {
+        return lo;
+    }
+
+    uint32_t hi = (((i + 1) >= 0) && ((i + 1) < words)) ? row[i + 1] : fill;
+    return (lo >> b) | (hi << (UINT32_T_BITS - b));
+}
+
+// ANDs (erode) or ORs (dilate) the 2*ksize+1 bits around each bit of src into dst 32 pixels at a time.
+// The window is built out of power of two sized windows so this costs log2(ksize) passes over the row.
+// Bits past the end of src must be set to the fill value. The temporary rows hold src shifted right by
+// ksize bits so that windows only look forward and must be MORPH_ROW_WORDS() long.
+#define MORPH_ROW_WORDS(w, ksize)   (((w) + ((ksize) * 2) + UINT32_T_MASK) >> UINT32_T_SHIFT)
+
+static void morph_row(uint32_t *dst, uint32_t *src, uint32_t *tmp0, uint32_t *tmp1, int words, int tmp_words,
+                      int ksize, bool dilate) {
+    uint32_t fill = dilate ? 0 : 0xFFFFFFFF;
+    uint32_t *p = tmp0, *t = tmp1;
+
+    for (int i = 0; i < tmp_words; i++) {
+        p[i] = morph_row_bits(src, words, (i << UINT32_T_SHIFT) - ksize, fill);
+    }
+
+    for (int i = 0; i < words; i++) {
+        dst[i] = fill;
+    }
+
+    // p holds the AND/OR of the len bits starting at each bit.
+    for (int n = (ksize * 2) + 1, len = 1, pos = 0; n; n >>= 1) {
+        if (n & 1) {
+            for (int i = 0; i < words; i++) {
+                uint32_t bits = morph_row_bits(p, tmp_words, (i << UINT32_T_SHIFT) + pos, fill);
+                dst[i] = dilate ? (dst[i] | bits) : (dst[i] & bits);
+            }
+            pos += len;
+        }
+
+        if (n > 1) {
+            for (int i = 0; i < tmp_words; i++) {
+                uint32_t bits = morph_row_bits(p, tmp_words, (i << UINT32_T_SHIFT) + len, fill);
+                t[i] = dilate ? (p[i] | bits) : (p[i] & bits);
+            }
+            uint32_t *tmp = p;
+            p = t;
+            t = tmp;
+            len <<= 1;
+        }
+    }
+}
+
+// Erode/dilate for when all/any pixel of the kernel must be set (threshold 0) on BINARY and GRAYSCALE
+// images. This is a separable min/max filter on a bit image of the non-zero pixels. Rows are filtered
+// 32 pixels at a time and columns with the van Herk/Gil-Werman algorithm which needs 3 operations per
+// output word no matter the kernel size. Output is the same as imlib_erode_dilate().
+static void imlib_erode_dilate_fast(image_t *img, int ksize, int e_or_d, image_t *mask) {
+    bool dilate = e_or_d;
+    uint32_t fill = dilate ? 0 : 0xFFFFFFFF;
+    int words = IMAGE_BINARY_LINE_LEN(img);
+    int tmp_words = MORPH_ROW_WORDS(img->w, ksize);
+    int k_len = (ksize * 2) + 1;
+    // Rows outside of the image are padded with fill which is the same as clamping for min/max.
+    int rows = img->h + (ksize * 2);
+    uint32_t tail = (img->w & UINT32_T_MASK) ? ((1 << (img->w & UINT32_T_MASK)) - 1) : 0xFFFFFFFF;
+
+    uint32_t *prefix = fb_alloc(rows * words * sizeof(uint32_t), FB_ALLOC_NO_HINT);
+    uint32_t *suffix = fb_alloc(rows * words * sizeof(uint32_t), FB_ALLOC_NO_HINT);
+    uint32_t *line = fb_alloc(words * sizeof(uint32_t), FB_ALLOC_NO_HINT);
+    uint32_t *tmp0 = fb_alloc(tmp_words * sizeof(uint32_t), FB_ALLOC_NO_HINT);
+    uint32_t *tmp1 = fb_alloc(tmp_words * sizeof(uint32_t), FB_ALLOC_NO_HINT);
+
+    for (int r = 0; r < rows; r++) {
+        uint32_t *prefix_row = prefix + (r * words);
+        int y = r - ksize;
+
+        if ((y < 0) || (y >= img->h)) {
+            for (int i = 0; i < words; i++) {
+                prefix_row[i] = fill;
+            }
+        } else {
+            if (img->pixfmt == PIXFORMAT_BINARY) {
+                memcpy(line, IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y), words * sizeof(uint32_t));
+            } else {
+                uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y);
+                memset(line, 0, words * sizeof(uint32_t));
+                for (int x = 0, xx = img->w; x < xx; x++) {
+                    if (IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x)) {
+                        IMAGE_SET_BINARY_PIXEL_FAST(line, x);
+                    }
+                }
+            }
+
+            line[words - 1] = dilate ? (line[words - 1] & tail) : (line[words - 1] | ~tail);
+            morph_row(prefix_row, line, tmp0, tmp1, words, tmp_words, ksize, dilate);
+        }
+
+        memcpy(suffix + (r * words), prefix_row, words * sizeof(uint32_t));
+    }
+
+    // Running AND/OR from the start of each block of k_len rows and from the end of each block.
+    for (int r = 1; r < rows; r++) {
+        if (r % k_len) {
+            uint32_t *row = prefix + (r * words), *prev = row - words;
+            for (int i = 0; i < words; i++) {
+                row[i] = dilate ? (row[i] | prev[i]) : (row[i] & prev[i]);
+            }
+        }
+    }
+
+    for (int r = rows - 2; r >= 0; r--) {
+        if ((r % k_len) != (k_len - 1)) {
+            uint32_t *row = suffix + (r * words), *next = row + words;
+            for (int i = 0; i < words; i++) {
+                row[i] = dilate ? (row[i] | next[i]) : (row[i] & next[i]);
+            }
+        }
+    }
+
+    for (int y = 0, yy = img->h; y < yy; y++) {
+        // The window for y covers padded rows y to y + k_len - 1 which spans at most two blocks.
+        uint32_t *suffix_row = suffix + (y * words);
+        uint32_t *prefix_row = prefix + ((y + k_len - 1) * words);
+
+        for (int i = 0; i < words; i++) {
+            line[i] = dilate ? (suffix_row[i] | prefix_row[i]) : (suffix_row[i] & prefix_row[i]);
+        }
+
+        if (img->pixfmt == PIXFORMAT_BINARY) {
+            uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y);
+
+            if (!mask) {
+                memcpy(row_ptr, line, words * sizeof(uint32_t));
+                continue;
+            }
+
+            for (int x = 0, xx = img->w; x < xx; x++) {
+                if (image_get_mask_pixel(mask, x, y)) {
+                    IMAGE_PUT_BINARY_PIXEL_FAST(row_ptr, x, IMAGE_GET_BINARY_PIXEL_FAST(line, x));
+                }
+            }
+        } else {
+            uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y);
+
+            for (int x = 0, xx = img->w; x < xx; x++) {
+                if (mask && (!image_get_mask_pixel(mask, x, y))) {
+                    continue; // Short circuit.
+                }
+
+                // Preserve original pixel value... or clear/set it.
+                if (!dilate) {
+                    if (!IMAGE_GET_BINARY_PIXEL_FAST(line, x)) {
+                        IMAGE_PUT_GRAYSCALE_PIXEL_FAST(row_ptr, x, COLOR_GRAYSCALE_BINARY_MIN);
+                    }
+                } else {
+                    if (IMAGE_GET_BINARY_PIXEL_FAST(line, x)) {
+                        IMAGE_PUT_GRAYSCALE_PIXEL_FAST(row_ptr, x, COLOR_GRAYSCALE_BINARY_MAX);
+                    }
+                }
+            }
+        }
+    }
+
+    fb_free(); // tmp1
+    fb_free(); // tmp0
+    fb_free(); // line
+    fb_free(); // suffix
+    fb_free(); // prefix
+}
+
+// Set to 0 to always use the counting path below.
+#ifndef ERODE_DILATE_FAST
+#define ERODE_DILATE_FAST   (1)
+#endif
+
 static void imlib_erode_dilate(image_t *img, int ksize, int threshold, int e_or_d, image_t *mask) {
+    if (ERODE_DILATE_FAST && ((img->pixfmt == PIXFORMAT_BINARY) || (img->pixfmt == PIXFORMAT_GRAYSCALE))
+        && (threshold == (e_or_d ? 0 : (imlib_ksize_to_n(ksize) - 1)))) {
+        imlib_erode_dilate_fast(img, ksize, e_or_d, mask);
+        return;
+    }
+
     int brows = ksize + 1;
     image_t buf;
     buf.w = img->w;
@@ -922,7 +1123,7 @@ static void imlib_erode_dilate(image_t *img, int ksize, int threshold, int e_or_
                     if (mask && (!image_get_mask_pixel(mask, x, y))) {
                         continue; // Short circuit.
                     }
-                    if (x > ksize && x < img->w - ksize && y >= ksize && y < img->h - ksize) {
+                    if (!mask && x > ksize && x < img->w - ksize && y >= ksize && y < img->h - ksize) {
                         // faster
                         for (int j = -ksize; j <= ksize; j++) {
                             uint32_t *k_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y + j);
@@ -991,7 +1192,7 @@ static void imlib_erode_dilate(image_t *img, int ksize, int threshold, int e_or_
                         continue; // Short circuit.
                     }
 
-                    if (x > ksize && x < img->w - ksize && y >= ksize && y < img->h - ksize) {
+                    if (!mask && x > ksize && x < img->w - ksize && y >= ksize && y < img->h - ksize) {
                         // faster
                         for (int j = -ksize; j <= ksize; j++) {
                             uint8_t *k_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y + j);
@@ -1062,7 +1263,7 @@ static void imlib_erode_dilate(image_t *img, int ksize, int threshold, int e_or_
                         continue; // Short circuit.
                     }
 
-                    if (x > ksize && x < img->w - ksize && y >= ksize && y < img->h - ksize) {
+                    if (!mask && x > ksize && x < img->w - ksize && y >= ksize && y < img->h - ksize) {
                         // faster
                         for (int j = -ksize; j <= ksize; j++) {
                             uint16_t *k_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y + j);
@@ -15,6 +15,9 @@ typedef struct xylr {
 }
 xylr_t;
 
+// Blob codes and the threshold masks of the single pass are 32-bit so it handles at most 32 thresholds.
+#define FIND_BLOBS_THRESHOLDS_MAX   (32)
+
 static float sign(float x) {
     return x / fabsf(x);
 }
@@ -122,12 +125,704 @@ static float calc_roundness(float blob_a, float blob_b, float blob_c) {
     return IM_DIV(roundness_min, roundness_max);
 }
 
+static void find_blobs_merge(list_t *out, int margin,
+                             bool (*merge_cb) (void *, find_blobs_list_lnk_data_t *, find_blobs_list_lnk_data_t *),
+                             void *merge_cb_arg, unsigned int x_hist_bins_max, unsigned int y_hist_bins_max) {
+    for (;;) {
+        bool merge_occured = false;
+
+        list_t out_temp;
+        list_init(&out_temp, sizeof(find_blobs_list_lnk_data_t));
+
+        while (list_size(out)) {
+            find_blobs_list_lnk_data_t lnk_blob;
+            list_pop_front(out, &lnk_blob);
+
+            for (size_t k = 0, l = list_size(out); k < l; k++) {
+                find_blobs_list_lnk_data_t tmp_blob;
+                list_pop_front(out, &tmp_blob);
+
+                rectangle_t temp;
+                temp.x = __SSAT(tmp_blob.rect.x - margin, 16);
+                temp.y = __SSAT(tmp_blob.rect.y - margin, 16);
+                temp.w = __USAT(tmp_blob.rect.w + (margin * 2), 15);
+                temp.h = __USAT(tmp_blob.rect.h + (margin * 2), 15);
+
+                if (rectangle_overlap(&(lnk_blob.rect), &temp)
+                    && ((merge_cb_arg == NULL) || merge_cb(merge_cb_arg, &lnk_blob, &tmp_blob))) {
+                    // Have to merge these first before merging rects.
+                    if (x_hist_bins_max) {
+                        merge_bins(lnk_blob.rect.x,
+                                   lnk_blob.rect.x + lnk_blob.rect.w - 1,
+                                   &lnk_blob.x_hist_bins,
+                                   &lnk_blob.x_hist_bins_count,
+                                   tmp_blob.rect.x,
+                                   tmp_blob.rect.x + tmp_blob.rect.w - 1,
+                                   &tmp_blob.x_hist_bins,
+                                   &tmp_blob.x_hist_bins_count,
+                                   x_hist_bins_max);
+                    }
+                    if (y_hist_bins_max) {
+                        merge_bins(lnk_blob.rect.y,
+                                   lnk_blob.rect.y + lnk_blob.rect.h - 1,
+                                   &lnk_blob.y_hist_bins,
+                                   &lnk_blob.y_hist_bins_count,
+                                   tmp_blob.rect.y,
+                                   tmp_blob.rect.y + tmp_blob.rect.h - 1,
+                                   &tmp_blob.y_hist_bins,
+                                   &tmp_blob.y_hist_bins_count,
+                                   y_hist_bins_max);
+                    }
+                    // Merge corners...
+                    for (int i = 0; i < FIND_BLOBS_CORNERS_RESOLUTION; i++) {
+                        float z_dst = (lnk_blob.corners[i].x * cos_table[FIND_BLOBS_ANGLE_RESOLUTION * i]) +
+                                      (lnk_blob.corners[i].y * sin_table[FIND_BLOBS_ANGLE_RESOLUTION * i]);
+                        float z_src = (tmp_blob.corners[i].x * cos_table[FIND_BLOBS_ANGLE_RESOLUTION * i]) +
+                                      (tmp_blob.corners[i].y * cos_table[FIND_BLOBS_ANGLE_RESOLUTION * i]);
+                        if (z_src < z_dst) {
+                            lnk_blob.corners[i].x = tmp_blob.corners[i].x;
+                            lnk_blob.corners[i].y = tmp_blob.corners[i].y;
+                        }
+                    }
+                    // Merge rects...
+                    rectangle_united(&(lnk_blob.rect), &(tmp_blob.rect));
+                    // Merge counters...
+                    lnk_blob.pixels += tmp_blob.pixels; // won't overflow
+                    lnk_blob.perimeter += tmp_blob.perimeter; // won't overflow
+                    lnk_blob.code |= tmp_blob.code; // won't overflow
+                    lnk_blob.count += tmp_blob.count; // won't overflow
+                    // Merge accumulators...
+                    lnk_blob.centroid_x_acc += tmp_blob.centroid_x_acc;
+                    lnk_blob.centroid_y_acc += tmp_blob.centroid_y_acc;
+                    lnk_blob.rotation_acc_x += tmp_blob.rotation_acc_x;
+                    lnk_blob.rotation_acc_y += tmp_blob.rotation_acc_y;
+                    lnk_blob.roundness_acc += tmp_blob.roundness_acc;
+                    // Compute current values...
+                    lnk_blob.centroid_x = lnk_blob.centroid_x_acc / lnk_blob.pixels;
+                    lnk_blob.centroid_y = lnk_blob.centroid_y_acc / lnk_blob.pixels;
+                    lnk_blob.rotation = fast_atan2f(lnk_blob.rotation_acc_y / lnk_blob.pixels,
+                                                    lnk_blob.rotation_acc_x / lnk_blob.pixels);
+                    lnk_blob.roundness = lnk_blob.roundness_acc / lnk_blob.pixels;
+                    merge_occured = true;
+                } else {
+                    list_push_back(out, &tmp_blob);
+                }
+            }
+
+            list_push_back(&out_temp, &lnk_blob);
+        }
+
+        list_copy(out, &out_temp);
+
+        if (!merge_occured) {
+            break;
+        }
+    }
+}
+
+// Per blob statistics accumulated one horizontal run of pixels at a time.
+typedef struct find_blobs_acc {
+    float corners_acc[FIND_BLOBS_CORNERS_RESOLUTION];
+    point_t corners[FIND_BLOBS_CORNERS_RESOLUTION];
+    int corners_n[FIND_BLOBS_CORNERS_RESOLUTION];
+    int pixels;
+    int perimeter;
+    int cx;
+    int cy;
+    long long a;
+    long long b;
+    long long c;
+} find_blobs_acc_t;
+
+static void find_blobs_acc_init(find_blobs_acc_t *acc, int x_max, int y_max) {
+    // These values are initialized to their maximum before we minimize.
+    for (int i = 0; i < FIND_BLOBS_CORNERS_RESOLUTION; i++) {
+        acc->corners[i].x = IM_CLAMP(x_max * sign(cos_table[FIND_BLOBS_ANGLE_RESOLUTION * i]), 0, x_max);
+        acc->corners[i].y = IM_CLAMP(y_max * sign(sin_table[FIND_BLOBS_ANGLE_RESOLUTION * i]), 0, y_max);
+        acc->corners_acc[i] = (acc->corners[i].x * cos_table[FIND_BLOBS_ANGLE_RESOLUTION * i]) +
+                              (acc->corners[i].y * sin_table[FIND_BLOBS_ANGLE_RESOLUTION * i]);
+        acc->corners_n[i] = 1;
+    }
+
+    acc->pixels = 0;
+    acc->perimeter = 0;
+    acc->cx = 0;
+    acc->cy = 0;
+    acc->a = 0;
+    acc->b = 0;
+    acc->c = 0;
+}
+
+static void find_blobs_acc_add_run(find_blobs_acc_t *acc, int y, int left, int right,
+                                   uint16_t *x_hist_bins, uint16_t *y_hist_bins) {
+    int sum = sum_m_to_n(left, right);
+    int sum_2 = sum_2_m_to_n(left, right);
+    int cnt = right - left + 1;
+    int avg = sum / cnt;
+
+    for (int i = 0; i < FIND_BLOBS_CORNERS_RESOLUTION; i++) {
+        int x_new = (cos_table[FIND_BLOBS_ANGLE_RESOLUTION * i] > 0) ? left :
+                    ((cos_table[FIND_BLOBS_ANGLE_RESOLUTION * i] == 0) ? avg : right);
+        float z = (x_new * cos_table[FIND_BLOBS_ANGLE_RESOLUTION * i]) +
+                  (y * sin_table[FIND_BLOBS_ANGLE_RESOLUTION * i]);
+        if (z < acc->corners_acc[i]) {
+            acc->corners_acc[i] = z;
+            acc->corners[i].x = x_new;
+            acc->corners[i].y = y;
+            acc->corners_n[i] = 1;
+        } else if (z == acc->corners_acc[i]) {
+            acc->corners[i].x = cumulative_moving_average(acc->corners[i].x, x_new, acc->corners_n[i]);
+            acc->corners[i].y = cumulative_moving_average(acc->corners[i].y, y, acc->corners_n[i]);
+            acc->corners_n[i] += 1;
+        }
+    }
+
+    acc->pixels += cnt;
+    acc->perimeter += 2;
+    acc->cx += sum;
+    acc->cy += y * cnt;
+    acc->a += sum_2;
+    acc->b += y * sum;
+    acc->c += y * y * cnt;
+
+    if (y_hist_bins) {
+        y_hist_bins[y] += cnt;
+    }
+    if (x_hist_bins) {
+        for (int i = left; i <= right; i++) {
+            x_hist_bins[i] += 1;
+        }
+    }
+}
+
+// Computes the final blob statistics and adds the blob to the output list if it passes the filters.
+static void find_blobs_acc_output(find_blobs_acc_t *acc, list_t *out, image_t *ptr, size_t code,
+                                  unsigned int area_threshold, unsigned int pixels_threshold,
+                                  bool (*threshold_cb) (void *, find_blobs_list_lnk_data_t *), void *threshold_cb_arg,
+                                  uint16_t *x_hist_bins, uint16_t *y_hist_bins,
+                                  unsigned int x_hist_bins_max, unsigned int y_hist_bins_max) {
+    point_t *corners = acc->corners;
+    rectangle_t rect;
+    rect.x = corners[(FIND_BLOBS_CORNERS_RESOLUTION * 0) / 4].x; // l
+    rect.y = corners[(FIND_BLOBS_CORNERS_RESOLUTION * 1) / 4].y; // t
+    rect.w = corners[(FIND_BLOBS_CORNERS_RESOLUTION * 2) / 4].x -
+             corners[(FIND_BLOBS_CORNERS_RESOLUTION * 0) / 4].x + 1; // r - l + 1
+    rect.h = corners[(FIND_BLOBS_CORNERS_RESOLUTION * 3) / 4].y -
+             corners[(FIND_BLOBS_CORNERS_RESOLUTION * 1) / 4].y + 1; // b - t + 1
+
+    if (((rect.w * rect.h) < area_threshold) || (acc->pixels < pixels_threshold)) {
+        return;
+    }
+
+    // See imlib_find_blobs() for the derivation of the moments below.
+    float b_mx = acc->cx / ((float) acc->pixels);
+    float b_my = acc->cy / ((float) acc->pixels);
+    int mx = fast_roundf(b_mx); // x centroid
+    int my = fast_roundf(b_my); // y centroid
+    int small_blob_a = acc->a - ((mx * acc->cx) + (mx * acc->cx)) + (acc->pixels * mx * mx);
+    int small_blob_b = acc->b - ((mx * acc->cy) + (my * acc->cx)) + (acc->pixels * mx * my);
+    int small_blob_c = acc->c - ((my * acc->cy) + (my * acc->cy)) + (acc->pixels * my * my);
+
+    find_blobs_list_lnk_data_t lnk_blob;
+    memcpy(lnk_blob.corners, corners, FIND_BLOBS_CORNERS_RESOLUTION * sizeof(point_t));
+    memcpy(&lnk_blob.rect, &rect, sizeof(rectangle_t));
+    lnk_blob.pixels = acc->pixels;
+    lnk_blob.perimeter = acc->perimeter;
+    lnk_blob.code = 1 << code;
+    lnk_blob.count = 1;
+    lnk_blob.centroid_x = b_mx;
+    lnk_blob.centroid_y = b_my;
+    lnk_blob.rotation = (small_blob_a != small_blob_c) ?
+                        (fast_atan2f(2 * small_blob_b, small_blob_a - small_blob_c) / 2.0f) : 0.0f;
+    lnk_blob.roundness = calc_roundness(small_blob_a, small_blob_b, small_blob_c);
+    lnk_blob.x_hist_bins_count = 0;
+    lnk_blob.x_hist_bins = NULL;
+    lnk_blob.y_hist_bins_count = 0;
+    lnk_blob.y_hist_bins = NULL;
+    // These store the current average accumulation.
+    lnk_blob.centroid_x_acc = lnk_blob.centroid_x * lnk_blob.pixels;
+    lnk_blob.centroid_y_acc = lnk_blob.centroid_y * lnk_blob.pixels;
+    lnk_blob.rotation_acc_x = cosf(lnk_blob.rotation) * lnk_blob.pixels;
+    lnk_blob.rotation_acc_y = sinf(lnk_blob.rotation) * lnk_blob.pixels;
+    lnk_blob.roundness_acc = lnk_blob.roundness * lnk_blob.pixels;
+
+    if (x_hist_bins) {
+        bin_up(x_hist_bins, ptr->w, x_hist_bins_max, &lnk_blob.x_hist_bins, &lnk_blob.x_hist_bins_count);
+    }
+
+    if (y_hist_bins) {
+        bin_up(y_hist_bins, ptr->h, y_hist_bins_max, &lnk_blob.y_hist_bins, &lnk_blob.y_hist_bins_count);
+    }
+
+    bool add_to_list = threshold_cb_arg == NULL;
+    if (!add_to_list) {
+        // Protect ourselves from caught exceptions in the callback
+        // code from freeing our fb_alloc() stack.
+        fb_alloc_mark();
+        fb_alloc_mark_permanent();
+        add_to_list = threshold_cb(threshold_cb_arg, &lnk_blob);
+        fb_alloc_free_till_mark_past_mark_permanent();
+    }
+
+    if (add_to_list) {
+        list_push_back(out, &lnk_blob);
+    } else {
+        if (lnk_blob.x_hist_bins) {
+            xfree(lnk_blob.x_hist_bins);
+        }
+        if (lnk_blob.y_hist_bins) {
+            xfree(lnk_blob.y_hist_bins);
+        }
+    }
+}
+
+// Pixels are classified into a mask of the thresholds they match, bit j for threshold j. Gray pixels
+// are looked up directly. RGB565 pixels are converted to LAB and the masks of the thresholds each of
+// L, A and B is in are ANDed together, so classifying a pixel costs the same for any number of thresholds.
+typedef struct find_blobs_labeler {
+    image_t *ptr;
+    color_thresholds_bitmap_t *bitmap;
+    bool invert;
+    uint32_t all;
+    uint32_t *lut;
+} find_blobs_labeler_t;
+
+#define FIND_BLOBS_LUT_L_OFFSET     (0)
+#define FIND_BLOBS_LUT_A_OFFSET     (COLOR_L_MAX - COLOR_L_MIN + 1)
+#define FIND_BLOBS_LUT_B_OFFSET     (FIND_BLOBS_LUT_A_OFFSET + COLOR_A_MAX - COLOR_A_MIN + 1)
+#define FIND_BLOBS_LUT_LAB_SIZE     (FIND_BLOBS_LUT_B_OFFSET + COLOR_B_MAX - COLOR_B_MIN + 1)
+
+static void find_blobs_labeler_lut_set(uint32_t *lut, int min, int max, int lo, int hi, uint32_t bit) {
+    for (int v = IM_MAX(lo, min); v <= IM_MIN(hi, max); v++) {
+        lut[v - min] |= bit;
+    }
+}
+
+static void find_blobs_labeler_init(find_blobs_labeler_t *lb, image_t *ptr, list_t *thresholds,
+                                    color_thresholds_bitmap_t *bitmap, bool invert) {
+    lb->ptr = ptr;
+    lb->bitmap = bitmap;
+    lb->invert = invert;
+    lb->all = (list_size(thresholds) < FIND_BLOBS_THRESHOLDS_MAX) ? ((1U << list_size(thresholds)) - 1) : 0xFFFFFFFF;
+
+    if ((ptr->pixfmt == PIXFORMAT_BINARY) || (ptr->pixfmt == PIXFORMAT_GRAYSCALE)) {
+        lb->lut = fb_alloc((COLOR_GRAYSCALE_MAX + 1) * sizeof(uint32_t), FB_ALLOC_NO_HINT);
+        for (int v = 0; v <= COLOR_GRAYSCALE_MAX; v++) {
+            lb->lut[v] = 0;
+            size_t j = 0;
+            list_for_each(it, thresholds) {
+                if (COLOR_THRESHOLD_GRAYSCALE(v, (color_thresholds_list_lnk_data_t *) list_get_data(it), invert)) {
+                    lb->lut[v] |= 1U << j;
+                }
+                j++;
+            }
+        }
+    } else {
+        lb->lut = fb_alloc0(FIND_BLOBS_LUT_LAB_SIZE * sizeof(uint32_t), FB_ALLOC_NO_HINT);
+        size_t j = 0;
+        list_for_each(it, thresholds) {
+            color_thresholds_list_lnk_data_t *t = (color_thresholds_list_lnk_data_t *) list_get_data(it);
+            find_blobs_labeler_lut_set(lb->lut + FIND_BLOBS_LUT_L_OFFSET, COLOR_L_MIN, COLOR_L_MAX,
+                                       t->LMin, t->LMax, 1U << j);
+            find_blobs_labeler_lut_set(lb->lut + FIND_BLOBS_LUT_A_OFFSET, COLOR_A_MIN, COLOR_A_MAX,
+                                       t->AMin, t->AMax, 1U << j);
+            find_blobs_labeler_lut_set(lb->lut + FIND_BLOBS_LUT_B_OFFSET, COLOR_B_MIN, COLOR_B_MAX,
+                                       t->BMin, t->BMax, 1U << j);
+            j++;
+        }
+    }
+}
+
+static void find_blobs_labeler_free(find_blobs_labeler_t *lb) {
+    fb_free(); // lb->lut
+}
+
+static uint32_t find_blobs_labeler_classify_rgb565(find_blobs_labeler_t *lb, int pixel) {
+    // Without invert, pixels outside of every threshold are rejected with one lookup.
+    if (lb->bitmap && (!lb->invert) && (!COLOR_THRESHOLD_BITMAP(pixel, lb->bitmap->any, false))) {
+        return 0;
+    }
+
+    uint32_t mask = lb->lut[FIND_BLOBS_LUT_L_OFFSET + COLOR_RGB565_TO_L(pixel) - COLOR_L_MIN] &
+                    lb->lut[FIND_BLOBS_LUT_A_OFFSET + COLOR_RGB565_TO_A(pixel) - COLOR_A_MIN] &
+                    lb->lut[FIND_BLOBS_LUT_B_OFFSET + COLOR_RGB565_TO_B(pixel) - COLOR_B_MIN];
+
+    return lb->invert ? (mask ^ lb->all) : mask;
+}
+
+// A horizontal run of pixels that match the same thresholds. Runs are stored in raster order.
+typedef struct find_blobs_run {
+    int16_t x0, x1, y;
+    uint8_t claimed;
+    uint32_t mask;
+    int32_t seg;
+} find_blobs_run_t;
+
+// A horizontal run of pixels available to the threshold of the current pass. These are the runs the
+// flood fill for that threshold fills one at a time and are made of one or more adjacent pixel runs.
+typedef struct find_blobs_seg {
+    int16_t x0, x1, y;
+    uint8_t visited;
+    int32_t run;
+} find_blobs_seg_t;
+
+// A flood fill lifo entry. t_l and b_l are where the scans above and below the segment resume.
+typedef struct find_blobs_frame {
+    int32_t seg;
+    int16_t t_l, b_l;
+} find_blobs_frame_t;
+
+// Returns the last x of the run of pixels starting at x that match the same thresholds.
+static int find_blobs_run_end(find_blobs_labeler_t *lb, void *row_ptr, int x, int x_max, uint32_t *mask) {
+    switch (lb->ptr->pixfmt) {
+        case PIXFORMAT_BINARY: {
+            uint32_t *row = (uint32_t *) row_ptr;
+            int bit = IMAGE_GET_BINARY_PIXEL_FAST(row, x);
+            *mask = lb->lut[bit];
+
+            if (lb->lut[0] == lb->lut[1]) {
+                return x_max;
+            }
+
+            // Skip 32 pixels at a time looking for the first bit that differs.
+            uint32_t invert = bit ? 0xFFFFFFFF : 0;
+            int i = x >> UINT32_T_SHIFT;
+            uint32_t word = (row[i] ^ invert) & (0xFFFFFFFF << (x & UINT32_T_MASK));
+
+            while (!word) {
+                if ((++i << UINT32_T_SHIFT) > x_max) {
+                    return x_max;
+                }
+                word = row[i] ^ invert;
+            }
+
+            return IM_MIN((i << UINT32_T_SHIFT) + __builtin_ctz(word) - 1, x_max);
+        }
+        case PIXFORMAT_GRAYSCALE: {
+            uint8_t *row = (uint8_t *) row_ptr;
+            uint32_t m = *mask = lb->lut[row[x]];
+
+            while ((x < x_max) && (lb->lut[row[x + 1]] == m)) {
+                x++;
+            }
+
+            return x;
+        }
+        case PIXFORMAT_RGB565: {
+            uint16_t *row = (uint16_t *) row_ptr;
+            int pixel = row[x];
+            uint32_t m = *mask = find_blobs_labeler_classify_rgb565(lb, pixel);
+
+            // Neighboring pixels are frequently the same color.
+            while (x < x_max) {
+                int next_pixel = row[x + 1];
+                if ((next_pixel != pixel) && (find_blobs_labeler_classify_rgb565(lb, next_pixel) != m)) {
+                    break;
+                }
+                pixel = next_pixel;
+                x++;
+            }
+
+            return x;
+        }
+        default: {
+            *mask = 0;
+            return x_max;
+        }
+    }
+}
+
+// Returns true if the find_blobs() seeding pattern for x_stride/y_stride samples a pixel in x0 to x1 of y.
+static bool find_blobs_seeded(int y, int x0, int x1, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride) {
+    if ((y - roi->y) % y_stride) {
+        return false;
+    }
+
+    int x = roi->x + (y % x_stride);
+
+    if (x < x0) {
+        x += (((x0 - x) + x_stride - 1) / x_stride) * x_stride;
+    }
+
+    return x <= x1;
+}
+
+// Returns the number of pixels from a to b that are not left or right, which the flood fill skips.
+static inline int find_blobs_count(int a, int b, int left, int right) {
+    return IM_MAX(IM_MIN(b, right - 1) - IM_MAX(a, left + 1) + 1, 0);
+}
+
+// Scans the pixels from t_l to right of the row of runs i to ii next to the segment from left to right
+// like the flood fill does for threshold bit. Returns the segment of the first pixel that the flood fill
+// recurses into and sets x to it, or returns -1. Adds the pixels that the flood fill counts in the perimeter
+// up to there to the perimeter. These are the pixels not claimed by an earlier threshold that do not match
+// the threshold.
+static int32_t find_blobs_scan(find_blobs_run_t *runs, find_blobs_seg_t *segs, int32_t i, int32_t ii,
+                               uint32_t bit, int t_l, int left, int right, int *x, int *perimeter) {
+    // Binary search for the first run that ends at or after t_l.
+    for (int32_t j = ii; i < j; ) {
+        int32_t m = i + ((j - i) / 2);
+        if (runs[m].x1 < t_l) {
+            i = m + 1;
+        } else {
+            j = m;
+        }
+    }
+
+    int pos = t_l;
+
+    for (find_blobs_run_t *run = runs + i; (run < (runs + ii)) && (run->x0 <= right); run++) {
+        int x0 = IM_MAX(run->x0, t_l);
+
+        if (run->claimed) {
+            *perimeter += find_blobs_count(pos, x0 - 1, left, right);
+            pos = run->x1 + 1;
+        } else if (run->mask & bit) {
+            // Visiting a segment claims all of its runs so this one is in an unvisited segment.
+            *perimeter += find_blobs_count(pos, x0 - 1, left, right);
+            *x = x0;
+            return run->seg;
+        }
+    }
+
+    *perimeter += find_blobs_count(pos, right, left, right);
+    return -1;
+}
+
+// Finds the blobs for all thresholds by run-length encoding the rows of the image once and then running
+// the per threshold flood fill of imlib_find_blobs() on the runs instead of the pixels. The runs of
+// pixels that match several thresholds are available to the later thresholds until a seeded blob of an
+// earlier threshold claims them. The runs are visited in the same order as the flood fill visits them,
+// so all blob stats including the perimeter and the corners tied between several runs are identical to
+// the per threshold passes. The work scales with the number of runs instead of the number of pixels
+// times the number of thresholds. Returns false if the runs do not fit in memory.
+static bool find_blobs_single_pass(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int x_stride,
+                           unsigned int y_stride, list_t *thresholds, color_thresholds_bitmap_t *bitmap,
+                           bool invert, unsigned int area_threshold, unsigned int pixels_threshold,
+                           bool (*threshold_cb) (void *, find_blobs_list_lnk_data_t *), void *threshold_cb_arg,
+                           unsigned int x_hist_bins_max, unsigned int y_hist_bins_max) {
+    find_blobs_labeler_t lb;
+    find_blobs_labeler_init(&lb, ptr, thresholds, bitmap, invert);
+
+    uint16_t *x_hist_bins = NULL;
+    if (x_hist_bins_max) {
+        x_hist_bins = fb_alloc(ptr->w * sizeof(uint16_t), FB_ALLOC_NO_HINT);
+    }
+
+    uint16_t *y_hist_bins = NULL;
+    if (y_hist_bins_max) {
+        y_hist_bins = fb_alloc(ptr->h * sizeof(uint16_t), FB_ALLOC_NO_HINT);
+    }
+
+    // The runs of row y are run_rows[y - y_min] to run_rows[y - y_min + 1] and the same for segments.
+    // row_masks[y - y_min] is the mask of all thresholds matched by the runs of row y.
+    int32_t *run_rows = fb_alloc((roi->h + 1) * sizeof(int32_t), FB_ALLOC_NO_HINT);
+    int32_t *seg_rows = fb_alloc((roi->h + 1) * sizeof(int32_t), FB_ALLOC_NO_HINT);
+    uint32_t *row_masks = fb_alloc0(roi->h * sizeof(uint32_t), FB_ALLOC_NO_HINT);
+
+    // Each run needs at most one segment and one lifo entry.
+    uint32_t runs_size;
+    find_blobs_run_t *runs = fb_alloc_all(&runs_size, FB_ALLOC_NO_HINT);
+    int32_t runs_max = runs_size / (sizeof(find_blobs_run_t) + sizeof(find_blobs_seg_t) + sizeof(find_blobs_frame_t));
+    int32_t n = 0;
+
+    int x_min = roi->x, x_max = roi->x + roi->w - 1;
+    int y_min = roi->y, y_max = roi->y + roi->h - 1;
+    bool overflow = false;
+
+    // Run-length encode the rows.
+    for (int y = y_min; (y <= y_max) && (!overflow); y++) {
+        void *row_ptr;
+        switch (ptr->pixfmt) {
+            case PIXFORMAT_BINARY: {
+                row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(ptr, y);
+                break;
+            }
+            case PIXFORMAT_GRAYSCALE: {
+                row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(ptr, y);
+                break;
+            }
+            default: {
+                row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, y);
+                break;
+            }
+        }
+
+        run_rows[y - y_min] = n;
+
+        for (int x = x_min; x <= x_max; ) {
+            uint32_t mask;
+            int x_end = find_blobs_run_end(&lb, row_ptr, x, x_max, &mask);
+
+            if (mask) {
+                if (n == runs_max) {
+                    overflow = true;
+                    break;
+                }
+
+                find_blobs_run_t *run = runs + n++;
+                run->x0 = x;
+                run->x1 = x_end;
+                run->y = y;
+                run->claimed = false;
+                run->mask = mask;
+                row_masks[y - y_min] |= mask;
+            }
+
+            x = x_end + 1;
+        }
+    }
+
+    if (!overflow) {
+        run_rows[roi->h] = n;
+
+        find_blobs_seg_t *segs = (find_blobs_seg_t *) (runs + n);
+        find_blobs_frame_t *lifo = (find_blobs_frame_t *) (segs + n);
+
+        for (size_t code = 0; code < list_size(thresholds); code++) {
+            uint32_t bit = 1U << code;
+            int32_t ns = 0;
+
+            // Joins the adjacent runs available to this threshold into segments. Rows without any run
+            // of this threshold are skipped so the cost of each threshold is proportional to its runs.
+            for (int y = y_min; y <= y_max; y++) {
+                seg_rows[y - y_min] = ns;
+
+                if (!(row_masks[y - y_min] & bit)) {
+                    continue;
+                }
+
+                for (int32_t i = run_rows[y - y_min], ii = run_rows[y - y_min + 1]; i < ii; i++) {
+                    find_blobs_run_t *run = runs + i;
+
+                    if ((!(run->mask & bit)) || run->claimed) {
+                        continue;
+                    }
+
+                    if ((ns > seg_rows[y - y_min]) && ((segs[ns - 1].x1 + 1) == run->x0)) {
+                        segs[ns - 1].x1 = run->x1;
+                    } else {
+                        find_blobs_seg_t *seg = segs + ns++;
+                        seg->x0 = run->x0;
+                        seg->x1 = run->x1;
+                        seg->y = y;
+                        seg->visited = false;
+                        seg->run = i;
+                    }
+
+                    run->seg = ns - 1;
+                }
+            }
+
+            seg_rows[roi->h] = ns;
+
+            // Blobs are found in the order the flood fill seeding reaches them.
+            for (int32_t s = 0; s < ns; s++) {
+                if (segs[s].visited || (!find_blobs_seeded(segs[s].y, segs[s].x0, segs[s].x1, roi, x_stride, y_stride))) {
+                    continue;
+                }
+
+                find_blobs_acc_t acc;
+                find_blobs_acc_init(&acc, x_max, y_max);
+
+                if (x_hist_bins) {
+                    memset(x_hist_bins, 0, ptr->w * sizeof(uint16_t));
+                }
+                if (y_hist_bins) {
+                    memset(y_hist_bins, 0, ptr->h * sizeof(uint16_t));
+                }
+
+                find_blobs_frame_t frame = { s, segs[s].x0, segs[s].x0 };
+                size_t lifo_size = 0;
+                bool visit = true;
+
+                for (;;) {
+                    find_blobs_seg_t *seg = segs + frame.seg;
+                    int y = seg->y, left = seg->x0, right = seg->x1;
+
+                    if (visit) {
+                        seg->visited = true;
+                        for (int32_t i = seg->run; (i < n) && (runs[i].y == y) && (runs[i].x1 <= right); i++) {
+                            runs[i].claimed = true;
+                        }
+                        find_blobs_acc_add_run(&acc, y, left, right, x_hist_bins, y_hist_bins);
+                    }
+
+                    int x;
+                    int32_t next = -1;
+
+                    if (y > y_min) {
+                        next = find_blobs_scan(runs, segs, run_rows[y - y_min - 1], run_rows[y - y_min], bit,
+                                               frame.t_l, left, right, &x, &acc.perimeter);
+                        if (next >= 0) {
+                            lifo[lifo_size++] = (find_blobs_frame_t) { frame.seg, x + 1, frame.b_l };
+                        }
+                    } else {
+                        acc.perimeter += right - left + 1;
+                    }
+
+                    if (next < 0) {
+                        if (y < y_max) {
+                            next = find_blobs_scan(runs, segs, run_rows[y - y_min + 1], run_rows[y - y_min + 2], bit,
+                                                   frame.b_l, left, right, &x, &acc.perimeter);
+                            if (next >= 0) {
+                                lifo[lifo_size++] = (find_blobs_frame_t) { frame.seg, frame.t_l, x + 1 };
+                            }
+                        } else {
+                            acc.perimeter += right - left + 1;
+                        }
+                    }
+
+                    if (next >= 0) {
+                        frame = (find_blobs_frame_t) { next, segs[next].x0, segs[next].x0 };
+                        visit = true;
+                    } else if (lifo_size) {
+                        frame = lifo[--lifo_size];
+                        visit = false;
+                    } else {
+                        break;
+                    }
+                }
+
+                find_blobs_acc_output(&acc, out, ptr, code, area_threshold, pixels_threshold,
+                                      threshold_cb, threshold_cb_arg, x_hist_bins, y_hist_bins,
+                                      x_hist_bins_max, y_hist_bins_max);
+            }
+        }
+    }
+
+    fb_free(); // runs
+    fb_free(); // row_masks
+    fb_free(); // seg_rows
+    fb_free(); // run_rows
+    if (y_hist_bins) {
+        fb_free();
+    }
+    if (x_hist_bins) {
+        fb_free();
+    }
+    find_blobs_labeler_free(&lb);
+    return !overflow;
+}
+
 void imlib_find_blobs(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride,
-                      list_t *thresholds, bool invert, unsigned int area_threshold, unsigned int pixels_threshold,
-                      bool merge, int margin,
+                      list_t *thresholds, color_thresholds_bitmap_t *bitmap, bool invert,
+                      unsigned int area_threshold, unsigned int pixels_threshold, bool merge, int margin,
                       bool (*threshold_cb) (void *, find_blobs_list_lnk_data_t *), void *threshold_cb_arg,
                       bool (*merge_cb) (void *, find_blobs_list_lnk_data_t *, find_blobs_list_lnk_data_t *), void *merge_cb_arg,
-                      unsigned int x_hist_bins_max, unsigned int y_hist_bins_max) {
+                      unsigned int x_hist_bins_max, unsigned int y_hist_bins_max, find_blobs_mode_t mode) {
+    // Falls back to the flood fill if there are too many runs.
+    if ((mode == FIND_BLOBS_MODE_SINGLE_PASS) && (list_size(thresholds) <= FIND_BLOBS_THRESHOLDS_MAX)) {
+        list_init(out, sizeof(find_blobs_list_lnk_data_t));
+        if (find_blobs_single_pass(out, ptr, roi, x_stride, y_stride, thresholds, bitmap, invert, area_threshold,
+                           pixels_threshold, threshold_cb, threshold_cb_arg, x_hist_bins_max, y_hist_bins_max)) {
+            if (merge) {
+                find_blobs_merge(out, margin, merge_cb, merge_cb_arg, x_hist_bins_max, y_hist_bins_max);
+            }
+            return;
+        }
+    }
+
     // Same size as the image so we don't have to translate.
     image_t bmp;
     bmp.w = ptr->w;
@@ -769,12 +1464,14 @@ void imlib_find_blobs(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int
                 break;
             }
             case PIXFORMAT_RGB565: {
+                uint32_t *lnk_bits = bitmap ? COLOR_THRESHOLDS_BITMAP_GET(bitmap, code) : NULL;
                 for (int y = roi->y, yy = roi->y + roi->h, y_max = yy - 1; y < yy; y += y_stride) {
                     uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, y);
                     uint32_t *bmp_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&bmp, y);
                     for (int x = roi->x + (y % x_stride), xx = roi->x + roi->w, x_max = xx - 1; x < xx; x += x_stride) {
                         if ((!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row_ptr, x))
-                            && COLOR_THRESHOLD_RGB565(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x), lnk_data, invert)) {
+                            && COLOR_THRESHOLD_RGB565_BITMAP(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x), lnk_data,
+                                                             lnk_bits, invert)) {
                             int old_x = x;
                             int old_y = y;
 
@@ -816,15 +1513,15 @@ void imlib_find_blobs(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int
 
                                 while ((left > roi->x)
                                        && (!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, left - 1))
-                                       && COLOR_THRESHOLD_RGB565(IMAGE_GET_RGB565_PIXEL_FAST(row, left - 1), lnk_data,
-                                                                 invert)) {
+                                       && COLOR_THRESHOLD_RGB565_BITMAP(IMAGE_GET_RGB565_PIXEL_FAST(row, left - 1), lnk_data,
+                                                                        lnk_bits, invert)) {
                                     left--;
                                 }
 
                                 while ((right < (roi->x + roi->w - 1))
                                        && (!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, right + 1))
-                                       && COLOR_THRESHOLD_RGB565(IMAGE_GET_RGB565_PIXEL_FAST(row, right + 1), lnk_data,
-                                                                 invert)) {
+                                       && COLOR_THRESHOLD_RGB565_BITMAP(IMAGE_GET_RGB565_PIXEL_FAST(row, right + 1), lnk_data,
+                                                                        lnk_bits, invert)) {
                                     right++;
                                 }
 
@@ -888,9 +1585,10 @@ void imlib_find_blobs(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int
 
                                                 if ((!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, i))
                                                     && (ok =
-                                                            COLOR_THRESHOLD_RGB565(IMAGE_GET_RGB565_PIXEL_FAST(row, i),
-                                                                                   lnk_data,
-                                                                                   invert))) {
+                                                            COLOR_THRESHOLD_RGB565_BITMAP(IMAGE_GET_RGB565_PIXEL_FAST(row, i),
+                                                                                          lnk_data,
+                                                                                          lnk_bits,
+                                                                                          invert))) {
                                                     xylr_t context;
                                                     context.x = x;
                                                     context.y = y;
@@ -924,9 +1622,10 @@ void imlib_find_blobs(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int
 
                                                 if ((!IMAGE_GET_BINARY_PIXEL_FAST(bmp_row, i))
                                                     && (ok =
-                                                            COLOR_THRESHOLD_RGB565(IMAGE_GET_RGB565_PIXEL_FAST(row, i),
-                                                                                   lnk_data,
-                                                                                   invert))) {
+                                                            COLOR_THRESHOLD_RGB565_BITMAP(IMAGE_GET_RGB565_PIXEL_FAST(row, i),
+                                                                                          lnk_data,
+                                                                                          lnk_bits,
+                                                                                          invert))) {
                                                     xylr_t context;
                                                     context.x = x;
                                                     context.y = y;
@@ -1092,96 +1791,7 @@ void imlib_find_blobs(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int
     fb_free(); // bitmap
 
     if (merge) {
-        for (;;) {
-            bool merge_occured = false;
-
-            list_t out_temp;
-            list_init(&out_temp, sizeof(find_blobs_list_lnk_data_t));
-
-            while (list_size(out)) {
-                find_blobs_list_lnk_data_t lnk_blob;
-                list_pop_front(out, &lnk_blob);
-
-                for (size_t k = 0, l = list_size(out); k < l; k++) {
-                    find_blobs_list_lnk_data_t tmp_blob;
-                    list_pop_front(out, &tmp_blob);
-
-                    rectangle_t temp;
-                    temp.x = __SSAT(tmp_blob.rect.x - margin, 16);
-                    temp.y = __SSAT(tmp_blob.rect.y - margin, 16);
-                    temp.w = __USAT(tmp_blob.rect.w + (margin * 2), 15);
-                    temp.h = __USAT(tmp_blob.rect.h + (margin * 2), 15);
-
-                    if (rectangle_overlap(&(lnk_blob.rect), &temp)
-                        && ((merge_cb_arg == NULL) || merge_cb(merge_cb_arg, &lnk_blob, &tmp_blob))) {
-                        // Have to merge these first before merging rects.
-                        if (x_hist_bins_max) {
-                            merge_bins(lnk_blob.rect.x,
-                                       lnk_blob.rect.x + lnk_blob.rect.w - 1,
-                                       &lnk_blob.x_hist_bins,
-                                       &lnk_blob.x_hist_bins_count,
-                                       tmp_blob.rect.x,
-                                       tmp_blob.rect.x + tmp_blob.rect.w - 1,
-                                       &tmp_blob.x_hist_bins,
-                                       &tmp_blob.x_hist_bins_count,
-                                       x_hist_bins_max);
-                        }
-                        if (y_hist_bins_max) {
-                            merge_bins(lnk_blob.rect.y,
-                                       lnk_blob.rect.y + lnk_blob.rect.h - 1,
-                                       &lnk_blob.y_hist_bins,
-                                       &lnk_blob.y_hist_bins_count,
-                                       tmp_blob.rect.y,
-                                       tmp_blob.rect.y + tmp_blob.rect.h - 1,
-                                       &tmp_blob.y_hist_bins,
-                                       &tmp_blob.y_hist_bins_count,
-                                       y_hist_bins_max);
-                        }
-                        // Merge corners...
-                        for (int i = 0; i < FIND_BLOBS_CORNERS_RESOLUTION; i++) {
-                            float z_dst = (lnk_blob.corners[i].x * cos_table[FIND_BLOBS_ANGLE_RESOLUTION * i]) +
-                                          (lnk_blob.corners[i].y * sin_table[FIND_BLOBS_ANGLE_RESOLUTION * i]);
-                            float z_src = (tmp_blob.corners[i].x * cos_table[FIND_BLOBS_ANGLE_RESOLUTION * i]) +
-                                          (tmp_blob.corners[i].y * cos_table[FIND_BLOBS_ANGLE_RESOLUTION * i]);
-                            if (z_src < z_dst) {
-                                lnk_blob.corners[i].x = tmp_blob.corners[i].x;
-                                lnk_blob.corners[i].y = tmp_blob.corners[i].y;
-                            }
-                        }
-                        // Merge rects...
-                        rectangle_united(&(lnk_blob.rect), &(tmp_blob.rect));
-                        // Merge counters...
-                        lnk_blob.pixels += tmp_blob.pixels; // won't overflow
-                        lnk_blob.perimeter += tmp_blob.perimeter; // won't overflow
-                        lnk_blob.code |= tmp_blob.code; // won't overflow
-                        lnk_blob.count += tmp_blob.count; // won't overflow
-                        // Merge accumulators...
-                        lnk_blob.centroid_x_acc += tmp_blob.centroid_x_acc;
-                        lnk_blob.centroid_y_acc += tmp_blob.centroid_y_acc;
-                        lnk_blob.rotation_acc_x += tmp_blob.rotation_acc_x;
-                        lnk_blob.rotation_acc_y += tmp_blob.rotation_acc_y;
-                        lnk_blob.roundness_acc += tmp_blob.roundness_acc;
-                        // Compute current values...
-                        lnk_blob.centroid_x = lnk_blob.centroid_x_acc / lnk_blob.pixels;
-                        lnk_blob.centroid_y = lnk_blob.centroid_y_acc / lnk_blob.pixels;
-                        lnk_blob.rotation = fast_atan2f(lnk_blob.rotation_acc_y / lnk_blob.pixels,
-                                                        lnk_blob.rotation_acc_x / lnk_blob.pixels);
-                        lnk_blob.roundness = lnk_blob.roundness_acc / lnk_blob.pixels;
-                        merge_occured = true;
-                    } else {
-                        list_push_back(out, &tmp_blob);
-                    }
-                }
-
-                list_push_back(&out_temp, &lnk_blob);
-            }
-
-            list_copy(out, &out_temp);
-
-            if (!merge_occured) {
-                break;
-            }
-        }
+        find_blobs_merge(out, margin, merge_cb, merge_cb_arg, x_hist_bins_max, y_hist_bins_max);
     }
 }
 
@@ -207,6 +207,26 @@ void list_clear(list_t *ptr) {
     ptr->size = 0;
 }
 
+// Moves all the links of src to the end of dst, src is left empty.
+void list_concat(list_t *dst, list_t *src) {
+    if (!src->size) {
+        return;
+    }
+
+    if (dst->size) {
+        dst->tail->next = src->head;
+        src->head->prev = dst->tail;
+    } else {
+        dst->head = src->head;
+    }
+
+    dst->tail = src->tail;
+    dst->size += src->size;
+    src->head = NULL;
+    src->tail = NULL;
+    src->size = 0;
+}
+
 size_t list_size(list_t *ptr) {
     return ptr->size;
 }
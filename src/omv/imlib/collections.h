@@ -87,6 +87,7 @@ void list_init(list_t *ptr, size_t data_len);
 void list_copy(list_t *dst, list_t *src);
 void list_free(list_t *ptr);
 void list_clear(list_t *ptr);
+void list_concat(list_t *dst, list_t *src);
 size_t list_size(list_t *ptr);
 void list_push_front(list_t *ptr, void *data);
 void list_push_back(list_t *ptr, void *data);
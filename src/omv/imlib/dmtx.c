@@ -6305,11 +6305,13 @@ dmtxMatrix3Print(DmtxMatrix3 m)
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void imlib_find_datamatrices(list_t *out, image_t *ptr, rectangle_t *roi, int effort)
+void imlib_find_datamatrices(list_t *out, image_t *ptr, rectangle_t *roi, int effort, image_planes_t *planes)
 {
-    uint8_t *grayscale_image = (ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? ptr->data : fb_alloc(roi->w * roi->h, FB_ALLOC_NO_HINT);
+    // Scan the whole grayscale plane cropped to the roi if there's one, else a copy of the roi.
+    uint8_t *plane = imlib_planes_grayscale(planes, ptr);
+    uint8_t *grayscale_image = plane ? plane : fb_alloc(roi->w * roi->h, FB_ALLOC_NO_HINT);
 
-    if (ptr->pixfmt != PIXFORMAT_GRAYSCALE) {
+    if (!plane) {
         image_t img;
         img.w = roi->w;
         img.h = roi->h;
@@ -6321,15 +6323,15 @@ void imlib_find_datamatrices(list_t *out, image_t *ptr, rectangle_t *roi, int ef
     umm_init_x(fb_avail());
 
     DmtxImage *image = dmtxImageCreate(grayscale_image,
-                                       (ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? ptr->w : roi->w,
-                                       (ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? ptr->h : roi->h,
+                                       plane ? ptr->w : roi->w,
+                                       plane ? ptr->h : roi->h,
                                        DmtxPack8bppK);
 
     DmtxDecode *decode = dmtxDecodeCreate(image, 1);
-    dmtxDecodeSetProp(decode, DmtxPropXmin, (ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? roi->x : 0);
-    dmtxDecodeSetProp(decode, DmtxPropYmin, (ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? roi->y : 0);
-    dmtxDecodeSetProp(decode, DmtxPropXmax, ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? roi->x : 0) + (roi->w - 1));
-    dmtxDecodeSetProp(decode, DmtxPropYmax, ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? roi->y : 0) + (roi->h - 1));
+    dmtxDecodeSetProp(decode, DmtxPropXmin, plane ? roi->x : 0);
+    dmtxDecodeSetProp(decode, DmtxPropYmin, plane ? roi->y : 0);
+    dmtxDecodeSetProp(decode, DmtxPropXmax, (plane ? roi->x : 0) + (roi->w - 1));
+    dmtxDecodeSetProp(decode, DmtxPropYmax, (plane ? roi->y : 0) + (roi->h - 1));
 
     list_init(out, sizeof(find_datamatrices_list_lnk_data_t));
 
@@ -6354,25 +6356,25 @@ void imlib_find_datamatrices(list_t *out, image_t *ptr, rectangle_t *roi, int ef
             int height = dmtxDecodeGetProp(decode, DmtxPropHeight);
 
             rectangle_init(&(lnk_data.rect),
-                           fast_roundf(p[0].X) + ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? 0 : roi->x),
-                           height - 1 - fast_roundf(p[0].Y) + ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? 0 : roi->y), 0, 0);
+                           fast_roundf(p[0].X) + (plane ? 0 : roi->x),
+                           height - 1 - fast_roundf(p[0].Y) + (plane ? 0 : roi->y), 0, 0);
 
             for (size_t k = 1, l = (sizeof(p) / sizeof(p[0])); k < l; k++) {
                 rectangle_t temp;
-                rectangle_init(&temp, fast_roundf(p[k].X) + ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? 0 : roi->x),
-                        height - 1 - fast_roundf(p[k].Y) + ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? 0 : roi->y), 0, 0);
+                rectangle_init(&temp, fast_roundf(p[k].X) + (plane ? 0 : roi->x),
+                        height - 1 - fast_roundf(p[k].Y) + (plane ? 0 : roi->y), 0, 0);
                 rectangle_united(&(lnk_data.rect), &temp);
             }
 
             // Add corners...
-            lnk_data.corners[0].x =              fast_roundf(p[3].X) + ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? 0 : roi->x); // top-left
-            lnk_data.corners[0].y = height - 1 - fast_roundf(p[3].Y) + ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? 0 : roi->y); // top-left
-            lnk_data.corners[1].x =              fast_roundf(p[2].X) + ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? 0 : roi->x); // top-right
-            lnk_data.corners[1].y = height - 1 - fast_roundf(p[2].Y) + ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? 0 : roi->y); // top-right
-            lnk_data.corners[2].x =              fast_roundf(p[1].X) + ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? 0 : roi->x); // bottom-right
-            lnk_data.corners[2].y = height - 1 - fast_roundf(p[1].Y) + ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? 0 : roi->y); // bottom-right
-            lnk_data.corners[3].x =              fast_roundf(p[0].X) + ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? 0 : roi->x); // bottom-left
-            lnk_data.corners[3].y = height - 1 - fast_roundf(p[0].Y) + ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? 0 : roi->y); // bottom-left
+            lnk_data.corners[0].x =              fast_roundf(p[3].X) + (plane ? 0 : roi->x); // top-left
+            lnk_data.corners[0].y = height - 1 - fast_roundf(p[3].Y) + (plane ? 0 : roi->y); // top-left
+            lnk_data.corners[1].x =              fast_roundf(p[2].X) + (plane ? 0 : roi->x); // top-right
+            lnk_data.corners[1].y = height - 1 - fast_roundf(p[2].Y) + (plane ? 0 : roi->y); // top-right
+            lnk_data.corners[2].x =              fast_roundf(p[1].X) + (plane ? 0 : roi->x); // bottom-right
+            lnk_data.corners[2].y = height - 1 - fast_roundf(p[1].Y) + (plane ? 0 : roi->y); // bottom-right
+            lnk_data.corners[3].x =              fast_roundf(p[0].X) + (plane ? 0 : roi->x); // bottom-left
+            lnk_data.corners[3].y = height - 1 - fast_roundf(p[0].Y) + (plane ? 0 : roi->y); // bottom-left
 
             // Payload is NOT already null terminated.
             lnk_data.payload_len = message->outputIdx;
@@ -6400,7 +6402,7 @@ void imlib_find_datamatrices(list_t *out, image_t *ptr, rectangle_t *roi, int ef
     dmtxImageDestroy(&image);
 
     fb_free(); // umm_init_x();
-    if (ptr->pixfmt != PIXFORMAT_GRAYSCALE) {
+    if (!plane) {
         fb_free(); // grayscale_image;
     }
 }
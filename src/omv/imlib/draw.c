@@ -5683,6 +5683,286 @@ void imlib_draw_image(image_t *dst_img,
     }
 }
 
+typedef struct image_tensor_x_map {
+    int16_t x0, x1; // left and right source pixels
+    int16_t w; // weight of the right source pixel (0-256)
+} image_tensor_x_map_t;
+
+// Horizontally interpolates one source row for every output column. Results are 16-bit
+// fixed point (value * 256) and are not rounded until after the vertical interpolation.
+static void imlib_draw_image_tensor_row(uint16_t *dst, image_t *src_img, int y, int channels,
+                                        const image_tensor_x_map_t *x_map, int dst_w, void *line_buf) {
+    pixformat_t pixfmt = src_img->pixfmt;
+    void *row_ptr;
+
+    if (src_img->is_bayer || src_img->is_yuv) {
+        // Only convert the span of the row that is sampled. Conversion works on pixel pairs.
+        int x_start = x_map[0].x0 & ~1;
+        int x_end = IM_MIN(x_map[dst_w - 1].x1 + 2, src_img->w);
+        pixfmt = (channels == 1) ? PIXFORMAT_GRAYSCALE : PIXFORMAT_RGB565;
+
+        if (src_img->is_bayer) {
+            // Debayered pixels are written starting at the beginning of the row buffer.
+            int offset = x_start * ((pixfmt == PIXFORMAT_GRAYSCALE) ? sizeof(uint8_t) : sizeof(uint16_t));
+            imlib_debayer_line(x_start, x_end, y, ((uint8_t *) line_buf) + offset, pixfmt, src_img);
+        } else {
+            imlib_deyuv_line(x_start, x_end, y, line_buf, pixfmt, src_img);
+        }
+
+        row_ptr = line_buf;
+    } else {
+        row_ptr = imlib_compute_row_ptr(src_img, y);
+    }
+
+    switch (pixfmt) {
+        case PIXFORMAT_BINARY: {
+            uint32_t *row_ptr_32 = (uint32_t *) row_ptr;
+            for (int x = 0; x < dst_w; x++) {
+                const image_tensor_x_map_t *m = x_map + x;
+                int p0 = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr_32, m->x0));
+                int p1 = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr_32, m->x1));
+                int p = (p0 * (256 - m->w)) + (p1 * m->w);
+                for (int c = 0; c < channels; c++) {
+                    *dst++ = p;
+                }
+            }
+            break;
+        }
+        case PIXFORMAT_GRAYSCALE: {
+            uint8_t *row_ptr_8 = (uint8_t *) row_ptr;
+            for (int x = 0; x < dst_w; x++) {
+                const image_tensor_x_map_t *m = x_map + x;
+                int p = (row_ptr_8[m->x0] * (256 - m->w)) + (row_ptr_8[m->x1] * m->w);
+                for (int c = 0; c < channels; c++) {
+                    *dst++ = p;
+                }
+            }
+            break;
+        }
+        case PIXFORMAT_RGB565: {
+            uint16_t *row_ptr_16 = (uint16_t *) row_ptr;
+            if (channels == 1) {
+                for (int x = 0; x < dst_w; x++) {
+                    const image_tensor_x_map_t *m = x_map + x;
+                    int p0 = COLOR_RGB565_TO_Y(row_ptr_16[m->x0]);
+                    int p1 = COLOR_RGB565_TO_Y(row_ptr_16[m->x1]);
+                    *dst++ = (p0 * (256 - m->w)) + (p1 * m->w);
+                }
+            } else {
+                for (int x = 0; x < dst_w; x++) {
+                    const image_tensor_x_map_t *m = x_map + x;
+                    int p0 = row_ptr_16[m->x0], p1 = row_ptr_16[m->x1], w0 = 256 - m->w, w1 = m->w;
+                    *dst++ = (COLOR_RGB565_TO_R8(p0) * w0) + (COLOR_RGB565_TO_R8(p1) * w1);
+                    *dst++ = (COLOR_RGB565_TO_G8(p0) * w0) + (COLOR_RGB565_TO_G8(p1) * w1);
+                    *dst++ = (COLOR_RGB565_TO_B8(p0) * w0) + (COLOR_RGB565_TO_B8(p1) * w1);
+                }
+            }
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+// Fused resize, color conversion and quantization for neural network inputs. The ROI is scaled
+// with bilinear interpolation to fill the HWC tensor while keeping its aspect ratio (the excess
+// is cropped equally from both sides) like imlib_draw_image() does with IMAGE_HINT_BILINEAR,
+// IMAGE_HINT_CENTER and IMAGE_HINT_SCALE_ASPECT_EXPAND. Each value v in [0:1] is written as v for
+// float tensors and as round(v / scale) + zero_point (saturated) for 8-bit tensors.
+void imlib_draw_image_tensor(void *tensor, int w, int h, int channels, image_tensor_datatype_t datatype,
+                             float scale, int zero_point, image_t *src_img, rectangle_t *roi) {
+    rectangle_t src_roi;
+    if (roi) {
+        src_roi = *roi;
+    } else {
+        rectangle_init(&src_roi, 0, 0, src_img->w, src_img->h);
+    }
+
+    // Compressed images are decompressed first.
+    image_t new_src_img;
+    bool is_compressed = src_img->is_compressed;
+    if (is_compressed) {
+        new_src_img.w = src_img->w;
+        new_src_img.h = src_img->h;
+        new_src_img.pixfmt = (channels == 1) ? PIXFORMAT_GRAYSCALE : PIXFORMAT_RGB565;
+        new_src_img.data = fb_alloc(image_size(&new_src_img), FB_ALLOC_CACHE_ALIGN);
+
+        if (src_img->pixfmt == PIXFORMAT_JPEG) {
+            jpeg_decompress(&new_src_img, src_img);
+        } else {
+            png_decompress(&new_src_img, src_img);
+        }
+
+        src_img = &new_src_img;
+    }
+
+    // Same scale and center math as imlib_draw_image().
+    float x_scale = w / ((float) src_roi.w);
+    float y_scale = h / ((float) src_roi.h);
+    float xy_scale = IM_MAX(x_scale, y_scale);
+    int src_width_scaled = fast_floorf(xy_scale * src_roi.w);
+    int src_height_scaled = fast_floorf(xy_scale * src_roi.h);
+    int dst_x_start = fast_floorf((w - src_width_scaled) / 2.f);
+    int dst_y_start = fast_floorf((h - src_height_scaled) / 2.f);
+    int src_x_start = 0, src_y_start = 0;
+
+    if (dst_x_start < 0) {
+        src_x_start = -dst_x_start;
+        dst_x_start = 0;
+    }
+
+    if (dst_y_start < 0) {
+        src_y_start = -dst_y_start;
+        dst_y_start = 0;
+    }
+
+    int dst_x_end = IM_MIN(dst_x_start + src_width_scaled - src_x_start, w);
+    int dst_y_end = IM_MIN(dst_y_start + src_height_scaled - src_y_start, h);
+    src_x_start += fast_floorf(src_roi.x * xy_scale);
+    src_y_start += fast_floorf(src_roi.y * xy_scale);
+
+    long src_frac = fast_floorf(65536.0f / xy_scale);
+    long src_x_accum = fast_floorf((src_x_start << 16) / xy_scale);
+    long src_y_accum = fast_floorf((src_y_start << 16) / xy_scale);
+
+    // Bilinear shifts the image right by (0.5, 0.5) so we have to undo that.
+    if ((src_frac != 65536) && (src_roi.w > 1) && (src_roi.h > 1)) {
+        src_x_accum -= 0x8000;
+        src_y_accum -= 0x8000;
+    }
+
+    int w_start = src_roi.x, w_limit = src_roi.x + src_roi.w - 1;
+    int h_start = src_roi.y, h_limit = src_roi.y + src_roi.h - 1;
+    int dst_w = IM_MAX(dst_x_end - dst_x_start, 0);
+
+    image_tensor_x_map_t *x_map = fb_alloc(IM_MAX(dst_w, 1) * sizeof(image_tensor_x_map_t), FB_ALLOC_NO_HINT);
+
+    for (int x = 0; x < dst_w; x++, src_x_accum += src_frac) {
+        int src_x_index = src_x_accum >> 16;
+        image_tensor_x_map_t *m = x_map + x;
+
+        // keep pixels in bounds
+        if (src_x_index < w_start) {
+            m->x0 = m->x1 = w_start;
+        } else if (src_x_index >= w_limit) {
+            m->x0 = m->x1 = w_limit;
+        } else {
+            m->x0 = src_x_index;
+            m->x1 = src_x_index + 1;
+        }
+
+        m->w = (src_x_accum >> 8) & 0xff;
+    }
+
+    // Quantization table for each possible 8-bit value.
+    uint8_t lut_8[256];
+    float lut_f[256];
+
+    for (int i = 0; i < 256; i++) {
+        float v = i * (1.0f / COLOR_GRAYSCALE_MAX);
+        if (datatype == IMAGE_TENSOR_DATATYPE_FLOAT) {
+            lut_f[i] = v;
+        } else {
+            int q = fast_roundf(v / scale) + zero_point;
+            lut_8[i] = (datatype == IMAGE_TENSOR_DATATYPE_INT8) ? __SSAT(q, 8) : __USAT(q, 8);
+        }
+    }
+
+    int row_len = IM_MAX(dst_w, 1) * channels;
+    uint16_t *row_0 = fb_alloc(row_len * sizeof(uint16_t), FB_ALLOC_NO_HINT);
+    uint16_t *row_1 = fb_alloc(row_len * sizeof(uint16_t), FB_ALLOC_NO_HINT);
+    void *line_buf = fb_alloc(src_img->w * sizeof(uint16_t), FB_ALLOC_NO_HINT);
+    int row_0_index = -1, row_1_index = -1;
+
+    int tensor_stride = w * channels;
+    uint8_t *tensor_8 = (uint8_t *) tensor;
+    float *tensor_f = (float *) tensor;
+
+    for (int y = 0; y < h; y++) {
+        int offset = y * tensor_stride;
+        int x = 0, x_end = tensor_stride;
+
+        if ((dst_y_start <= y) && (y < dst_y_end) && dst_w) {
+            int src_y_index = src_y_accum >> 16, y0 = src_y_index, y1 = src_y_index + 1;
+            int wy = (src_y_accum >> 8) & 0xff;
+            src_y_accum += src_frac;
+
+            // keep row pointers in bounds
+            if (src_y_index < h_start) {
+                y0 = y1 = h_start;
+            } else if (src_y_index >= h_limit) {
+                y0 = y1 = h_limit;
+            }
+
+            // Reuse the rows interpolated for the previous output row when possible.
+            if (row_1_index == y0) {
+                uint16_t *tmp = row_0;
+                row_0 = row_1;
+                row_1 = tmp;
+                row_0_index = y0;
+                row_1_index = -1;
+            }
+
+            if (row_0_index != y0) {
+                imlib_draw_image_tensor_row(row_0, src_img, y0, channels, x_map, dst_w, line_buf);
+                row_0_index = y0;
+            }
+
+            if ((y1 != y0) && (row_1_index != y1)) {
+                imlib_draw_image_tensor_row(row_1, src_img, y1, channels, x_map, dst_w, line_buf);
+                row_1_index = y1;
+            }
+
+            uint16_t *r1 = (y1 != y0) ? row_1 : row_0;
+
+            // Black background on the left.
+            x_end = dst_x_start * channels;
+            for (; x < x_end; x++) {
+                if (datatype == IMAGE_TENSOR_DATATYPE_FLOAT) {
+                    tensor_f[offset + x] = lut_f[0];
+                } else {
+                    tensor_8[offset + x] = lut_8[0];
+                }
+            }
+
+            int wy0 = 256 - wy;
+            if (datatype == IMAGE_TENSOR_DATATYPE_FLOAT) {
+                float *dst = tensor_f + offset + x;
+                for (int i = 0; i < row_len; i++) {
+                    dst[i] = lut_f[((row_0[i] * wy0) + (r1[i] * wy) + 32768) >> 16];
+                }
+            } else {
+                uint8_t *dst = tensor_8 + offset + x;
+                for (int i = 0; i < row_len; i++) {
+                    dst[i] = lut_8[((row_0[i] * wy0) + (r1[i] * wy) + 32768) >> 16];
+                }
+            }
+
+            x += dst_w * channels;
+            x_end = tensor_stride;
+        }
+
+        // Black background on the right, top and bottom.
+        for (; x < x_end; x++) {
+            if (datatype == IMAGE_TENSOR_DATATYPE_FLOAT) {
+                tensor_f[offset + x] = lut_f[0];
+            } else {
+                tensor_8[offset + x] = lut_8[0];
+            }
+        }
+    }
+
+    fb_free(); // line_buf
+    fb_free(); // row_1
+    fb_free(); // row_0
+    fb_free(); // x_map
+
+    if (is_compressed) {
+        fb_free();
+    }
+}
+
 #ifdef IMLIB_ENABLE_FLOOD_FILL
 void imlib_flood_fill(image_t *img, int x, int y,
                       float seed_threshold, float floating_threshold,
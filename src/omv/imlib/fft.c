@@ -13,6 +13,10 @@
 #include "file_utils.h"
 #include "omv_common.h"
 #include "fft.h"
+
+// Columns transformed per gather/scatter pass in the 2D transforms.
+#define FFT2D_STRIP    (8)
+
 // http://processors.wiki.ti.com/index.php/Efficient_FFT_Computation_of_Real_Input
 
 const static float fft_cos_table[512] = {
@@ -349,82 +353,127 @@ static void prepare_real_input_again(float *in, int in_len, float *out, int N_po
 //    }
 //}
 
-// Copies N complex pairs from in to out while bit reversing their indexes. The
-// in and out arrays may be the same.
+// Bit reverses the order of N complex pairs in place.
 
-static void prepare_complex_input(float *in, float *out, int N_pow2, int stride) {
-    if (in == out) {
-        for (int k = 0, l = 2 << N_pow2; k < l; k += 2) {
-            int m = bit_reverse(k, N_pow2);
-            if (k < m) {
-                swap(out + (m * stride) + 0, in + (k * stride) + 0);
-                swap(out + (m * stride) + 1, in + (k * stride) + 1);
-            }
-        }
-    } else {
-        for (int k = 0, l = 2 << N_pow2; k < l; k += 2) {
-            int m = bit_reverse(k, N_pow2);
-            out[(m * stride) + 0] = in[(k * stride) + 0];
-            out[(m * stride) + 1] = in[(k * stride) + 1];
+static void prepare_complex_input(float *inout, int N_pow2) {
+    for (int k = 0, l = 2 << N_pow2; k < l; k += 2) {
+        int m = bit_reverse(k, N_pow2);
+        if (k < m) {
+            swap(inout + m + 0, inout + k + 0);
+            swap(inout + m + 1, inout + k + 1);
         }
     }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-// Performs the fft in place.
-static void do_fft(float *inout, int N_pow2, int stride) {
-    int N = 2 << N_pow2;
-    for (int N_pow2_i = 1; N_pow2_i <= N_pow2; N_pow2_i++) {
-        int N_mul2 = 2 << N_pow2_i;
-        int N_div2 = 1 << N_pow2_i;
-        for (int i = 0; i < N; i += N_mul2) {
-            for (int j = i, k = 0, l = i + N_div2, m = N >> N_pow2_i; j < l; j += 2, k += m) {
-                int x0_r = (j * stride) + 0;
-                int x0_i = (j * stride) + 1;
-                int x1_r = ((j + N_div2) * stride) + 0;
-                int x1_i = ((j + N_div2) * stride) + 1;
-                float tmp_r = (inout[x1_r] * get_cos(k, N_pow2)) +
-                              (inout[x1_i] * get_sin(k, N_pow2));
-                float tmp_i = (inout[x1_i] * get_cos(k, N_pow2)) -
-                              (inout[x1_r] * get_sin(k, N_pow2));
-                inout[x1_r] = inout[x0_r] - tmp_r;
-                inout[x1_i] = inout[x0_i] - tmp_i;
-                inout[x0_r] += tmp_r;
-                inout[x0_i] += tmp_i;
-            }
+// Radix-4 passes merge two radix-2 stages, s and s + 1, into a single pass over the data. A
+// pass with a quarter size of q = 2^(s-1) complex points uses W^t, W^2t and W^3t for t < q,
+// where W = e^(-2*pi*i/4q). The tables of all passes are computed once per transform size.
+
+// Twiddle at table index k (k * pi / 512 radians), for k < 1024.
+OMV_ATTR_ALWAYS_INLINE static void get_twiddle(int k, float *w) {
+    if (k < 512) {
+        w[0] = fft_cos_table[k];
+        w[1] = fft_sin_table[k];
+    } else {
+        w[0] = -fft_cos_table[k - 512];
+        w[1] = -fft_sin_table[k - 512];
+    }
+}
+
+static int twiddles_size(int N_pow2) {
+    int size = 0;
+    for (int s = (N_pow2 & 1) + 1; s < N_pow2; s += 2) {
+        size += 6 << (s - 1);
+    }
+    return size;
+}
+
+static float *twiddles_alloc(int N_pow2) {
+    float *twiddles = fb_alloc(IM_MAX(twiddles_size(N_pow2), 1) * sizeof(float), FB_ALLOC_NO_HINT);
+    float *w = twiddles;
+
+    for (int s = (N_pow2 & 1) + 1; s < N_pow2; s += 2) {
+        for (int t = 0, q = 1 << (s - 1); t < q; t++, w += 6) {
+            get_twiddle((t * 1) << (9 - s), w + 0);
+            get_twiddle((t * 2) << (9 - s), w + 2);
+            get_twiddle((t * 3) << (9 - s), w + 4);
         }
     }
+
+    return twiddles;
 }
 
-// Performs the ifft in place.
-static void do_ifft(float *inout, int N_pow2, int stride) {
+// Performs the fft (or the ifft without scaling) in place on bit reversed input.
+OMV_ATTR_ALWAYS_INLINE static void do_fft_radix4(float *inout, int N_pow2, const float *twiddles, bool inverse) {
     int N = 2 << N_pow2;
-    for (int N_pow2_i = 1; N_pow2_i <= N_pow2; N_pow2_i++) {
-        int N_mul2 = 2 << N_pow2_i;
-        int N_div2 = 1 << N_pow2_i;
-        for (int i = 0; i < N; i += N_mul2) {
-            for (int j = i, k = 0, l = i + N_div2, m = N >> N_pow2_i; j < l; j += 2, k += m) {
-                int x0_r = (j * stride) + 0;
-                int x0_i = (j * stride) + 1;
-                int x1_r = ((j + N_div2) * stride) + 0;
-                int x1_i = ((j + N_div2) * stride) + 1;
-                float tmp_r = (inout[x1_r] * get_cos(k, N_pow2)) -
-                              (inout[x1_i] * get_sin(k, N_pow2));
-                float tmp_i = (inout[x1_i] * get_cos(k, N_pow2)) +
-                              (inout[x1_r] * get_sin(k, N_pow2));
-                inout[x1_r] = inout[x0_r] - tmp_r;
-                inout[x1_i] = inout[x0_i] - tmp_i;
-                inout[x0_r] += tmp_r;
-                inout[x0_i] += tmp_i;
+    // The forward transform multiplies by conj(W) terms and rotates by -i, the inverse by +i.
+    float sign = inverse ? -1.0f : 1.0f;
+
+    // Odd sizes start with a radix-2 stage, its only twiddle is 1.
+    if (N_pow2 & 1) {
+        for (int j = 0; j < N; j += 4) {
+            float tmp_r = inout[j + 2];
+            float tmp_i = inout[j + 3];
+            inout[j + 2] = inout[j + 0] - tmp_r;
+            inout[j + 3] = inout[j + 1] - tmp_i;
+            inout[j + 0] += tmp_r;
+            inout[j + 1] += tmp_i;
+        }
+    }
+
+    for (int s = (N_pow2 & 1) + 1; s < N_pow2; s += 2) {
+        int q = 2 << (s - 1); // quarter size in floats
+        for (int i = 0; i < N; i += (q << 2)) {
+            const float *w = twiddles;
+            for (int j = i, l = i + q; j < l; j += 2, w += 6) {
+                float *a = inout + j;
+                float *b = a + q;
+                float *c = b + q;
+                float *d = c + q;
+                float w1_r = w[0], w1_i = w[1] * sign;
+                float w2_r = w[2], w2_i = w[3] * sign;
+                float w3_r = w[4], w3_i = w[5] * sign;
+                // b is in the W^2t position of the bit reversed input, c in the W^t one.
+                float b_r = (b[0] * w2_r) + (b[1] * w2_i);
+                float b_i = (b[1] * w2_r) - (b[0] * w2_i);
+                float c_r = (c[0] * w1_r) + (c[1] * w1_i);
+                float c_i = (c[1] * w1_r) - (c[0] * w1_i);
+                float d_r = (d[0] * w3_r) + (d[1] * w3_i);
+                float d_i = (d[1] * w3_r) - (d[0] * w3_i);
+                float apb_r = a[0] + b_r, apb_i = a[1] + b_i;
+                float amb_r = a[0] - b_r, amb_i = a[1] - b_i;
+                float cpd_r = c_r + d_r, cpd_i = c_i + d_i;
+                float cmd_r = (c_r - d_r) * sign, cmd_i = (c_i - d_i) * sign;
+                a[0] = apb_r + cpd_r;
+                a[1] = apb_i + cpd_i;
+                c[0] = apb_r - cpd_r;
+                c[1] = apb_i - cpd_i;
+                b[0] = amb_r + cmd_i;
+                b[1] = amb_i - cmd_r;
+                d[0] = amb_r - cmd_i;
+                d[1] = amb_i + cmd_r;
             }
         }
+        twiddles += 3 * q;
     }
+}
+
+// Performs the fft in place.
+static void do_fft(float *inout, int N_pow2, const float *twiddles) {
+    do_fft_radix4(inout, N_pow2, twiddles, false);
+}
+
+// Performs the ifft in place.
+static void do_ifft(float *inout, int N_pow2, const float *twiddles) {
+    int N = 2 << N_pow2;
+    do_fft_radix4(inout, N_pow2, twiddles, true);
 
     float div = 1.0 / (N >> 1);
     for (int i = 0; i < N; i += 2) {
-        inout[(i * stride) + 0] *= div;
-        inout[(i * stride) + 1] *= div;
+        inout[i + 0] *= div;
+        inout[i + 1] *= div;
     }
 }
 
@@ -441,16 +490,40 @@ void fft1d_dealloc() {
     fb_free();
 }
 
+// The row helpers below take a scratch buffer of N floats and the twiddles of an N / 2 point
+// fft so that the 2D transforms can share them across all rows.
+
+static void fft1d_run_row(fft1d_controller_t *controller, float *h_buffer, const float *twiddles) {
+    prepare_real_input(controller->d_pointer, controller->d_len,
+                       h_buffer, controller->pow2 - 1);
+    do_fft(h_buffer, controller->pow2 - 1, twiddles);
+    unpack_fft(h_buffer, controller->data, controller->pow2 - 1);
+}
+
+static void ifft1d_run_row(fft1d_controller_t *controller, float *h_buffer, const float *twiddles) {
+    pack_fft(controller->data, h_buffer, controller->pow2 - 1);
+    prepare_complex_input(h_buffer, controller->pow2 - 1);
+    do_ifft(h_buffer, controller->pow2 - 1, twiddles);
+    memset(controller->data, 0, (2 << controller->pow2) * sizeof(float));
+    memcpy(controller->data, h_buffer, (1 << controller->pow2) * sizeof(float));
+}
+
+static void fft1d_run_again_row(fft1d_controller_t *controller, float *h_buffer, const float *twiddles) {
+    prepare_real_input_again(controller->data, 1 << controller->pow2,
+                             h_buffer, controller->pow2 - 1);
+    do_fft(h_buffer, controller->pow2 - 1, twiddles);
+    unpack_fft(h_buffer, controller->data, controller->pow2 - 1);
+}
+
 void fft1d_run(fft1d_controller_t *controller) {
     // We can speed up the FFT by packing data into both the real and imaginary
     // values. This results in having to do an FFT of half the size normally.
 
     float *h_buffer = fb_alloc((1 << controller->pow2) * sizeof(float), FB_ALLOC_NO_HINT);
-    prepare_real_input(controller->d_pointer, controller->d_len,
-                       h_buffer, controller->pow2 - 1);
-    do_fft(h_buffer, controller->pow2 - 1, 1);
-    unpack_fft(h_buffer, controller->data, controller->pow2 - 1);
-    fb_free();
+    float *twiddles = twiddles_alloc(controller->pow2 - 1);
+    fft1d_run_row(controller, h_buffer, twiddles);
+    fb_free(); // twiddles
+    fb_free(); // h_buffer
 }
 
 void ifft1d_run(fft1d_controller_t *controller) {
@@ -458,13 +531,10 @@ void ifft1d_run(fft1d_controller_t *controller) {
     // values. This results in having to do an FFT of half the size normally.
 
     float *h_buffer = fb_alloc((1 << controller->pow2) * sizeof(float), FB_ALLOC_NO_HINT);
-    pack_fft(controller->data, h_buffer, controller->pow2 - 1);
-    prepare_complex_input(h_buffer, h_buffer,
-                          controller->pow2 - 1, 1);
-    do_ifft(h_buffer, controller->pow2 - 1, 1);
-    memset(controller->data, 0, (2 << controller->pow2) * sizeof(float));
-    memcpy(controller->data, h_buffer, (1 << controller->pow2) * sizeof(float));
-    fb_free();
+    float *twiddles = twiddles_alloc(controller->pow2 - 1);
+    ifft1d_run_row(controller, h_buffer, twiddles);
+    fb_free(); // twiddles
+    fb_free(); // h_buffer
 }
 
 void fft1d_mag(fft1d_controller_t *controller) {
@@ -519,11 +589,10 @@ void fft1d_run_again(fft1d_controller_t *controller) {
     // values. This results in having to do an FFT of half the size normally.
 
     float *h_buffer = fb_alloc((1 << controller->pow2) * sizeof(float), FB_ALLOC_NO_HINT);
-    prepare_real_input_again(controller->data, 1 << controller->pow2,
-                             h_buffer, controller->pow2 - 1);
-    do_fft(h_buffer, controller->pow2 - 1, 1);
-    unpack_fft(h_buffer, controller->data, controller->pow2 - 1);
-    fb_free();
+    float *twiddles = twiddles_alloc(controller->pow2 - 1);
+    fft1d_run_again_row(controller, h_buffer, twiddles);
+    fb_free(); // twiddles
+    fb_free(); // h_buffer
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -545,13 +614,59 @@ void fft2d_dealloc() {
     fb_free();
 }
 
+// Striding down a column touches a new cache line per point, so columns are transformed in
+// strips of FFT2D_STRIP which are gathered (bit reversed) into a contiguous buffer first.
+static void fft2d_columns(fft2d_controller_t *controller, bool inverse) {
+    int w = 1 << controller->w_pow2;
+    int h = 1 << controller->h_pow2;
+    int col_len = 2 << controller->h_pow2;
+    int row_len = 2 << controller->w_pow2;
+    int strip = IM_MIN(w, FFT2D_STRIP);
+    float *buf = fb_alloc(strip * col_len * sizeof(float), FB_ALLOC_NO_HINT);
+    float *twiddles = twiddles_alloc(controller->h_pow2);
+
+    for (int x = 0; x < w; x += strip) {
+        for (int y = 0; y < h; y++) {
+            float *row_ptr = controller->data + (y * row_len) + (x * 2);
+            float *buf_ptr = buf + bit_reverse(y * 2, controller->h_pow2);
+            for (int i = 0; i < strip; i++, buf_ptr += col_len) {
+                buf_ptr[0] = row_ptr[(i * 2) + 0];
+                buf_ptr[1] = row_ptr[(i * 2) + 1];
+            }
+        }
+
+        for (int i = 0; i < strip; i++) {
+            if (inverse) {
+                do_ifft(buf + (i * col_len), controller->h_pow2, twiddles);
+            } else {
+                do_fft(buf + (i * col_len), controller->h_pow2, twiddles);
+            }
+        }
+
+        for (int y = 0; y < h; y++) {
+            float *row_ptr = controller->data + (y * row_len) + (x * 2);
+            float *buf_ptr = buf + (y * 2);
+            for (int i = 0; i < strip; i++, buf_ptr += col_len) {
+                row_ptr[(i * 2) + 0] = buf_ptr[0];
+                row_ptr[(i * 2) + 1] = buf_ptr[1];
+            }
+        }
+    }
+
+    fb_free(); // twiddles
+    fb_free(); // buf
+}
+
 void fft2d_run(fft2d_controller_t *controller) {
     // This section copies image data into the fft buffer. It takes care of
     // extracting the grey channel from RGB images if necessary. The code
     // also handles dealing with a rect less than the image size.
+    uint8_t *tmp = fb_alloc(controller->r.w * sizeof(uint8_t), FB_ALLOC_NO_HINT);
+    float *h_buffer = fb_alloc((1 << controller->w_pow2) * sizeof(float), FB_ALLOC_NO_HINT);
+    float *twiddles = twiddles_alloc(controller->w_pow2 - 1);
+
     for (int i = 0; i < controller->r.h; i++) {
         // Get image data into buffer.
-        uint8_t *tmp = fb_alloc(controller->r.w * sizeof(uint8_t), FB_ALLOC_NO_HINT);
         for (int j = 0; j < controller->r.w; j++) {
             if (IM_IS_GS(controller->img)) {
                 tmp[j] = IM_GET_GS_PIXEL(controller->img,
@@ -561,42 +676,40 @@ void fft2d_run(fft2d_controller_t *controller) {
                                                                controller->r.x + j, controller->r.y + i));
             }
         }
-        // Do FFT on image data and copy to main buffer.
+        // Do FFT on image data directly into the main buffer.
         fft1d_controller_t fft1d_controller_i;
-        fft1d_alloc(&fft1d_controller_i, tmp, controller->r.w);
-        fft1d_run(&fft1d_controller_i);
-        memcpy(controller->data + (i * (2 << controller->w_pow2)),
-               fft1d_controller_i.data, (2 << fft1d_controller_i.pow2) * sizeof(float));
-        fft1d_dealloc();
-        // Free image data buffer.
-        fb_free();
+        fft1d_controller_i.d_pointer = tmp;
+        fft1d_controller_i.d_len = controller->r.w;
+        fft1d_controller_i.pow2 = controller->w_pow2;
+        fft1d_controller_i.data = controller->data + (i * (2 << controller->w_pow2));
+        fft1d_run_row(&fft1d_controller_i, h_buffer, twiddles);
     }
 
-    // The above operates on the rows and this fft operates on the columns. To
-    // avoid having to transpose the array the fft takes a stride input.
-    for (int i = 0, ii = 2 << controller->w_pow2; i < ii; i += 2) {
-        float *p = controller->data + i;
-//        apply_hann_window(p, controller->h_pow2, (1 << controller->w_pow2));
-        prepare_complex_input(p, p, controller->h_pow2, (1 << controller->w_pow2));
-        do_fft(p, controller->h_pow2, (1 << controller->w_pow2));
-    }
+    fb_free(); // twiddles
+    fb_free(); // h_buffer
+    fb_free(); // tmp
+
+    // The above operates on the rows and this fft operates on the columns.
+    fft2d_columns(controller, false);
 }
 
 void ifft2d_run(fft2d_controller_t *controller) {
     // Do columns...
-    for (int i = 0, ii = 2 << controller->w_pow2; i < ii; i += 2) {
-        float *p = controller->data + i;
-        prepare_complex_input(p, p, controller->h_pow2, (1 << controller->w_pow2));
-        do_ifft(p, controller->h_pow2, (1 << controller->w_pow2));
-    }
+    fft2d_columns(controller, true);
 
     // Do rows...
+    float *h_buffer = fb_alloc((1 << controller->w_pow2) * sizeof(float), FB_ALLOC_NO_HINT);
+    float *twiddles = twiddles_alloc(controller->w_pow2 - 1);
+
     for (int i = 0, ii = 1 << controller->h_pow2; i < ii; i++) {
         fft1d_controller_t fft1d_controller_i;
         fft1d_controller_i.pow2 = controller->w_pow2;
         fft1d_controller_i.data = controller->data + (i * (2 << controller->w_pow2));
-        ifft1d_run(&fft1d_controller_i);
+        ifft1d_run_row(&fft1d_controller_i, h_buffer, twiddles);
     }
+
+    fb_free(); // twiddles
+    fb_free(); // h_buffer
 }
 
 void fft2d_mag(fft2d_controller_t *controller) {
@@ -730,19 +843,19 @@ void fft2d_logpolar(fft2d_controller_t *controller) {
 }
 
 void fft2d_run_again(fft2d_controller_t *controller) {
+    float *h_buffer = fb_alloc((1 << controller->w_pow2) * sizeof(float), FB_ALLOC_NO_HINT);
+    float *twiddles = twiddles_alloc(controller->w_pow2 - 1);
+
     for (int i = 0, ii = 1 << controller->h_pow2; i < ii; i++) {
         fft1d_controller_t fft1d_controller_i;
         fft1d_controller_i.pow2 = controller->w_pow2;
         fft1d_controller_i.data = controller->data + (i * (2 << controller->w_pow2));
-        fft1d_run_again(&fft1d_controller_i);
+        fft1d_run_again_row(&fft1d_controller_i, h_buffer, twiddles);
     }
 
-    // The above operates on the rows and this fft operates on the columns. To
-    // avoid having to transpose the array the fft takes a stride input.
-    for (int i = 0, ii = 2 << controller->w_pow2; i < ii; i += 2) {
-        float *p = controller->data + i;
-//        apply_hann_window(p, controller->h_pow2, (1 << controller->w_pow2));
-        prepare_complex_input(p, p, controller->h_pow2, (1 << controller->w_pow2));
-        do_fft(p, controller->h_pow2, (1 << controller->w_pow2));
-    }
+    fb_free(); // twiddles
+    fb_free(); // h_buffer
+
+    // The above operates on the rows and this fft operates on the columns.
+    fft2d_columns(controller, false);
 }
@@ -388,6 +388,303 @@ static uint8_t hist_median(uint8_t *data, int len, const int cutoff) {
     return i - 1;
 } /* hist_median() */
 
+// Constant time median filter (Perreault and Hebert, "Median Filtering in Constant Time").
+//
+// Each image column keeps a histogram of the 2*ksize+1 rows around the current row which is updated
+// with one add and one remove per row. The kernel histogram is then slid across the row by adding the
+// entering column histogram and removing the leaving one. Histograms are split into coarse bins of
+// MEDIAN_HIST_FINE fine bins each. Only the coarse kernel histogram is slid for every pixel while the
+// fine bins of a coarse bin are brought up to date lazily when the median falls into it.
+//
+// Bins and borders match the sliding histogram filter below so the output is the same.
+#define MEDIAN_HIST_FINE_SHIFT      (3)
+#define MEDIAN_HIST_FINE            (1 << MEDIAN_HIST_FINE_SHIFT)
+#define MEDIAN_HIST_BINS_MAX        (64)
+#define MEDIAN_HIST_COARSE_MAX      (MEDIAN_HIST_BINS_MAX / MEDIAN_HIST_FINE)
+// Below this the sliding histogram is faster. Above the max the column counts overflow.
+#define MEDIAN_HIST_KSIZE_MIN       (2)
+#ifndef MEDIAN_HIST_KSIZE_MAX
+#define MEDIAN_HIST_KSIZE_MAX       (127)
+#endif
+
+typedef struct median_hist {
+    int bins;
+    int coarse;
+    uint8_t *col_fine;   // bins per column.
+    uint8_t *col_coarse; // coarse bins per column.
+    uint16_t fine[MEDIAN_HIST_BINS_MAX];
+    uint16_t coarse_hist[MEDIAN_HIST_COARSE_MAX];
+    int fine_x[MEDIAN_HIST_COARSE_MAX]; // x the fine bins of each coarse bin are valid for (-1 if none).
+} median_hist_t;
+
+static void median_hist_alloc(median_hist_t *h, int w, int bins) {
+    h->bins = bins;
+    h->coarse = bins >> MEDIAN_HIST_FINE_SHIFT;
+    h->col_fine = fb_alloc0(w * bins, FB_ALLOC_NO_HINT);
+    h->col_coarse = fb_alloc0(w * h->coarse, FB_ALLOC_NO_HINT);
+}
+
+static void median_hist_free(median_hist_t *h) {
+    fb_free(); // col_coarse
+    fb_free(); // col_fine
+}
+
+static inline void median_hist_col_update(median_hist_t *h, int x, int old_bin, int new_bin) {
+    uint8_t *col_fine = h->col_fine + (x * h->bins);
+    uint8_t *col_coarse = h->col_coarse + (x * h->coarse);
+    col_fine[old_bin]--;
+    col_fine[new_bin]++;
+    col_coarse[old_bin >> MEDIAN_HIST_FINE_SHIFT]--;
+    col_coarse[new_bin >> MEDIAN_HIST_FINE_SHIFT]++;
+}
+
+static inline void median_hist_col_add(median_hist_t *h, int x, int bin, int n) {
+    h->col_fine[(x * h->bins) + bin] += n;
+    h->col_coarse[(x * h->coarse) + (bin >> MEDIAN_HIST_FINE_SHIFT)] += n;
+}
+
+// Sets up the coarse kernel histogram for the start of a row. Columns outside of the image are clamped.
+static void median_hist_row_start(median_hist_t *h, int w, int ksize) {
+    memset(h->coarse_hist, 0, sizeof(h->coarse_hist));
+
+    for (int k = -ksize; k <= ksize; k++) {
+        uint8_t *col_coarse = h->col_coarse + (IM_CLAMP(k, 0, w - 1) * h->coarse);
+        for (int c = 0; c < h->coarse; c++) {
+            h->coarse_hist[c] += col_coarse[c];
+        }
+    }
+
+    for (int c = 0; c < h->coarse; c++) {
+        h->fine_x[c] = -1;
+    }
+}
+
+// Slides the coarse kernel histogram from x - 1 to x.
+static inline void median_hist_slide(median_hist_t *h, int x, int w, int ksize) {
+    uint8_t *col_add = h->col_coarse + (IM_MIN(x + ksize, w - 1) * h->coarse);
+    uint8_t *col_sub = h->col_coarse + (IM_MAX(x - ksize - 1, 0) * h->coarse);
+
+    for (int c = 0; c < h->coarse; c++) {
+        h->coarse_hist[c] += col_add[c] - col_sub[c];
+    }
+}
+
+// Brings the fine bins of coarse bin c up to date for x.
+static void median_hist_fine_update(median_hist_t *h, int c, int x, int w, int ksize) {
+    uint16_t *fine = h->fine + (c << MEDIAN_HIST_FINE_SHIFT);
+    int offset = c << MEDIAN_HIST_FINE_SHIFT;
+
+    if ((h->fine_x[c] < 0) || ((x - h->fine_x[c]) > ((ksize * 2) + 1))) {
+        // Cheaper to rebuild the bins from scratch.
+        memset(fine, 0, MEDIAN_HIST_FINE * sizeof(uint16_t));
+
+        for (int k = -ksize; k <= ksize; k++) {
+            uint8_t *col_fine = h->col_fine + (IM_CLAMP(x + k, 0, w - 1) * h->bins) + offset;
+            for (int i = 0; i < MEDIAN_HIST_FINE; i++) {
+                fine[i] += col_fine[i];
+            }
+        }
+    } else {
+        for (int xx = h->fine_x[c] + 1; xx <= x; xx++) {
+            uint8_t *col_add = h->col_fine + (IM_MIN(xx + ksize, w - 1) * h->bins) + offset;
+            uint8_t *col_sub = h->col_fine + (IM_MAX(xx - ksize - 1, 0) * h->bins) + offset;
+            for (int i = 0; i < MEDIAN_HIST_FINE; i++) {
+                fine[i] += col_add[i] - col_sub[i];
+            }
+        }
+    }
+
+    h->fine_x[c] = x;
+}
+
+// Same result as hist_median() on the kernel histogram.
+static uint8_t median_hist_find(median_hist_t *h, int x, int w, int ksize, const int cutoff) {
+    if (cutoff <= 0) {
+        return -1;
+    }
+
+    int sum = 0;
+    for (int c = 0; c < h->coarse; c++) {
+        if ((sum + h->coarse_hist[c]) >= cutoff) {
+            median_hist_fine_update(h, c, x, w, ksize);
+            uint16_t *fine = h->fine + (c << MEDIAN_HIST_FINE_SHIFT);
+
+            for (int i = 0; ; i++) {
+                sum += fine[i];
+                if (sum >= cutoff) {
+                    return (c << MEDIAN_HIST_FINE_SHIFT) + i;
+                }
+            }
+        }
+
+        sum += h->coarse_hist[c];
+    }
+
+    return h->bins - 1;
+}
+
+static void imlib_median_filter_hist(image_t *img, const int ksize, const int median_cutoff, bool threshold,
+                                     int offset, bool invert, image_t *mask) {
+    // The column histograms remove the row above the window so one more buffered row is needed.
+    int brows = ksize + 2;
+    image_t buf;
+    buf.w = img->w;
+    buf.h = brows;
+    buf.pixfmt = img->pixfmt;
+    buf.data = fb_alloc(image_line_size(img) * brows, FB_ALLOC_NO_HINT);
+
+    int w = img->w;
+    int h_max = img->h - 1;
+    bool rgb565 = img->pixfmt == PIXFORMAT_RGB565;
+    median_hist_t h[3];
+
+    if (rgb565) {
+        median_hist_alloc(&h[0], w, 32);
+        median_hist_alloc(&h[1], w, 64);
+        median_hist_alloc(&h[2], w, 32);
+    } else {
+        median_hist_alloc(&h[0], w, 64);
+    }
+
+    // Column histograms for the rows around y = 0 with clamped borders.
+    for (int j = -ksize; j <= ksize; j++) {
+        int y_j = IM_CLAMP(j, 0, h_max);
+
+        if (rgb565) {
+            uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y_j);
+            for (int x = 0; x < w; x++) {
+                int pixel = IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x);
+                median_hist_col_add(&h[0], x, COLOR_RGB565_TO_R5(pixel), 1);
+                median_hist_col_add(&h[1], x, COLOR_RGB565_TO_G6(pixel), 1);
+                median_hist_col_add(&h[2], x, COLOR_RGB565_TO_B5(pixel), 1);
+            }
+        } else {
+            uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y_j);
+            for (int x = 0; x < w; x++) {
+                median_hist_col_add(&h[0], x, IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x) >> 2, 1);
+            }
+        }
+    }
+
+    for (int y = 0, yy = img->h; y < yy; y++) {
+        if (y) {
+            int y_old = IM_MAX(y - ksize - 1, 0);
+            int y_new = IM_MIN(y + ksize, h_max);
+
+            if (y_old != y_new) {
+                if (rgb565) {
+                    uint16_t *old_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y_old);
+                    uint16_t *new_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y_new);
+                    for (int x = 0; x < w; x++) {
+                        int old_pixel = IMAGE_GET_RGB565_PIXEL_FAST(old_row_ptr, x);
+                        int new_pixel = IMAGE_GET_RGB565_PIXEL_FAST(new_row_ptr, x);
+                        if (old_pixel != new_pixel) {
+                            median_hist_col_update(&h[0], x, COLOR_RGB565_TO_R5(old_pixel),
+                                                   COLOR_RGB565_TO_R5(new_pixel));
+                            median_hist_col_update(&h[1], x, COLOR_RGB565_TO_G6(old_pixel),
+                                                   COLOR_RGB565_TO_G6(new_pixel));
+                            median_hist_col_update(&h[2], x, COLOR_RGB565_TO_B5(old_pixel),
+                                                   COLOR_RGB565_TO_B5(new_pixel));
+                        }
+                    }
+                } else {
+                    uint8_t *old_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y_old);
+                    uint8_t *new_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y_new);
+                    for (int x = 0; x < w; x++) {
+                        median_hist_col_update(&h[0], x, IMAGE_GET_GRAYSCALE_PIXEL_FAST(old_row_ptr, x) >> 2,
+                                               IMAGE_GET_GRAYSCALE_PIXEL_FAST(new_row_ptr, x) >> 2);
+                    }
+                }
+            }
+        }
+
+        for (int i = 0, ii = rgb565 ? 3 : 1; i < ii; i++) {
+            median_hist_row_start(&h[i], w, ksize);
+        }
+
+        if (rgb565) {
+            uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y);
+            uint16_t *buf_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(&buf, (y % brows));
+
+            for (int x = 0; x < w; x++) {
+                if (x) {
+                    median_hist_slide(&h[0], x, w, ksize);
+                    median_hist_slide(&h[1], x, w, ksize);
+                    median_hist_slide(&h[2], x, w, ksize);
+                }
+
+                if (mask && (!image_get_mask_pixel(mask, x, y))) {
+                    IMAGE_PUT_RGB565_PIXEL_FAST(buf_row_ptr, x, IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
+                    continue; // Short circuit.
+                }
+
+                uint8_t r = median_hist_find(&h[0], x, w, ksize, median_cutoff);
+                uint8_t g = median_hist_find(&h[1], x, w, ksize, median_cutoff);
+                uint8_t b = median_hist_find(&h[2], x, w, ksize, median_cutoff);
+
+                int pixel = COLOR_R5_G6_B5_TO_RGB565(r, g, b);
+
+                if (threshold) {
+                    if (((COLOR_RGB565_TO_Y(pixel) - offset) <
+                         COLOR_RGB565_TO_Y(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x))) ^ invert) {
+                        pixel = COLOR_RGB565_BINARY_MAX;
+                    } else {
+                        pixel = COLOR_RGB565_BINARY_MIN;
+                    }
+                }
+
+                IMAGE_PUT_RGB565_PIXEL_FAST(buf_row_ptr, x, pixel);
+            }
+        } else {
+            uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y);
+            uint8_t *buf_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(&buf, (y % brows));
+
+            for (int x = 0; x < w; x++) {
+                if (x) {
+                    median_hist_slide(&h[0], x, w, ksize);
+                }
+
+                if (mask && (!image_get_mask_pixel(mask, x, y))) {
+                    IMAGE_PUT_GRAYSCALE_PIXEL_FAST(buf_row_ptr, x, IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x));
+                    continue; // Short circuit.
+                }
+
+                uint8_t pixel = median_hist_find(&h[0], x, w, ksize, median_cutoff) << 2;
+
+                if (threshold) {
+                    if (((pixel - offset) < IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x)) ^ invert) {
+                        pixel = COLOR_GRAYSCALE_BINARY_MAX;
+                    } else {
+                        pixel = COLOR_GRAYSCALE_BINARY_MIN;
+                    }
+                }
+
+                IMAGE_PUT_GRAYSCALE_PIXEL_FAST(buf_row_ptr, x, pixel);
+            }
+        }
+
+        if (y > ksize) {
+            // Transfer buffer lines...
+            memcpy(img->data + ((y - ksize - 1) * image_line_size(img)),
+                   buf.data + (((y - ksize - 1) % brows) * image_line_size(img)),
+                   image_line_size(img));
+        }
+    }
+
+    // Copy any remaining lines from the buffer image...
+    for (int y = IM_MAX(img->h - ksize - 1, 0), yy = img->h; y < yy; y++) {
+        memcpy(img->data + (y * image_line_size(img)),
+               buf.data + ((y % brows) * image_line_size(img)),
+               image_line_size(img));
+    }
+
+    for (int i = rgb565 ? 2 : 0; i >= 0; i--) {
+        median_hist_free(&h[i]);
+    }
+
+    fb_free(); // buf
+}
+
 void imlib_median_filter(image_t *img, const int ksize, float percentile, bool threshold, int offset, bool invert,
                          image_t *mask) {
     int brows = ksize + 1;
@@ -399,6 +696,12 @@ void imlib_median_filter(image_t *img, const int ksize, float percentile, bool t
     const int n = ((ksize * 2) + 1) * ((ksize * 2) + 1);
     const int median_cutoff = fast_floorf(percentile * (float) n);
 
+    if (((img->pixfmt == PIXFORMAT_GRAYSCALE) || (img->pixfmt == PIXFORMAT_RGB565))
+        && (ksize >= MEDIAN_HIST_KSIZE_MIN) && (ksize <= MEDIAN_HIST_KSIZE_MAX)) {
+        imlib_median_filter_hist(img, ksize, median_cutoff, threshold, offset, invert, mask);
+        return;
+    }
+
     switch (img->pixfmt) {
         case PIXFORMAT_BINARY: {
             buf.data = fb_alloc(IMAGE_BINARY_LINE_LEN_BYTES(img) * brows, FB_ALLOC_NO_HINT);
@@ -1235,6 +1538,375 @@ void imlib_midpoint_filter(image_t *img, const int ksize, float bias, bool thres
 
 // http://www.fmwconcepts.com/imagemagick/digital_image_filtering.pdf
 
+static void imlib_morph_direct(image_t *img,
+                               const int ksize,
+                               const int *krn,
+                               const float m,
+                               const float b,
+                               bool threshold,
+                               int offset,
+                               bool invert,
+                               image_t *mask);
+
+// Splits krn into the outer product of col_krn and row_krn plus an extra center tap (like the
+// unsharp and laplacian kernels have). Returns false if the kernel is not separable.
+static bool imlib_morph_separate(const int ksize, const int *krn, int *row_krn, int *col_krn, int *center) {
+    int n = (ksize * 2) + 1;
+    int p = -1, q = -1;
+
+    // Find a non-zero pivot whose row and column do not go through the center tap.
+    for (int i = 0; (i < n) && (p < 0); i++) {
+        for (int j = 0; (i != ksize) && (j < n); j++) {
+            if ((j != ksize) && krn[(i * n) + j]) {
+                p = i;
+                q = j;
+                break;
+            }
+        }
+    }
+
+    if (p < 0) {
+        return false;
+    }
+
+    // The row vector is the pivot row divided by its greatest common divisor.
+    int gcd = 0;
+    for (int j = 0; j < n; j++) {
+        for (int a = abs(krn[(p * n) + j]), b; a; a = b) {
+            b = gcd % a;
+            gcd = a;
+        }
+    }
+
+    for (int j = 0; j < n; j++) {
+        row_krn[j] = krn[(p * n) + j] / gcd;
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (krn[(i * n) + q] % row_krn[q]) {
+            return false;
+        }
+
+        col_krn[i] = krn[(i * n) + q] / row_krn[q];
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (((i != ksize) || (j != ksize)) && (krn[(i * n) + j] != (col_krn[i] * row_krn[j]))) {
+                return false;
+            }
+        }
+    }
+
+    *center = krn[(ksize * n) + ksize] - (col_krn[ksize] * row_krn[ksize]);
+    return true;
+}
+
+// Same as imlib_morph() for a kernel that is the outer product of col_krn and row_krn plus center
+// times the center pixel. Each output line is computed with a vertical pass into a line of
+// accumulators followed by a horizontal pass over it, so the cost is linear in ksize.
+void imlib_sepmorph(image_t *img,
+                    const int ksize,
+                    const int *row_krn,
+                    const int *col_krn,
+                    const int center,
+                    const float m,
+                    const float b,
+                    bool threshold,
+                    int offset,
+                    bool invert,
+                    image_t *mask) {
+    int n = (ksize * 2) + 1;
+    int brows = ksize + 1;
+    int channels = (img->pixfmt == PIXFORMAT_RGB565) ? 3 : 1;
+    int acc_w = img->w + (ksize * 2);
+    image_t buf;
+    buf.w = img->w;
+    buf.h = brows;
+    buf.pixfmt = img->pixfmt;
+    invert = invert ? 1 : 0; // ensure binary
+
+    // Shift the vertical sums down (when needed) so the horizontal sums cannot overflow.
+    uint32_t row_sum = 0, col_sum = 0, shift = 0;
+    uint32_t max_value = (img->pixfmt == PIXFORMAT_BINARY) ? COLOR_BINARY_MAX :
+                         (img->pixfmt == PIXFORMAT_GRAYSCALE) ? COLOR_GRAYSCALE_MAX : COLOR_G6_MAX;
+
+    for (int i = 0; i < n; i++) {
+        row_sum += abs(row_krn[i]);
+        col_sum += abs(col_krn[i]);
+    }
+
+    while (((((uint64_t) col_sum * max_value) >> shift) * row_sum) >= (1 << 30)) {
+        shift += 1;
+    }
+
+    // Output is computed in 32.32 fixed point. If m or b are too large for the products to fit in 64
+    // bits the full 2D kernel is run by imlib_morph_direct() instead.
+    float acc_max = (((((uint64_t) col_sum * max_value) >> shift) * row_sum) << shift);
+    float range = (fabsf(m) * (IM_MAX(acc_max, 1.0f) + (abs(center) * max_value))) + fabsf(b);
+
+    if (!(range < 1073741824.0f)) {
+        int *krn = fb_alloc(n * n * sizeof(int), FB_ALLOC_NO_HINT);
+
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                krn[(i * n) + j] = col_krn[i] * row_krn[j];
+            }
+        }
+
+        krn[(ksize * n) + ksize] += center;
+        imlib_morph_direct(img, ksize, krn, m, b, threshold, offset, invert, mask);
+        fb_free();
+        return;
+    }
+
+    const int32_t round = shift ? (1 << (shift - 1)) : 0;
+    const int64_t m_int = (int64_t) (m * (1 << shift) * 4294967296.0f);
+    const int64_t c_int = ((int64_t) (m * 4294967296.0f)) * center;
+    const int64_t b_int = (int64_t) (b * 4294967296.0f);
+
+    int32_t *acc_buf = fb_alloc(acc_w * channels * sizeof(int32_t), FB_ALLOC_NO_HINT);
+
+    switch (img->pixfmt) {
+        case PIXFORMAT_BINARY: {
+            buf.data = fb_alloc(IMAGE_BINARY_LINE_LEN_BYTES(img) * brows, FB_ALLOC_NO_HINT);
+
+            for (int y = 0; y < img->h; y++) {
+                uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y);
+                uint32_t *buf_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&buf, (y % brows));
+                int32_t *acc_row = acc_buf + ksize;
+
+                memset(acc_row, 0, img->w * sizeof(int32_t));
+
+                for (int j = 0; j < n; j++) {
+                    uint32_t *k_row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, IM_CLAMP(y + j - ksize, 0, (img->h - 1)));
+                    int32_t k = col_krn[j];
+
+                    for (int x = 0; k && (x < img->w); x++) {
+                        acc_row[x] += k * IMAGE_GET_BINARY_PIXEL_FAST(k_row_ptr, x);
+                    }
+                }
+
+                for (int x = 0; x < img->w; x++) {
+                    acc_row[x] = (acc_row[x] + round) >> shift;
+                }
+
+                for (int x = 0; x < ksize; x++) {
+                    acc_buf[x] = acc_row[0];
+                    acc_row[img->w + x] = acc_row[img->w - 1];
+                }
+
+                for (int x = 0; x < img->w; x++) {
+                    int p = IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x);
+
+                    if (mask && (!image_get_mask_pixel(mask, x, y))) {
+                        IMAGE_PUT_BINARY_PIXEL_FAST(buf_row_ptr, x, p);
+                        continue; // Short circuit.
+                    }
+
+                    int32_t acc = 0;
+                    for (int i = 0; i < n; i++) {
+                        acc += row_krn[i] * acc_buf[x + i];
+                    }
+
+                    int pixel = __USAT((int32_t) (((acc * m_int) + (c_int * p) + b_int) >> 32), 1);
+
+                    if (threshold) {
+                        pixel -= offset;
+                        pixel = pixel < IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x);
+                        pixel = pixel ^ invert;
+                    }
+
+                    IMAGE_PUT_BINARY_PIXEL_FAST(buf_row_ptr, x, pixel);
+                }
+
+                if (y >= ksize) {
+                    // Transfer buffer lines...
+                    memcpy(IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, (y - ksize)),
+                           IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&buf, ((y - ksize) % brows)),
+                           IMAGE_BINARY_LINE_LEN_BYTES(img));
+                }
+            }
+
+            // Copy any remaining lines from the buffer image...
+            for (int y = IM_MAX(img->h - ksize, 0); y < img->h; y++) {
+                memcpy(IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(img, y),
+                       IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(&buf, (y % brows)),
+                       IMAGE_BINARY_LINE_LEN_BYTES(img));
+            }
+
+            fb_free();
+            break;
+        }
+        case PIXFORMAT_GRAYSCALE: {
+            buf.data = fb_alloc(IMAGE_GRAYSCALE_LINE_LEN_BYTES(img) * brows, FB_ALLOC_NO_HINT);
+
+            for (int y = 0; y < img->h; y++) {
+                uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y);
+                uint8_t *buf_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(&buf, (y % brows));
+                int32_t *acc_row = acc_buf + ksize;
+
+                memset(acc_row, 0, img->w * sizeof(int32_t));
+
+                for (int j = 0; j < n; j++) {
+                    uint8_t *k_row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, IM_CLAMP(y + j - ksize, 0, (img->h - 1)));
+                    int32_t k = col_krn[j];
+
+                    for (int x = 0; k && (x < img->w); x++) {
+                        acc_row[x] += k * k_row_ptr[x];
+                    }
+                }
+
+                for (int x = 0; x < img->w; x++) {
+                    acc_row[x] = (acc_row[x] + round) >> shift;
+                }
+
+                for (int x = 0; x < ksize; x++) {
+                    acc_buf[x] = acc_row[0];
+                    acc_row[img->w + x] = acc_row[img->w - 1];
+                }
+
+                for (int x = 0; x < img->w; x++) {
+                    int p = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x);
+
+                    if (mask && (!image_get_mask_pixel(mask, x, y))) {
+                        IMAGE_PUT_GRAYSCALE_PIXEL_FAST(buf_row_ptr, x, p);
+                        continue; // Short circuit.
+                    }
+
+                    int32_t acc = 0;
+                    for (int i = 0; i < n; i++) {
+                        acc += row_krn[i] * acc_buf[x + i];
+                    }
+
+                    int pixel = __USAT((int32_t) (((acc * m_int) + (c_int * p) + b_int) >> 32), 8);
+
+                    if (threshold) {
+                        pixel -= offset;
+                        pixel = pixel < p;
+                        pixel = (pixel ^ invert) * COLOR_GRAYSCALE_BINARY_MAX;
+                    }
+
+                    IMAGE_PUT_GRAYSCALE_PIXEL_FAST(buf_row_ptr, x, pixel);
+                }
+
+                if (y >= ksize) {
+                    // Transfer buffer lines...
+                    memcpy(IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, (y - ksize)),
+                           IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(&buf, ((y - ksize) % brows)),
+                           IMAGE_GRAYSCALE_LINE_LEN_BYTES(img));
+                }
+            }
+
+            // Copy any remaining lines from the buffer image...
+            for (int y = IM_MAX(img->h - ksize, 0); y < img->h; y++) {
+                memcpy(IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y),
+                       IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(&buf, (y % brows)),
+                       IMAGE_GRAYSCALE_LINE_LEN_BYTES(img));
+            }
+
+            fb_free();
+            break;
+        }
+        case PIXFORMAT_RGB565: {
+            buf.data = fb_alloc(IMAGE_RGB565_LINE_LEN_BYTES(img) * brows, FB_ALLOC_NO_HINT);
+
+            int32_t *r_buf = acc_buf;
+            int32_t *g_buf = r_buf + acc_w;
+            int32_t *b_buf = g_buf + acc_w;
+
+            for (int y = 0; y < img->h; y++) {
+                uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y);
+                uint16_t *buf_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(&buf, (y % brows));
+                int32_t *r_row = r_buf + ksize, *g_row = g_buf + ksize, *b_row = b_buf + ksize;
+
+                memset(r_row, 0, img->w * sizeof(int32_t));
+                memset(g_row, 0, img->w * sizeof(int32_t));
+                memset(b_row, 0, img->w * sizeof(int32_t));
+
+                for (int j = 0; j < n; j++) {
+                    uint16_t *k_row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, IM_CLAMP(y + j - ksize, 0, (img->h - 1)));
+                    int32_t k = col_krn[j];
+
+                    for (int x = 0; k && (x < img->w); x++) {
+                        int pixel = k_row_ptr[x];
+                        r_row[x] += k * COLOR_RGB565_TO_R5(pixel);
+                        g_row[x] += k * COLOR_RGB565_TO_G6(pixel);
+                        b_row[x] += k * COLOR_RGB565_TO_B5(pixel);
+                    }
+                }
+
+                for (int x = 0; x < img->w; x++) {
+                    r_row[x] = (r_row[x] + round) >> shift;
+                    g_row[x] = (g_row[x] + round) >> shift;
+                    b_row[x] = (b_row[x] + round) >> shift;
+                }
+
+                for (int x = 0; x < ksize; x++) {
+                    r_buf[x] = r_row[0];
+                    g_buf[x] = g_row[0];
+                    b_buf[x] = b_row[0];
+                    r_row[img->w + x] = r_row[img->w - 1];
+                    g_row[img->w + x] = g_row[img->w - 1];
+                    b_row[img->w + x] = b_row[img->w - 1];
+                }
+
+                for (int x = 0; x < img->w; x++) {
+                    int p = IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x);
+
+                    if (mask && (!image_get_mask_pixel(mask, x, y))) {
+                        IMAGE_PUT_RGB565_PIXEL_FAST(buf_row_ptr, x, p);
+                        continue; // Short circuit.
+                    }
+
+                    int32_t r_acc = 0, g_acc = 0, b_acc = 0;
+                    for (int i = 0; i < n; i++) {
+                        int32_t k = row_krn[i];
+                        r_acc += k * r_buf[x + i];
+                        g_acc += k * g_buf[x + i];
+                        b_acc += k * b_buf[x + i];
+                    }
+
+                    int r_pixel = __USAT((int32_t) (((r_acc * m_int) + (c_int * COLOR_RGB565_TO_R5(p)) + b_int) >> 32), 5);
+                    int g_pixel = __USAT((int32_t) (((g_acc * m_int) + (c_int * COLOR_RGB565_TO_G6(p)) + b_int) >> 32), 6);
+                    int b_pixel = __USAT((int32_t) (((b_acc * m_int) + (c_int * COLOR_RGB565_TO_B5(p)) + b_int) >> 32), 5);
+                    int pixel = COLOR_R5_G6_B5_TO_RGB565(r_pixel, g_pixel, b_pixel);
+
+                    if (threshold) {
+                        pixel = COLOR_RGB565_TO_Y(pixel) - offset;
+                        pixel = pixel < COLOR_RGB565_TO_Y(p);
+                        pixel = (pixel ^ invert) * COLOR_RGB565_BINARY_MAX;
+                    }
+
+                    IMAGE_PUT_RGB565_PIXEL_FAST(buf_row_ptr, x, pixel);
+                }
+
+                if (y >= ksize) {
+                    // Transfer buffer lines...
+                    memcpy(IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, (y - ksize)),
+                           IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(&buf, ((y - ksize) % brows)),
+                           IMAGE_RGB565_LINE_LEN_BYTES(img));
+                }
+            }
+
+            // Copy any remaining lines from the buffer image...
+            for (int y = IM_MAX(img->h - ksize, 0); y < img->h; y++) {
+                memcpy(IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y),
+                       IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(&buf, (y % brows)),
+                       IMAGE_RGB565_LINE_LEN_BYTES(img));
+            }
+
+            fb_free();
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+
+    fb_free();
+}
+
 void imlib_morph(image_t *img,
                  const int ksize,
                  const int *krn,
@@ -1244,6 +1916,38 @@ void imlib_morph(image_t *img,
                  int offset,
                  bool invert,
                  image_t *mask) {
+    // The 3x3 kernels have their own optimized paths in imlib_morph_direct(). Larger kernels are run
+    // as two 1D passes if they are separable (e.g. the gaussian() and laplacian() kernels).
+    if (ksize >= 2) {
+        int n = (ksize * 2) + 1, center;
+        int *row_krn = fb_alloc(n * sizeof(int), FB_ALLOC_NO_HINT);
+        int *col_krn = fb_alloc(n * sizeof(int), FB_ALLOC_NO_HINT);
+        bool separable = imlib_morph_separate(ksize, krn, row_krn, col_krn, &center);
+
+        if (separable) {
+            imlib_sepmorph(img, ksize, row_krn, col_krn, center, m, b, threshold, offset, invert, mask);
+        }
+
+        fb_free();
+        fb_free();
+
+        if (separable) {
+            return;
+        }
+    }
+
+    imlib_morph_direct(img, ksize, krn, m, b, threshold, offset, invert, mask);
+}
+
+static void imlib_morph_direct(image_t *img,
+                               const int ksize,
+                               const int *krn,
+                               const float m,
+                               const float b,
+                               bool threshold,
+                               int offset,
+                               bool invert,
+                               image_t *mask) {
     int brows = ksize + 1;
     image_t buf;
     buf.w = img->w;
@@ -2077,4 +2781,274 @@ void imlib_bilateral_filter(image_t *img,
         }
     }
 }
+
+// Bilateral grid (Chen, Paris and Durand 2007). Each channel is splatted into a volume of cells
+// that are ksize * space_sigma pixels wide and tall and color_sigma of the channel range deep,
+// holding the sum and count of the values that fall in them. The volume is blurred with a [1 2 1] kernel along
+// each axis and the output is sliced out of it with trilinear interpolation. Only a few rows of the
+// volume are kept around at a time so the image is filtered in place, and the cost per pixel does
+// not depend on the spatial sigma.
+//
+// The volume rows need (5 * channels + 1) * (w / cell + 2) * (range bins + 2) * 8 bytes of fb, so
+// 166KB for a QVGA RGB565 image with ksize 3 and the default sigmas. The exact filter is used if
+// they don't fit, and for ksize <= 2 where it is faster than the grid.
+#define BILATERAL_GRID_MIN_KSIZE        (3)
+#define BILATERAL_GRID_MIN_CELL_SIZE    (2)
+#define BILATERAL_GRID_MAX_CELL_SIZE    (16)
+#define BILATERAL_GRID_MAX_RANGE_BINS   (32)
+#define BILATERAL_GRID_LERP(a, b, f)    ((((a) * (256 - (f))) + ((b) * (f))) >> 8)
+
+typedef struct bilateral_grid_channel {
+    int max;
+    uint8_t z_node[256];  // Nearest range node of each value.
+    uint16_t z_pos[256];  // Range position of each value (8.8 fixed point).
+    int32_t *raw[3];      // Splatted rows of the volume.
+    int32_t *blurred[2];  // Blurred rows of the volume.
+} bilateral_grid_channel_t;
+
+static void bilateral_grid_read_line(image_t *img, int y, uint8_t **lines) {
+    if (img->pixfmt == PIXFORMAT_GRAYSCALE) {
+        memcpy(lines[0], IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y), img->w);
+    } else {
+        uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y);
+        for (int x = 0; x < img->w; x++) {
+            int pixel = IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x);
+            lines[0][x] = COLOR_RGB565_TO_R5(pixel);
+            lines[1][x] = COLOR_RGB565_TO_G6(pixel);
+            lines[2][x] = COLOR_RGB565_TO_B5(pixel);
+        }
+    }
+}
+
+// Blurs the volume row r1 with its neighbors r0 and r2 (NULL past the edges) into dst.
+static void bilateral_grid_blur(int32_t *dst, int32_t *tmp, int32_t *r0, int32_t *r1, int32_t *r2, int gw, int gd) {
+    int stride = gd * 2;
+    int len = gw * stride;
+
+    // Along y.
+    for (int i = 0; i < len; i++) {
+        tmp[i] = r1[i] * 2;
+    }
+
+    for (int i = 0; r0 && (i < len); i++) {
+        tmp[i] += r0[i];
+    }
+
+    for (int i = 0; r2 && (i < len); i++) {
+        tmp[i] += r2[i];
+    }
+
+    // Along z (range), which is interleaved with the sums and counts.
+    for (int x = 0; x < gw; x++) {
+        int32_t *src_ptr = tmp + (x * stride);
+        int32_t *dst_ptr = dst + (x * stride);
+
+        dst_ptr[0] = (src_ptr[0] * 2) + src_ptr[2];
+        dst_ptr[1] = (src_ptr[1] * 2) + src_ptr[3];
+
+        for (int i = 2; i < (stride - 2); i++) {
+            dst_ptr[i] = (src_ptr[i] * 2) + src_ptr[i - 2] + src_ptr[i + 2];
+        }
+
+        dst_ptr[stride - 2] = (src_ptr[stride - 2] * 2) + src_ptr[stride - 4];
+        dst_ptr[stride - 1] = (src_ptr[stride - 1] * 2) + src_ptr[stride - 3];
+    }
+
+    // Along x.
+    for (int i = 0; i < stride; i++) {
+        tmp[i] = (dst[i] * 2) + dst[i + stride];
+    }
+
+    for (int i = stride; i < (len - stride); i++) {
+        tmp[i] = (dst[i] * 2) + dst[i - stride] + dst[i + stride];
+    }
+
+    for (int i = len - stride; i < len; i++) {
+        tmp[i] = (dst[i] * 2) + dst[i - stride];
+    }
+
+    memcpy(dst, tmp, len * sizeof(int32_t));
+}
+
+void imlib_bilateral_grid(image_t *img,
+                          const int ksize,
+                          float color_sigma,
+                          float space_sigma,
+                          bool threshold,
+                          int offset,
+                          bool invert,
+                          image_t *mask) {
+    int channels = (img->pixfmt == PIXFORMAT_RGB565) ? 3 : 1;
+    int s_s = IM_CLAMP(fast_roundf(ksize * space_sigma), BILATERAL_GRID_MIN_CELL_SIZE, BILATERAL_GRID_MAX_CELL_SIZE);
+    int bins = IM_CLAMP(fast_ceilf(IM_DIV(1.0f, color_sigma)), 1, BILATERAL_GRID_MAX_RANGE_BINS);
+    int gw = ((img->w - 1) / s_s) + 2;
+    int gh = ((img->h - 1) / s_s) + 2;
+    int gd = bins + 2;
+    size_t row_size = gw * gd * 2 * sizeof(int32_t);
+    // Volume rows, line buffers and lookup tables, plus a size word and padding per fb_alloc().
+    size_t size = (row_size * ((channels * 5) + 1)) + (img->w * (channels + 5)) +
+                  (channels * sizeof(bilateral_grid_channel_t)) + (((channels * 6) + 5) * 2 * sizeof(uint32_t));
+
+    if (((img->pixfmt != PIXFORMAT_GRAYSCALE) && (img->pixfmt != PIXFORMAT_RGB565)) ||
+        (ksize < BILATERAL_GRID_MIN_KSIZE) || (size > fb_avail())) {
+        imlib_bilateral_filter(img, ksize, color_sigma, space_sigma, threshold, offset, invert, mask);
+        return;
+    }
+    // Scales small cells up so the interpolation keeps some precision.
+    int32_t unit = IM_MAX(256 / (s_s * s_s), 1);
+
+    uint16_t *x_node = fb_alloc(img->w * sizeof(uint16_t), FB_ALLOC_NO_HINT);
+    uint16_t *x_cell = fb_alloc(img->w * sizeof(uint16_t), FB_ALLOC_NO_HINT);
+    uint8_t *x_frac = fb_alloc(img->w, FB_ALLOC_NO_HINT);
+
+    for (int x = 0; x < img->w; x++) {
+        x_node[x] = (x + (s_s / 2)) / s_s;
+        x_cell[x] = x / s_s;
+        x_frac[x] = ((x % s_s) * 256) / s_s;
+    }
+
+    bilateral_grid_channel_t *ch = fb_alloc(channels * sizeof(bilateral_grid_channel_t), FB_ALLOC_NO_HINT);
+    uint8_t *lines[3];
+    int32_t *tmp = fb_alloc(row_size, FB_ALLOC_NO_HINT);
+
+    for (int c = 0; c < channels; c++) {
+        ch[c].max = (channels == 1) ? COLOR_GRAYSCALE_MAX : (c == 1) ? COLOR_G6_MAX : COLOR_R5_MAX;
+
+        for (int v = 0; v <= ch[c].max; v++) {
+            int z_pos = ((v * bins * 256) + (ch[c].max / 2)) / ch[c].max;
+            ch[c].z_node[v] = (z_pos + 128) >> 8;
+            ch[c].z_pos[v] = z_pos;
+        }
+
+        for (int i = 0; i < 3; i++) {
+            ch[c].raw[i] = fb_alloc(row_size, FB_ALLOC_NO_HINT);
+        }
+
+        for (int i = 0; i < 2; i++) {
+            ch[c].blurred[i] = fb_alloc(row_size, FB_ALLOC_NO_HINT);
+        }
+
+        lines[c] = fb_alloc(img->w, FB_ALLOC_NO_HINT);
+    }
+
+    // Node g is splatted, node g - 1 is blurred and the rows between nodes g - 2 and g - 1 are
+    // sliced. Rows are always splatted before they are overwritten.
+    for (int g = 0, splat_y = 0; g <= gh; g++) {
+        if (g < gh) {
+            int y_end = IM_MIN(((g + 1) * s_s) - (s_s / 2), img->h);
+
+            for (int c = 0; c < channels; c++) {
+                memset(ch[c].raw[g % 3], 0, row_size);
+            }
+
+            for (; splat_y < y_end; splat_y++) {
+                bilateral_grid_read_line(img, splat_y, lines);
+
+                for (int c = 0; c < channels; c++) {
+                    int32_t *raw = ch[c].raw[g % 3];
+                    uint8_t *line = lines[c];
+                    uint8_t *z_node = ch[c].z_node;
+
+                    for (int x = 0; x < img->w; x++) {
+                        int v = line[x];
+                        int32_t *cell = raw + (((x_node[x] * gd) + z_node[v]) * 2);
+                        cell[0] += v * unit;
+                        cell[1] += unit;
+                    }
+                }
+            }
+        }
+
+        if ((g >= 1) && (g <= gh)) {
+            int b = g - 1;
+
+            for (int c = 0; c < channels; c++) {
+                bilateral_grid_blur(ch[c].blurred[b % 2], tmp,
+                                    (b > 0) ? ch[c].raw[(b - 1) % 3] : NULL,
+                                    ch[c].raw[b % 3],
+                                    ((b + 1) < gh) ? ch[c].raw[(b + 1) % 3] : NULL,
+                                    gw, gd);
+            }
+        }
+
+        if (g >= 2) {
+            int b = g - 2;
+
+            for (int y = b * s_s, yy = IM_MIN((b + 1) * s_s, img->h); y < yy; y++) {
+                int fy = ((y - (b * s_s)) * 256) / s_s;
+                bilateral_grid_read_line(img, y, lines);
+
+                for (int x = 0; x < img->w; x++) {
+                    if (mask && (!image_get_mask_pixel(mask, x, y))) {
+                        continue; // Short circuit.
+                    }
+
+                    int out[3];
+
+                    for (int c = 0; c < channels; c++) {
+                        int v = lines[c][x];
+                        int z_pos = ch[c].z_pos[v], fz = z_pos & 0xFF, fx = x_frac[x];
+                        int i = ((x_cell[x] * gd) + (z_pos >> 8)) * 2;
+                        int j = i + (gd * 2);
+                        int32_t *b0 = ch[c].blurred[b % 2];
+                        int32_t *b1 = ch[c].blurred[(b + 1) % 2];
+                        int32_t acc[2];
+
+                        for (int k = 0; k < 2; k++) {
+                            int32_t a0 = BILATERAL_GRID_LERP(b0[i + k], b0[i + k + 2], fz);
+                            int32_t a1 = BILATERAL_GRID_LERP(b0[j + k], b0[j + k + 2], fz);
+                            int32_t a2 = BILATERAL_GRID_LERP(b1[i + k], b1[i + k + 2], fz);
+                            int32_t a3 = BILATERAL_GRID_LERP(b1[j + k], b1[j + k + 2], fz);
+                            acc[k] = BILATERAL_GRID_LERP(BILATERAL_GRID_LERP(a0, a1, fx),
+                                                         BILATERAL_GRID_LERP(a2, a3, fx), fy);
+                        }
+
+                        out[c] = (acc[1] > 0) ? IM_MIN((acc[0] + (acc[1] / 2)) / acc[1], ch[c].max) : v;
+                    }
+
+                    if (channels == 1) {
+                        uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, y);
+                        int pixel = out[0];
+
+                        if (threshold) {
+                            if (((pixel - offset) < lines[0][x]) ^ invert) {
+                                pixel = COLOR_GRAYSCALE_BINARY_MAX;
+                            } else {
+                                pixel = COLOR_GRAYSCALE_BINARY_MIN;
+                            }
+                        }
+
+                        IMAGE_PUT_GRAYSCALE_PIXEL_FAST(row_ptr, x, pixel);
+                    } else {
+                        uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(img, y);
+                        int pixel = COLOR_R5_G6_B5_TO_RGB565(out[0], out[1], out[2]);
+
+                        if (threshold) {
+                            int this_pixel = COLOR_R5_G6_B5_TO_RGB565(lines[0][x], lines[1][x], lines[2][x]);
+                            if (((COLOR_RGB565_TO_Y(pixel) - offset) < COLOR_RGB565_TO_Y(this_pixel)) ^ invert) {
+                                pixel = COLOR_RGB565_BINARY_MAX;
+                            } else {
+                                pixel = COLOR_RGB565_BINARY_MIN;
+                            }
+                        }
+
+                        IMAGE_PUT_RGB565_PIXEL_FAST(row_ptr, x, pixel);
+                    }
+                }
+            }
+        }
+    }
+
+    for (int c = 0; c < channels; c++) {
+        for (int i = 0; i < 6; i++) {
+            fb_free();
+        }
+    }
+
+    fb_free(); // tmp
+    fb_free(); // ch
+    fb_free(); // x_frac
+    fb_free(); // x_cell
+    fb_free(); // x_node
+}
 #endif // IMLIB_ENABLE_BILATERAL
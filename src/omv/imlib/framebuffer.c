@@ -276,9 +276,14 @@ vbuffer_t *framebuffer_get_buffer(int32_t index) {
 
 void framebuffer_flush_buffers(bool fifo_flush) {
     if (fifo_flush) {
-        // Drop all frame buffers.
+        // Drop all frame buffers except for leased ones which the application still holds.
         for (int32_t i = 0; i < framebuffer->n_buffers; i++) {
-            memset(framebuffer_get_buffer(i), 0, sizeof(vbuffer_t));
+            vbuffer_t *buffer = framebuffer_get_buffer(i);
+            if (buffer->leased && (!buffer->released)) {
+                buffer->stale = true;
+            } else {
+                memset(buffer, 0, sizeof(vbuffer_t));
+            }
         }
     }
     // Move the tail pointer to the head which empties the virtual fifo while keeping the same
@@ -305,7 +310,12 @@ int framebuffer_set_buffers(int32_t n_buffers) {
     framebuffer->n_buffers = n_buffers;
     framebuffer->head = 0;
 
-    framebuffer_flush_buffers(true);
+    // The buffers moved so all leases are dropped.
+    for (int32_t i = 0; i < framebuffer->n_buffers; i++) {
+        memset(framebuffer_get_buffer(i), 0, sizeof(vbuffer_t));
+    }
+
+    framebuffer_flush_buffers(false);
 
     return 0;
 }
@@ -343,8 +353,11 @@ void framebuffer_auto_adjust_buffers() {
 void framebuffer_free_current_buffer() {
     vbuffer_t *buffer = framebuffer_get_buffer(framebuffer->head);
     #ifdef __DCACHE_PRESENT
-    // Make sure all cached CPU writes are discarded before returning the buffer.
-    SCB_InvalidateDCache_by_Addr(buffer->data, framebuffer_get_buffer_size());
+    // Make sure all cached CPU writes are discarded before returning the buffer. A leased buffer
+    // is still in use and is invalidated when it is released.
+    if (!buffer->leased) {
+        SCB_InvalidateDCache_by_Addr(buffer->data, framebuffer_get_buffer_size());
+    }
     #endif
 
     // Invalidate frame.
@@ -356,6 +369,59 @@ void framebuffer_free_current_buffer() {
     }
 }
 
+vbuffer_t *framebuffer_lease_current_buffer() {
+    // Single buffer mode captures into the only buffer.
+    if ((framebuffer->n_buffers == 1) || (framebuffer->pixfmt == PIXFORMAT_INVALID)) {
+        return NULL;
+    }
+
+    vbuffer_t *buffer = framebuffer_get_buffer(framebuffer->head);
+
+    if (buffer->leased) {
+        // Capture has not picked up a release yet so the buffer is simply kept.
+        buffer->released = false;
+        return buffer;
+    }
+
+    // Capture needs a buffer to write to besides the one being read.
+    int32_t leased = 1;
+    for (int32_t i = 0; i < framebuffer->n_buffers; i++) {
+        leased += framebuffer_get_buffer(i)->leased;
+    }
+
+    if (leased > (framebuffer->n_buffers - 2)) {
+        return NULL;
+    }
+
+    buffer->leased = true;
+    return buffer;
+}
+
+int framebuffer_release_buffer(uint8_t *pixels) {
+    for (int32_t i = 0; i < framebuffer->n_buffers; i++) {
+        vbuffer_t *buffer = framebuffer_get_buffer(i);
+        if ((buffer->data == pixels) && buffer->leased && (!buffer->released)) {
+            #ifdef __DCACHE_PRESENT
+            // Make sure all cached CPU writes are discarded before returning the buffer.
+            SCB_InvalidateDCache_by_Addr(buffer->data, framebuffer_get_buffer_size());
+            #endif
+            // Capture picks the buffer up on the next frame so that the buffer it commits
+            // is always the one it started writing to.
+            buffer->released = true;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+// In video FIFO mode leased buffers are never filled and leased or stale buffers are never
+// read. Both sides walk the ring in the same order so skipping keeps the frames in order.
+static bool framebuffer_skip_buffer(int32_t index) {
+    vbuffer_t *buffer = framebuffer_get_buffer(index);
+    return buffer->leased || buffer->stale;
+}
+
 void framebuffer_setup_buffers() {
     #ifdef __DCACHE_PRESENT
     for (int32_t i = 0; i < framebuffer->n_buffers; i++) {
@@ -394,6 +460,10 @@ vbuffer_t *framebuffer_get_head(framebuffer_flags_t flags) {
         if (framebuffer->head == framebuffer->tail) {
             return NULL;
         }
+        // The tail is never skipped as it always holds a new frame.
+        while (framebuffer_skip_buffer(new_head) && (new_head != framebuffer->tail)) {
+            new_head = (new_head + 1) % framebuffer->n_buffers;
+        }
     }
 
     if (!(flags & FB_PEEK)) {
@@ -408,6 +478,16 @@ vbuffer_t *framebuffer_get_tail(framebuffer_flags_t flags) {
     if (framebuffer->check_head) {
         framebuffer->check_head = false;
         framebuffer->sampled_head = framebuffer->head;
+
+        for (int32_t i = 0; i < framebuffer->n_buffers; i++) {
+            vbuffer_t *buffer = framebuffer_get_buffer(i);
+            if (buffer->released) {
+                // The old frame must not be read again.
+                buffer->stale = true;
+                buffer->released = false;
+                buffer->leased = false;
+            }
+        }
     }
 
     int32_t new_tail = (framebuffer->tail + 1) % framebuffer->n_buffers;
@@ -429,12 +509,21 @@ vbuffer_t *framebuffer_get_tail(framebuffer_flags_t flags) {
         // Triple Buffer Mode.
     } else if (framebuffer->n_buffers == 3) {
         // For triple buffering we are never writing where tail or head
-        // (which may instantly update to be equal to tail) is.
-        if (new_tail == framebuffer->sampled_head) {
+        // (which may instantly update to be equal to tail) is. A leased
+        // buffer drops this to double buffering.
+        if ((new_tail == framebuffer->sampled_head) || framebuffer_get_buffer(new_tail)->leased) {
             new_tail = (new_tail + 1) % framebuffer->n_buffers;
         }
+        if ((new_tail == framebuffer->sampled_head) || framebuffer_get_buffer(new_tail)->leased) {
+            // Setup to check head again.
+            framebuffer->check_head = true;
+            return NULL;
+        }
         // Video FIFO Mode.
     } else {
+        while (framebuffer_get_buffer(new_tail)->leased && (new_tail != framebuffer->sampled_head)) {
+            new_tail = (new_tail + 1) % framebuffer->n_buffers;
+        }
         if (new_tail == framebuffer->sampled_head) {
             // Setup to check head again.
             framebuffer->check_head = true;
@@ -454,6 +543,7 @@ vbuffer_t *framebuffer_get_tail(framebuffer_flags_t flags) {
     if (!(flags & FB_PEEK)) {
         // Trigger reset on the frame buffer the next time it is used.
         buffer->reset_state = true;
+        buffer->stale = false;
 
         // Mark the frame buffer ready in single buffer mode.
         if (framebuffer->n_buffers == 1) {
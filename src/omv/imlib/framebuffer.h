@@ -51,6 +51,12 @@ typedef struct vbuffer {
     // Used internally by frame buffer code.
     volatile bool waiting_for_data;
     bool reset_state;
+    // Leased buffers are held by the application and skipped by the capture code. Released
+    // buffers are handed back to capture at the start of the next frame and are then stale
+    // (skipped when reading frames) until capture fills them again.
+    volatile bool leased;
+    volatile bool released;
+    bool stale;
     // Image data array.
     OMV_ATTR_ALIGNED(uint8_t data[], FRAMEBUFFER_ALIGNMENT);
 } vbuffer_t;
@@ -101,11 +107,11 @@ void framebuffer_init_from_image(image_t *img);
 // if the src is JPEG and fits in the JPEG buffer, or encode and stream src image to the IDE if not.
 void framebuffer_update_jpeg_buffer();
 
-// Clear the framebuffer FIFO. If fifo_flush is true, reset and discard all framebuffers,
-// otherwise, retain the last frame in the fifo.
+// Clear the framebuffer FIFO. If fifo_flush is true, reset and discard all framebuffers (leased
+// framebuffers are kept), otherwise, retain the last frame in the fifo.
 void framebuffer_flush_buffers(bool fifo_flush);
 
-// Controls the number of virtual buffers in the frame buffer.
+// Controls the number of virtual buffers in the frame buffer. Drops all leases.
 int framebuffer_set_buffers(int32_t n_buffers);
 
 // Automatically finds the best buffering size given RAM.
@@ -114,6 +120,13 @@ void framebuffer_auto_adjust_buffers();
 // Call when done with the current vbuffer to mark it as free.
 void framebuffer_free_current_buffer();
 
+// Leases the current vbuffer to the application so it outlives the next frame. Capture continues
+// in the remaining buffers. Returns NULL if there is no frame or no buffer can be spared.
+vbuffer_t *framebuffer_lease_current_buffer();
+
+// Returns a leased vbuffer (found by its pixels) to the FIFO. Returns -1 if it is not leased.
+int framebuffer_release_buffer(uint8_t *pixels);
+
 // Call to do any heavy setup before frame capture.
 void framebuffer_setup_buffers();
 
@@ -10,16 +10,21 @@
  * Based on the work of Francesco Comaschi (f.comaschi@tue.nl)
  */
 #include <stdio.h>
+#include <string.h>
 #include "py/obj.h"
 #include "py/nlr.h"
 
 #include "xalloc.h"
+#include "fb_alloc.h"
 #include "imlib.h"
 // built-in cascades
 #include "cascade.h"
 #include "file_utils.h"
 
 #ifdef IMLIB_ENABLE_FEATURES
+// Number of windows classified together by the pyramid detector.
+#define HAAR_LANES    (4)
+
 static int eval_weak_classifier(cascade_t *cascade, point_t pt, int t_idx, int w_idx, int r_idx) {
     int32_t sumw = 0;
     mw_image_t *sum = cascade->sum;
@@ -74,36 +79,200 @@ static int run_cascade_classifier(cascade_t *cascade, point_t pt) {
     return 1;
 }
 
-array_t *imlib_detect_objects(image_t *image, cascade_t *cascade, rectangle_t *roi) {
-    // Integral images
-    mw_image_t sum;
-    mw_image_t ssq;
+// Evaluates the cascade on n (<= HAAR_LANES) windows of the current integral image rows at once.
+// Each feature is decoded once and applied to all windows still alive, which turns the inner loops
+// into short fixed-length loops over independent windows. Windows drop out as they fail a stage.
+static void run_cascade_classifier_lanes(cascade_t *cascade, const int *xs, int n, uint8_t *hits) {
+    mw_image_t *sum = cascade->sum;
+    int win_w = cascade->window.w;
+    int win_h = cascade->window.h;
+    uint32_t win_n = (win_w * win_h);
+    int lane_x[HAAR_LANES];
+    int lane_t[HAAR_LANES];
+    int lane_idx[HAAR_LANES];
+    int32_t lane_std[HAAR_LANES];
+    int32_t stage_sum[HAAR_LANES];
+    int32_t sumw[HAAR_LANES];
+    int live = 0;
+
+    for (int l = 0; l < n; l++) {
+        uint32_t i_s = imlib_integral_mw_lookup(cascade->sum, xs[l], 0, win_w, win_h);
+        uint32_t i_sq = imlib_integral_mw_lookup(cascade->ssq, xs[l], 0, win_w, win_h);
+        uint32_t m = i_s / win_n;
+        uint32_t v = i_sq / win_n - (m * m);
+
+        hits[l] = 0;
+
+        // Skip homogeneous regions.
+        if (v >= (50 * 50)) {
+            lane_x[live] = xs[l];
+            lane_idx[live] = l;
+            lane_std[live] = fast_sqrtf(i_sq * win_n - (i_s * i_s));
+            live++;
+        }
+    }
 
-    // Detected objects array
-    array_t *objects;
+    for (int i = 0, w_idx = 0, r_idx = 0, t_idx = 0; (i < cascade->n_stages) && live; i++) {
+        for (int l = 0; l < live; l++) {
+            stage_sum[l] = 0;
+        }
 
-    // Allocate the objects array
-    array_alloc(&objects, xfree);
+        for (int j = 0; j < cascade->stages_array[i]; j++, t_idx++) {
+            int tree_thresh = cascade->tree_thresh_array[t_idx];
+            int n_rects = cascade->num_rectangles_array[t_idx];
 
-    // Set cascade image pointers
-    cascade->img = image;
-    cascade->sum = &sum;
-    cascade->ssq = &ssq;
+            for (int l = 0; l < live; l++) {
+                sumw[l] = 0;
+                lane_t[l] = tree_thresh * lane_std[l];
+            }
 
-    // Set scanning step.
-    // Viola and Jones achieved best results using a scaling factor
-    // of 1.25 and a scanning factor proportional to the current scale.
-    // Start with a step of 5% of the image width and reduce at each scaling step
-    cascade->step = (roi->w * 50) / 1000;
+            for (int k = 0; k < n_rects; k++) {
+                int x = cascade->rectangles_array[r_idx + (k << 2) + 0];
+                int y = cascade->rectangles_array[r_idx + (k << 2) + 1];
+                int w = cascade->rectangles_array[r_idx + (k << 2) + 2];
+                int h = cascade->rectangles_array[r_idx + (k << 2) + 3];
+                int32_t weight = cascade->weights_array[w_idx + k] << 12;
+                const uint32_t *row0 = sum->data[y];
+                const uint32_t *row1 = sum->data[y + h];
+
+                for (int l = 0; l < live; l++) {
+                    int x0 = lane_x[l] + x;
+                    int32_t r = row1[x0 + w] + row0[x0] - row0[x0 + w] - row1[x0];
+                    sumw[l] += r * weight;
+                }
+            }
 
-    // Make sure step is less than window height + 1
-    if (cascade->step > cascade->window.h) {
-        cascade->step = cascade->window.h;
+            int alpha1 = cascade->alpha1_array[t_idx];
+            int alpha2 = cascade->alpha2_array[t_idx];
+
+            for (int l = 0; l < live; l++) {
+                stage_sum[l] += (sumw[l] >= lane_t[l]) ? alpha2 : alpha1;
+            }
+
+            w_idx += n_rects;
+            r_idx += n_rects * 4;
+        }
+
+        // Drop the windows that didn't pass this stage.
+        float stage_thresh = cascade->threshold * cascade->stages_thresh_array[i];
+        int next = 0;
+
+        for (int l = 0; l < live; l++) {
+            if (!(stage_sum[l] < stage_thresh)) {
+                lane_x[next] = lane_x[l];
+                lane_idx[next] = lane_idx[l];
+                lane_std[next] = lane_std[l];
+                next++;
+            }
+        }
+
+        live = next;
     }
 
-    // Allocate integral images
-    imlib_integral_mw_alloc(&sum, roi->w, cascade->window.h + 1);
-    imlib_integral_mw_alloc(&ssq, roi->w, cascade->window.h + 1);
+    for (int l = 0; l < live; l++) {
+        hits[lane_idx[l]] = 1;
+    }
+}
+
+// Builds the next pyramid level in place from the previous one. Every source pixel lies at or
+// after the destination pixel it produces, so the downscale never reads an overwritten pixel.
+static void detect_objects_pyramid_level(uint8_t *level, int pw, int ph, int w, int h) {
+    int x_ratio = (int) ((pw << 16) / w) + 1;
+    int y_ratio = (int) ((ph << 16) / h) + 1;
+
+    for (int y = 0; y < h; y++) {
+        const uint8_t *src = level + (((y * y_ratio) >> 16) * pw);
+        uint8_t *dst = level + (y * w);
+        for (int x = 0; x < w; x++) {
+            dst[x] = src[(x * x_ratio) >> 16];
+        }
+    }
+}
+
+static void detect_objects_pyramid(image_t *image, cascade_t *cascade, rectangle_t *roi, array_t *objects) {
+    mw_image_t *sum = cascade->sum;
+    mw_image_t *ssq = cascade->ssq;
+    uint8_t *level = fb_alloc(roi->w * roi->h, FB_ALLOC_NO_HINT);
+    int pw = roi->w, ph = roi->h;
+
+    // Grayscale copy of the ROI, this is the first pyramid level.
+    for (int y = 0; y < roi->h; y++) {
+        uint8_t *dst = level + (y * roi->w);
+        if (image->bpp == 1) {
+            memcpy(dst, image->pixels + ((roi->y + y) * image->w) + roi->x, roi->w);
+        } else {
+            uint16_t *src = ((uint16_t *) image->pixels) + ((roi->y + y) * image->w) + roi->x;
+            for (int x = 0; x < roi->w; x++) {
+                dst[x] = COLOR_RGB565_TO_Y(src[x]);
+            }
+        }
+    }
+
+    // Iterate over the image pyramid
+    for (float factor = 1.0f; ; factor *= cascade->scale_factor) {
+        // Set the scaled width and height
+        int szw = roi->w / factor;
+        int szh = roi->h / factor;
+
+        // Break if scaled image is smaller than feature size
+        if (szw < cascade->window.w || szh < cascade->window.h) {
+            break;
+        }
+
+        if ((szw != pw) || (szh != ph)) {
+            detect_objects_pyramid_level(level, pw, ph, szw, szh);
+            pw = szw;
+            ph = szh;
+        }
+
+        // Compute the first rows of the level integral images
+        sum->w = szw;
+        ssq->w = szw;
+        imlib_integral_mw_ss_raw(level, szw, sum, ssq);
+
+        // Scale the scanning step
+        cascade->step = cascade->step / factor;
+        cascade->step = (cascade->step == 0) ? 1 : cascade->step;
+
+        int y2 = szh - cascade->window.h;
+        int x2 = szw - cascade->window.w;
+
+        for (int y = 0; y < y2; y += cascade->step) {
+            for (int x = 0; x < x2; ) {
+                int xs[HAAR_LANES];
+                uint8_t hits[HAAR_LANES];
+                int n = 0;
+
+                for (; (n < HAAR_LANES) && (x < x2); n++, x += cascade->step) {
+                    xs[n] = x;
+                }
+
+                run_cascade_classifier_lanes(cascade, xs, n, hits);
+
+                for (int l = 0; l < n; l++) {
+                    if (hits[l]) {
+                        array_push_back(objects,
+                                        rectangle_alloc(fast_roundf(xs[l] * factor) + roi->x,
+                                                        fast_roundf(y * factor) + roi->y,
+                                                        fast_roundf(cascade->window.w * factor),
+                                                        fast_roundf(cascade->window.h * factor)));
+                    }
+                }
+            }
+
+            // If not last line, shift integral images
+            if ((y + cascade->step) < y2) {
+                imlib_integral_mw_shift_ss_raw(level, szw, sum, ssq, cascade->step);
+            }
+        }
+    }
+
+    fb_free(); // level
+}
+
+static void detect_objects(image_t *image, cascade_t *cascade, rectangle_t *roi, array_t *objects) {
+    mw_image_t *sum = cascade->sum;
+    mw_image_t *ssq = cascade->ssq;
 
     // Iterate over the image pyramid
     for (float factor = 1.0f; ; factor *= cascade->scale_factor) {
@@ -117,11 +286,11 @@ array_t *imlib_detect_objects(image_t *image, cascade_t *cascade, rectangle_t *r
         }
 
         // Set the integral images scale
-        imlib_integral_mw_scale(roi, &sum, szw, szh);
-        imlib_integral_mw_scale(roi, &ssq, szw, szh);
+        imlib_integral_mw_scale(roi, sum, szw, szh);
+        imlib_integral_mw_scale(roi, ssq, szw, szh);
 
         // Compute new scaled integral images
-        imlib_integral_mw_ss(image, &sum, &ssq, roi);
+        imlib_integral_mw_ss(image, sum, ssq, roi);
 
         // Scale the scanning step
         cascade->step = cascade->step / factor;
@@ -147,10 +316,52 @@ array_t *imlib_detect_objects(image_t *image, cascade_t *cascade, rectangle_t *r
 
             // If not last line, shift integral images
             if ((y + cascade->step) < y2) {
-                imlib_integral_mw_shift_ss(image, &sum, &ssq, roi, cascade->step);
+                imlib_integral_mw_shift_ss(image, sum, ssq, roi, cascade->step);
             }
         }
     }
+}
+
+// When pyramid is true the ROI is converted to grayscale once and each scale is downsampled from
+// the previous one, so the integral images are built from plain 8-bit rows and windows are
+// classified HAAR_LANES at a time. Sampling differs slightly from the classic path which
+// resamples the source image at every scale.
+array_t *imlib_detect_objects(image_t *image, cascade_t *cascade, rectangle_t *roi, bool pyramid) {
+    // Integral images
+    mw_image_t sum;
+    mw_image_t ssq;
+
+    // Detected objects array
+    array_t *objects;
+
+    // Allocate the objects array
+    array_alloc(&objects, xfree);
+
+    // Set cascade image pointers
+    cascade->img = image;
+    cascade->sum = &sum;
+    cascade->ssq = &ssq;
+
+    // Set scanning step.
+    // Viola and Jones achieved best results using a scaling factor
+    // of 1.25 and a scanning factor proportional to the current scale.
+    // Start with a step of 5% of the image width and reduce at each scaling step
+    cascade->step = (roi->w * 50) / 1000;
+
+    // Make sure step is less than window height + 1
+    if (cascade->step > cascade->window.h) {
+        cascade->step = cascade->window.h;
+    }
+
+    // Allocate integral images
+    imlib_integral_mw_alloc(&sum, roi->w, cascade->window.h + 1);
+    imlib_integral_mw_alloc(&ssq, roi->w, cascade->window.h + 1);
+
+    if (pyramid) {
+        detect_objects_pyramid(image, cascade, roi, objects);
+    } else {
+        detect_objects(image, cascade, roi, objects);
+    }
 
     imlib_integral_mw_free(&ssq);
     imlib_integral_mw_free(&sum);
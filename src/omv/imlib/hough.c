@@ -10,248 +10,199 @@
  */
 #include "imlib.h"
 
-#ifdef IMLIB_ENABLE_FIND_LINES
-void imlib_find_lines(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride,
-                      uint32_t threshold, unsigned int theta_margin, unsigned int rho_margin) {
-    int r_diag_len, r_diag_len_div, theta_size, r_size, hough_divide = 1; // divides theta and rho accumulators
-
-    for (;;) {
-        // shrink to fit...
-        r_diag_len = fast_roundf(fast_sqrtf((roi->w * roi->w) + (roi->h * roi->h)));
-        r_diag_len_div = (r_diag_len + hough_divide - 1) / hough_divide;
-        theta_size = 1 + ((180 + hough_divide - 1) / hough_divide) + 1; // left & right padding
-        r_size = (r_diag_len_div * 2) + 1; // -r_diag_len to +r_diag_len
-        if ((sizeof(uint32_t) * theta_size * r_size) <= fb_avail()) {
-            break;
+#if defined(IMLIB_ENABLE_FIND_LINES) || defined(IMLIB_ENABLE_FIND_CIRCLES)
+typedef struct hough_edge {
+    uint16_t x, y;      // relative to the roi
+    uint16_t theta;     // gradient direction in degrees (0 to 359)
+    uint16_t magnitude;
+} hough_edge_t;
+
+// Sobel Algorithm (p[row][column] around x, y). Lines keep pixels with an L1 magnitude of at
+// least 126 and circles keep every pixel with a non-zero L2 magnitude.
+static inline int hough_sobel_edge(hough_edge_t *edge, int x, int y, bool l2,
+                                   int p00, int p01, int p02, int p10, int p12, int p20, int p21, int p22) {
+    int x_acc = (p00 + (p10 * 2) + p20) - (p02 + (p12 * 2) + p22);
+    int y_acc = (p00 + (p01 * 2) + p02) - (p20 + (p21 * 2) + p22);
+    int magnitude;
+
+    if (l2) {
+        magnitude = fast_roundf(fast_sqrtf((x_acc * x_acc) + (y_acc * y_acc)));
+        if (!magnitude) {
+            return 0;
         }
-        hough_divide = hough_divide << 1; // powers of 2...
-        if (hough_divide > 4) {
-            fb_alloc_fail();                   // support 1, 2, 4
+    } else {
+        magnitude = (abs(x_acc) + abs(y_acc)) / 2;
+        if (magnitude < 126) {
+            return 0;
         }
     }
 
-    uint32_t *acc = fb_alloc0(sizeof(uint32_t) * theta_size * r_size, FB_ALLOC_NO_HINT);
-
-    switch (ptr->pixfmt) {
-        case PIXFORMAT_BINARY: {
-            for (int y = roi->y + 1, yy = roi->y + roi->h - 1; y < yy; y += y_stride) {
-                uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(ptr, y);
-                for (int x = roi->x + (y % x_stride) + 1, xx = roi->x + roi->w - 1; x < xx; x += x_stride) {
-                    int pixel; // Sobel Algorithm Below
-                    int x_acc = 0;
-                    int y_acc = 0;
-
-                    row_ptr -= ((ptr->w + UINT32_T_MASK) >> UINT32_T_SHIFT);
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +1; // x[0,0] -> pixel * +1
-                    y_acc += pixel * +1; // y[0,0] -> pixel * +1
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x));
-                    // x[0,1] -> pixel * 0
-                    y_acc += pixel * +2; // y[0,1] -> pixel * +2
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -1; // x[0,2] -> pixel * -1
-                    y_acc += pixel * +1; // y[0,2] -> pixel * +1
-
-                    row_ptr += ((ptr->w + UINT32_T_MASK) >> UINT32_T_SHIFT);
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +2; // x[1,0] -> pixel * +2
-                                         // y[1,0] -> pixel * 0
-
-                    // pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x));
-                    // x[1,1] -> pixel * 0
-                    // y[1,1] -> pixel * 0
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -2; // x[1,2] -> pixel * -2
-                                         // y[1,2] -> pixel * 0
-
-                    row_ptr += ((ptr->w + UINT32_T_MASK) >> UINT32_T_SHIFT);
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +1; // x[2,0] -> pixel * +1
-                    y_acc += pixel * -1; // y[2,0] -> pixel * -1
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x));
-                    // x[2,1] -> pixel * 0
-                    y_acc += pixel * -2; // y[2,1] -> pixel * -2
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -1; // x[2,2] -> pixel * -1
-                    y_acc += pixel * -1; // y[2,2] -> pixel * -1
+    int theta = fast_roundf((x_acc ? fast_atan2f(y_acc, x_acc) : 1.570796f) * 57.295780) % 360; // * (180 / PI)
+    if (theta < 0) {
+        theta += 360;
+    }
 
-                    row_ptr -= ((ptr->w + UINT32_T_MASK) >> UINT32_T_SHIFT);
+    edge->x = x;
+    edge->y = y;
+    edge->theta = theta;
+    edge->magnitude = magnitude;
+    return 1;
+}
 
-                    int mag = (abs(x_acc) + abs(y_acc)) / 2;
-                    if (mag < 126) {
-                        continue;
-                    }
+// Collects the edge pixels of every strided pixel in roi, starting at row *y, into edges. Stops
+// at the first row that may not fit in the n edges. Returns the number of edges and advances *y.
+static size_t hough_find_edges(image_t *ptr, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride,
+                               bool l2, int *y, hough_edge_t *edges, size_t n) {
+    size_t count = 0, row_max = (roi->w / x_stride) + 1;
+    int y_start = *y, yy = roi->y + roi->h - 1;
 
-                    int theta = fast_roundf((x_acc ? fast_atan2f(y_acc, x_acc) : 1.570796f) * 57.295780) % 180; // * (180 / PI)
-                    if (theta < 0) {
-                        theta += 180;
-                    }
-                    int rho = (fast_roundf(((x - roi->x) * cos_table[theta]) +
-                                           ((y - roi->y) * sin_table[theta])) / hough_divide) + r_diag_len_div;
-                    int acc_index = (rho * theta_size) + ((theta / hough_divide) + 1); // add offset
-                    acc[acc_index] += mag;
+    switch (ptr->pixfmt) {
+        case PIXFORMAT_BINARY: {
+            for (; (*y < yy) && ((n - count) >= row_max); *y += y_stride) {
+                uint32_t *row_ptr_0 = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(ptr, *y - 1);
+                uint32_t *row_ptr_1 = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(ptr, *y);
+                uint32_t *row_ptr_2 = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(ptr, *y + 1);
+                for (int x = roi->x + (*y % x_stride) + 1, xx = roi->x + roi->w - 1; x < xx; x += x_stride) {
+                    count += hough_sobel_edge(edges + count, x - roi->x, *y - roi->y, l2,
+                                              COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr_0, x - 1)),
+                                              COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr_0, x)),
+                                              COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr_0, x + 1)),
+                                              COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr_1, x - 1)),
+                                              COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr_1, x + 1)),
+                                              COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr_2, x - 1)),
+                                              COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr_2, x)),
+                                              COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr_2, x + 1)));
                 }
             }
             break;
         }
         case PIXFORMAT_GRAYSCALE: {
-            for (int y = roi->y + 1, yy = roi->y + roi->h - 1; y < yy; y += y_stride) {
-                uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(ptr, y);
-                for (int x = roi->x + (y % x_stride) + 1, xx = roi->x + roi->w - 1; x < xx; x += x_stride) {
-                    int pixel; // Sobel Algorithm Below
-                    int x_acc = 0;
-                    int y_acc = 0;
-
-                    row_ptr -= ptr->w;
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x - 1);
-                    x_acc += pixel * +1; // x[0,0] -> pixel * +1
-                    y_acc += pixel * +1; // y[0,0] -> pixel * +1
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x);
-                    // x[0,1] -> pixel * 0
-                    y_acc += pixel * +2; // y[0,1] -> pixel * +2
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x + 1);
-                    x_acc += pixel * -1; // x[0,2] -> pixel * -1
-                    y_acc += pixel * +1; // y[0,2] -> pixel * +1
-
-                    row_ptr += ptr->w;
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x - 1);
-                    x_acc += pixel * +2; // x[1,0] -> pixel * +2
-                                         // y[1,0] -> pixel * 0
-
-                    // pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x);
-                    // x[1,1] -> pixel * 0
-                    // y[1,1] -> pixel * 0
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x + 1);
-                    x_acc += pixel * -2; // x[1,2] -> pixel * -2
-                                         // y[1,2] -> pixel * 0
-
-                    row_ptr += ptr->w;
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x - 1);
-                    x_acc += pixel * +1; // x[2,0] -> pixel * +1
-                    y_acc += pixel * -1; // y[2,0] -> pixel * -1
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x);
-                    // x[2,1] -> pixel * 0
-                    y_acc += pixel * -2; // y[2,1] -> pixel * -2
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x + 1);
-                    x_acc += pixel * -1; // x[2,2] -> pixel * -1
-                    y_acc += pixel * -1; // y[2,2] -> pixel * -1
-
-                    row_ptr -= ptr->w;
-
-                    int mag = (abs(x_acc) + abs(y_acc)) / 2;
-                    if (mag < 126) {
-                        continue;
-                    }
-
-                    int theta = fast_roundf((x_acc ? fast_atan2f(y_acc, x_acc) : 1.570796f) * 57.295780) % 180; // * (180 / PI)
-                    if (theta < 0) {
-                        theta += 180;
-                    }
-                    int rho = (fast_roundf(((x - roi->x) * cos_table[theta]) +
-                                           ((y - roi->y) * sin_table[theta])) / hough_divide) + r_diag_len_div;
-                    int acc_index = (rho * theta_size) + ((theta / hough_divide) + 1); // add offset
-                    acc[acc_index] += mag;
+            for (; (*y < yy) && ((n - count) >= row_max); *y += y_stride) {
+                uint8_t *row_ptr_0 = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(ptr, *y - 1);
+                uint8_t *row_ptr_1 = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(ptr, *y);
+                uint8_t *row_ptr_2 = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(ptr, *y + 1);
+                for (int x = roi->x + (*y % x_stride) + 1, xx = roi->x + roi->w - 1; x < xx; x += x_stride) {
+                    count += hough_sobel_edge(edges + count, x - roi->x, *y - roi->y, l2,
+                                              IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr_0, x - 1),
+                                              IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr_0, x),
+                                              IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr_0, x + 1),
+                                              IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr_1, x - 1),
+                                              IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr_1, x + 1),
+                                              IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr_2, x - 1),
+                                              IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr_2, x),
+                                              IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr_2, x + 1));
                 }
             }
             break;
         }
         case PIXFORMAT_RGB565: {
-            for (int y = roi->y + 1, yy = roi->y + roi->h - 1; y < yy; y += y_stride) {
-                uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, y);
-                for (int x = roi->x + (y % x_stride) + 1, xx = roi->x + roi->w - 1; x < xx; x += x_stride) {
-                    int pixel; // Sobel Algorithm Below
-                    int x_acc = 0;
-                    int y_acc = 0;
-
-                    row_ptr -= ptr->w;
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +1; // x[0,0] -> pixel * +1
-                    y_acc += pixel * +1; // y[0,0] -> pixel * +1
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
-                    // x[0,1] -> pixel * 0
-                    y_acc += pixel * +2; // y[0,1] -> pixel * +2
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -1; // x[0,2] -> pixel * -1
-                    y_acc += pixel * +1; // y[0,2] -> pixel * +1
-
-                    row_ptr += ptr->w;
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +2; // x[1,0] -> pixel * +2
-                                         // y[1,0] -> pixel * 0
-
-                    // pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
-                    // x[1,1] -> pixel * 0
-                    // y[1,1] -> pixel * 0
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -2; // x[1,2] -> pixel * -2
-                                         // y[1,2] -> pixel * 0
-
-                    row_ptr += ptr->w;
+            for (; (*y < yy) && ((n - count) >= row_max); *y += y_stride) {
+                uint16_t *row_ptr_0 = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, *y - 1);
+                uint16_t *row_ptr_1 = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, *y);
+                uint16_t *row_ptr_2 = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, *y + 1);
+                for (int x = roi->x + (*y % x_stride) + 1, xx = roi->x + roi->w - 1; x < xx; x += x_stride) {
+                    count += hough_sobel_edge(edges + count, x - roi->x, *y - roi->y, l2,
+                                              COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr_0, x - 1)),
+                                              COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr_0, x)),
+                                              COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr_0, x + 1)),
+                                              COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr_1, x - 1)),
+                                              COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr_1, x + 1)),
+                                              COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr_2, x - 1)),
+                                              COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr_2, x)),
+                                              COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr_2, x + 1)));
+                }
+            }
+            break;
+        }
+        default: {
+            *y = yy;
+            break;
+        }
+    }
 
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +1; // x[2,0] -> pixel * +1
-                    y_acc += pixel * -1; // y[2,0] -> pixel * -1
+    if ((*y == y_start) && (*y < yy)) {
+        fb_alloc_fail(); // not even one row fits
+    }
 
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
-                    // x[2,1] -> pixel * 0
-                    y_acc += pixel * -2; // y[2,1] -> pixel * -2
+    return count;
+}
+#endif // IMLIB_ENABLE_FIND_LINES || IMLIB_ENABLE_FIND_CIRCLES
 
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -1; // x[2,2] -> pixel * -1
-                    y_acc += pixel * -1; // y[2,2] -> pixel * -1
+#ifdef IMLIB_ENABLE_FIND_LINES
+// Adds a vote to the 16-bit accumulator. Votes are scaled down by *shift, which is incremented
+// (halving the whole accumulator) whenever a cell would overflow.
+static inline void hough_lines_vote(uint16_t *acc, size_t acc_size, int acc_index, int magnitude, int *shift) {
+    uint32_t value = acc[acc_index] + (magnitude >> *shift);
+
+    if (value > UINT16_MAX) {
+        for (size_t i = 0; i < acc_size; i++) {
+            acc[i] >>= 1;
+        }
+        *shift += 1;
+        value = acc[acc_index] + (magnitude >> *shift);
+    }
 
-                    row_ptr -= ptr->w;
+    acc[acc_index] = value;
+}
 
-                    int mag = (abs(x_acc) + abs(y_acc)) / 2;
-                    if (mag < 126) {
-                        continue;
-                    }
+void imlib_find_lines(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride,
+                      uint32_t threshold, unsigned int theta_margin, unsigned int rho_margin,
+                      unsigned int theta_window) {
+    int r_diag_len, r_diag_len_div, theta_size, r_size, hough_divide = 1; // divides theta and rho accumulators
+    int acc_shift = 0;
 
-                    int theta = fast_roundf((x_acc ? fast_atan2f(y_acc, x_acc) : 1.570796f) * 57.295780) % 180; // * (180 / PI)
-                    if (theta < 0) {
-                        theta += 180;
-                    }
-                    int rho = (fast_roundf(((x - roi->x) * cos_table[theta]) +
-                                           ((y - roi->y) * sin_table[theta])) / hough_divide) + r_diag_len_div;
-                    int acc_index = (rho * theta_size) + ((theta / hough_divide) + 1); // add offset
-                    acc[acc_index] += mag;
-                }
-            }
+    for (;;) {
+        // shrink to fit...
+        r_diag_len = fast_roundf(fast_sqrtf((roi->w * roi->w) + (roi->h * roi->h)));
+        r_diag_len_div = (r_diag_len + hough_divide - 1) / hough_divide;
+        theta_size = 1 + ((180 + hough_divide - 1) / hough_divide) + 1; // left & right padding
+        r_size = (r_diag_len_div * 2) + 1; // -r_diag_len to +r_diag_len
+        // Leave room for a few rows of edges too.
+        if (((sizeof(uint16_t) * theta_size * r_size) + (sizeof(hough_edge_t) * 4 * roi->w)) <= fb_avail()) {
             break;
         }
-        default: {
-            break;
+        hough_divide = hough_divide << 1; // powers of 2...
+        if (hough_divide > 4) {
+            fb_alloc_fail();                   // support 1, 2, 4
         }
     }
 
+    size_t acc_size = theta_size * r_size;
+    uint16_t *acc = fb_alloc0(sizeof(uint16_t) * acc_size, FB_ALLOC_NO_HINT);
+
+    uint32_t edges_size;
+    hough_edge_t *edges = fb_alloc_all(&edges_size, FB_ALLOC_PREFER_SPEED);
+    size_t edges_n = edges_size / sizeof(hough_edge_t);
+
+    // Each edge pixel votes for the lines within theta_window accumulator columns of its gradient.
+    int theta_window_deg = IM_MIN((int) theta_window * hough_divide, 89);
+
+    for (int y = roi->y + 1, yy = roi->y + roi->h - 1; y < yy; ) {
+        for (size_t i = 0, count = hough_find_edges(ptr, roi, x_stride, y_stride, false, &y, edges, edges_n);
+             i < count; i++) {
+            int theta_0 = (edges[i].theta % 180) - theta_window_deg;
+            int theta_1 = (edges[i].theta % 180) + theta_window_deg;
+
+            for (int t = theta_0; t <= theta_1; t += hough_divide) {
+                // A line at theta - 180 is the same line at theta with the sign of rho flipped.
+                int theta = (t < 0) ? (t + 180) : ((t >= 180) ? (t - 180) : t);
+                int rho = (fast_roundf((edges[i].x * cos_table[theta]) +
+                                       (edges[i].y * sin_table[theta])) / hough_divide) + r_diag_len_div;
+                int acc_index = (rho * theta_size) + ((theta / hough_divide) + 1); // add offset
+                hough_lines_vote(acc, acc_size, acc_index, edges[i].magnitude, &acc_shift);
+            }
+        }
+    }
+
+    fb_free(); // edges
+
     list_init(out, sizeof(find_lines_list_lnk_data_t));
 
     for (int y = 1, yy = r_size - 1; y < yy; y++) {
-        uint32_t *row_ptr = acc + (theta_size * y);
+        uint16_t *row_ptr = acc + (theta_size * y);
 
         for (int x = 1, xx = theta_size - 1; x < xx; x++) {
-            if ((row_ptr[x] >= threshold)
+            if ((((uint32_t) row_ptr[x] << acc_shift) >= threshold)
                 && (row_ptr[x] >= row_ptr[x - theta_size - 1])
                 && (row_ptr[x] >= row_ptr[x - theta_size])
                 && (row_ptr[x] >= row_ptr[x - theta_size + 1])
@@ -264,7 +215,7 @@ void imlib_find_lines(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int
                 find_lines_list_lnk_data_t lnk_line;
                 memset(&lnk_line, 0, sizeof(find_lines_list_lnk_data_t));
 
-                lnk_line.magnitude = row_ptr[x];
+                lnk_line.magnitude = (uint32_t) row_ptr[x] << acc_shift;
                 lnk_line.theta = (x - 1) * hough_divide; // remove offset
                 lnk_line.rho = (y - r_diag_len_div) * hough_divide;
 
@@ -392,7 +343,7 @@ void imlib_find_line_segments(list_t *out, image_t *ptr, rectangle_t *roi, unsig
     const unsigned int max_gap_pixels = 5;
 
     list_t temp_out;
-    imlib_find_lines(&temp_out, ptr, roi, x_stride, y_stride, threshold, theta_margin, rho_margin);
+    imlib_find_lines(&temp_out, ptr, roi, x_stride, y_stride, threshold, theta_margin, rho_margin, 0);
     list_init(out, sizeof(find_lines_list_lnk_data_t));
 
     const int r_diag_len = fast_roundf(fast_sqrtf((roi->w * roi->w) + (roi->h * roi->h))) * 2;
@@ -486,209 +437,11 @@ void imlib_find_line_segments(list_t *out, image_t *ptr, rectangle_t *roi, unsig
 void imlib_find_circles(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride,
                         uint32_t threshold, unsigned int x_margin, unsigned int y_margin, unsigned int r_margin,
                         unsigned int r_min, unsigned int r_max, unsigned int r_step) {
-    uint16_t *theta_acc = fb_alloc0(sizeof(uint16_t) * roi->w * roi->h, FB_ALLOC_NO_HINT);
-    uint16_t *magnitude_acc = fb_alloc0(sizeof(uint16_t) * roi->w * roi->h, FB_ALLOC_NO_HINT);
-
-    switch (ptr->pixfmt) {
-        case PIXFORMAT_BINARY: {
-            for (int y = roi->y + 1, yy = roi->y + roi->h - 1; y < yy; y += y_stride) {
-                uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(ptr, y);
-                for (int x = roi->x + (y % x_stride) + 1, xx = roi->x + roi->w - 1; x < xx; x += x_stride) {
-                    int pixel; // Sobel Algorithm Below
-                    int x_acc = 0;
-                    int y_acc = 0;
-
-                    row_ptr -= ((ptr->w + UINT32_T_MASK) >> UINT32_T_SHIFT);
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +1; // x[0,0] -> pixel * +1
-                    y_acc += pixel * +1; // y[0,0] -> pixel * +1
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x));
-                    // x[0,1] -> pixel * 0
-                    y_acc += pixel * +2; // y[0,1] -> pixel * +2
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -1; // x[0,2] -> pixel * -1
-                    y_acc += pixel * +1; // y[0,2] -> pixel * +1
-
-                    row_ptr += ((ptr->w + UINT32_T_MASK) >> UINT32_T_SHIFT);
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +2; // x[1,0] -> pixel * +2
-                                         // y[1,0] -> pixel * 0
-
-                    // pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x));
-                    // x[1,1] -> pixel * 0
-                    // y[1,1] -> pixel * 0
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -2; // x[1,2] -> pixel * -2
-                                         // y[1,2] -> pixel * 0
-
-                    row_ptr += ((ptr->w + UINT32_T_MASK) >> UINT32_T_SHIFT);
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +1; // x[2,0] -> pixel * +1
-                    y_acc += pixel * -1; // y[2,0] -> pixel * -1
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x));
-                    // x[2,1] -> pixel * 0
-                    y_acc += pixel * -2; // y[2,1] -> pixel * -2
-
-                    pixel = COLOR_BINARY_TO_GRAYSCALE(IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -1; // x[2,2] -> pixel * -1
-                    y_acc += pixel * -1; // y[2,2] -> pixel * -1
-
-                    row_ptr -= ((ptr->w + UINT32_T_MASK) >> UINT32_T_SHIFT);
-
-                    int theta = fast_roundf((x_acc ? fast_atan2f(y_acc, x_acc) : 1.570796f) * 57.295780) % 360; // * (180 / PI)
-                    if (theta < 0) {
-                        theta += 360;
-                    }
-                    int magnitude = fast_roundf(fast_sqrtf((x_acc * x_acc) + (y_acc * y_acc)));
-                    int index = (roi->w * (y - roi->y)) + (x - roi->x);
-
-                    theta_acc[index] = theta;
-                    magnitude_acc[index] = magnitude;
-                }
-            }
-            break;
-        }
-        case PIXFORMAT_GRAYSCALE: {
-            for (int y = roi->y + 1, yy = roi->y + roi->h - 1; y < yy; y += y_stride) {
-                uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(ptr, y);
-                for (int x = roi->x + (y % x_stride) + 1, xx = roi->x + roi->w - 1; x < xx; x += x_stride) {
-                    int pixel; // Sobel Algorithm Below
-                    int x_acc = 0;
-                    int y_acc = 0;
-
-                    row_ptr -= ptr->w;
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x - 1);
-                    x_acc += pixel * +1; // x[0,0] -> pixel * +1
-                    y_acc += pixel * +1; // y[0,0] -> pixel * +1
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x);
-                    // x[0,1] -> pixel * 0
-                    y_acc += pixel * +2; // y[0,1] -> pixel * +2
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x + 1);
-                    x_acc += pixel * -1; // x[0,2] -> pixel * -1
-                    y_acc += pixel * +1; // y[0,2] -> pixel * +1
-
-                    row_ptr += ptr->w;
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x - 1);
-                    x_acc += pixel * +2; // x[1,0] -> pixel * +2
-                                         // y[1,0] -> pixel * 0
-
-                    // pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x);
-                    // x[1,1] -> pixel * 0
-                    // y[1,1] -> pixel * 0
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x + 1);
-                    x_acc += pixel * -2; // x[1,2] -> pixel * -2
-                                         // y[1,2] -> pixel * 0
-
-                    row_ptr += ptr->w;
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x - 1);
-                    x_acc += pixel * +1; // x[2,0] -> pixel * +1
-                    y_acc += pixel * -1; // y[2,0] -> pixel * -1
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x);
-                    // x[2,1] -> pixel * 0
-                    y_acc += pixel * -2; // y[2,1] -> pixel * -2
-
-                    pixel = IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x + 1);
-                    x_acc += pixel * -1; // x[2,2] -> pixel * -1
-                    y_acc += pixel * -1; // y[2,2] -> pixel * -1
-
-                    row_ptr -= ptr->w;
-
-                    int theta = fast_roundf((x_acc ? fast_atan2f(y_acc, x_acc) : 1.570796f) * 57.295780) % 360; // * (180 / PI)
-                    if (theta < 0) {
-                        theta += 360;
-                    }
-                    int magnitude = fast_roundf(fast_sqrtf((x_acc * x_acc) + (y_acc * y_acc)));
-                    int index = (roi->w * (y - roi->y)) + (x - roi->x);
-
-                    theta_acc[index] = theta;
-                    magnitude_acc[index] = magnitude;
-                }
-            }
-            break;
-        }
-        case PIXFORMAT_RGB565: {
-            for (int y = roi->y + 1, yy = roi->y + roi->h - 1; y < yy; y += y_stride) {
-                uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, y);
-                for (int x = roi->x + (y % x_stride) + 1, xx = roi->x + roi->w - 1; x < xx; x += x_stride) {
-                    int pixel; // Sobel Algorithm Below
-                    int x_acc = 0;
-                    int y_acc = 0;
-
-                    row_ptr -= ptr->w;
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +1; // x[0,0] -> pixel * +1
-                    y_acc += pixel * +1; // y[0,0] -> pixel * +1
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
-                    // x[0,1] -> pixel * 0
-                    y_acc += pixel * +2; // y[0,1] -> pixel * +2
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -1; // x[0,2] -> pixel * -1
-                    y_acc += pixel * +1; // y[0,2] -> pixel * +1
-
-                    row_ptr += ptr->w;
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +2; // x[1,0] -> pixel * +2
-                                         // y[1,0] -> pixel * 0
-
-                    // pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
-                    // x[1,1] -> pixel * 0
-                    // y[1,1] -> pixel * 0
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -2; // x[1,2] -> pixel * -2
-                                         // y[1,2] -> pixel * 0
-
-                    row_ptr += ptr->w;
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x - 1));
-                    x_acc += pixel * +1; // x[2,0] -> pixel * +1
-                    y_acc += pixel * -1; // y[2,0] -> pixel * -1
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x));
-                    // x[2,1] -> pixel * 0
-                    y_acc += pixel * -2; // y[2,1] -> pixel * -2
-
-                    pixel = COLOR_RGB565_TO_GRAYSCALE(IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x + 1));
-                    x_acc += pixel * -1; // x[2,2] -> pixel * -1
-                    y_acc += pixel * -1; // y[2,2] -> pixel * -1
-
-                    row_ptr -= ptr->w;
-
-                    int theta = fast_roundf((x_acc ? fast_atan2f(y_acc, x_acc) : 1.570796f) * 57.295780) % 360; // * (180 / PI)
-                    if (theta < 0) {
-                        theta += 360;
-                    }
-                    int magnitude = fast_roundf(fast_sqrtf((x_acc * x_acc) + (y_acc * y_acc)));
-                    int index = (roi->w * (y - roi->y)) + (x - roi->x);
-
-                    theta_acc[index] = theta;
-                    magnitude_acc[index] = magnitude;
-                }
-            }
-            break;
-        }
-        default: {
-            break;
-        }
-    }
+    // Worst case every strided pixel is an edge.
+    int edges_y = roi->y + 1;
+    size_t edges_n = (((roi->h + y_stride - 1) / y_stride) * ((roi->w / x_stride) + 1));
+    hough_edge_t *edges = fb_alloc(sizeof(hough_edge_t) * edges_n, FB_ALLOC_NO_HINT);
+    edges_n = hough_find_edges(ptr, roi, x_stride, y_stride, true, &edges_y, edges, edges_n);
 
     // Theta Direction (% 180)
     //
@@ -741,50 +494,46 @@ void imlib_find_circles(list_t *out, image_t *ptr, rectangle_t *roi, unsigned in
             rsin[i] = (int16_t) roundf(r * sin_table[i]);
         }
 
-        for (int y = 0, yy = roi->h; y < yy; y++) {
-            for (int x = 0, xx = roi->w; x < xx; x++) {
-                int index = (roi->w * y) + x;
-                int theta = theta_acc[index];
-                int magnitude = magnitude_acc[index];
-                if (!magnitude) {
-                    continue;
+        for (size_t i = 0; i < edges_n; i++) {
+            int x = edges[i].x;
+            int y = edges[i].y;
+            int theta = edges[i].theta;
+            int magnitude = edges[i].magnitude;
+
+            // We have to do the below step twice because the gradient may be pointing inside or outside the circle.
+            // Only graidents pointing inside of the circle sum up to produce a large magnitude.
+            for (;;) {
+                // Hi to lo edge direction
+                int a = x + rcos[theta] - r;
+                if ((a < 0) || (w_size <= a)) {
+                    break;                           // circle doesn't fit in the window
                 }
-
-                // We have to do the below step twice because the gradient may be pointing inside or outside the circle.
-                // Only graidents pointing inside of the circle sum up to produce a large magnitude.
-                for (;;) {
-                    // Hi to lo edge direction
-                    int a = x + rcos[theta] - r;
-                    if ((a < 0) || (w_size <= a)) {
-                        break;                           // circle doesn't fit in the window
-                    }
-                    int b = y + rsin[theta] - r;
-                    if ((b < 0) || (h_size <= b)) {
-                        break;                           // circle doesn't fit in the window
-                    }
-                    int acc_index = (((b >> hough_shift) + 1) * a_size) + ((a >> hough_shift) + 1); // add offset
-
-                    int acc_value = acc[acc_index] += magnitude;
-                    acc[acc_index] = acc_value;
-                    break;
+                int b = y + rsin[theta] - r;
+                if ((b < 0) || (h_size <= b)) {
+                    break;                           // circle doesn't fit in the window
                 }
+                int acc_index = (((b >> hough_shift) + 1) * a_size) + ((a >> hough_shift) + 1); // add offset
 
-                for (;;) {
-                    // Lo to hi edge direction
-                    int a = x - rcos[theta] - r;
-                    if ((a < 0) || (w_size <= a)) {
-                        break;                           // circle doesn't fit in the window
-                    }
-                    int b = y - rsin[theta] - r;
-                    if ((b < 0) || (h_size <= b)) {
-                        break;                           // circle doesn't fit in the window
-                    }
-                    int acc_index = (((b >> hough_shift) + 1) * a_size) + ((a >> hough_shift) + 1); // add offset
+                int acc_value = acc[acc_index] += magnitude;
+                acc[acc_index] = acc_value;
+                break;
+            }
 
-                    int acc_value = acc[acc_index] += magnitude;
-                    acc[acc_index] = acc_value;
-                    break;
+            for (;;) {
+                // Lo to hi edge direction
+                int a = x - rcos[theta] - r;
+                if ((a < 0) || (w_size <= a)) {
+                    break;                           // circle doesn't fit in the window
+                }
+                int b = y - rsin[theta] - r;
+                if ((b < 0) || (h_size <= b)) {
+                    break;                           // circle doesn't fit in the window
                 }
+                int acc_index = (((b >> hough_shift) + 1) * a_size) + ((a >> hough_shift) + 1); // add offset
+
+                int acc_value = acc[acc_index] += magnitude;
+                acc[acc_index] = acc_value;
+                break;
             }
         }
 
@@ -822,8 +571,7 @@ void imlib_find_circles(list_t *out, image_t *ptr, rectangle_t *roi, unsigned in
         fb_free(); // acc
     }
 
-    fb_free(); // magnitude_acc
-    fb_free(); // theta_acc
+    fb_free(); // edges
 
     for (;;) {
         // Merge overlapping.
@@ -239,6 +239,99 @@ void rectangle_united(rectangle_t *dst, rectangle_t *src) {
     dst->h = bottomY - topY;
 }
 
+///////////////////////
+// ROI Tracker Stuff //
+///////////////////////
+
+void roi_tracker_init(roi_tracker_t *ptr, int interval, float expand) {
+    ptr->interval = interval;
+    ptr->expand = expand;
+    roi_tracker_reset(ptr);
+}
+
+void roi_tracker_reset(roi_tracker_t *ptr) {
+    ptr->frame = 0;
+    ptr->count = 0;
+}
+
+// Grows the tracked rects into search windows clipped to the roi and merges the windows that
+// overlap so that a marker cannot be found twice. Returns 0 if the whole roi must be searched.
+static int roi_tracker_windows(roi_tracker_t *ptr, rectangle_t *roi, rectangle_t *windows) {
+    if ((!ptr->count) || (ptr->interval && (ptr->frame >= ptr->interval))) {
+        return 0;
+    }
+
+    for (int i = 0; i < ptr->count; i++) {
+        rectangle_t *r = &ptr->rects[i];
+        int margin = IM_MAX(fast_roundf(IM_MAX(r->w, r->h) * ptr->expand), 8);
+        rectangle_init(&windows[i], r->x - margin, r->y - margin, r->w + (margin * 2), r->h + (margin * 2));
+        rectangle_intersected(&windows[i], roi);
+
+        // The marker left the roi.
+        if ((windows[i].w <= 0) || (windows[i].h <= 0)) {
+            return 0;
+        }
+    }
+
+    int n = ptr->count;
+
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) {
+            if (rectangle_overlap(&windows[i], &windows[j])) {
+                rectangle_united(&windows[i], &windows[j]);
+                windows[j] = windows[--n];
+                j = i; // The grown window may overlap windows already checked.
+            }
+        }
+    }
+
+    return n;
+}
+
+static void roi_tracker_update(roi_tracker_t *ptr, list_t *out, size_t rect_offset) {
+    // Too many markers to track, keep searching the whole roi.
+    if (list_size(out) > ROI_TRACKER_MAX_RECTS) {
+        ptr->count = 0;
+        return;
+    }
+
+    ptr->count = 0;
+    list_for_each(it, out) {
+        rectangle_copy(&ptr->rects[ptr->count++], (rectangle_t *) (((char *) list_get_data(it)) + rect_offset));
+    }
+}
+
+void imlib_roi_tracker_find(roi_tracker_t *ptr, list_t *out, image_t *img, rectangle_t *roi, size_t rect_offset,
+                            roi_tracker_find_t find, void *data) {
+    rectangle_t windows[ROI_TRACKER_MAX_RECTS];
+    int n = roi_tracker_windows(ptr, roi, windows);
+
+    if (n) {
+        size_t tracked = ptr->count;
+
+        find(out, img, &windows[0], data);
+
+        for (int i = 1; i < n; i++) {
+            list_t window_out;
+            find(&window_out, img, &windows[i], data);
+            list_concat(out, &window_out);
+        }
+
+        if (list_size(out) >= tracked) {
+            ptr->frame += 1;
+            roi_tracker_update(ptr, out, rect_offset);
+            return;
+        }
+
+        // Lost a marker, the results are dropped (payloads are on the heap) and the whole roi searched.
+        list_free(out);
+    }
+
+    find(out, img, roi, data);
+    ptr->frame = 0;
+    roi_tracker_update(ptr, out, rect_offset);
+}
+
 /////////////////
 // Image Stuff //
 /////////////////
@@ -498,6 +591,59 @@ uint16_t imlib_yuv_to_rgb(uint8_t y, int8_t u, int8_t v) {
     return COLOR_R8_G8_B8_TO_RGB565(r, g, b);
 }
 
+// A single threshold is its own any and all bitmap.
+static size_t imlib_color_thresholds_bitmap_count(list_t *thresholds) {
+    size_t count = list_size(thresholds);
+    return (count > 1) ? (count + 2) : count;
+}
+
+size_t imlib_color_thresholds_bitmap_size(list_t *thresholds) {
+    return imlib_color_thresholds_bitmap_count(thresholds) * COLOR_THRESHOLDS_BITMAP_WORDS * sizeof(uint32_t);
+}
+
+void imlib_color_thresholds_bitmap_init(color_thresholds_bitmap_t *bitmap, list_t *thresholds, uint32_t *data) {
+    bitmap->count = list_size(thresholds);
+    bitmap->bits = data;
+    bitmap->any = bitmap->all = data;
+
+    if (bitmap->count > 1) {
+        bitmap->any = COLOR_THRESHOLDS_BITMAP_GET(bitmap, bitmap->count);
+        bitmap->all = COLOR_THRESHOLDS_BITMAP_GET(bitmap, bitmap->count + 1);
+    }
+
+    memset(data, 0, imlib_color_thresholds_bitmap_size(thresholds));
+
+    for (int pixel = COLOR_RGB565_BINARY_MIN; pixel <= COLOR_RGB565_BINARY_MAX; pixel++) {
+        int l = COLOR_RGB565_TO_L(pixel);
+        int a = COLOR_RGB565_TO_A(pixel);
+        int b = COLOR_RGB565_TO_B(pixel);
+        uint32_t mask = 1 << (pixel & UINT32_T_MASK);
+        size_t word = pixel >> UINT32_T_SHIFT;
+        size_t matches = 0;
+        size_t index = 0;
+
+        list_for_each(it, thresholds) {
+            color_thresholds_list_lnk_data_t *t = list_get_data(it);
+            if ((t->LMin <= l) && (l <= t->LMax) &&
+                (t->AMin <= a) && (a <= t->AMax) &&
+                (t->BMin <= b) && (b <= t->BMax)) {
+                COLOR_THRESHOLDS_BITMAP_GET(bitmap, index)[word] |= mask;
+                matches++;
+            }
+            index++;
+        }
+
+        if (bitmap->count > 1) {
+            if (matches) {
+                bitmap->any[word] |= mask;
+            }
+            if (matches == bitmap->count) {
+                bitmap->all[word] |= mask;
+            }
+        }
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 #if defined(IMLIB_ENABLE_IMAGE_FILE_IO)
@@ -192,6 +192,36 @@ color_thresholds_list_lnk_data_t;
          (_threshold->BMin <= _b) && (_b <= _threshold->BMax)) ^ _invert; \
     })
 
+// Compiled RGB565 color thresholds. Each threshold is evaluated once for all 65536 RGB565 values and
+// stored as a membership bitmap (8 KB) which turns a threshold test into a single bit lookup instead of
+// three LAB table loads and six compares. The bitmaps fit in the L1 cache where the LAB table does not.
+#define COLOR_THRESHOLDS_BITMAP_WORDS           (65536 / 32)
+
+typedef struct color_thresholds_bitmap {
+    size_t count;   // Number of thresholds.
+    uint32_t *any;  // Pixels matching any threshold.
+    uint32_t *all;  // Pixels matching all thresholds.
+    uint32_t *bits; // Per threshold bitmaps back to back.
+} color_thresholds_bitmap_t;
+
+#define COLOR_THRESHOLDS_BITMAP_GET(bitmap, index) \
+    ((bitmap)->bits + ((index) * COLOR_THRESHOLDS_BITMAP_WORDS))
+
+#define COLOR_THRESHOLD_BITMAP(pixel, bits, invert)                                      \
+    ({                                                                                   \
+        __typeof__ (pixel) _pixel = (pixel);                                             \
+        __typeof__ (invert) _invert = (invert);                                          \
+        (((bits)[_pixel >> UINT32_T_SHIFT] >> (_pixel & UINT32_T_MASK)) & 1) ^ _invert; \
+    })
+
+// Uses the compiled threshold bits if not NULL.
+#define COLOR_THRESHOLD_RGB565_BITMAP(pixel, threshold, bits, invert) \
+    ({                                                                \
+        __typeof__ (pixel) _bpixel = (pixel);                         \
+        (bits) ? COLOR_THRESHOLD_BITMAP(_bpixel, (bits), (invert)) :  \
+        COLOR_THRESHOLD_RGB565(_bpixel, (threshold), (invert));       \
+    })
+
 #define COLOR_BOUND_BINARY(pixel0, pixel1, threshold)    \
     ({                                                   \
         __typeof__ (pixel0) _pixel0 = (pixel0);          \
@@ -760,6 +790,22 @@ typedef enum jpeg_subsampling {
     JPEG_SUBSAMPLING_420  = 0x22, // Chroma subsampling 4:2:0
 } jpeg_subsampling_t;
 
+// Receives a chunk of the JPEG stream. Return false to abort encoding.
+typedef bool (*jpeg_sink_t)(void *arg, const uint8_t *data, uint32_t size);
+// Smallest chunk the streaming encoder works with (one DU may emit up to 256 bytes).
+#define JPEG_STREAM_MIN_CHUNK    (512)
+
+// Rate control state carried from frame to frame (see jpeg_compress_rc()).
+#define JPEG_RC_BANDS            (16)
+typedef struct jpeg_rate_control {
+    uint32_t target;                // Byte budget per frame.
+    int quality;                    // Quality the next frame is encoded at.
+    int min_quality;
+    int max_quality;
+    uint32_t size;                  // Size of the last frame, 0 if it did not fit.
+    uint32_t bands[JPEG_RC_BANDS];  // Bytes the last frame spent per horizontal band.
+} jpeg_rate_control_t;
+
 // Old Image Macros - Will be refactor and removed. But, only after making sure through testing new macros work.
 
 // Image kernels
@@ -853,6 +899,24 @@ typedef struct {
     uint32_t **swap;
 } mw_image_t;
 
+typedef enum image_plane {
+    IMAGE_PLANE_GRAYSCALE = (1 << 0),
+    IMAGE_PLANE_SUM       = (1 << 1),
+    IMAGE_PLANE_SUMSQ     = (1 << 2),
+} image_plane_t;
+
+// Planes derived from an image which are computed on first use and shared by the algorithms that
+// run on the same image until it changes. The buffers are kept for the next image of the same size.
+typedef struct image_planes {
+    image_t img;        // Image the planes were derived from.
+    uint32_t valid;     // Planes (image_plane_t) that are up to date.
+    uint32_t size;      // Bytes allocated for the plane buffers.
+    uint32_t max_size;  // Planes that don't fit in max_size bytes are not cached (0 for no limit).
+    uint8_t *grayscale;
+    i_image_t sum;
+    i_image_t sumsq;
+} image_planes_t;
+
 typedef struct _vector {
     float x;
     float y;
@@ -985,6 +1049,22 @@ typedef struct histogram {
     float *BBins;
 } histogram_t;
 
+#define HISTOGRAM_CACHE_LUT_SIZE \
+    ((COLOR_L_MAX - COLOR_L_MIN + 1) + (COLOR_A_MAX - COLOR_A_MIN + 1) + (COLOR_B_MAX - COLOR_B_MIN + 1))
+
+typedef struct histogram_cache {
+    image_t img;
+    int tile;
+    int tiles_w;
+    int tiles_h;
+    int values;
+    int l_bins;
+    int a_bins;
+    int b_bins;
+    uint8_t lut[HISTOGRAM_CACHE_LUT_SIZE];
+    uint16_t *counts;
+} histogram_cache_t;
+
 typedef struct percentile {
     uint8_t LValue;
     int8_t AValue;
@@ -1006,6 +1086,11 @@ typedef struct statistics {
 #define FIND_BLOBS_CORNERS_RESOLUTION    20 // multiple of 4
 #define FIND_BLOBS_ANGLE_RESOLUTION      (360 / FIND_BLOBS_CORNERS_RESOLUTION)
 
+typedef enum find_blobs_mode {
+    FIND_BLOBS_MODE_FLOOD_FILL,  // One flood fill pass per threshold.
+    FIND_BLOBS_MODE_SINGLE_PASS, // One run-length encoding pass for all thresholds, same results.
+} find_blobs_mode_t;
+
 typedef struct find_blobs_list_lnk_data {
     point_t corners[FIND_BLOBS_CORNERS_RESOLUTION];
     rectangle_t rect;
@@ -1099,6 +1184,20 @@ typedef struct find_barcodes_list_lnk_data {
     int quality;
 } find_barcodes_list_lnk_data_t;
 
+// Re-detects markers in windows around the previous detections and only searches the whole ROI
+// every interval frames (0 = never) or when a tracked marker is lost.
+#define ROI_TRACKER_MAX_RECTS    8
+
+typedef struct roi_tracker {
+    uint16_t interval;
+    uint16_t frame;
+    float expand;
+    int count;
+    rectangle_t rects[ROI_TRACKER_MAX_RECTS];
+} roi_tracker_t;
+
+typedef void (*roi_tracker_find_t) (list_t *out, image_t *ptr, rectangle_t *roi, void *data);
+
 typedef enum image_hint {
     IMAGE_HINT_AREA      = (1 << 0),
     IMAGE_HINT_BILINEAR  = (1 << 1),
@@ -1115,6 +1214,12 @@ typedef enum image_hint {
     IMAGE_HINT_BLACK_BACKGROUND = (1 << 31)
 } image_hint_t;
 
+typedef enum image_tensor_datatype {
+    IMAGE_TENSOR_DATATYPE_UINT8,
+    IMAGE_TENSOR_DATATYPE_INT8,
+    IMAGE_TENSOR_DATATYPE_FLOAT
+} image_tensor_datatype_t;
+
 typedef struct imlib_draw_row_data {
     image_t *dst_img; // user
     pixformat_t src_img_pixfmt; // user
@@ -1164,6 +1269,8 @@ int8_t imlib_rgb565_to_a(uint16_t pixel);
 int8_t imlib_rgb565_to_b(uint16_t pixel);
 uint16_t imlib_lab_to_rgb(uint8_t l, int8_t a, int8_t b);
 uint16_t imlib_yuv_to_rgb(uint8_t y, int8_t u, int8_t v);
+size_t imlib_color_thresholds_bitmap_size(list_t *thresholds);
+void imlib_color_thresholds_bitmap_init(color_thresholds_bitmap_t *bitmap, list_t *thresholds, uint32_t *data);
 
 /* Image file functions */
 void ppm_read_geometry(FIL *fp, image_t *img, const char *path, ppm_read_settings_t *rs);
@@ -1182,6 +1289,19 @@ void jpeg_get_mcu(image_t *src, int x_offset, int y_offset, int dx, int dy,
                   int8_t *Y0, int8_t *CB, int8_t *CR);
 void jpeg_decompress(image_t *dst, image_t *src);
 bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc, jpeg_subsampling_t subsampling);
+#if (OMV_JPEG_CODEC_ENABLE == 0)
+// Encodes src in chunks passed to sink, alternating between the two halves of buf so that the sink
+// may transfer one chunk while the next is being encoded. A chunk stays valid until the sink
+// returns from its next call. A restart marker is inserted every restart_rows MCU rows (0 to
+// disable) and ends a chunk. If rc is not NULL it overrides quality. Returns true if the sink aborted.
+bool jpeg_compress_stream(image_t *src, int quality, jpeg_rate_control_t *rc, jpeg_subsampling_t subsampling,
+                          int restart_rows, uint8_t *buf, uint32_t size, jpeg_sink_t sink, void *sink_arg);
+void jpeg_rate_control_init(jpeg_rate_control_t *rc, uint32_t target);
+// Like jpeg_compress() but encodes at rc->quality, paces the frame against rc->target and
+// adapts rc->quality for the next frame.
+bool jpeg_compress_rc(image_t *src, image_t *dst, jpeg_rate_control_t *rc, bool realloc,
+                      jpeg_subsampling_t subsampling);
+#endif
 bool jpeg_is_valid(image_t *img);
 int jpeg_clean_trailing_bytes(int bpp, uint8_t *data);
 void jpeg_read_geometry(FIL *fp, image_t *img, const char *path, jpg_read_settings_t *rs);
@@ -1235,8 +1355,9 @@ int imlib_image_std(image_t *src); // grayscale only
 /* Template Matching */
 void imlib_midpoint_pool(image_t *img_i, image_t *img_o, int x_div, int y_div, const int bias);
 void imlib_mean_pool(image_t *img_i, image_t *img_o, int x_div, int y_div);
-float imlib_template_match_ds(image_t *image, image_t *t, rectangle_t *r);
-float imlib_template_match_ex(image_t *image, image_t *t, rectangle_t *roi, int step, rectangle_t *r);
+float imlib_template_match_ds(image_t *image, image_t *t, rectangle_t *r, image_planes_t *planes);
+float imlib_template_match_ex(image_t *image, image_t *t, rectangle_t *roi, int step, rectangle_t *r,
+                              image_planes_t *planes);
 
 /* Clustering functions */
 array_t *cluster_kmeans(array_t *points, int k, cluster_dist_t dist_func);
@@ -1259,11 +1380,22 @@ void imlib_integral_mw_shift(image_t *src, mw_image_t *sum, int n);
 void imlib_integral_mw_shift_sq(image_t *src, mw_image_t *sum, int n);
 void imlib_integral_mw_ss(image_t *src, mw_image_t *sum, mw_image_t *ssq, rectangle_t *roi);
 void imlib_integral_mw_shift_ss(image_t *src, mw_image_t *sum, mw_image_t *ssq, rectangle_t *roi, int n);
+void imlib_integral_mw_ss_raw(const uint8_t *src, int stride, mw_image_t *sum, mw_image_t *ssq);
+void imlib_integral_mw_shift_ss_raw(const uint8_t *src, int stride, mw_image_t *sum, mw_image_t *ssq, int n);
 long imlib_integral_mw_lookup(mw_image_t *sum, int x, int y, int w, int h);
 
+/* Derived image planes */
+void imlib_planes_init(image_planes_t *planes);
+void imlib_planes_free(image_planes_t *planes);
+void imlib_planes_invalidate(image_planes_t *planes, image_t *img);
+uint8_t *imlib_planes_grayscale(image_planes_t *planes, image_t *img);
+void imlib_planes_grayscale_roi(image_planes_t *planes, image_t *img, rectangle_t *roi, uint8_t *data);
+i_image_t *imlib_planes_integral(image_planes_t *planes, image_t *img);
+i_image_t *imlib_planes_integral_sq(image_planes_t *planes, image_t *img);
+
 /* Haar/VJ */
 int imlib_load_cascade(struct cascade *cascade, const char *path);
-array_t *imlib_detect_objects(struct image *image, struct cascade *cascade, struct rectangle *roi);
+array_t *imlib_detect_objects(struct image *image, struct cascade *cascade, struct rectangle *roi, bool pyramid);
 
 /* Corner detectors */
 void fast_detect(image_t *image, array_t *keypoints, int threshold, rectangle_t *roi);
@@ -1361,6 +1493,8 @@ void imlib_draw_image(image_t *dst_img,
                       imlib_draw_row_callback_t callback,
                       void *callback_arg,
                       void *dst_row_override);
+void imlib_draw_image_tensor(void *tensor, int w, int h, int channels, image_tensor_datatype_t datatype,
+                             float scale, int zero_point, image_t *src_img, rectangle_t *roi);
 void imlib_flood_fill(image_t *img, int x, int y,
                       float seed_threshold, float floating_threshold,
                       int c, bool invert, bool clear_background, image_t *mask);
@@ -1373,7 +1507,8 @@ void imlib_gamma(image_t *img, float gamma, float scale, float offset);
 // Binary Functions
 void imlib_zero_line_op(int x, int x_end, int y_row, imlib_draw_row_data_t *data);
 void imlib_mask_line_op(int x, int x_end, int y_row, imlib_draw_row_data_t *data);
-void imlib_binary(image_t *out, image_t *img, list_t *thresholds, bool invert, bool zero, image_t *mask);
+void imlib_binary(image_t *out, image_t *img, list_t *thresholds, color_thresholds_bitmap_t *bitmap,
+                  bool invert, bool zero, image_t *mask);
 void imlib_invert(image_t *img);
 void imlib_b_and_line_op(image_t *img, int line, void *other, void *data, bool vflipped);
 void imlib_b_and(image_t *img, const char *path, image_t *other, int scalar, image_t *mask);
@@ -1422,6 +1557,17 @@ void imlib_morph(image_t *img,
                  int offset,
                  bool invert,
                  image_t *mask);
+void imlib_sepmorph(image_t *img,
+                    const int ksize,
+                    const int *row_krn,
+                    const int *col_krn,
+                    const int center,
+                    const float m,
+                    const float b,
+                    bool threshold,
+                    int offset,
+                    bool invert,
+                    image_t *mask);
 void imlib_bilateral_filter(image_t *img,
                             const int ksize,
                             float color_sigma,
@@ -1430,6 +1576,14 @@ void imlib_bilateral_filter(image_t *img,
                             int offset,
                             bool invert,
                             image_t *mask);
+void imlib_bilateral_grid(image_t *img,
+                          const int ksize,
+                          float color_sigma,
+                          float space_sigma,
+                          bool threshold,
+                          int offset,
+                          bool invert,
+                          image_t *mask);
 // Image Correction
 void imlib_logpolar_int(image_t *dst, image_t *src, rectangle_t *roi, bool linear, bool reverse); // helper/internal
 void imlib_logpolar(image_t *img, bool linear, bool reverse);
@@ -1447,7 +1601,14 @@ void imlib_get_similarity(image_t *img,
                           float *std,
                           float *min,
                           float *max);
-void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_t *thresholds, bool invert, image_t *other);
+void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_t *thresholds,
+                         color_thresholds_bitmap_t *bitmap, bool invert, image_t *other);
+size_t imlib_histogram_cache_size(image_t *ptr, int tile, int l_bins, int a_bins, int b_bins);
+void imlib_histogram_cache_init(histogram_cache_t *cache, image_t *ptr, int tile,
+                                int l_bins, int a_bins, int b_bins, uint16_t *counts);
+void imlib_histogram_cache_update(histogram_cache_t *cache, image_t *ptr);
+void imlib_histogram_cache_get_histogram(histogram_t *out, histogram_cache_t *cache, rectangle_t *roi,
+                                         list_t *thresholds, bool invert);
 void imlib_get_percentile(percentile_t *out, pixformat_t pixfmt, histogram_t *ptr, float percentile);
 void imlib_get_threshold(threshold_t *out, pixformat_t pixfmt, histogram_t *ptr);
 void imlib_get_statistics(statistics_t *out, pixformat_t pixfmt, histogram_t *ptr);
@@ -1463,16 +1624,17 @@ bool imlib_get_regression(find_lines_list_lnk_data_t *out,
                           bool robust);
 // Color Tracking
 void imlib_find_blobs(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride,
-                      list_t *thresholds, bool invert, unsigned int area_threshold, unsigned int pixels_threshold,
-                      bool merge, int margin,
+                      list_t *thresholds, color_thresholds_bitmap_t *bitmap, bool invert,
+                      unsigned int area_threshold, unsigned int pixels_threshold, bool merge, int margin,
                       bool (*threshold_cb) (void *, find_blobs_list_lnk_data_t *), void *threshold_cb_arg,
                       bool (*merge_cb) (void *, find_blobs_list_lnk_data_t *, find_blobs_list_lnk_data_t *), void *merge_cb_arg,
-                      unsigned int x_hist_bins_max, unsigned int y_hist_bins_max);
+                      unsigned int x_hist_bins_max, unsigned int y_hist_bins_max, find_blobs_mode_t mode);
 // Shape Detection
 size_t trace_line(image_t *ptr, line_t *l, int *theta_buffer, uint32_t *mag_buffer, point_t *point_buffer); // helper/internal
 void merge_alot(list_t *out, int threshold, int theta_threshold); // helper/internal
 void imlib_find_lines(list_t *out, image_t *ptr, rectangle_t *roi, unsigned int x_stride, unsigned int y_stride,
-                      uint32_t threshold, unsigned int theta_margin, unsigned int rho_margin);
+                      uint32_t threshold, unsigned int theta_margin, unsigned int rho_margin,
+                      unsigned int theta_window);
 void imlib_lsd_find_line_segments(list_t *out,
                                   image_t *ptr,
                                   rectangle_t *roi,
@@ -1485,13 +1647,17 @@ void imlib_find_circles(list_t *out, image_t *ptr, rectangle_t *roi, unsigned in
                         uint32_t threshold, unsigned int x_margin, unsigned int y_margin, unsigned int r_margin,
                         unsigned int r_min, unsigned int r_max, unsigned int r_step);
 void imlib_find_rects(list_t *out, image_t *ptr, rectangle_t *roi,
-                      uint32_t threshold);
+                      uint32_t threshold, image_planes_t *planes);
 // 1/2D Bar Codes
-void imlib_find_qrcodes(list_t *out, image_t *ptr, rectangle_t *roi);
+void imlib_find_qrcodes(list_t *out, image_t *ptr, rectangle_t *roi, image_planes_t *planes);
 void imlib_find_apriltags(list_t *out, image_t *ptr, rectangle_t *roi, apriltag_families_t families,
-                          float fx, float fy, float cx, float cy);
-void imlib_find_datamatrices(list_t *out, image_t *ptr, rectangle_t *roi, int effort);
-void imlib_find_barcodes(list_t *out, image_t *ptr, rectangle_t *roi);
+                          float fx, float fy, float cx, float cy, int quad_decimate, image_planes_t *planes);
+void imlib_find_datamatrices(list_t *out, image_t *ptr, rectangle_t *roi, int effort, image_planes_t *planes);
+void imlib_find_barcodes(list_t *out, image_t *ptr, rectangle_t *roi, bool fast, image_planes_t *planes);
+void roi_tracker_init(roi_tracker_t *ptr, int interval, float expand);
+void roi_tracker_reset(roi_tracker_t *ptr);
+void imlib_roi_tracker_find(roi_tracker_t *ptr, list_t *out, image_t *img, rectangle_t *roi, size_t rect_offset,
+                            roi_tracker_find_t find, void *data);
 // Template Matching
 void imlib_phasecorrelate(image_t *img0,
                           image_t *img1,
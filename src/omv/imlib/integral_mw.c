@@ -46,6 +46,7 @@
  *
  *  Functions without a suffix compute/shift summed images, _sq suffix compute/shift
  *  summed squared images, and _ss compute/shift both summed and squared in a single pass.
+ *  The _raw variants read unscaled 8-bit grayscale rows directly (e.g. a pyramid level).
  */
 #include <stdlib.h>
 #include <stdio.h>
@@ -295,6 +296,64 @@ void imlib_integral_mw_shift_ss(image_t *src, mw_image_t *sum, mw_image_t *ssq,
     }
 }
 
+void imlib_integral_mw_ss_raw(const uint8_t *src, int stride, mw_image_t *sum, mw_image_t *ssq) {
+    // Image data pointers
+    typeof(*sum->data) * sum_data = sum->data;
+    typeof(*sum->data) * ssq_data = ssq->data;
+
+    // Compute the first row to avoid branching
+    for (int s = 0, sq = 0, x = 0; x < sum->w; x++) {
+        int p = src[x];
+        s += p;
+        sq += p * p;
+        sum_data[0][x] = s;
+        ssq_data[0][x] = sq;
+    }
+
+    // Compute the remaining rows
+    for (int y = 1; y < sum->h; y++) {
+        const uint8_t *row = src + (y * stride);
+        for (int s = 0, sq = 0, x = 0; x < sum->w; x++) {
+            int p = row[x];
+            s += p;
+            sq += p * p;
+            sum_data[y][x] = s + sum_data[y - 1][x];
+            ssq_data[y][x] = sq + ssq_data[y - 1][x];
+        }
+    }
+
+    sum->y_offs = sum->h;
+    ssq->y_offs = sum->h;
+}
+
+void imlib_integral_mw_shift_ss_raw(const uint8_t *src, int stride, mw_image_t *sum, mw_image_t *ssq, int n) {
+    // Shift integral image rows by n lines
+    for (int y = 0; y < sum->h; y++) {
+        sum->swap[y] = sum->data[(y + n) % sum->h];
+        ssq->swap[y] = ssq->data[(y + n) % ssq->h];
+    }
+
+    // Swap the data and swap pointers
+    SWAP_PTRS(sum->data, sum->swap);
+    SWAP_PTRS(ssq->data, ssq->swap);
+
+    // Pointer to the current sum and ssq data
+    typeof(*sum->data) * sum_data = sum->data;
+    typeof(*ssq->data) * ssq_data = ssq->data;
+
+    // Compute the last n lines
+    for (int y = (sum->h - n); y < sum->h; y++, sum->y_offs++, ssq->y_offs++) {
+        const uint8_t *row = src + (sum->y_offs * stride);
+        for (int s = 0, sq = 0, x = 0; x < sum->w; x++) {
+            int p = row[x];
+            s += p;
+            sq += p * p;
+            sum_data[y][x] = s + sum_data[y - 1][x];
+            ssq_data[y][x] = sq + ssq_data[y - 1][x];
+        }
+    }
+}
+
 long imlib_integral_mw_lookup(mw_image_t *sum, int x, int y, int w, int h) {
 #define PIXEL_AT(x, y) \
     (sum->data[(y)][x])
@@ -983,10 +983,29 @@ typedef struct {
     int bitc, bitb;
     bool realloc;
     bool overflow;
+    // Streaming output (see jpeg_compress_stream()). The two chunks are filled alternately.
+    jpeg_sink_t sink;
+    void *sink_arg;
+    uint8_t *chunks[2];
+    int chunk;
+    uint32_t flushed;
+    // Rate control (see jpeg_compress_rc()). AC coefficients at or past ac_limit in zigzag order
+    // are dropped while the frame runs over budget.
+    jpeg_rate_control_t *rc;
+    int ac_limit;
+    uint32_t rc_used;
+    uint32_t rc_projected;
+    uint32_t rc_bands[JPEG_RC_BANDS];
 } jpeg_buf_t;
 
 // Quantization tables
-static float fdtbl_Y[64], fdtbl_UV[64];
+// Quantizer reciprocals in natural order: q = (|x| * recip + (1 << (shift - 1))) >> shift.
+typedef struct {
+    uint32_t recip[64];
+    uint8_t shift[64];
+} jpeg_qtbl_t;
+
+static jpeg_qtbl_t qtbl_Y, qtbl_UV;
 static uint8_t YTable[64], UVTable[64];
 
 static const uint8_t s_jpeg_ZigZag[] = {
@@ -1232,6 +1251,22 @@ static const uint16_t UVAC_HT[256][2] = {
     }                                                                                         \
     iLen += iNewLen; ulAcc |= (ulCode << (32 - iLen));
 
+//
+// Hands the bytes written so far to the sink and continues in the other chunk
+//
+static void jpeg_flush_chunk(jpeg_buf_t *jpeg_buf) {
+    if (jpeg_buf->idx) {
+        if ((!jpeg_buf->overflow) && (!jpeg_buf->sink(jpeg_buf->sink_arg, jpeg_buf->buf, jpeg_buf->idx))) {
+            // Sink aborted, the rest of the output is dropped.
+            jpeg_buf->overflow = true;
+        }
+        jpeg_buf->flushed += jpeg_buf->idx;
+        jpeg_buf->chunk ^= 1;
+        jpeg_buf->buf = jpeg_buf->chunks[jpeg_buf->chunk];
+        jpeg_buf->idx = 0;
+    }
+} /* jpeg_flush_chunk() */
+
 //
 // See if we're close to filling up the output buffer
 // If so, allocate more space now so that we don't have
@@ -1242,6 +1277,10 @@ static const uint16_t UVAC_HT[256][2] = {
 //
 static int jpeg_check_highwater(jpeg_buf_t *jpeg_buf) {
     if ((jpeg_buf->idx + 1) >= jpeg_buf->length - 256) {
+        if (jpeg_buf->sink) {
+            jpeg_flush_chunk(jpeg_buf);
+            return jpeg_buf->overflow;
+        }
         if (jpeg_buf->realloc == false) {
             // Can't realloc buffer
             jpeg_buf->overflow = true;
@@ -1274,13 +1313,16 @@ void jpeg_restore_buf(jpeg_buf_t *jpeg_buf, uint8_t *pOut, int iBitCount, uint32
 
 static void jpeg_put_char(jpeg_buf_t *jpeg_buf, char c) {
     if ((jpeg_buf->idx + 1) >= jpeg_buf->length) {
-        if (jpeg_buf->realloc == false) {
+        if (jpeg_buf->sink) {
+            jpeg_flush_chunk(jpeg_buf);
+        } else if (jpeg_buf->realloc == false) {
             // Can't realloc buffer
             jpeg_buf->overflow = true;
             return;
+        } else {
+            jpeg_buf->length += 1024;
+            jpeg_buf->buf = xrealloc(jpeg_buf->buf, jpeg_buf->length);
         }
-        jpeg_buf->length += 1024;
-        jpeg_buf->buf = xrealloc(jpeg_buf->buf, jpeg_buf->length);
     }
 
     jpeg_buf->buf[jpeg_buf->idx++] = c;
@@ -1288,13 +1330,16 @@ static void jpeg_put_char(jpeg_buf_t *jpeg_buf, char c) {
 
 static void jpeg_put_bytes(jpeg_buf_t *jpeg_buf, const void *data, int size) {
     if ((jpeg_buf->idx + size) >= jpeg_buf->length) {
-        if (jpeg_buf->realloc == false) {
+        if (jpeg_buf->sink) {
+            jpeg_flush_chunk(jpeg_buf);
+        } else if (jpeg_buf->realloc == false) {
             // Can't realloc buffer
             jpeg_buf->overflow = true;
             return;
+        } else {
+            jpeg_buf->length += 1024;
+            jpeg_buf->buf = xrealloc(jpeg_buf->buf, jpeg_buf->length);
         }
-        jpeg_buf->length += 1024;
-        jpeg_buf->buf = xrealloc(jpeg_buf->buf, jpeg_buf->length);
     }
 
     memcpy(jpeg_buf->buf + jpeg_buf->idx, data, size);
@@ -1327,17 +1372,23 @@ static void jpeg_calcBits(int val, uint16_t bits[2]) {
     bits[0] = val & ((1 << bits[1]) - 1);
 }
 
-static int jpeg_processDU(jpeg_buf_t *jpeg_buf, int8_t *CDU, float *fdtbl, int DC, const uint16_t (*HTDC)[2],
-                          const uint16_t (*HTAC)[2]) {
-    int DU[64];
-    int DUQ[64];
+// The halving adds round down, which lowers the average of the chroma samples by 1/4 for a 2:1
+// average and by 1/2 for a 2x2 average. The DC of the scaled DCT is the sum of the 64 samples, so
+// adding these back to it restores the block average.
+#define JPEG_AVG2_DC_BIAS   (16)
+#define JPEG_AVG4_DC_BIAS   (32)
+
+// Averages a 2x2 block of an MCU, rounding like the halving adds of the DSP path.
+static inline int jpeg_avg4(const int8_t *p) {
+    return (((p[0] + p[1]) >> 1) + ((p[JPEG_MCU_W] + p[JPEG_MCU_W + 1]) >> 1)) >> 1;
+}
+
+// Row pass of the scaled DCT. The outputs and the outputs of the column pass fit in 16 bits.
+static void jpeg_fdct_rows(const int8_t *CDU, int16_t *DU) {
     int z1, z2, z3, z4, z5, z11, z13;
     int t0, t1, t2, t3, t4, t5, t6, t7, t10, t11, t12, t13;
-    const uint16_t EOB[2] = { HTAC[0x00][0], HTAC[0x00][1] };
-    const uint16_t M16zeroes[2] = { HTAC[0xF0][0], HTAC[0xF0][1] };
 
-    // DCT rows
-    for (int i = 8, *p = DU; i > 0; i--, p += 8, CDU += 8) {
+    for (int16_t *p = DU; p < (DU + 64); p += 8, CDU += 8) {
         t0 = CDU[0] + CDU[7];
         t1 = CDU[1] + CDU[6];
         t2 = CDU[2] + CDU[5];
@@ -1378,9 +1429,68 @@ static int jpeg_processDU(jpeg_buf_t *jpeg_buf, int8_t *CDU, float *fdtbl, int D
         p[1] = z11 + z4;
         p[7] = z11 - z4;
     }
+}
+
+#if defined(ARM_MATH_DSP)
+// Multiplies both halfwords of x by a FIX_ constant.
+static inline uint32_t jpeg_fdct_multiply2(uint32_t x, uint32_t c) {
+    return __PKHBT(((int32_t) __SMUAD(x, c)) >> 8, ((int32_t) __SMUADX(x, c)) >> 8, 16);
+}
+
+// Column pass of the scaled DCT, two columns at a time in the two halfwords of each word. No
+// intermediate value leaves 16 bits so this is bit-exact with the scalar column pass.
+static void jpeg_fdct_columns(int16_t *DU) {
+    uint32_t z1, z2, z3, z4, z5, z11, z13;
+    uint32_t t0, t1, t2, t3, t4, t5, t6, t7, t10, t11, t12, t13;
+
+    for (uint32_t *p = (uint32_t *) DU; p < ((uint32_t *) (DU + 8)); p++) {
+        t0 = __SADD16(p[0], p[28]);
+        t1 = __SADD16(p[4], p[24]);
+        t2 = __SADD16(p[8], p[20]);
+        t3 = __SADD16(p[12], p[16]);
+
+        t7 = __SSUB16(p[0], p[28]);
+        t6 = __SSUB16(p[4], p[24]);
+        t5 = __SSUB16(p[8], p[20]);
+        t4 = __SSUB16(p[12], p[16]);
+
+        // Even part
+        t10 = __SADD16(t0, t3);
+        t13 = __SSUB16(t0, t3);
+        t11 = __SADD16(t1, t2);
+        t12 = __SSUB16(t1, t2);
+        z1 = jpeg_fdct_multiply2(__SADD16(t12, t13), FIX_0_707106781);
+
+        p[0] = __SADD16(t10, t11);
+        p[16] = __SSUB16(t10, t11);
+        p[8] = __SADD16(t13, z1);
+        p[24] = __SSUB16(t13, z1);
+
+        // Odd part
+        t10 = __SADD16(t4, t5);
+        t11 = __SADD16(t5, t6);
+        t12 = __SADD16(t6, t7);
+
+        z5 = jpeg_fdct_multiply2(__SSUB16(t10, t12), FIX_0_382683433);
+        z2 = __SADD16(jpeg_fdct_multiply2(t10, FIX_0_541196100), z5);
+        z4 = __SADD16(jpeg_fdct_multiply2(t12, FIX_1_306562965), z5);
+        z3 = jpeg_fdct_multiply2(t11, FIX_0_707106781);
+        z11 = __SADD16(t7, z3);
+        z13 = __SSUB16(t7, z3);
+
+        p[20] = __SADD16(z13, z2);
+        p[12] = __SSUB16(z13, z2);
+        p[4] = __SADD16(z11, z4);
+        p[28] = __SSUB16(z11, z4);
+    }
+}
+#else
+// Column pass of the scaled DCT.
+static void jpeg_fdct_columns(int16_t *DU) {
+    int z1, z2, z3, z4, z5, z11, z13;
+    int t0, t1, t2, t3, t4, t5, t6, t7, t10, t11, t12, t13;
 
-    // DCT columns
-    for (int i = 8, *p = DU; i > 0; i--, p++) {
+    for (int16_t *p = DU; p < (DU + 8); p++) {
         t0 = p[0] + p[56];
         t1 = p[8] + p[48];
         t2 = p[16] + p[40];
@@ -1421,15 +1531,34 @@ static int jpeg_processDU(jpeg_buf_t *jpeg_buf, int8_t *CDU, float *fdtbl, int D
         p[8] = z11 + z4;
         p[56] = z11 - z4;
     }
+}
+#endif
 
-    // first non-zero element in reverse order
-    int end0pos = 0;
-    // Quantize/descale/zigzag the coefficients
+static int jpeg_processDU(jpeg_buf_t *jpeg_buf, int8_t *CDU, const jpeg_qtbl_t *qtbl, int DCbias, int DC,
+                          const uint16_t (*HTDC)[2], const uint16_t (*HTAC)[2]) {
+    int16_t DU[64] __attribute__((aligned(4)));
+    int DUQ[64];
+    const uint16_t EOB[2] = { HTAC[0x00][0], HTAC[0x00][1] };
+    const uint16_t M16zeroes[2] = { HTAC[0xF0][0], HTAC[0xF0][1] };
+
+    jpeg_fdct_rows(CDU, DU);
+    jpeg_fdct_columns(DU);
+    DU[0] += DCbias;
+
+    // Quantize/descale/zigzag the coefficients, marking the non-zero ones in zigzag order.
+    uint64_t nz = 0;
     for (int i = 0; i < 64; ++i) {
-        DUQ[s_jpeg_ZigZag[i]] = fast_roundf(DU[i] * fdtbl[i]);
-        if (s_jpeg_ZigZag[i] > end0pos && DUQ[s_jpeg_ZigZag[i]]) {
-            end0pos = s_jpeg_ZigZag[i];
-        }
+        int v = DU[i];
+        int z = s_jpeg_ZigZag[i];
+        uint32_t q = ((abs(v) * qtbl->recip[i]) + (1 << (qtbl->shift[i] - 1))) >> qtbl->shift[i];
+        DUQ[z] = (v < 0) ? -q : q;
+        nz |= ((uint64_t) (q != 0)) << z;
+    }
+
+    // Only the AC coefficients below ac_limit are coded.
+    uint64_t ac = nz & ~1ULL;
+    if (jpeg_buf->ac_limit < 64) {
+        ac &= (1ULL << jpeg_buf->ac_limit) - 1;
     }
 
     if (jpeg_check_highwater(jpeg_buf)) {
@@ -1455,18 +1584,13 @@ static int jpeg_processDU(jpeg_buf_t *jpeg_buf, int8_t *CDU, float *fdtbl, int D
         STORECODE(pOut, iBitCount, bits[0], ulBits, bits[1])
     }
 
-    // Encode ACs
-    if (end0pos == 0) {
-        STORECODE(pOut, iBitCount, EOB[0], ulBits, EOB[1])
-        jpeg_restore_buf(jpeg_buf, pOut, iBitCount, ulBits);
-        return DUQ[0];
-    }
-
-    for (int i = 1; i <= end0pos; ++i) {
-        int startpos = i;
-        for (; DUQ[i] == 0 && i <= end0pos ; ++i) {
-        }
-        int nrzeroes = i - startpos;
+    // Encode ACs, jumping from one non-zero coefficient to the next.
+    int end0pos = 0;
+    while (ac) {
+        int i = __builtin_ctzll(ac);
+        int nrzeroes = i - end0pos - 1;
+        ac &= ac - 1;
+        end0pos = i;
         if (nrzeroes >= 16) {
             int lng = nrzeroes >> 4;
             for (int nrmarker = 1; nrmarker <= lng; ++nrmarker) {
@@ -1486,6 +1610,15 @@ static int jpeg_processDU(jpeg_buf_t *jpeg_buf, int8_t *CDU, float *fdtbl, int D
     return DUQ[0];
 }
 
+// Sets the reciprocal of divisor with a 16-bit mantissa. Coefficients fit in 16 bits so the
+// product fits in 32 bits.
+static void jpeg_qtbl_set(jpeg_qtbl_t *qtbl, int k, float divisor) {
+    int e;
+    float m = frexpf(divisor, &e);
+    qtbl->recip[k] = fast_roundf(32768.0f / m);
+    qtbl->shift[k] = 15 + e;
+}
+
 static void jpeg_init(int quality) {
     static int q = 0;
 
@@ -1503,14 +1636,15 @@ static void jpeg_init(int quality) {
 
         for (int r = 0, k = 0; r < 8; ++r) {
             for (int c = 0; c < 8; ++c, ++k) {
-                fdtbl_Y[k] = 1.0f / (aasf[r] * aasf[c] * YTable [s_jpeg_ZigZag[k]] * 8.0f);
-                fdtbl_UV[k] = 1.0f / (aasf[r] * aasf[c] * UVTable[s_jpeg_ZigZag[k]] * 8.0f);
+                jpeg_qtbl_set(&qtbl_Y, k, aasf[r] * aasf[c] * YTable [s_jpeg_ZigZag[k]] * 8.0f);
+                jpeg_qtbl_set(&qtbl_UV, k, aasf[r] * aasf[c] * UVTable[s_jpeg_ZigZag[k]] * 8.0f);
             }
         }
     }
 }
 
-static void jpeg_write_headers(jpeg_buf_t *jpeg_buf, int w, int h, int bpp, jpeg_subsampling_t subsampling) {
+static void jpeg_write_headers(jpeg_buf_t *jpeg_buf, int w, int h, int bpp, jpeg_subsampling_t subsampling,
+                               int restart_interval) {
     // Number of components (1 or 3)
     uint8_t nr_comp = (bpp == 1)? 1 : 3;
 
@@ -1604,6 +1738,12 @@ static void jpeg_write_headers(jpeg_buf_t *jpeg_buf, int w, int h, int bpp, jpeg
         jpeg_put_bytes(jpeg_buf, std_ac_chrominance_values, sizeof(std_ac_chrominance_values));
     }
 
+    // Write DRI marker
+    if (restart_interval) {
+        jpeg_put_bytes(jpeg_buf, (uint8_t [6]) {0xFF, 0xDD, 0x00, 0x04,
+                                                restart_interval >> 8, restart_interval & 0xFF}, 6);
+    }
+
     // Write SOS marker
     jpeg_put_bytes(jpeg_buf, m_sos, sizeof(m_sos));
     for (int i = 0; i < nr_comp; i++) {
@@ -1614,32 +1754,94 @@ static void jpeg_write_headers(jpeg_buf_t *jpeg_buf, int w, int h, int bpp, jpeg
     jpeg_put_bytes(jpeg_buf, (uint8_t [3]) {0x00, 0x3F, 0x0}, 3);
 }
 
-bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc, jpeg_subsampling_t subsampling) {
-    #if (TIME_JPEG == 1)
-    mp_uint_t start = mp_hal_ticks_ms();
-    #endif
+// Ends a restart interval: pads the entropy coded data to a byte boundary with 1 bits and writes
+// the RSTn marker. The caller resets the DC predictors.
+static void jpeg_write_restart(jpeg_buf_t *jpeg_buf, int n) {
+    static const uint16_t fillBits[] = {0x7F, 7};
+    jpeg_writeBits(jpeg_buf, fillBits);
+    jpeg_buf->bitc = 0;
+    jpeg_buf->bitb = 0;
 
-    if (!dst->data) {
-        uint32_t size = 0;
-        dst->data = fb_alloc_all(&size, FB_ALLOC_PREFER_SIZE | FB_ALLOC_CACHE_ALIGN);
-        dst->size = IMLIB_IMAGE_MAX_SIZE(size);
+    jpeg_put_char(jpeg_buf, 0xFF);
+    jpeg_put_char(jpeg_buf, 0xD0 + (n & 7));
+
+    // Each restart interval is decodable on its own so it makes a good chunk.
+    if (jpeg_buf->sink) {
+        jpeg_flush_chunk(jpeg_buf);
     }
+}
 
-    if (src->is_compressed) {
-        return true;
+// Paces the frame against the byte budget using the band profile of the last frame. While the
+// frame runs ahead of budget the high frequency AC coefficients are dropped, halving the number
+// kept each row, and they are restored the same way once it is back on track.
+static void jpeg_rate_control_row(jpeg_buf_t *jpeg_buf, int row, int rows) {
+    jpeg_rate_control_t *rc = jpeg_buf->rc;
+    uint32_t used = jpeg_buf->flushed + jpeg_buf->idx;
+    jpeg_buf->rc_bands[(row * JPEG_RC_BANDS) / rows] += used - jpeg_buf->rc_used;
+    jpeg_buf->rc_used = used;
+
+    // Fraction (in 1/65536ths) of the last frame that was spent by the end of this row. Without
+    // a usable last frame the bytes are assumed to be spread evenly.
+    uint32_t pos = ((row + 1) * JPEG_RC_BANDS * 256) / rows;
+    uint32_t frac = pos << 4;
+
+    if (rc->size) {
+        uint32_t spent = 0, total = 0;
+        for (int i = 0; i < JPEG_RC_BANDS; i++) {
+            if (i < (pos >> 8)) {
+                spent += rc->bands[i];
+            } else if (i == (pos >> 8)) {
+                spent += (rc->bands[i] * (pos & 255)) >> 8;
+            }
+            total += rc->bands[i];
+        }
+        if (total) {
+            frac = (((uint64_t) spent) << 16) / total;
+        }
     }
 
-    // JPEG buffer
-    jpeg_buf_t jpeg_buf = {
-        .idx = 0,
-        .buf = dst->pixels,
-        .length = dst->size,
-        .bitc = 0,
-        .bitb = 0,
-        .realloc = realloc,
-        .overflow = false,
-    };
+    uint32_t slack = rc->target / 16;
+    uint32_t expected = (((uint64_t) (rc->target - slack)) * frac) >> 16;
+
+    if (used > (expected + slack)) {
+        // Remember how big the frame would have been at this quality.
+        if ((jpeg_buf->ac_limit == 64) && frac) {
+            jpeg_buf->rc_projected = (((uint64_t) used) << 16) / frac;
+        }
+        jpeg_buf->ac_limit = IM_MAX(jpeg_buf->ac_limit / 2, 1);
+    } else if (used < expected) {
+        jpeg_buf->ac_limit = IM_MIN(jpeg_buf->ac_limit * 2, 64);
+    }
+}
 
+// Picks the quality of the next frame. The frame size is modelled as inversely proportional to
+// the quantizer scale, which undershoots the correction as the real curve is flatter, so the
+// quality converges without oscillating.
+static void jpeg_rate_control_frame(jpeg_buf_t *jpeg_buf, int quality, bool overflow) {
+    jpeg_rate_control_t *rc = jpeg_buf->rc;
+    uint32_t size = IM_MAX(jpeg_buf->flushed + jpeg_buf->idx, jpeg_buf->rc_projected);
+    uint32_t aim = IM_MAX(rc->target - (rc->target / 16), 1U);
+    int scale = IM_MAX((quality < 50) ? (5000 / quality) : (200 - (quality * 2)), 1);
+
+    if (overflow) {
+        // The frame was cut short, so neither its size nor its profile can be trusted.
+        scale *= 2;
+        rc->size = 0;
+    } else {
+        scale = IM_MIN((((uint64_t) scale * size) + (aim / 2)) / aim, 5000ULL);
+        rc->size = size;
+        memcpy(rc->bands, jpeg_buf->rc_bands, sizeof(rc->bands));
+    }
+
+    scale = IM_MIN(IM_MAX(scale, 1), 5000);
+    quality = (scale <= 100) ? ((200 - scale) / 2) : (5000 / scale);
+    rc->quality = IM_MIN(IM_MAX(quality, rc->min_quality), rc->max_quality);
+}
+
+// Encodes src into jpeg_buf. A restart marker is inserted every restart_rows MCU rows if non-zero.
+// Returns true if the output overflowed.
+static bool jpeg_encode(image_t *src, jpeg_buf_t *jpeg_buf, int quality, jpeg_subsampling_t subsampling,
+                        int restart_rows) {
     // Initialize quantization tables
     jpeg_init(quality);
 
@@ -1657,9 +1859,26 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc, jpeg_s
         subsampling = JPEG_SUBSAMPLING_444;
     }
 
-    jpeg_write_headers(&jpeg_buf, src->w, src->h, src->is_color ? 2 : 1, subsampling);
+    // The restart interval is counted in MCUs, a 4:2:2 or 4:2:0 MCU is 16 pixels wide.
+    int mcu_w = (subsampling == JPEG_SUBSAMPLING_444) ? JPEG_MCU_W : (JPEG_MCU_W * 2);
+    int restart_interval = restart_rows * ((src->w + mcu_w - 1) / mcu_w);
+
+    if (restart_interval > 0xFFFF) {
+        restart_rows = 0;
+        restart_interval = 0;
+    }
+
+    jpeg_write_headers(jpeg_buf, src->w, src->h, src->is_color ? 2 : 1, subsampling, restart_interval);
 
     int DCY = 0, DCU = 0, DCV = 0;
+    int restart_row = 0, restart_n = 0;
+    int mcu_h = (subsampling == JPEG_SUBSAMPLING_420) ? (JPEG_MCU_H * 2) : JPEG_MCU_H;
+    int mcu_row = 0, mcu_rows = (src->h + mcu_h - 1) / mcu_h;
+
+    jpeg_buf->ac_limit = 64;
+    jpeg_buf->rc_used = 0;
+    jpeg_buf->rc_projected = 0;
+    memset(jpeg_buf->rc_bands, 0, sizeof(jpeg_buf->rc_bands));
 
     switch (subsampling) {
         // Quiet GCC compiler warning (this is never reached)
@@ -1678,17 +1897,26 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc, jpeg_s
                     int dx = IM_MIN(JPEG_MCU_W, src->w - x_offset);
 
                     jpeg_get_mcu(src, x_offset, y_offset, dx, dy, YDU, UDU, VDU);
-                    DCY = jpeg_processDU(&jpeg_buf, YDU, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                    DCY = jpeg_processDU(jpeg_buf, YDU, &qtbl_Y, 0, DCY, YDC_HT, YAC_HT);
 
                     if (src->is_color) {
-                        DCU = jpeg_processDU(&jpeg_buf, UDU, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
-                        DCV = jpeg_processDU(&jpeg_buf, VDU, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
+                        DCU = jpeg_processDU(jpeg_buf, UDU, &qtbl_UV, 0, DCU, UVDC_HT, UVAC_HT);
+                        DCV = jpeg_processDU(jpeg_buf, VDU, &qtbl_UV, 0, DCV, UVDC_HT, UVAC_HT);
                     }
                 }
 
-                if (jpeg_buf.overflow) {
+                if (jpeg_buf->overflow) {
                     return true;
                 }
+
+                if (jpeg_buf->rc) {
+                    jpeg_rate_control_row(jpeg_buf, mcu_row++, mcu_rows);
+                }
+
+                if (restart_rows && (++restart_row == restart_rows) && ((y_offset + JPEG_MCU_H) < src->h)) {
+                    jpeg_write_restart(jpeg_buf, restart_n++);
+                    DCY = DCU = DCV = restart_row = 0;
+                }
             }
             break;
         }
@@ -1716,7 +1944,7 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc, jpeg_s
                             memset(VDU + i, 0, JPEG_444_GS_MCU_SIZE);
                         }
 
-                        DCY = jpeg_processDU(&jpeg_buf, YDU + i, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                        DCY = jpeg_processDU(jpeg_buf, YDU + i, &qtbl_Y, 0, DCY, YDC_HT, YAC_HT);
                     }
 
                     // horizontal subsampling of U & V
@@ -1774,10 +2002,10 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc, jpeg_s
                         VDU_avg[j + 7] = VDUp1_avg_76_54 >> 16;
                         #else
                         for (int i = 0; i < JPEG_MCU_W; i += 2) {
-                            UDU_avg[j + (i / 2)] = (UDUp0[i] + UDUp0[i + 1]) / 2;
-                            VDU_avg[j + (i / 2)] = (VDUp0[i] + VDUp0[i + 1]) / 2;
-                            UDU_avg[j + (i / 2) + (JPEG_MCU_W / 2)] = (UDUp1[i] + UDUp1[i + 1]) / 2;
-                            VDU_avg[j + (i / 2) + (JPEG_MCU_W / 2)] = (VDUp1[i] + VDUp1[i + 1]) / 2;
+                            UDU_avg[j + (i / 2)] = (UDUp0[i] + UDUp0[i + 1]) >> 1;
+                            VDU_avg[j + (i / 2)] = (VDUp0[i] + VDUp0[i + 1]) >> 1;
+                            UDU_avg[j + (i / 2) + (JPEG_MCU_W / 2)] = (UDUp1[i] + UDUp1[i + 1]) >> 1;
+                            VDU_avg[j + (i / 2) + (JPEG_MCU_W / 2)] = (VDUp1[i] + VDUp1[i + 1]) >> 1;
                         }
                         UDUp0 += JPEG_MCU_W;
                         VDUp0 += JPEG_MCU_W;
@@ -1786,13 +2014,22 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc, jpeg_s
                         #endif
                     }
 
-                    DCU = jpeg_processDU(&jpeg_buf, UDU_avg, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
-                    DCV = jpeg_processDU(&jpeg_buf, VDU_avg, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
+                    DCU = jpeg_processDU(jpeg_buf, UDU_avg, &qtbl_UV, JPEG_AVG2_DC_BIAS, DCU, UVDC_HT, UVAC_HT);
+                    DCV = jpeg_processDU(jpeg_buf, VDU_avg, &qtbl_UV, JPEG_AVG2_DC_BIAS, DCV, UVDC_HT, UVAC_HT);
                 }
 
-                if (jpeg_buf.overflow) {
+                if (jpeg_buf->overflow) {
                     return true;
                 }
+
+                if (jpeg_buf->rc) {
+                    jpeg_rate_control_row(jpeg_buf, mcu_row++, mcu_rows);
+                }
+
+                if (restart_rows && (++restart_row == restart_rows) && ((y_offset + JPEG_MCU_H) < src->h)) {
+                    jpeg_write_restart(jpeg_buf, restart_n++);
+                    DCY = DCU = DCV = restart_row = 0;
+                }
             }
             break;
         }
@@ -1822,7 +2059,7 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc, jpeg_s
                                 memset(VDU + i + j, 0, JPEG_444_GS_MCU_SIZE);
                             }
 
-                            DCY = jpeg_processDU(&jpeg_buf, YDU + i + j, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                            DCY = jpeg_processDU(jpeg_buf, YDU + i + j, &qtbl_Y, 0, DCY, YDC_HT, YAC_HT);
                         }
 
                         // Reset back two columns.
@@ -1895,22 +2132,14 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc, jpeg_s
                         VDUp += 4;
                         #else
                         for (int i = 0; i < JPEG_MCU_W; i += 2) {
-                            UDU_avg[j + (i / 2)] =
-                                (UDUp0[i] + UDUp0[i + 1] + UDUp0[i + JPEG_MCU_W] + UDUp0[i + 1 + JPEG_MCU_W]) / 4;
-                            VDU_avg[j + (i / 2)] =
-                                (VDUp0[i] + VDUp0[i + 1] + VDUp0[i + JPEG_MCU_W] + VDUp0[i + 1 + JPEG_MCU_W]) / 4;
-                            UDU_avg[j + (i / 2) + (JPEG_MCU_W / 2)] =
-                                (UDUp1[i] + UDUp1[i + 1] + UDUp1[i + JPEG_MCU_W] + UDUp1[i + 1 + JPEG_MCU_W]) / 4;
-                            VDU_avg[j + (i / 2) + (JPEG_MCU_W / 2)] =
-                                (VDUp1[i] + VDUp1[i + 1] + VDUp1[i + JPEG_MCU_W] + VDUp1[i + 1 + JPEG_MCU_W]) / 4;
-                            UDU_avg[k + (i / 2)] =
-                                (UDUp2[i] + UDUp2[i + 1] + UDUp2[i + JPEG_MCU_W] + UDUp2[i + 1 + JPEG_MCU_W]) / 4;
-                            VDU_avg[k + (i / 2)] =
-                                (VDUp2[i] + VDUp2[i + 1] + VDUp2[i + JPEG_MCU_W] + VDUp2[i + 1 + JPEG_MCU_W]) / 4;
-                            UDU_avg[k + (i / 2) + (JPEG_MCU_W / 2)] =
-                                (UDUp3[i] + UDUp3[i + 1] + UDUp3[i + JPEG_MCU_W] + UDUp3[i + 1 + JPEG_MCU_W]) / 4;
-                            VDU_avg[k + (i / 2) + (JPEG_MCU_W / 2)] =
-                                (VDUp3[i] + VDUp3[i + 1] + VDUp3[i + JPEG_MCU_W] + VDUp3[i + 1 + JPEG_MCU_W]) / 4;
+                            UDU_avg[j + (i / 2)] = jpeg_avg4(UDUp0 + i);
+                            VDU_avg[j + (i / 2)] = jpeg_avg4(VDUp0 + i);
+                            UDU_avg[j + (i / 2) + (JPEG_MCU_W / 2)] = jpeg_avg4(UDUp1 + i);
+                            VDU_avg[j + (i / 2) + (JPEG_MCU_W / 2)] = jpeg_avg4(VDUp1 + i);
+                            UDU_avg[k + (i / 2)] = jpeg_avg4(UDUp2 + i);
+                            VDU_avg[k + (i / 2)] = jpeg_avg4(VDUp2 + i);
+                            UDU_avg[k + (i / 2) + (JPEG_MCU_W / 2)] = jpeg_avg4(UDUp3 + i);
+                            VDU_avg[k + (i / 2) + (JPEG_MCU_W / 2)] = jpeg_avg4(VDUp3 + i);
                         }
                         UDUp0 += JPEG_MCU_W * 2;
                         VDUp0 += JPEG_MCU_W * 2;
@@ -1923,16 +2152,25 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc, jpeg_s
                         #endif
                     }
 
-                    DCU = jpeg_processDU(&jpeg_buf, UDU_avg, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
-                    DCV = jpeg_processDU(&jpeg_buf, VDU_avg, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
+                    DCU = jpeg_processDU(jpeg_buf, UDU_avg, &qtbl_UV, JPEG_AVG4_DC_BIAS, DCU, UVDC_HT, UVAC_HT);
+                    DCV = jpeg_processDU(jpeg_buf, VDU_avg, &qtbl_UV, JPEG_AVG4_DC_BIAS, DCV, UVDC_HT, UVAC_HT);
                 }
 
-                if (jpeg_buf.overflow) {
+                if (jpeg_buf->overflow) {
                     return true;
                 }
 
                 // Advance to the next rows.
                 y_offset += (JPEG_MCU_H * 2);
+
+                if (jpeg_buf->rc) {
+                    jpeg_rate_control_row(jpeg_buf, mcu_row++, mcu_rows);
+                }
+
+                if (restart_rows && (++restart_row == restart_rows) && (y_offset < src->h)) {
+                    jpeg_write_restart(jpeg_buf, restart_n++);
+                    DCY = DCU = DCV = restart_row = 0;
+                }
             }
             break;
         }
@@ -1940,11 +2178,48 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc, jpeg_s
 
     // Do the bit alignment of the EOI marker
     static const uint16_t fillBits[] = {0x7F, 7};
-    jpeg_writeBits(&jpeg_buf, fillBits);
+    jpeg_writeBits(jpeg_buf, fillBits);
 
     // EOI
-    jpeg_put_char(&jpeg_buf, 0xFF);
-    jpeg_put_char(&jpeg_buf, 0xD9);
+    jpeg_put_char(jpeg_buf, 0xFF);
+    jpeg_put_char(jpeg_buf, 0xD9);
+
+    if (jpeg_buf->sink) {
+        jpeg_flush_chunk(jpeg_buf);
+    }
+
+    return jpeg_buf->overflow;
+}
+
+bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc, jpeg_subsampling_t subsampling) {
+    #if (TIME_JPEG == 1)
+    mp_uint_t start = mp_hal_ticks_ms();
+    #endif
+
+    if (!dst->data) {
+        uint32_t size = 0;
+        dst->data = fb_alloc_all(&size, FB_ALLOC_PREFER_SIZE | FB_ALLOC_CACHE_ALIGN);
+        dst->size = IMLIB_IMAGE_MAX_SIZE(size);
+    }
+
+    if (src->is_compressed) {
+        return true;
+    }
+
+    // JPEG buffer
+    jpeg_buf_t jpeg_buf = {
+        .idx = 0,
+        .buf = dst->pixels,
+        .length = dst->size,
+        .bitc = 0,
+        .bitb = 0,
+        .realloc = realloc,
+        .overflow = false,
+    };
+
+    if (jpeg_encode(src, &jpeg_buf, quality, subsampling, 0)) {
+        return true;
+    }
 
     dst->size = jpeg_buf.idx;
     dst->data = jpeg_buf.buf;
@@ -1956,6 +2231,84 @@ bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc, jpeg_s
     return false;
 }
 
+bool jpeg_compress_rc(image_t *src, image_t *dst, jpeg_rate_control_t *rc, bool realloc,
+                      jpeg_subsampling_t subsampling) {
+    if (!dst->data) {
+        uint32_t size = 0;
+        dst->data = fb_alloc_all(&size, FB_ALLOC_PREFER_SIZE | FB_ALLOC_CACHE_ALIGN);
+        dst->size = IMLIB_IMAGE_MAX_SIZE(size);
+    }
+
+    if (src->is_compressed) {
+        return true;
+    }
+
+    jpeg_buf_t jpeg_buf = {
+        .idx = 0,
+        .buf = dst->pixels,
+        .length = dst->size,
+        .bitc = 0,
+        .bitb = 0,
+        .realloc = realloc,
+        .overflow = false,
+        .rc = rc,
+    };
+
+    int quality = rc->quality;
+    bool overflow = jpeg_encode(src, &jpeg_buf, quality, subsampling, 0);
+    jpeg_rate_control_frame(&jpeg_buf, quality, overflow);
+
+    if (overflow) {
+        return true;
+    }
+
+    dst->size = jpeg_buf.idx;
+    dst->data = jpeg_buf.buf;
+    return false;
+}
+
+void jpeg_rate_control_init(jpeg_rate_control_t *rc, uint32_t target) {
+    memset(rc, 0, sizeof(jpeg_rate_control_t));
+    rc->target = target;
+    rc->quality = 50;
+    rc->min_quality = 5;
+    rc->max_quality = 95;
+}
+
+bool jpeg_compress_stream(image_t *src, int quality, jpeg_rate_control_t *rc, jpeg_subsampling_t subsampling,
+                          int restart_rows, uint8_t *buf, uint32_t size, jpeg_sink_t sink, void *sink_arg) {
+    if (src->is_compressed || (size < (JPEG_STREAM_MIN_CHUNK * 2))) {
+        return true;
+    }
+
+    jpeg_buf_t jpeg_buf = {
+        .idx = 0,
+        .buf = buf,
+        .length = size / 2,
+        .bitc = 0,
+        .bitb = 0,
+        .realloc = false,
+        .overflow = false,
+        .sink = sink,
+        .sink_arg = sink_arg,
+        .chunks = { buf, buf + (size / 2) },
+        .chunk = 0,
+        .rc = rc,
+    };
+
+    if (rc) {
+        quality = rc->quality;
+    }
+
+    // Only the sink can abort a stream, in which case the frame says nothing about the rate.
+    bool aborted = jpeg_encode(src, &jpeg_buf, quality, subsampling, restart_rows);
+    if (rc && (!aborted)) {
+        jpeg_rate_control_frame(&jpeg_buf, quality, false);
+    }
+
+    return aborted;
+}
+
 #endif // (OMV_JPEG_CODEC_ENABLE == 0)
 
 bool jpeg_is_valid(image_t *img) {
@@ -524,20 +524,37 @@ static inline uint32_t popcount(uint32_t i) {
     return (((i + (i >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
 }
 
-static kp_t *find_best_match(kp_t *kp1, array_t *kpts, int *dist_out1, int *dist_out2, int *index) {
+// Returns the descriptor distance, or a partial distance >= limit once it can't be below it.
+static inline int desc_dist(const kp_t *kp1, const kp_t *kp2, int limit) {
+    const uint32_t *desc1 = (const uint32_t *) kp1->desc;
+    const uint32_t *desc2 = (const uint32_t *) kp2->desc;
+    int dist = 0;
+
+    // Checking the limit once per half rejects most keypoints without adding branches to every word.
+    for (int m = 0; m < (KDESC_SIZE / 4); m += 4) {
+        dist += popcount(desc1[m + 0] ^ desc2[m + 0]);
+        dist += popcount(desc1[m + 1] ^ desc2[m + 1]);
+        dist += popcount(desc1[m + 2] ^ desc2[m + 2]);
+        dist += popcount(desc1[m + 3] ^ desc2[m + 3]);
+        if (dist >= limit) {
+            break;
+        }
+    }
+
+    return dist;
+}
+
+static kp_t *find_best_match(kp_t *kp1, array_t *kpts, int limit, int *dist_out1, int *dist_out2, int *index) {
     kp_t *min_kp = NULL;
-    int min_dist1 = MAX_KP_DIST;
-    int min_dist2 = MAX_KP_DIST;
+    int min_dist1 = limit;
+    int min_dist2 = limit;
     int kpts_size = array_length(kpts);
 
     for (int i = 0; i < kpts_size; i++) {
-        int dist = 0;
         kp_t *kp2 = array_at(kpts, i);
 
         if (kp2->matched == 0) {
-            for (int m = 0; m < (KDESC_SIZE / 4); m++) {
-                dist += popcount(((uint32_t *) (kp1->desc))[m] ^ ((uint32_t *) (kp2->desc))[m]);
-            }
+            int dist = desc_dist(kp1, kp2, min_dist1);
 
             if (dist < min_dist1) {
                 *index = i;
@@ -553,6 +570,34 @@ static kp_t *find_best_match(kp_t *kp1, array_t *kpts, int *dist_out1, int *dist
     return min_kp;
 }
 
+// Returns the best match of kp1 in kpts if it passes the distance ratio test, NULL otherwise. If the
+// distance of some unmatched keypoint in kpts is known (bound), the search only needs the distances
+// below the smallest second distance that passes the ratio test for any best distance up to bound,
+// so most keypoints are rejected after the first words of the descriptor.
+static kp_t *find_good_match(kp_t *kp1, array_t *kpts, int bound, int threshold, int *index, int *dist_out) {
+    int min_dist1 = 0;
+    int min_dist2 = 0;
+    int limit = MAX_KP_DIST;
+    kp_t *min_kp = NULL;
+
+    if (bound < MAX_KP_DIST) {
+        limit = IM_MIN(IM_MAX((bound * 100 / (threshold + 1)) + 1, bound + 1), MAX_KP_DIST);
+        min_kp = find_best_match(kp1, kpts, limit, &min_dist1, &min_dist2, index);
+    }
+
+    if (min_kp == NULL) {
+        min_kp = find_best_match(kp1, kpts, MAX_KP_DIST, &min_dist1, &min_dist2, index);
+    }
+
+    // Test the distance ratio between the best two matches
+    if ((min_kp == NULL) || ((min_dist1 * 100 / min_dist2) > threshold)) {
+        return NULL;
+    }
+
+    *dist_out = min_dist1;
+    return min_kp;
+}
+
 int orb_match_keypoints(array_t *kpts1, array_t *kpts2, int *match, int threshold, rectangle_t *r, point_t *c, int *angle) {
     int matches = 0;
     int cx = 0, cy = 0;
@@ -568,22 +613,18 @@ int orb_match_keypoints(array_t *kpts1, array_t *kpts2, int *match, int threshol
     for (int i = 0; i < kpts1_size; i++) {
         int kp_index1 = 0;
         int kp_index2 = 0;
-        int min_dist1 = 0;
-        int min_dist2 = 0;
-        kp_t *min_kp = NULL;
+        int min_dist = 0;
         kp_t *kp1 = array_at(kpts1, i);
 
         // Find the best match in second set
-        min_kp = find_best_match(kp1, kpts2, &min_dist1, &min_dist2, &kp_index2);
-        // Test the distance ratio between the best two matches
-        if ((min_dist1 * 100 / min_dist2) > threshold) {
+        kp_t *min_kp = find_good_match(kp1, kpts2, MAX_KP_DIST, threshold, &kp_index2, &min_dist);
+        if (min_kp == NULL) {
             continue;
         }
 
-        // Cross-match the keypoint in the first set
-        kp_t *kp2 = find_best_match(min_kp, kpts1, &min_dist1, &min_dist2, &kp_index1);
-        // Test the distance ratio between the best two matches
-        if ((min_dist1 * 100 / min_dist2) > threshold) {
+        // Cross-match the keypoint in the first set, kp1 is at min_dist.
+        kp_t *kp2 = find_good_match(min_kp, kpts1, min_dist, threshold, &kp_index1, &min_dist);
+        if (kp2 == NULL) {
             continue;
         }
 
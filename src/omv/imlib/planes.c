@@ -0,0 +1,181 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Derived image planes.
+ *
+ * Grayscale and integral planes computed once per image and shared by the algorithms that need
+ * them. The planes live on the heap so that they outlive the fb_alloc() stack of the call that
+ * computed them. Callers fall back to converting into their own buffers when a plane cannot be
+ * allocated or does not fit in the size limit of the planes.
+ */
+#include "imlib.h"
+
+void imlib_planes_init(image_planes_t *planes) {
+    memset(planes, 0, sizeof(image_planes_t));
+}
+
+// Frees the plane buffers. The size limit is kept.
+void imlib_planes_free(image_planes_t *planes) {
+    if (!planes) {
+        return;
+    }
+
+    if (planes->grayscale) {
+        xfree(planes->grayscale);
+    }
+
+    if (planes->sum.data) {
+        xfree(planes->sum.data);
+    }
+
+    if (planes->sumsq.data) {
+        xfree(planes->sumsq.data);
+    }
+
+    uint32_t max_size = planes->max_size;
+    imlib_planes_init(planes);
+    planes->max_size = max_size;
+}
+
+static void *imlib_planes_alloc(image_planes_t *planes, uint32_t size) {
+    if (planes->max_size && ((planes->size + size) > planes->max_size)) {
+        return NULL;
+    }
+
+    void *ptr = xalloc_try_alloc(size);
+
+    if (ptr) {
+        planes->size += size;
+    }
+
+    return ptr;
+}
+
+// Drops the planes derived from img, or all planes if img is NULL.
+void imlib_planes_invalidate(image_planes_t *planes, image_t *img) {
+    if (planes && ((!img) || (planes->img.data == img->data))) {
+        planes->valid = 0;
+    }
+}
+
+// Rekeys the planes to img. The buffers are kept if the size did not change.
+static void imlib_planes_update(image_planes_t *planes, image_t *img) {
+    if ((planes->img.w != img->w) || (planes->img.h != img->h)) {
+        imlib_planes_free(planes);
+    } else if ((planes->img.data != img->data) || (planes->img.pixfmt != img->pixfmt)) {
+        planes->valid = 0;
+    }
+
+    planes->img = *img;
+}
+
+// Returns the grayscale plane of img which is img itself for grayscale images. Returns NULL if the
+// plane cannot be allocated.
+uint8_t *imlib_planes_grayscale(image_planes_t *planes, image_t *img) {
+    if (img->pixfmt == PIXFORMAT_GRAYSCALE) {
+        return img->data;
+    }
+
+    if (!planes) {
+        return NULL;
+    }
+
+    imlib_planes_update(planes, img);
+
+    if (!(planes->valid & IMAGE_PLANE_GRAYSCALE)) {
+        if ((!planes->grayscale) && (!(planes->grayscale = imlib_planes_alloc(planes, img->w * img->h)))) {
+            return NULL;
+        }
+
+        image_t dst = {
+            .w = img->w,
+            .h = img->h,
+            .pixfmt = PIXFORMAT_GRAYSCALE,
+            .data = planes->grayscale
+        };
+
+        imlib_draw_image(&dst, img, 0, 0, 1.f, 1.f, NULL, -1, 256, NULL, NULL, 0, NULL, NULL, NULL);
+        planes->valid |= IMAGE_PLANE_GRAYSCALE;
+    }
+
+    return planes->grayscale;
+}
+
+// Copies the roi of the grayscale plane to data (roi->w * roi->h bytes). Converts the roi directly
+// if there's no plane.
+void imlib_planes_grayscale_roi(image_planes_t *planes, image_t *img, rectangle_t *roi, uint8_t *data) {
+    uint8_t *plane = imlib_planes_grayscale(planes, img);
+
+    if (plane) {
+        for (int y = 0; y < roi->h; y++) {
+            memcpy(data + (y * roi->w), plane + ((roi->y + y) * img->w) + roi->x, roi->w);
+        }
+    } else {
+        image_t dst = {
+            .w = roi->w,
+            .h = roi->h,
+            .pixfmt = PIXFORMAT_GRAYSCALE,
+            .data = data
+        };
+
+        imlib_draw_image(&dst, img, 0, 0, 1.f, 1.f, roi, -1, 256, NULL, NULL, 0, NULL, NULL, NULL);
+    }
+}
+
+static i_image_t *imlib_planes_integral_plane(image_planes_t *planes, image_t *img, image_plane_t plane) {
+    if (!planes) {
+        return NULL;
+    }
+
+    image_t src = {
+        .w = img->w,
+        .h = img->h,
+        .pixfmt = PIXFORMAT_GRAYSCALE,
+        .data = imlib_planes_grayscale(planes, img)
+    };
+
+    if (!src.data) {
+        return NULL;
+    }
+
+    // Grayscale images are not rekeyed by imlib_planes_grayscale().
+    imlib_planes_update(planes, img);
+
+    i_image_t *sum = (plane == IMAGE_PLANE_SUM) ? &planes->sum : &planes->sumsq;
+
+    if (!(planes->valid & plane)) {
+        if (!sum->data) {
+            if (!(sum->data = imlib_planes_alloc(planes, img->w * img->h * sizeof(*sum->data)))) {
+                return NULL;
+            }
+
+            sum->w = img->w;
+            sum->h = img->h;
+        }
+
+        if (plane == IMAGE_PLANE_SUM) {
+            imlib_integral_image(&src, sum);
+        } else {
+            imlib_integral_image_sq(&src, sum);
+        }
+
+        planes->valid |= plane;
+    }
+
+    return sum;
+}
+
+// Returns the integral image of the grayscale plane of img or NULL if it cannot be allocated.
+i_image_t *imlib_planes_integral(image_planes_t *planes, image_t *img) {
+    return imlib_planes_integral_plane(planes, img, IMAGE_PLANE_SUM);
+}
+
+// Returns the squared integral image of the grayscale plane of img or NULL if it cannot be allocated.
+i_image_t *imlib_planes_integral_sq(image_planes_t *planes, image_t *img) {
+    return imlib_planes_integral_plane(planes, img, IMAGE_PLANE_SUMSQ);
+}
@@ -2957,18 +2957,12 @@ const char *quirc_strerror(quirc_decode_error_t err)
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void imlib_find_qrcodes(list_t *out, image_t *ptr, rectangle_t *roi)
+void imlib_find_qrcodes(list_t *out, image_t *ptr, rectangle_t *roi, image_planes_t *planes)
 {
     struct quirc *controller = quirc_new();
     quirc_resize(controller, roi->w, roi->h);
     uint8_t *grayscale_image = quirc_begin(controller, NULL, NULL);
-
-    image_t img;
-    img.w = roi->w;
-    img.h = roi->h;
-    img.pixfmt = PIXFORMAT_GRAYSCALE;
-    img.data = grayscale_image;
-    imlib_draw_image(&img, ptr, 0, 0, 1.f, 1.f, roi, -1, 256, NULL, NULL, 0, NULL, NULL, NULL);
+    imlib_planes_grayscale_roi(planes, ptr, roi, grayscale_image);
 
     quirc_end(controller);
     list_init(out, sizeof(find_qrcodes_list_lnk_data_t));
@@ -154,7 +154,8 @@ void imlib_get_similarity(image_t *img,
 }
 #endif //IMLIB_ENABLE_GET_SIMILARITY
 
-void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_t *thresholds, bool invert, image_t *other) {
+void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_t *thresholds,
+                         color_thresholds_bitmap_t *bitmap, bool invert, image_t *other) {
     switch (ptr->pixfmt) {
         case PIXFORMAT_BINARY: {
             memset(out->LBins, 0, out->LBinCount * sizeof(uint32_t));
@@ -346,14 +347,16 @@ void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_
                 // Reset pixel count.
                 pixel_count = 0;
                 if (!other) {
+                    size_t index = 0;
                     list_for_each(it, thresholds) {
                         color_thresholds_list_lnk_data_t *lnk_data = list_get_data(it);
+                        uint32_t *bits = bitmap ? COLOR_THRESHOLDS_BITMAP_GET(bitmap, index++) : NULL;
 
                         for (int y = roi->y, yy = roi->y + roi->h; y < yy; y++) {
                             uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, y);
                             for (int x = roi->x, xx = roi->x + roi->w; x < xx; x++) {
                                 int pixel = IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x);
-                                if (COLOR_THRESHOLD_RGB565(pixel, lnk_data, invert)) {
+                                if (COLOR_THRESHOLD_RGB565_BITMAP(pixel, lnk_data, bits, invert)) {
                                     ((uint32_t *) out->LBins)[fast_roundf((COLOR_RGB565_TO_L(pixel) - COLOR_L_MIN) * l_mult)]++;
                                     ((uint32_t *) out->ABins)[fast_roundf((COLOR_RGB565_TO_A(pixel) - COLOR_A_MIN) * a_mult)]++;
                                     ((uint32_t *) out->BBins)[fast_roundf((COLOR_RGB565_TO_B(pixel) - COLOR_B_MIN) * b_mult)]++;
@@ -363,8 +366,10 @@ void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_
                         }
                     }
                 } else {
+                    size_t index = 0;
                     list_for_each(it, thresholds) {
                         color_thresholds_list_lnk_data_t *lnk_data = list_get_data(it);
+                        uint32_t *bits = bitmap ? COLOR_THRESHOLDS_BITMAP_GET(bitmap, index++) : NULL;
 
                         for (int y = roi->y, yy = roi->y + roi->h; y < yy; y++) {
                             uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, y),
@@ -376,7 +381,7 @@ void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_
                                 int g = abs(COLOR_RGB565_TO_G6(pixel) - COLOR_RGB565_TO_G6(other_pixel));
                                 int b = abs(COLOR_RGB565_TO_B5(pixel) - COLOR_RGB565_TO_B5(other_pixel));
                                 pixel = COLOR_R5_G6_B5_TO_RGB565(r, g, b);
-                                if (COLOR_THRESHOLD_RGB565(pixel, lnk_data, invert)) {
+                                if (COLOR_THRESHOLD_RGB565_BITMAP(pixel, lnk_data, bits, invert)) {
                                     ((uint32_t *) out->LBins)[fast_roundf((COLOR_RGB565_TO_L(pixel) - COLOR_L_MIN) * l_mult)]++;
                                     ((uint32_t *) out->ABins)[fast_roundf((COLOR_RGB565_TO_A(pixel) - COLOR_A_MIN) * a_mult)]++;
                                     ((uint32_t *) out->BBins)[fast_roundf((COLOR_RGB565_TO_B(pixel) - COLOR_B_MIN) * b_mult)]++;
@@ -410,6 +415,315 @@ void imlib_get_histogram(histogram_t *out, image_t *ptr, rectangle_t *roi, list_
     }
 }
 
+// Tiled histogram cache.
+//
+// The image is split into tile x tile cells and every cell stores a count per channel bin
+// (COLOR_BINARY/GRAYSCALE bins, or L, A and B bins back to back for RGB565). The counts along a
+// tile row are stored as a running sum so the histogram of a run of whole tiles is one subtraction
+// per bin. A query adds the whole tile rows covered by the ROI and only scans the partial tiles
+// along the ROI border, so the cost is O(perimeter + tile rows * bins) instead of O(area).
+//
+// By default there is a bin per raw channel value (613 for RGB565, so 368KB with 16x16 tiles for a
+// QVGA image). Fewer bins make the cache smaller, but it can then only answer queries for the
+// same bin counts, other queries scan the ROI like imlib_get_histogram() does.
+//
+// The counts are uint16_t and wrap. This is fine as long as the difference between two running
+// sums fits in 16 bits, which is guaranteed by keeping tile * width below 64K.
+static int histogram_cache_channel_bins(int bins, int min, int max) {
+    return ((bins > 0) && (bins < (max - min + 1))) ? bins : (max - min + 1);
+}
+
+// Maps the raw values of a channel to bins the same way imlib_get_histogram() does.
+static void histogram_cache_channel_lut(uint8_t *lut, int bins, int min, int max) {
+    float mult = (bins - 1) / ((float) (max - min));
+
+    for (int i = 0, ii = max - min + 1; i < ii; i++) {
+        lut[i] = fast_roundf(i * mult);
+    }
+}
+
+// Returns the total bin count and the count per channel in bins.
+static int histogram_cache_bins(pixformat_t pixfmt, int l_bins, int a_bins, int b_bins, int *bins) {
+    bins[0] = bins[1] = bins[2] = 0;
+
+    switch (pixfmt) {
+        case PIXFORMAT_BINARY: {
+            bins[0] = histogram_cache_channel_bins(l_bins, COLOR_BINARY_MIN, COLOR_BINARY_MAX);
+            break;
+        }
+        case PIXFORMAT_GRAYSCALE: {
+            bins[0] = histogram_cache_channel_bins(l_bins, COLOR_GRAYSCALE_MIN, COLOR_GRAYSCALE_MAX);
+            break;
+        }
+        case PIXFORMAT_RGB565: {
+            bins[0] = histogram_cache_channel_bins(l_bins, COLOR_L_MIN, COLOR_L_MAX);
+            bins[1] = histogram_cache_channel_bins(a_bins, COLOR_A_MIN, COLOR_A_MAX);
+            bins[2] = histogram_cache_channel_bins(b_bins, COLOR_B_MIN, COLOR_B_MAX);
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+
+    return bins[0] + bins[1] + bins[2];
+}
+
+// Adds the bins of the pixels in [x0, x1) x [y0, y1) to counts.
+static void histogram_cache_scan(histogram_cache_t *cache, int x0, int x1, int y0, int y1, uint32_t *counts) {
+    image_t *ptr = &cache->img;
+
+    switch (ptr->pixfmt) {
+        case PIXFORMAT_BINARY: {
+            uint8_t *lut = cache->lut - COLOR_BINARY_MIN;
+            for (int y = y0; y < y1; y++) {
+                uint32_t *row_ptr = IMAGE_COMPUTE_BINARY_PIXEL_ROW_PTR(ptr, y);
+                for (int x = x0; x < x1; x++) {
+                    counts[lut[IMAGE_GET_BINARY_PIXEL_FAST(row_ptr, x)]]++;
+                }
+            }
+            break;
+        }
+        case PIXFORMAT_GRAYSCALE: {
+            uint8_t *lut = cache->lut - COLOR_GRAYSCALE_MIN;
+            for (int y = y0; y < y1; y++) {
+                uint8_t *row_ptr = IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(ptr, y);
+                for (int x = x0; x < x1; x++) {
+                    counts[lut[IMAGE_GET_GRAYSCALE_PIXEL_FAST(row_ptr, x)]]++;
+                }
+            }
+            break;
+        }
+        case PIXFORMAT_RGB565: {
+            uint8_t *l_lut = cache->lut - COLOR_L_MIN;
+            uint8_t *a_lut = cache->lut + (COLOR_L_MAX - COLOR_L_MIN + 1) - COLOR_A_MIN;
+            uint8_t *b_lut = a_lut + COLOR_A_MIN + (COLOR_A_MAX - COLOR_A_MIN + 1) - COLOR_B_MIN;
+            uint32_t *a_counts = counts + cache->l_bins;
+            uint32_t *b_counts = a_counts + cache->a_bins;
+            for (int y = y0; y < y1; y++) {
+                uint16_t *row_ptr = IMAGE_COMPUTE_RGB565_PIXEL_ROW_PTR(ptr, y);
+                for (int x = x0; x < x1; x++) {
+                    int pixel = IMAGE_GET_RGB565_PIXEL_FAST(row_ptr, x);
+                    counts[l_lut[COLOR_RGB565_TO_L(pixel)]]++;
+                    a_counts[a_lut[COLOR_RGB565_TO_A(pixel)]]++;
+                    b_counts[b_lut[COLOR_RGB565_TO_B(pixel)]]++;
+                }
+            }
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+// True if cache_bins counts of a channel can be turned into bin_count bins.
+static bool histogram_cache_channel_exact(int cache_bins, int bin_count, int min, int max) {
+    return (cache_bins == (max - min + 1)) || (cache_bins == bin_count);
+}
+
+// Bins the counts of a channel the same way imlib_get_histogram() does, the counts are either
+// per raw value or already binned to bin_count bins. Returns the pixel count.
+static uint32_t histogram_cache_bin(float *bins, int bin_count, int cache_bins, uint32_t *counts, uint8_t *weights) {
+    float mult = (bin_count - 1) / ((float) (cache_bins - 1));
+    uint32_t pixel_count = 0;
+    memset(bins, 0, bin_count * sizeof(uint32_t));
+
+    for (int i = 0; i < cache_bins; i++) {
+        uint32_t count = weights ? (counts[i] * weights[i]) : counts[i];
+        ((uint32_t *) bins)[fast_roundf(i * mult)] += count;
+        pixel_count += count;
+    }
+
+    return pixel_count;
+}
+
+static void histogram_cache_normalize(float *bins, int bin_count, float pixels) {
+    for (int i = 0; i < bin_count; i++) {
+        bins[i] = ((uint32_t *) bins)[i] * pixels;
+    }
+}
+
+size_t imlib_histogram_cache_size(image_t *ptr, int tile, int l_bins, int a_bins, int b_bins) {
+    int bins[3];
+    int tiles_w = (ptr->w + tile - 1) / tile;
+    int tiles_h = (ptr->h + tile - 1) / tile;
+    return tiles_w * tiles_h * histogram_cache_bins(ptr->pixfmt, l_bins, a_bins, b_bins, bins) * sizeof(uint16_t);
+}
+
+void imlib_histogram_cache_init(histogram_cache_t *cache, image_t *ptr, int tile,
+                                int l_bins, int a_bins, int b_bins, uint16_t *counts) {
+    int bins[3];
+    cache->tile = tile;
+    cache->tiles_w = (ptr->w + tile - 1) / tile;
+    cache->tiles_h = (ptr->h + tile - 1) / tile;
+    cache->values = histogram_cache_bins(ptr->pixfmt, l_bins, a_bins, b_bins, bins);
+    cache->l_bins = bins[0];
+    cache->a_bins = bins[1];
+    cache->b_bins = bins[2];
+    cache->counts = counts;
+
+    switch (ptr->pixfmt) {
+        case PIXFORMAT_BINARY: {
+            histogram_cache_channel_lut(cache->lut, bins[0], COLOR_BINARY_MIN, COLOR_BINARY_MAX);
+            break;
+        }
+        case PIXFORMAT_GRAYSCALE: {
+            histogram_cache_channel_lut(cache->lut, bins[0], COLOR_GRAYSCALE_MIN, COLOR_GRAYSCALE_MAX);
+            break;
+        }
+        case PIXFORMAT_RGB565: {
+            uint8_t *a_lut = cache->lut + (COLOR_L_MAX - COLOR_L_MIN + 1);
+            uint8_t *b_lut = a_lut + (COLOR_A_MAX - COLOR_A_MIN + 1);
+            histogram_cache_channel_lut(cache->lut, bins[0], COLOR_L_MIN, COLOR_L_MAX);
+            histogram_cache_channel_lut(a_lut, bins[1], COLOR_A_MIN, COLOR_A_MAX);
+            histogram_cache_channel_lut(b_lut, bins[2], COLOR_B_MIN, COLOR_B_MAX);
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+
+    imlib_histogram_cache_update(cache, ptr);
+}
+
+void imlib_histogram_cache_update(histogram_cache_t *cache, image_t *ptr) {
+    memcpy(&cache->img, ptr, sizeof(image_t));
+
+    int tile = cache->tile, values = cache->values;
+    uint32_t *sum = fb_alloc(values * sizeof(uint32_t), FB_ALLOC_PREFER_SPEED);
+    uint16_t *counts = cache->counts;
+
+    for (int y = 0; y < ptr->h; y += tile) {
+        memset(sum, 0, values * sizeof(uint32_t));
+
+        // sum carries the running total along the tile row.
+        for (int x = 0; x < ptr->w; x += tile, counts += values) {
+            histogram_cache_scan(cache, x, IM_MIN(x + tile, ptr->w), y, IM_MIN(y + tile, ptr->h), sum);
+
+            for (int i = 0; i < values; i++) {
+                counts[i] = sum[i];
+            }
+        }
+    }
+
+    fb_free(); // sum
+}
+
+void imlib_histogram_cache_get_histogram(histogram_t *out, histogram_cache_t *cache, rectangle_t *roi,
+                                         list_t *thresholds, bool invert) {
+    image_t *ptr = &cache->img;
+    bool threshold = thresholds && list_size(thresholds);
+    bool binary = ptr->pixfmt == PIXFORMAT_BINARY;
+    int min = binary ? COLOR_BINARY_MIN : COLOR_GRAYSCALE_MIN;
+    int max = binary ? COLOR_BINARY_MAX : COLOR_GRAYSCALE_MAX;
+    bool exact;
+
+    // Joint LAB thresholds cannot be applied to per channel counts and grayscale thresholds
+    // need a count per raw value.
+    if (ptr->pixfmt == PIXFORMAT_RGB565) {
+        exact = (!threshold)
+                && histogram_cache_channel_exact(cache->l_bins, out->LBinCount, COLOR_L_MIN, COLOR_L_MAX)
+                && histogram_cache_channel_exact(cache->a_bins, out->ABinCount, COLOR_A_MIN, COLOR_A_MAX)
+                && histogram_cache_channel_exact(cache->b_bins, out->BBinCount, COLOR_B_MIN, COLOR_B_MAX);
+    } else {
+        exact = threshold ?
+                (cache->l_bins == (max - min + 1)) :
+                histogram_cache_channel_exact(cache->l_bins, out->LBinCount, min, max);
+    }
+
+    if (!exact) {
+        imlib_get_histogram(out, ptr, roi, thresholds, NULL, invert, NULL);
+        return;
+    }
+
+    int tile = cache->tile, values = cache->values;
+    int roi_x_end = roi->x + roi->w, roi_y_end = roi->y + roi->h;
+
+    // Whole tiles inside the ROI (tiles on the right/bottom image edge may be short).
+    int tx0 = (roi->x + tile - 1) / tile;
+    int ty0 = (roi->y + tile - 1) / tile;
+    int tx1 = (roi_x_end == ptr->w) ? cache->tiles_w : (roi_x_end / tile);
+    int ty1 = (roi_y_end == ptr->h) ? cache->tiles_h : (roi_y_end / tile);
+
+    uint32_t *counts = fb_alloc0(values * sizeof(uint32_t), FB_ALLOC_PREFER_SPEED);
+
+    if ((tx0 < tx1) && (ty0 < ty1)) {
+        int x0 = tx0 * tile, x1 = IM_MIN(tx1 * tile, ptr->w);
+        int y0 = ty0 * tile, y1 = IM_MIN(ty1 * tile, ptr->h);
+
+        for (int ty = ty0; ty < ty1; ty++) {
+            uint16_t *row = cache->counts + (ty * cache->tiles_w * values);
+            uint16_t *hi = row + ((tx1 - 1) * values);
+
+            if (tx0) {
+                uint16_t *lo = row + ((tx0 - 1) * values);
+                for (int i = 0; i < values; i++) {
+                    counts[i] += (uint16_t) (hi[i] - lo[i]);
+                }
+            } else {
+                for (int i = 0; i < values; i++) {
+                    counts[i] += hi[i];
+                }
+            }
+        }
+
+        histogram_cache_scan(cache, roi->x, roi_x_end, roi->y, y0, counts);
+        histogram_cache_scan(cache, roi->x, roi_x_end, y1, roi_y_end, counts);
+        histogram_cache_scan(cache, roi->x, x0, y0, y1, counts);
+        histogram_cache_scan(cache, x1, roi_x_end, y0, y1, counts);
+    } else {
+        histogram_cache_scan(cache, roi->x, roi_x_end, roi->y, roi_y_end, counts);
+    }
+
+    switch (ptr->pixfmt) {
+        case PIXFORMAT_BINARY:
+        case PIXFORMAT_GRAYSCALE: {
+            uint8_t *weights = NULL;
+
+            // A pixel is counted once per threshold it matches like imlib_get_histogram().
+            if (threshold) {
+                weights = fb_alloc0(values, FB_ALLOC_NO_HINT);
+                for (int i = 0; i < values; i++) {
+                    list_for_each(it, thresholds) {
+                        color_thresholds_list_lnk_data_t *lnk_data = list_get_data(it);
+                        int pixel = i + min;
+                        weights[i] += binary ?
+                                      COLOR_THRESHOLD_BINARY(pixel, lnk_data, invert) :
+                                      COLOR_THRESHOLD_GRAYSCALE(pixel, lnk_data, invert);
+                    }
+                }
+            }
+
+            uint32_t pixel_count = histogram_cache_bin(out->LBins, out->LBinCount, cache->l_bins, counts, weights);
+            histogram_cache_normalize(out->LBins, out->LBinCount, IM_DIV(1, ((float) pixel_count)));
+
+            if (weights) {
+                fb_free(); // weights
+            }
+            break;
+        }
+        case PIXFORMAT_RGB565: {
+            uint32_t *a_counts = counts + cache->l_bins;
+            uint32_t *b_counts = a_counts + cache->a_bins;
+            float pixels = IM_DIV(1, ((float) (roi->w * roi->h)));
+            histogram_cache_bin(out->LBins, out->LBinCount, cache->l_bins, counts, NULL);
+            histogram_cache_bin(out->ABins, out->ABinCount, cache->a_bins, a_counts, NULL);
+            histogram_cache_bin(out->BBins, out->BBinCount, cache->b_bins, b_counts, NULL);
+            histogram_cache_normalize(out->LBins, out->LBinCount, pixels);
+            histogram_cache_normalize(out->ABins, out->ABinCount, pixels);
+            histogram_cache_normalize(out->BBins, out->BBinCount, pixels);
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+
+    fb_free(); // counts
+}
+
 void imlib_get_percentile(percentile_t *out, pixformat_t pixfmt, histogram_t *ptr, float percentile) {
     memset(out, 0, sizeof(percentile_t));
     switch (pixfmt) {
@@ -118,13 +118,18 @@ static float find_block_ncc(image_t *f, image_t *t, i_image_t *sum, int t_mean,
     return (num / (fast_sqrtf(f_sumsq) * fast_sqrtf(t_sumsq)));
 }
 
-float imlib_template_match_ds(image_t *f, image_t *t, rectangle_t *r) {
+float imlib_template_match_ds(image_t *f, image_t *t, rectangle_t *r, image_planes_t *planes) {
     point_t pts[9];
 
-    // Integral images
-    i_image_t sum;
-    imlib_integral_image_alloc(&sum, f->w, f->h);
-    imlib_integral_image(f, &sum);
+    // Integral images (shared with other calls on f if possible)
+    i_image_t sum_buf;
+    i_image_t *sum = imlib_planes_integral(planes, f);
+
+    if (!sum) {
+        sum = &sum_buf;
+        imlib_integral_image_alloc(sum, f->w, f->h);
+        imlib_integral_image(f, sum);
+    }
 
     // Normalized sum of squares of the template
     int t_mean = 0;
@@ -163,7 +168,7 @@ float imlib_template_match_ds(image_t *f, image_t *t, rectangle_t *r) {
             if (pts[i].x >= f->w || pts[i].y >= f->h) {
                 continue;
             }
-            float blk_xc = find_block_ncc(f, t, &sum, t_mean, t_sumsq, pts[i].x, pts[i].y);
+            float blk_xc = find_block_ncc(f, t, sum, t_mean, t_sumsq, pts[i].x, pts[i].y);
             if (blk_xc > max_xc) {
                 px = pts[i].x;
                 py = pts[i].y;
@@ -205,7 +210,9 @@ float imlib_template_match_ds(image_t *f, image_t *t, rectangle_t *r) {
         r->h = f->h - cy;
     }
 
-    imlib_integral_image_free(&sum);
+    if (sum == &sum_buf) {
+        imlib_integral_image_free(sum);
+    }
 
     //printf("max xc: %f\n", (double) max_xc);
     return max_xc;
@@ -217,19 +224,27 @@ float imlib_template_match_ds(image_t *f, image_t *t, rectangle_t *r) {
  * NOTE: only the denominator is optimized.
  *
  */
-float imlib_template_match_ex(image_t *f, image_t *t, rectangle_t *roi, int step, rectangle_t *r) {
+float imlib_template_match_ex(image_t *f, image_t *t, rectangle_t *roi, int step, rectangle_t *r,
+                              image_planes_t *planes) {
     int den_b = 0;
     float corr = 0.0f;
 
-    // Integral images
-    i_image_t sum;
-    i_image_t sumsq;
+    // Integral images (shared with other calls on f if possible)
+    i_image_t sum_buf, sumsq_buf;
+    i_image_t *sum = imlib_planes_integral(planes, f);
+    i_image_t *sumsq = imlib_planes_integral_sq(planes, f);
 
-    imlib_integral_image_alloc(&sum, f->w, f->h);
-    imlib_integral_image_alloc(&sumsq, f->w, f->h);
+    if (!sum) {
+        sum = &sum_buf;
+        imlib_integral_image_alloc(sum, f->w, f->h);
+        imlib_integral_image(f, sum);
+    }
 
-    imlib_integral_image(f, &sum);
-    imlib_integral_image_sq(f, &sumsq);
+    if (!sumsq) {
+        sumsq = &sumsq_buf;
+        imlib_integral_image_alloc(sumsq, f->w, f->h);
+        imlib_integral_image_sq(f, sumsq);
+    }
 
     // Normalized sum of squares of the template
     int t_mean = 0;
@@ -244,8 +259,8 @@ float imlib_template_match_ex(image_t *f, image_t *t, rectangle_t *roi, int step
         for (int u = roi->x; u <= (roi->x + roi->w - t->w); u += step) {
             int num = 0;
             // The mean of the current patch
-            uint32_t f_sum = imlib_integral_lookup(&sum, u, v, t->w, t->h);
-            uint32_t f_sumsq = imlib_integral_lookup(&sumsq, u, v, t->w, t->h);
+            uint32_t f_sum = imlib_integral_lookup(sum, u, v, t->w, t->h);
+            uint32_t f_sumsq = imlib_integral_lookup(sumsq, u, v, t->w, t->h);
             uint32_t f_mean = f_sum / (float) (t->w * t->h);
 
             // Normalized sum of squares of the image
@@ -272,7 +287,13 @@ float imlib_template_match_ex(image_t *f, image_t *t, rectangle_t *roi, int step
         }
     }
 
-    imlib_integral_image_free(&sum);
-    imlib_integral_image_free(&sumsq);
+    if (sum == &sum_buf) {
+        imlib_integral_image_free(sum);
+    }
+
+    if (sumsq == &sumsq_buf) {
+        imlib_integral_image_free(sumsq);
+    }
+
     return corr;
 }
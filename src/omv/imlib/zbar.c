@@ -1041,6 +1041,8 @@ struct zbar_image_s {
 
     unsigned seq;               /* page/frame sequence number */
     zbar_symbol_set_t *syms;    /* decoded result set */
+    const line_t *lines;        /* scan only along these lines (OpenMV) */
+    unsigned nlines;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1585,6 +1587,7 @@ struct zbar_image_scanner_s {
     unsigned long time;         /* scan start time */
     zbar_image_t *img;          /* currently scanning image *root* */
     int dx, dy, du, umin, v;    /* current scan direction */
+    int lx, ly, ldx, ldy;       /* current scan line origin/step (16.16) */
     zbar_symbol_set_t *syms;    /* previous decode results */
     /* recycled symbols in 4^n size buckets */
     recycle_bucket_t recycle[RECYCLE_BUCKETS];
@@ -1898,8 +1901,13 @@ static void symbol_handler (zbar_decoder_t *dcode)
     if(TEST_CFG(iscn, ZBAR_CFG_POSITION)) {
         /* tmp position fixup */
         int w = zbar_scanner_get_width(iscn->scn);
-        int u = iscn->umin + iscn->du * zbar_scanner_get_edge(iscn->scn, w, 0);
-        if(iscn->dx) {
+        int e = zbar_scanner_get_edge(iscn->scn, w, 0);
+        int u = iscn->umin + iscn->du * e;
+        if(iscn->ldx || iscn->ldy) {
+            x = (iscn->lx + iscn->ldx * e) >> 16;
+            y = (iscn->ly + iscn->ldy * e) >> 16;
+        }
+        else if(iscn->dx) {
             x = u;
             y = iscn->v;
         }
@@ -2178,7 +2186,50 @@ int zbar_scan_image (zbar_image_scanner_t *iscn,
 
     zbar_scanner_new_scan(scn);
 
-    density = CFG(iscn, ZBAR_CFG_Y_DENSITY);
+    /* scan each line both ways instead of the whole image */
+    if(img->lines) {
+        unsigned i;
+        for(i = 0; i < img->nlines; i++) {
+            const line_t *l = &img->lines[i];
+            int n = IM_MAX(abs(l->x2 - l->x1), abs(l->y2 - l->y1)), k;
+            if(!n)
+                continue;
+            for(k = 0; k < 2; k++) {
+                int x0 = k ? l->x2 : l->x1, y0 = k ? l->y2 : l->y1;
+                int x1 = k ? l->x1 : l->x2, y1 = k ? l->y1 : l->y2;
+                int x, y, j;
+                iscn->lx = x0 << 16;
+                iscn->ly = y0 << 16;
+                iscn->ldx = (x1 - x0) * 65536 / n;
+                iscn->ldy = (y1 - y0) * 65536 / n;
+                /* report the orientation of the nearest raster scan */
+                if(abs(x1 - x0) >= abs(y1 - y0)) {
+                    iscn->dx = iscn->du = (x1 < x0) ? -1 : 1;
+                    iscn->dy = 0;
+                }
+                else {
+                    iscn->dy = iscn->du = (y1 < y0) ? -1 : 1;
+                    iscn->dx = 0;
+                }
+                /* bilinear samples keep the edge positions of tilted bars */
+                for(j = 0, x = iscn->lx, y = iscn->ly; j <= n;
+                    j++, x += iscn->ldx, y += iscn->ldy) {
+                    int xi = x >> 16, yi = y >> 16;
+                    int fx = (x >> 8) & 0xff, fy = (y >> 8) & 0xff;
+                    const uint8_t *p = data + yi * w + xi;
+                    int ox = (xi + 1 < w) ? 1 : 0, oy = (yi + 1 < h) ? w : 0;
+                    int a = p[0] * (256 - fx) + p[ox] * fx;
+                    int b = p[oy] * (256 - fx) + p[oy + ox] * fx;
+                    zbar_scan_y(scn, (a * (256 - fy) + b * fy) >> 16);
+                }
+                quiet_border(iscn);
+            }
+        }
+        iscn->lx = iscn->ly = iscn->ldx = iscn->ldy = 0;
+        iscn->dx = iscn->dy = 0;
+    }
+
+    density = img->lines ? 0 : CFG(iscn, ZBAR_CFG_Y_DENSITY);
     if(density > 0) {
         const uint8_t *p = data;
         int x = 0, y = 0;
@@ -2234,7 +2285,7 @@ int zbar_scan_image (zbar_image_scanner_t *iscn,
     }
     iscn->dx = 0;
 
-    density = CFG(iscn, ZBAR_CFG_X_DENSITY);
+    density = img->lines ? 0 : CFG(iscn, ZBAR_CFG_X_DENSITY);
     if(density > 0) {
         const uint8_t *p = data;
         int x = 0, y = 0;
@@ -8711,11 +8762,200 @@ void zbar_scanner_get_state (const zbar_scanner_t *scn,
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void imlib_find_barcodes(list_t *out, image_t *ptr, rectangle_t *roi)
+#define BARCODE_CELL_SIZE           16
+#define BARCODE_CELL_MIN_ENERGY     256 // mean squared gradient
+#define BARCODE_CELL_MIN_COHERENCE  0.7f
+#define BARCODE_CELL_MAX_ANGLE_COS  0.85f // cos(2 * ~16 degrees)
+#define BARCODE_REGION_MIN_CELLS    3
+#define BARCODE_MAX_REGIONS         4
+#define BARCODE_REGION_LINES        5
+
+typedef struct barcode_cell {
+    float xx, yy, xy;   // Gradient structure tensor.
+    float u, v;         // Unit vector of the doubled gradient angle.
+} barcode_cell_t;
+
+typedef struct barcode_region {
+    float xx, yy, xy;
+    int start, count;   // Cells in the region (in the fill order).
+} barcode_region_t;
+
+// Finds regions of the crop window of img which have strong gradients in one direction (barcode
+// bars) and returns up to BARCODE_MAX_REGIONS * BARCODE_REGION_LINES lines across the bars of
+// the regions found.
+static int find_barcodes_lines(const zbar_image_t *img, line_t *lines)
+{
+    int cw = img->crop_w / BARCODE_CELL_SIZE;
+    int ch = img->crop_h / BARCODE_CELL_SIZE;
+
+    if ((cw < 1) || (ch < 1)) {
+        return 0;
+    }
+
+    const uint8_t *data = img->data;
+    int w = img->width, h = img->height;
+    int crop_x = img->crop_x, crop_y = img->crop_y;
+    barcode_cell_t *cells = fb_alloc(cw * ch * sizeof(barcode_cell_t), FB_ALLOC_NO_HINT);
+    uint16_t *fill = fb_alloc(cw * ch * sizeof(uint16_t), FB_ALLOC_NO_HINT);
+    uint8_t *state = fb_alloc0(cw * ch, FB_ALLOC_NO_HINT); // 0 = rejected, 1 = candidate, 2 = used
+
+    // Gradient statistics of each cell.
+    for (int cy = 0; cy < ch; cy++) {
+        for (int cx = 0; cx < cw; cx++) {
+            int xx = 0, yy = 0, xy = 0, sx = 0, sy = 0, sa = 0;
+            int x_start = IM_MAX(crop_x + (cx * BARCODE_CELL_SIZE), 1);
+            int y_start = IM_MAX(crop_y + (cy * BARCODE_CELL_SIZE), 1);
+            int x_end = IM_MIN(crop_x + ((cx + 1) * BARCODE_CELL_SIZE), w - 1);
+            int y_end = IM_MIN(crop_y + ((cy + 1) * BARCODE_CELL_SIZE), h - 1);
+            int n = 0;
+
+            for (int y = y_start; y < y_end; y++) {
+                const uint8_t *row = data + (y * w);
+                for (int x = x_start; x < x_end; x++, n++) {
+                    int gx = (row[x + 1] + row[x + w + 1]) - (row[x] + row[x + w]);
+                    int gy = (row[x + w] + row[x + w + 1]) - (row[x] + row[x + 1]);
+                    xx += gx * gx;
+                    yy += gy * gy;
+                    xy += gx * gy;
+                    sx += gx;
+                    sy += gy;
+                    sa += abs(gx) + abs(gy);
+                }
+            }
+
+            barcode_cell_t *cell = &cells[(cy * cw) + cx];
+            cell->xx = xx;
+            cell->yy = yy;
+            cell->xy = xy;
+
+            float energy = cell->xx + cell->yy;
+            float u = cell->xx - cell->yy, v = 2 * cell->xy;
+            float mag = fast_sqrtf((u * u) + (v * v));
+
+            // Bars have edges in both directions while object outlines usually have edges in one.
+            if (n && (energy >= (BARCODE_CELL_MIN_ENERGY * n)) && (mag >= (BARCODE_CELL_MIN_COHERENCE * energy))
+                && ((abs(sx) + abs(sy)) <= (sa / 2))) {
+                cell->u = u / mag;
+                cell->v = v / mag;
+                state[(cy * cw) + cx] = 1;
+            }
+        }
+    }
+
+    // Group neighbouring candidate cells with the same orientation into regions.
+    barcode_region_t regions[BARCODE_MAX_REGIONS];
+    int nregions = 0, nfill = 0;
+
+    for (int i = 0, j = cw * ch; i < j; i++) {
+        if (state[i] != 1) {
+            continue;
+        }
+
+        barcode_region_t region = { .start = nfill };
+        state[i] = 2;
+        fill[nfill++] = i;
+
+        for (int k = region.start; k < nfill; k++) {
+            barcode_cell_t *cell = &cells[fill[k]];
+            int cx = fill[k] % cw, cy = fill[k] / cw;
+            region.xx += cell->xx;
+            region.yy += cell->yy;
+            region.xy += cell->xy;
+
+            for (int ny = IM_MAX(cy - 1, 0), ny_end = IM_MIN(cy + 1, ch - 1); ny <= ny_end; ny++) {
+                for (int nx = IM_MAX(cx - 1, 0), nx_end = IM_MIN(cx + 1, cw - 1); nx <= nx_end; nx++) {
+                    int index = (ny * cw) + nx;
+                    barcode_cell_t *neighbor = &cells[index];
+                    if ((state[index] == 1)
+                        && (((cell->u * neighbor->u) + (cell->v * neighbor->v)) >= BARCODE_CELL_MAX_ANGLE_COS)) {
+                        state[index] = 2;
+                        fill[nfill++] = index;
+                    }
+                }
+            }
+        }
+
+        region.count = nfill - region.start;
+
+        if (region.count < BARCODE_REGION_MIN_CELLS) {
+            continue;
+        }
+
+        // Keep the largest regions.
+        int k = nregions;
+        if (nregions < BARCODE_MAX_REGIONS) {
+            nregions++;
+        } else if (region.count <= regions[k - 1].count) {
+            continue;
+        } else {
+            k -= 1;
+        }
+
+        for (; (k > 0) && (regions[k - 1].count < region.count); k--) {
+            regions[k] = regions[k - 1];
+        }
+
+        regions[k] = region;
+    }
+
+    // Lines along the dominant gradient direction spread across the region.
+    int nlines = 0;
+
+    for (int i = 0; i < nregions; i++) {
+        barcode_region_t *region = &regions[i];
+        float theta = fast_atan2f(2 * region->xy, region->xx - region->yy) / 2;
+        float ux = cosf(theta), uy = sinf(theta);
+        float mx = 0, my = 0;
+
+        for (int k = region->start, l = region->start + region->count; k < l; k++) {
+            mx += ((fill[k] % cw) + 0.5f) * BARCODE_CELL_SIZE;
+            my += ((fill[k] / cw) + 0.5f) * BARCODE_CELL_SIZE;
+        }
+
+        mx = (mx / region->count) + crop_x;
+        my = (my / region->count) + crop_y;
+
+        // Extent of the region along the bars.
+        float t_min = FLT_MAX, t_max = -FLT_MAX;
+
+        for (int k = region->start, l = region->start + region->count; k < l; k++) {
+            float dx = (((fill[k] % cw) + 0.5f) * BARCODE_CELL_SIZE) + crop_x - mx;
+            float dy = (((fill[k] / cw) + 0.5f) * BARCODE_CELL_SIZE) + crop_y - my;
+            float t = (dy * ux) - (dx * uy);
+            t_min = IM_MIN(t_min, t);
+            t_max = IM_MAX(t_max, t);
+        }
+
+        int length = img->crop_w + img->crop_h;
+
+        for (int k = 0; k < BARCODE_REGION_LINES; k++) {
+            float t = t_min + (((t_max - t_min) * (k + 1)) / (BARCODE_REGION_LINES + 1));
+            float px = mx - (t * uy), py = my + (t * ux);
+            line_t *l = &lines[nlines];
+            l->x1 = fast_roundf(px - (ux * length));
+            l->y1 = fast_roundf(py - (uy * length));
+            l->x2 = fast_roundf(px + (ux * length));
+            l->y2 = fast_roundf(py + (uy * length));
+
+            if (lb_clip_line(l, crop_x, crop_y, img->crop_w, img->crop_h)) {
+                nlines++;
+            }
+        }
+    }
+
+    fb_free(); // state
+    fb_free(); // fill
+    fb_free(); // cells
+    return nlines;
+}
+
+void imlib_find_barcodes(list_t *out, image_t *ptr, rectangle_t *roi, bool fast, image_planes_t *planes)
 {
-    uint8_t *grayscale_image = (ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? ptr->data : fb_alloc(roi->w * roi->h, FB_ALLOC_NO_HINT);
+    // Scan the whole grayscale plane cropped to the roi if there's one, else a copy of the roi.
+    uint8_t *plane = imlib_planes_grayscale(planes, ptr);
+    uint8_t *grayscale_image = plane ? plane : fb_alloc(roi->w * roi->h, FB_ALLOC_NO_HINT);
 
-    if (ptr->pixfmt != PIXFORMAT_GRAYSCALE) {
+    if (!plane) {
         image_t img;
         img.w = roi->w;
         img.h = roi->h;
@@ -8724,6 +8964,22 @@ void imlib_find_barcodes(list_t *out, image_t *ptr, rectangle_t *roi)
         imlib_draw_image(&img, ptr, 0, 0, 1.f, 1.f, roi, -1, 256, NULL, NULL, 0, NULL, NULL, NULL);
     }
 
+    line_t lines[BARCODE_MAX_REGIONS * BARCODE_REGION_LINES];
+    int nlines = 0;
+
+    if (fast) {
+        zbar_image_t temp = {
+            .width = plane ? ptr->w : roi->w,
+            .height = plane ? ptr->h : roi->h,
+            .data = grayscale_image,
+            .crop_x = plane ? roi->x : 0,
+            .crop_y = plane ? roi->y : 0,
+            .crop_w = roi->w,
+            .crop_h = roi->h,
+        };
+        nlines = find_barcodes_lines(&temp, lines);
+    }
+
     umm_init_x(fb_avail());
 
     zbar_image_scanner_t *scanner = zbar_image_scanner_create();
@@ -8731,35 +8987,57 @@ void imlib_find_barcodes(list_t *out, image_t *ptr, rectangle_t *roi)
 
     zbar_image_t image;
     image.format = *((int *) "Y800");
-    image.width = (ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? ptr->w : roi->w;
-    image.height = (ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? ptr->h : roi->h;
+    image.width = plane ? ptr->w : roi->w;
+    image.height = plane ? ptr->h : roi->h;
     image.data = grayscale_image;
-    image.datalen = ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? ptr->w : roi->w) * ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? ptr->h : roi->h);
-    image.crop_x = (ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? roi->x : 0;
-    image.crop_y = (ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? roi->y : 0;
+    image.datalen = (plane ? ptr->w : roi->w) * (plane ? ptr->h : roi->h);
+    image.crop_x = plane ? roi->x : 0;
+    image.crop_y = plane ? roi->y : 0;
     image.crop_w = roi->w;
     image.crop_h = roi->h;
     image.userdata = 0;
     image.seq = 0;
     image.syms = 0;
+    image.lines = NULL;
+    image.nlines = 0;
 
     list_init(out, sizeof(find_barcodes_list_lnk_data_t));
 
-    if (zbar_scan_image(scanner, &image) > 0) {
+    // In fast mode only a few lines across the bars of likely barcode regions are scanned. The
+    // full raster scan is the fallback if nothing is decoded along them.
+    int n = 0;
+
+    if (fast) {
+        image.lines = lines;
+        image.nlines = nlines;
+
+        if (nlines) {
+            n = zbar_scan_image(scanner, &image);
+        }
+
+        image.lines = NULL;
+        image.nlines = 0;
+    }
+
+    if (n <= 0) {
+        n = zbar_scan_image(scanner, &image);
+    }
+
+    if (n > 0) {
         for (const zbar_symbol_t *symbol = (image.syms) ? image.syms->head : NULL; symbol; symbol = zbar_symbol_next(symbol)) {
             if (zbar_symbol_get_loc_size(symbol) > 0) {
                 find_barcodes_list_lnk_data_t lnk_data;
 
                 rectangle_init(&(lnk_data.rect),
-                               zbar_symbol_get_loc_x(symbol, 0) + ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? 0 : roi->x),
-                               zbar_symbol_get_loc_y(symbol, 0) + ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? 0 : roi->y),
+                               zbar_symbol_get_loc_x(symbol, 0) + (plane ? 0 : roi->x),
+                               zbar_symbol_get_loc_y(symbol, 0) + (plane ? 0 : roi->y),
                                (zbar_symbol_get_loc_size(symbol) == 1) ? 1 : 0,
                                (zbar_symbol_get_loc_size(symbol) == 1) ? 1 : 0);
 
                 for (size_t k = 1, l = zbar_symbol_get_loc_size(symbol); k < l; k++) {
                     rectangle_t temp;
-                    rectangle_init(&temp, zbar_symbol_get_loc_x(symbol, k) + ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? 0 : roi->x),
-                            zbar_symbol_get_loc_y(symbol, k) + ((ptr->pixfmt == PIXFORMAT_GRAYSCALE) ? 0 : roi->y), 0, 0);
+                    rectangle_init(&temp, zbar_symbol_get_loc_x(symbol, k) + (plane ? 0 : roi->x),
+                            zbar_symbol_get_loc_y(symbol, k) + (plane ? 0 : roi->y), 0, 0);
                     rectangle_united(&(lnk_data.rect), &temp);
                 }
 
@@ -8858,7 +9136,7 @@ void imlib_find_barcodes(list_t *out, image_t *ptr, rectangle_t *roi)
 
     zbar_image_scanner_destroy(scanner);
     fb_free(); // umm_init_x();
-    if (ptr->pixfmt != PIXFORMAT_GRAYSCALE) {
+    if (!plane) {
         fb_free(); // grayscale_image;
     }
 }
@@ -919,6 +919,7 @@ mp_obj_t py_fir_draw_ir(uint n_args, const mp_obj_t *pos_args, mp_map_t *kw_args
     };
 
     image_t *dst_img = py_helper_arg_to_image(pos_args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(dst_img);
 
     mp_obj_t *ir_array;
     mp_obj_get_array_fixed_n(pos_args[1], src_img.w * src_img.h, &ir_array);
@@ -18,6 +18,7 @@
 #endif
 
 extern void *py_image_cobj(mp_obj_t img_obj);
+extern mp_obj_t py_image_thresholds_list(mp_obj_t arg);
 
 mp_obj_t py_func_unavailable(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     PY_ASSERT_TRUE_MSG(false, "This function is unavailable on your OpenMV Cam.");
@@ -381,7 +382,7 @@ int py_helper_keyword_color(image_t *img, uint n_args, const mp_obj_t *args, uin
 void py_helper_arg_to_thresholds(const mp_obj_t arg, list_t *thresholds) {
     mp_uint_t arg_thresholds_len;
     mp_obj_t *arg_thresholds;
-    mp_obj_get_array(arg, &arg_thresholds_len, &arg_thresholds);
+    mp_obj_get_array(py_image_thresholds_list(arg), &arg_thresholds_len, &arg_thresholds);
     if (!arg_thresholds_len) {
         return;
     }
@@ -20,6 +20,7 @@
 #include "py/objtype.h"
 #include "py/runtime.h"
 #include "py/mphal.h"
+#include "py/gc.h"
 
 #include "imlib.h"
 #include "array.h"
@@ -285,6 +286,45 @@ STATIC MP_DEFINE_CONST_OBJ_TYPE(
 
 #endif //IMLIB_ENABLE_DESCRIPTOR && IMLIB_ENABLE_FIND_KEYPOINTS
 
+// Thresholds Object //
+typedef struct py_thresholds_obj {
+    mp_obj_base_t base;
+    mp_obj_t thresholds;
+    color_thresholds_bitmap_t bitmap;
+} py_thresholds_obj_t;
+
+static void py_thresholds_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
+    py_thresholds_obj_t *self = self_in;
+    mp_printf(print, "{\"thresholds\":");
+    mp_obj_print_helper(print, self->thresholds, kind);
+    mp_printf(print, "}");
+}
+
+STATIC MP_DEFINE_CONST_OBJ_TYPE(
+    py_thresholds_type,
+    MP_QSTR_Thresholds,
+    MP_TYPE_FLAG_NONE,
+    print, py_thresholds_print
+    );
+
+// Returns the thresholds list of a thresholds object so that it can be used anywhere a list of
+// thresholds is accepted, or arg otherwise.
+mp_obj_t py_image_thresholds_list(mp_obj_t arg) {
+    if (MP_OBJ_IS_TYPE(arg, &py_thresholds_type)) {
+        return ((py_thresholds_obj_t *) arg)->thresholds;
+    }
+    return arg;
+}
+
+// Returns the compiled thresholds of a thresholds object for the image or NULL. Only RGB565
+// thresholds are compiled, grayscale thresholds are already a couple of compares.
+static color_thresholds_bitmap_t *py_image_thresholds_bitmap(mp_obj_t arg, image_t *img) {
+    if (arg && MP_OBJ_IS_TYPE(arg, &py_thresholds_type) && (img->pixfmt == PIXFORMAT_RGB565)) {
+        return &((py_thresholds_obj_t *) arg)->bitmap;
+    }
+    return NULL;
+}
+
 // Image //////////////////////////////////////////////////////////////////////
 
 typedef struct _py_image_obj_t {
@@ -304,6 +344,79 @@ void *py_image_cobj(mp_obj_t img_obj) {
     return &((py_image_obj_t *) img_obj)->_cobj;
 }
 
+// Planes derived from the last image that needed them. Only one set is kept, limited to a quarter
+// of the heap, and it's freed on each snapshot so that it doesn't pin heap memory across frames.
+#define PY_IMAGE_PLANES_HEAP_DIV    4
+
+// Buffers exposed by bytearray() can be written at any time without the planes being invalidated,
+// so planes are never cached for them. The cache is disabled if too many buffers are exposed. The
+// set is cleared on each snapshot, so that exposing the frame buffer once doesn't disable the
+// cache for every later frame. A bytearray() taken before a snapshot must not be written after it.
+#define PY_IMAGE_EXPOSED_MAX        4
+static uint8_t *py_image_exposed[PY_IMAGE_EXPOSED_MAX];
+static size_t py_image_exposed_count;
+
+// Counts the calls to py_image_invalidate_planes() and py_image_free_planes(). Other caches of
+// image data are stale when it changed since they were built.
+static uint32_t py_image_writes;
+
+static bool py_image_is_exposed(image_t *img) {
+    if (py_image_exposed_count > PY_IMAGE_EXPOSED_MAX) {
+        return true;
+    }
+
+    for (size_t i = 0; i < py_image_exposed_count; i++) {
+        if (py_image_exposed[i] == img->data) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void py_image_expose(image_t *img) {
+    if (!py_image_is_exposed(img)) {
+        if (py_image_exposed_count < PY_IMAGE_EXPOSED_MAX) {
+            py_image_exposed[py_image_exposed_count] = img->data;
+        }
+        py_image_exposed_count += 1;
+    }
+}
+
+// Returns the planes to use for img or NULL if they can't be cached.
+static image_planes_t *py_image_planes(image_t *img) {
+    if (py_image_is_exposed(img)) {
+        return NULL;
+    }
+
+    if (!MP_STATE_PORT(image_planes)) {
+        gc_info_t info;
+        gc_info(&info);
+        MP_STATE_PORT(image_planes) = xalloc0(sizeof(image_planes_t));
+        MP_STATE_PORT(image_planes)->max_size = info.total / PY_IMAGE_PLANES_HEAP_DIV;
+    }
+
+    return MP_STATE_PORT(image_planes);
+}
+
+// Must be called before the pixels of img are modified (or replaced by a new image).
+void py_image_invalidate_planes(image_t *img) {
+    py_image_writes += 1;
+    imlib_planes_invalidate(MP_STATE_PORT(image_planes), img);
+}
+
+// Frees the plane buffers and forgets the exposed buffers, called when a new frame is captured.
+void py_image_free_planes() {
+    py_image_writes += 1;
+    py_image_exposed_count = 0;
+    imlib_planes_free(MP_STATE_PORT(image_planes));
+}
+
+void py_image_init0() {
+    MP_STATE_PORT(image_planes) = NULL;
+    py_image_exposed_count = 0;
+}
+
 mp_obj_t py_image_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
     py_image_obj_t *self = MP_OBJ_TO_PTR(self_in);
     switch (op) {
@@ -510,6 +623,7 @@ static mp_obj_t py_image_subscr(mp_obj_t self_in, mp_obj_t index, mp_obj_t value
         }
     } else {
         // store
+        py_image_invalidate_planes(image);
         switch (image->pixfmt) {
             case PIXFORMAT_BINARY: {
                 if (MP_OBJ_IS_TYPE(index, &mp_type_slice)) {
@@ -720,6 +834,8 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_image_size_obj, py_image_size);
 
 static mp_obj_t py_image_bytearray(mp_obj_t img_obj) {
     image_t *arg_img = (image_t *) py_image_cobj(img_obj);
+    py_image_invalidate_planes(arg_img);
+    py_image_expose(arg_img);
     return mp_obj_new_bytearray_by_ref(image_size(arg_img), arg_img->data);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_image_bytearray_obj, py_image_bytearray);
@@ -805,6 +921,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_get_pixel_obj, 2, py_image_get_pixel)
 
 STATIC mp_obj_t py_image_set_pixel(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_UNCOMPRESSED);
+    py_image_invalidate_planes(arg_img);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 2, &arg_vec);
@@ -843,6 +960,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_set_pixel_obj, 2, py_image_set_pixel)
 #ifdef IMLIB_ENABLE_MEAN_POOLING
 static mp_obj_t py_image_mean_pool(mp_obj_t img_obj, mp_obj_t x_div_obj, mp_obj_t y_div_obj) {
     image_t *arg_img = py_helper_arg_to_image(img_obj, ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
 
     int arg_x_div = mp_obj_get_int(x_div_obj);
     PY_ASSERT_TRUE_MSG(arg_x_div >= 1, "Width divisor must be greater than >= 1");
@@ -891,6 +1009,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_3(py_image_mean_pooled_obj, py_image_mean_pooled)
 #ifdef IMLIB_ENABLE_MIDPOINT_POOLING
 static mp_obj_t py_image_midpoint_pool(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
 
     int arg_x_div = mp_obj_get_int(args[1]);
     PY_ASSERT_TRUE_MSG(arg_x_div >= 1, "Width divisor must be greater than >= 1");
@@ -1155,6 +1274,9 @@ static mp_obj_t py_image_to(pixformat_t pixfmt, const uint16_t *default_color_pa
         dst_img.data = xalloc(size);
     }
 
+    // The target may be src_img (in place), another image or the frame buffer.
+    py_image_invalidate_planes(&dst_img);
+
     if (dst_img.is_compressed) {
         if (arg_e) {
             fb_encode_for_ide(dst_img.data, &dst_img_tmp);
@@ -1245,6 +1367,58 @@ static mp_obj_t py_image_compressed_for_ide(uint n_args, const mp_obj_t *args, m
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_compressed_for_ide_obj, 1, py_image_compressed_for_ide);
 
+#if (OMV_JPEG_CODEC_ENABLE == 0)
+static bool py_image_compress_stream_sink(void *arg, const uint8_t *data, uint32_t size) {
+    mp_obj_t chunk = mp_obj_new_memoryview('B', size, (void *) data);
+    return mp_call_function_1(arg, chunk) != mp_const_false;
+}
+
+// Rate control state of compress_stream(), kept across frames while target_size is unchanged.
+static jpeg_rate_control_t py_image_compress_stream_rc;
+
+// Calls callback with a memoryview of each chunk of the JPEG stream. The memoryview is only valid
+// during the callback. Returning False from the callback aborts encoding. A non-zero target_size
+// adapts the quality from frame to frame to fit that many bytes, starting at quality.
+static mp_obj_t py_image_compress_stream(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
+    image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_UNCOMPRESSED);
+    mp_obj_t callback = args[1];
+    PY_ASSERT_TRUE_MSG(mp_obj_is_callable(callback), "Callback must be callable!");
+
+    int arg_q = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_quality), 90);
+    PY_ASSERT_TRUE_MSG((1 <= arg_q) && (arg_q <= 100), "Error: 1 <= quality <= 100!");
+
+    jpeg_subsampling_t subsampling =
+        py_helper_keyword_int(n_args, args, 3, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_subsampling), JPEG_SUBSAMPLING_AUTO);
+
+    int arg_restart = py_helper_keyword_int(n_args, args, 4, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_restart), 1);
+    PY_ASSERT_TRUE_MSG(arg_restart >= 0, "Error: restart >= 0!");
+
+    int arg_chunk_size =
+        py_helper_keyword_int(n_args, args, 5, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_chunk_size), 4096);
+    PY_ASSERT_TRUE_MSG(arg_chunk_size >= JPEG_STREAM_MIN_CHUNK, "Error: chunk_size >= 512!");
+
+    int arg_target_size = py_helper_keyword_int(n_args, args, 6, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_target_size), 0);
+    PY_ASSERT_TRUE_MSG(arg_target_size >= 0, "Error: target_size >= 0!");
+
+    jpeg_rate_control_t *rc = NULL;
+    if (arg_target_size) {
+        rc = &py_image_compress_stream_rc;
+        if (rc->target != (uint32_t) arg_target_size) {
+            jpeg_rate_control_init(rc, arg_target_size);
+            rc->quality = arg_q;
+        }
+    }
+
+    fb_alloc_mark();
+    uint8_t *buf = fb_alloc(arg_chunk_size * 2, FB_ALLOC_PREFER_SPEED | FB_ALLOC_CACHE_ALIGN);
+    bool aborted = jpeg_compress_stream(arg_img, arg_q, rc, subsampling, arg_restart,
+                                        buf, arg_chunk_size * 2, py_image_compress_stream_sink, callback);
+    fb_alloc_free_till_mark();
+    return mp_obj_new_bool(!aborted);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_compress_stream_obj, 2, py_image_compress_stream);
+#endif
+
 #if defined(IMLIB_ENABLE_IMAGE_FILE_IO)
 static mp_obj_t py_image_save(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_image_cobj(args[0]);
@@ -1276,6 +1450,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_image_flush_obj, py_image_flush);
 
 STATIC mp_obj_t py_image_clear(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_UNCOMPRESSED);
+    py_image_invalidate_planes(arg_img);
 
     image_t *arg_msk =
         py_helper_keyword_to_image(n_args, args, 1, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_mask), NULL);
@@ -1292,6 +1467,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_clear_obj, 1, py_image_clear);
 
 STATIC mp_obj_t py_image_draw_line(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 4, &arg_vec);
@@ -1312,6 +1488,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_draw_line_obj, 2, py_image_draw_line)
 
 STATIC mp_obj_t py_image_draw_rectangle(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 4, &arg_vec);
@@ -1334,6 +1511,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_draw_rectangle_obj, 2, py_image_draw_
 
 STATIC mp_obj_t py_image_draw_circle(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 3, &arg_vec);
@@ -1355,6 +1533,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_draw_circle_obj, 2, py_image_draw_cir
 
 STATIC mp_obj_t py_image_draw_ellipse(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 5, &arg_vec);
@@ -1378,6 +1557,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_draw_ellipse_obj, 2, py_image_draw_el
 
 STATIC mp_obj_t py_image_draw_string(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 3, &arg_vec);
@@ -1419,6 +1599,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_draw_string_obj, 2, py_image_draw_str
 
 STATIC mp_obj_t py_image_draw_cross(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 2, &arg_vec);
@@ -1440,6 +1621,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_draw_cross_obj, 2, py_image_draw_cros
 
 STATIC mp_obj_t py_image_draw_arrow(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 4, &arg_vec);
@@ -1478,6 +1660,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_draw_arrow_obj, 2, py_image_draw_arro
 
 STATIC mp_obj_t py_image_draw_edges(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
 
     mp_obj_t *corners, *p0, *p1, *p2, *p3;
     mp_obj_get_array_fixed_n(args[1], 4, &corners);
@@ -1524,6 +1707,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_draw_edges_obj, 2, py_image_draw_edge
 STATIC mp_obj_t py_image_draw_image(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     fb_alloc_mark();
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     image_t *arg_other = py_helper_arg_to_image(args[1], ARG_IMAGE_ANY | ARG_IMAGE_ALLOC);
 
     const mp_obj_t *arg_vec;
@@ -1611,6 +1795,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_draw_image_obj, 3, py_image_draw_imag
 
 STATIC mp_obj_t py_image_draw_keypoints(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
 
     int arg_c =
         py_helper_keyword_color(arg_img, n_args, args, 2, kw_args, -1); // White.
@@ -1660,6 +1845,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_draw_keypoints_obj, 2, py_image_draw_
 
 STATIC mp_obj_t py_image_mask_rectangle(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     int arg_rx;
     int arg_ry;
     int arg_rw;
@@ -1696,6 +1882,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_mask_rectangle_obj, 1, py_image_mask_
 
 STATIC mp_obj_t py_image_mask_circle(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     int arg_cx;
     int arg_cy;
     int arg_cr;
@@ -1729,6 +1916,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_mask_circle_obj, 1, py_image_mask_cir
 
 STATIC mp_obj_t py_image_mask_ellipse(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     int arg_cx;
     int arg_cy;
     int arg_rx;
@@ -1769,6 +1957,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_mask_ellipse_obj, 1, py_image_mask_el
 #ifdef IMLIB_ENABLE_FLOOD_FILL
 STATIC mp_obj_t py_image_flood_fill(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
 
     const mp_obj_t *arg_vec;
     uint offset = py_helper_consume_array(n_args, args, 1, 2, &arg_vec);
@@ -1816,6 +2005,7 @@ STATIC mp_obj_t py_awb(uint n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
 
     // Parse args.
     image_t *image = py_helper_arg_to_image(pos_args[0], ARG_IMAGE_UNCOMPRESSED);
+    py_image_invalidate_planes(image);
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
@@ -1834,6 +2024,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_awb_obj, 1, py_awb);
 
 STATIC mp_obj_t py_ccm(mp_obj_t img_obj, mp_obj_t ccm_obj) {
     image_t *image = py_helper_arg_to_image(img_obj, ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(image);
 
     float ccm[12] = {};
     bool offset = false;
@@ -1893,6 +2084,7 @@ STATIC mp_obj_t py_image_gamma(uint n_args, const mp_obj_t *pos_args, mp_map_t *
 
     // Parse args.
     image_t *image = py_helper_arg_to_image(pos_args[0], ARG_IMAGE_UNCOMPRESSED);
+    py_image_invalidate_planes(image);
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
@@ -1927,6 +2119,7 @@ STATIC mp_obj_t py_image_binary(uint n_args, const mp_obj_t *pos_args, mp_map_t
 
     // Parse args.
     image_t *image = py_helper_arg_to_image(pos_args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(image);
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
@@ -1967,7 +2160,8 @@ STATIC mp_obj_t py_image_binary(uint n_args, const mp_obj_t *pos_args, mp_map_t
         mask = py_helper_arg_to_image(args[ARG_mask].u_obj, ARG_IMAGE_MUTABLE | ARG_IMAGE_ALLOC);
     }
 
-    imlib_binary(&out, image, &thresholds, args[ARG_invert].u_int, args[ARG_zero].u_int, mask);
+    imlib_binary(&out, image, &thresholds, py_image_thresholds_bitmap(args[ARG_thresholds].u_obj, image),
+                 args[ARG_invert].u_int, args[ARG_zero].u_int, mask);
     fb_alloc_free_till_mark();
 
     list_free(&thresholds);
@@ -1982,7 +2176,9 @@ STATIC mp_obj_t py_image_binary(uint n_args, const mp_obj_t *pos_args, mp_map_t
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_binary_obj, 1, py_image_binary);
 
 STATIC mp_obj_t py_image_invert(mp_obj_t img_obj) {
-    imlib_invert(py_helper_arg_to_image(img_obj, ARG_IMAGE_MUTABLE));
+    image_t *arg_img = py_helper_arg_to_image(img_obj, ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
+    imlib_invert(arg_img);
     return img_obj;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_image_invert_obj, py_image_invert);
@@ -1990,6 +2186,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_image_invert_obj, py_image_invert);
 STATIC mp_obj_t py_image_b_and(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     image_t *arg_msk =
         py_helper_keyword_to_image(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_mask), NULL);
 
@@ -2014,6 +2211,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_b_and_obj, 2, py_image_b_and);
 STATIC mp_obj_t py_image_b_nand(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     image_t *arg_msk =
         py_helper_keyword_to_image(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_mask), NULL);
 
@@ -2038,6 +2236,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_b_nand_obj, 2, py_image_b_nand);
 STATIC mp_obj_t py_image_b_or(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     image_t *arg_msk =
         py_helper_keyword_to_image(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_mask), NULL);
 
@@ -2062,6 +2261,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_b_or_obj, 2, py_image_b_or);
 STATIC mp_obj_t py_image_b_nor(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     image_t *arg_msk =
         py_helper_keyword_to_image(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_mask), NULL);
 
@@ -2086,6 +2286,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_b_nor_obj, 2, py_image_b_nor);
 STATIC mp_obj_t py_image_b_xor(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     image_t *arg_msk =
         py_helper_keyword_to_image(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_mask), NULL);
 
@@ -2110,6 +2311,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_b_xor_obj, 2, py_image_b_xor);
 STATIC mp_obj_t py_image_b_xnor(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     image_t *arg_msk =
         py_helper_keyword_to_image(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_mask), NULL);
 
@@ -2142,6 +2344,7 @@ static mp_obj_t py_image_binary_moprh_op(uint n_args, const mp_obj_t *pos_args,
 
     // Parse args.
     image_t *image = py_helper_arg_to_image(pos_args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(image);
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
@@ -2185,6 +2388,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_close_obj, 1, py_image_close);
 STATIC mp_obj_t py_image_replace(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     bool arg_hmirror =
         py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_hmirror), false);
     bool arg_vflip =
@@ -2232,6 +2436,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_replace_obj, 1, py_image_replace);
 STATIC mp_obj_t py_image_add(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     image_t *arg_msk =
         py_helper_keyword_to_image(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_mask), NULL);
 
@@ -2256,6 +2461,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_add_obj, 2, py_image_add);
 STATIC mp_obj_t py_image_sub(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     bool arg_reverse =
         py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_reverse), false);
     image_t *arg_msk =
@@ -2282,6 +2488,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_sub_obj, 2, py_image_sub);
 STATIC mp_obj_t py_image_min(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     image_t *arg_msk =
         py_helper_keyword_to_image(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_mask), NULL);
 
@@ -2306,6 +2513,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_min_obj, 2, py_image_min);
 STATIC mp_obj_t py_image_max(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     image_t *arg_msk =
         py_helper_keyword_to_image(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_mask), NULL);
 
@@ -2330,6 +2538,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_max_obj, 2, py_image_max);
 STATIC mp_obj_t py_image_difference(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     image_t *arg_msk =
         py_helper_keyword_to_image(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_mask), NULL);
 
@@ -2354,6 +2563,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_difference_obj, 2, py_image_differenc
 STATIC mp_obj_t py_image_blend(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     float arg_alpha =
         py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_alpha), 128) / 256.0f;
     PY_ASSERT_TRUE_MSG((0 <= arg_alpha) && (arg_alpha <= 1), "Error: 0 <= alpha <= 256!");
@@ -2398,6 +2608,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_black_hat_obj, 1, py_image_black_hat)
 static mp_obj_t py_image_histeq(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     bool arg_adaptive =
         py_helper_keyword_int(n_args, args, 1, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_adaptive), false);
     float arg_clip_limit =
@@ -2420,6 +2631,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_histeq_obj, 1, py_image_histeq);
 STATIC mp_obj_t py_image_mean(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     int arg_ksize =
         py_helper_arg_to_ksize(args[1]);
     bool arg_threshold =
@@ -2443,6 +2655,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_mean_obj, 2, py_image_mean);
 STATIC mp_obj_t py_image_median(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     int arg_ksize =
         py_helper_arg_to_ksize(args[1]);
     float arg_percentile =
@@ -2469,6 +2682,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_median_obj, 2, py_image_median);
 STATIC mp_obj_t py_image_mode(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     int arg_ksize =
         py_helper_arg_to_ksize(args[1]);
     bool arg_threshold =
@@ -2492,6 +2706,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_mode_obj, 2, py_image_mode);
 STATIC mp_obj_t py_image_midpoint(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     int arg_ksize =
         py_helper_arg_to_ksize(args[1]);
     float arg_bias =
@@ -2518,22 +2733,48 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_midpoint_obj, 2, py_image_midpoint);
 STATIC mp_obj_t py_image_morph(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     int arg_ksize =
         py_helper_arg_to_ksize(args[1]);
 
     int n = imlib_ksize_to_n(arg_ksize);
 
     mp_obj_t *krn;
-    mp_obj_get_array_fixed_n(args[2], n, &krn);
+    size_t krn_len;
+    mp_obj_get_array(args[2], &krn_len, &krn);
 
     fb_alloc_mark();
 
-    int *arg_krn = fb_alloc(n * sizeof(int), FB_ALLOC_NO_HINT);
+    int *arg_krn = NULL, *arg_row_krn = NULL, *arg_col_krn = NULL;
     int arg_m = 0;
 
-    for (int i = 0; i < n; i++) {
-        arg_krn[i] = mp_obj_get_int(krn[i]);
-        arg_m += arg_krn[i];
+    if (krn_len == 2) {
+        // A separable kernel passed as (row, column) vectors.
+        int k_n = (arg_ksize * 2) + 1;
+        mp_obj_t *row_krn, *col_krn;
+        mp_obj_get_array_fixed_n(krn[0], k_n, &row_krn);
+        mp_obj_get_array_fixed_n(krn[1], k_n, &col_krn);
+
+        arg_row_krn = fb_alloc(k_n * sizeof(int), FB_ALLOC_NO_HINT);
+        arg_col_krn = fb_alloc(k_n * sizeof(int), FB_ALLOC_NO_HINT);
+        int row_m = 0, col_m = 0;
+
+        for (int i = 0; i < k_n; i++) {
+            arg_row_krn[i] = mp_obj_get_int(row_krn[i]);
+            arg_col_krn[i] = mp_obj_get_int(col_krn[i]);
+            row_m += arg_row_krn[i];
+            col_m += arg_col_krn[i];
+        }
+
+        arg_m = row_m * col_m;
+    } else {
+        mp_obj_get_array_fixed_n(args[2], n, &krn);
+        arg_krn = fb_alloc(n * sizeof(int), FB_ALLOC_NO_HINT);
+
+        for (int i = 0; i < n; i++) {
+            arg_krn[i] = mp_obj_get_int(krn[i]);
+            arg_m += arg_krn[i];
+        }
     }
 
     if (arg_m == 0) {
@@ -2553,7 +2794,13 @@ STATIC mp_obj_t py_image_morph(uint n_args, const mp_obj_t *args, mp_map_t *kw_a
     image_t *arg_msk =
         py_helper_keyword_to_image(n_args, args, 8, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_mask), NULL);
 
-    imlib_morph(arg_img, arg_ksize, arg_krn, arg_mul, arg_add, arg_threshold, arg_offset, arg_invert, arg_msk);
+    if (arg_krn) {
+        imlib_morph(arg_img, arg_ksize, arg_krn, arg_mul, arg_add, arg_threshold, arg_offset, arg_invert, arg_msk);
+    } else {
+        imlib_sepmorph(arg_img, arg_ksize, arg_row_krn, arg_col_krn, 0, arg_mul, arg_add,
+                       arg_threshold, arg_offset, arg_invert, arg_msk);
+    }
+
     fb_alloc_free_till_mark();
     return args[0];
 }
@@ -2564,6 +2811,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_morph_obj, 3, py_image_morph);
 STATIC mp_obj_t py_image_gaussian(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     int arg_ksize =
         py_helper_arg_to_ksize(args[1]);
 
@@ -2620,6 +2868,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_gaussian_obj, 2, py_image_gaussian);
 STATIC mp_obj_t py_image_laplacian(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     int arg_ksize =
         py_helper_arg_to_ksize(args[1]);
 
@@ -2678,6 +2927,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_laplacian_obj, 2, py_image_laplacian)
 STATIC mp_obj_t py_image_bilateral(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     int arg_ksize =
         py_helper_arg_to_ksize(args[1]);
     float arg_color_sigma =
@@ -2692,10 +2942,17 @@ STATIC mp_obj_t py_image_bilateral(uint n_args, const mp_obj_t *args, mp_map_t *
         py_helper_keyword_int(n_args, args, 6, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_invert), false);
     image_t *arg_msk =
         py_helper_keyword_to_image(n_args, args, 7, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_mask), NULL);
+    bool arg_grid =
+        py_helper_keyword_int(n_args, args, 8, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_grid), false);
 
     fb_alloc_mark();
-    imlib_bilateral_filter(arg_img, arg_ksize, arg_color_sigma, arg_space_sigma, arg_threshold, arg_offset, arg_invert,
-                           arg_msk);
+    if (arg_grid) {
+        imlib_bilateral_grid(arg_img, arg_ksize, arg_color_sigma, arg_space_sigma, arg_threshold, arg_offset, arg_invert,
+                             arg_msk);
+    } else {
+        imlib_bilateral_filter(arg_img, arg_ksize, arg_color_sigma, arg_space_sigma, arg_threshold, arg_offset, arg_invert,
+                               arg_msk);
+    }
     fb_alloc_free_till_mark();
     return args[0];
 }
@@ -2710,6 +2967,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_bilateral_obj, 2, py_image_bilateral)
 static mp_obj_t py_image_linpolar(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     PY_ASSERT_FALSE_MSG(arg_img->w % 2, "Width must be even!");
     PY_ASSERT_FALSE_MSG(arg_img->h % 2, "Height must be even!");
     bool arg_reverse =
@@ -2727,6 +2985,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_linpolar_obj, 1, py_image_linpolar);
 static mp_obj_t py_image_logpolar(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     PY_ASSERT_FALSE_MSG(arg_img->w % 2, "Width must be even!");
     PY_ASSERT_FALSE_MSG(arg_img->h % 2, "Height must be even!");
     bool arg_reverse =
@@ -2744,6 +3003,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_logpolar_obj, 1, py_image_logpolar);
 STATIC mp_obj_t py_image_lens_corr(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     PY_ASSERT_FALSE_MSG(arg_img->w % 2, "Width must be even!");
     PY_ASSERT_FALSE_MSG(arg_img->h % 2, "Height must be even!");
     float arg_strength =
@@ -2770,6 +3030,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_lens_corr_obj, 1, py_image_lens_corr)
 STATIC mp_obj_t py_image_rotation_corr(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img =
         py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+    py_image_invalidate_planes(arg_img);
     float arg_x_rotation =
         IM_DEG2RAD(py_helper_keyword_float(n_args, args, 1, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_x_rotation), 0.0f));
     float arg_y_rotation =
@@ -3669,189 +3930,102 @@ STATIC MP_DEFINE_CONST_OBJ_TYPE(
     locals_dict, &py_histogram_locals_dict
     );
 
-static mp_obj_t py_image_get_histogram(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
-    image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
-
-    list_t thresholds;
-    list_init(&thresholds, sizeof(color_thresholds_list_lnk_data_t));
-    py_helper_keyword_thresholds(n_args, args, 1, kw_args, &thresholds);
-    bool invert = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_invert), false);
-    image_t *other = py_helper_keyword_to_image(n_args, args, 3, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_difference), NULL);
-
-    rectangle_t roi;
-    py_helper_keyword_rectangle_roi(arg_img, n_args, args, 3, kw_args, &roi);
-
-    histogram_t hist;
-    switch (arg_img->pixfmt) {
+// Parses the bins keywords and allocates the histogram bins after an fb_alloc_mark().
+static void py_image_alloc_histogram(histogram_t *hist, pixformat_t pixfmt, uint n_args, const mp_obj_t *args,
+                                     mp_map_t *kw_args) {
+    switch (pixfmt) {
         case PIXFORMAT_BINARY: {
             int bins = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_bins),
                                              (COLOR_BINARY_MAX - COLOR_BINARY_MIN + 1));
             PY_ASSERT_TRUE_MSG(bins >= 2, "bins must be >= 2");
-            hist.LBinCount = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_l_bins), bins);
-            PY_ASSERT_TRUE_MSG(hist.LBinCount >= 2, "l_bins must be >= 2");
-            hist.ABinCount = 0;
-            hist.BBinCount = 0;
+            hist->LBinCount = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_l_bins), bins);
+            PY_ASSERT_TRUE_MSG(hist->LBinCount >= 2, "l_bins must be >= 2");
+            hist->ABinCount = 0;
+            hist->BBinCount = 0;
             fb_alloc_mark();
-            hist.LBins = fb_alloc(hist.LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
-            hist.ABins = NULL;
-            hist.BBins = NULL;
-            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, other);
-            list_free(&thresholds);
+            hist->LBins = fb_alloc(hist->LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
+            hist->ABins = NULL;
+            hist->BBins = NULL;
             break;
         }
         case PIXFORMAT_GRAYSCALE: {
             int bins = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_bins),
                                              (COLOR_GRAYSCALE_MAX - COLOR_GRAYSCALE_MIN + 1));
             PY_ASSERT_TRUE_MSG(bins >= 2, "bins must be >= 2");
-            hist.LBinCount = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_l_bins), bins);
-            PY_ASSERT_TRUE_MSG(hist.LBinCount >= 2, "l_bins must be >= 2");
-            hist.ABinCount = 0;
-            hist.BBinCount = 0;
+            hist->LBinCount = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_l_bins), bins);
+            PY_ASSERT_TRUE_MSG(hist->LBinCount >= 2, "l_bins must be >= 2");
+            hist->ABinCount = 0;
+            hist->BBinCount = 0;
             fb_alloc_mark();
-            hist.LBins = fb_alloc(hist.LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
-            hist.ABins = NULL;
-            hist.BBins = NULL;
-            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, other);
-            list_free(&thresholds);
+            hist->LBins = fb_alloc(hist->LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
+            hist->ABins = NULL;
+            hist->BBins = NULL;
             break;
         }
         case PIXFORMAT_RGB565: {
             int l_bins = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_bins),
                                                (COLOR_L_MAX - COLOR_L_MIN + 1));
             PY_ASSERT_TRUE_MSG(l_bins >= 2, "bins must be >= 2");
-            hist.LBinCount = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_l_bins), l_bins);
-            PY_ASSERT_TRUE_MSG(hist.LBinCount >= 2, "l_bins must be >= 2");
+            hist->LBinCount = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_l_bins), l_bins);
+            PY_ASSERT_TRUE_MSG(hist->LBinCount >= 2, "l_bins must be >= 2");
             int a_bins = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_bins),
                                                (COLOR_A_MAX - COLOR_A_MIN + 1));
             PY_ASSERT_TRUE_MSG(a_bins >= 2, "bins must be >= 2");
-            hist.ABinCount = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_a_bins), a_bins);
-            PY_ASSERT_TRUE_MSG(hist.ABinCount >= 2, "a_bins must be >= 2");
+            hist->ABinCount = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_a_bins), a_bins);
+            PY_ASSERT_TRUE_MSG(hist->ABinCount >= 2, "a_bins must be >= 2");
             int b_bins = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_bins),
                                                (COLOR_B_MAX - COLOR_B_MIN + 1));
             PY_ASSERT_TRUE_MSG(b_bins >= 2, "bins must be >= 2");
-            hist.BBinCount = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_b_bins), b_bins);
-            PY_ASSERT_TRUE_MSG(hist.BBinCount >= 2, "b_bins must be >= 2");
+            hist->BBinCount = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_b_bins), b_bins);
+            PY_ASSERT_TRUE_MSG(hist->BBinCount >= 2, "b_bins must be >= 2");
             fb_alloc_mark();
-            hist.LBins = fb_alloc(hist.LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
-            hist.ABins = fb_alloc(hist.ABinCount * sizeof(float), FB_ALLOC_NO_HINT);
-            hist.BBins = fb_alloc(hist.BBinCount * sizeof(float), FB_ALLOC_NO_HINT);
-            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, other);
-            list_free(&thresholds);
+            hist->LBins = fb_alloc(hist->LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
+            hist->ABins = fb_alloc(hist->ABinCount * sizeof(float), FB_ALLOC_NO_HINT);
+            hist->BBins = fb_alloc(hist->BBinCount * sizeof(float), FB_ALLOC_NO_HINT);
             break;
         }
         default: {
-            return MP_OBJ_NULL;
+            mp_raise_msg(&mp_type_ValueError, MP_ERROR_TEXT("Unsupported pixel format"));
         }
     }
+}
 
+// Converts the histogram and frees it with fb_alloc_free_till_mark().
+static mp_obj_t py_image_histogram_obj(histogram_t *hist, pixformat_t pixfmt) {
     py_histogram_obj_t *o = m_new_obj(py_histogram_obj_t);
     o->base.type = &py_histogram_type;
-    o->pixfmt = arg_img->pixfmt;
+    o->pixfmt = pixfmt;
 
-    o->LBins = mp_obj_new_list(hist.LBinCount, NULL);
-    o->ABins = mp_obj_new_list(hist.ABinCount, NULL);
-    o->BBins = mp_obj_new_list(hist.BBinCount, NULL);
+    o->LBins = mp_obj_new_list(hist->LBinCount, NULL);
+    o->ABins = mp_obj_new_list(hist->ABinCount, NULL);
+    o->BBins = mp_obj_new_list(hist->BBinCount, NULL);
 
-    for (int i = 0; i < hist.LBinCount; i++) {
-        ((mp_obj_list_t *) o->LBins)->items[i] = mp_obj_new_float(hist.LBins[i]);
+    for (int i = 0; i < hist->LBinCount; i++) {
+        ((mp_obj_list_t *) o->LBins)->items[i] = mp_obj_new_float(hist->LBins[i]);
     }
 
-    for (int i = 0; i < hist.ABinCount; i++) {
-        ((mp_obj_list_t *) o->ABins)->items[i] = mp_obj_new_float(hist.ABins[i]);
+    for (int i = 0; i < hist->ABinCount; i++) {
+        ((mp_obj_list_t *) o->ABins)->items[i] = mp_obj_new_float(hist->ABins[i]);
     }
 
-    for (int i = 0; i < hist.BBinCount; i++) {
-        ((mp_obj_list_t *) o->BBins)->items[i] = mp_obj_new_float(hist.BBins[i]);
+    for (int i = 0; i < hist->BBinCount; i++) {
+        ((mp_obj_list_t *) o->BBins)->items[i] = mp_obj_new_float(hist->BBins[i]);
     }
 
     fb_alloc_free_till_mark();
 
     return o;
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_get_histogram_obj, 1, py_image_get_histogram);
-
-static mp_obj_t py_image_get_statistics(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
-    image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
-
-    list_t thresholds;
-    list_init(&thresholds, sizeof(color_thresholds_list_lnk_data_t));
-    py_helper_keyword_thresholds(n_args, args, 1, kw_args, &thresholds);
-    bool invert = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_invert), false);
-    image_t *other = py_helper_keyword_to_image(n_args, args, 3, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_difference), NULL);
-
-    rectangle_t roi;
-    py_helper_keyword_rectangle_roi(arg_img, n_args, args, 3, kw_args, &roi);
-
-    histogram_t hist;
-    switch (arg_img->pixfmt) {
-        case PIXFORMAT_BINARY: {
-            int bins = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_bins),
-                                             (COLOR_BINARY_MAX - COLOR_BINARY_MIN + 1));
-            PY_ASSERT_TRUE_MSG(bins >= 2, "bins must be >= 2");
-            hist.LBinCount = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_l_bins), bins);
-            PY_ASSERT_TRUE_MSG(hist.LBinCount >= 2, "l_bins must be >= 2");
-            hist.ABinCount = 0;
-            hist.BBinCount = 0;
-            fb_alloc_mark();
-            hist.LBins = fb_alloc(hist.LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
-            hist.ABins = NULL;
-            hist.BBins = NULL;
-            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, other);
-            list_free(&thresholds);
-            break;
-        }
-        case PIXFORMAT_GRAYSCALE: {
-            int bins = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_bins),
-                                             (COLOR_GRAYSCALE_MAX - COLOR_GRAYSCALE_MIN + 1));
-            PY_ASSERT_TRUE_MSG(bins >= 2, "bins must be >= 2");
-            hist.LBinCount = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_l_bins), bins);
-            PY_ASSERT_TRUE_MSG(hist.LBinCount >= 2, "l_bins must be >= 2");
-            hist.ABinCount = 0;
-            hist.BBinCount = 0;
-            fb_alloc_mark();
-            hist.LBins = fb_alloc(hist.LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
-            hist.ABins = NULL;
-            hist.BBins = NULL;
-            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, other);
-            list_free(&thresholds);
-            break;
-        }
-        case PIXFORMAT_RGB565: {
-            int l_bins = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_bins),
-                                               (COLOR_L_MAX - COLOR_L_MIN + 1));
-            PY_ASSERT_TRUE_MSG(l_bins >= 2, "bins must be >= 2");
-            hist.LBinCount = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_l_bins), l_bins);
-            PY_ASSERT_TRUE_MSG(hist.LBinCount >= 2, "l_bins must be >= 2");
-            int a_bins = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_bins),
-                                               (COLOR_A_MAX - COLOR_A_MIN + 1));
-            PY_ASSERT_TRUE_MSG(a_bins >= 2, "bins must be >= 2");
-            hist.ABinCount = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_a_bins), a_bins);
-            PY_ASSERT_TRUE_MSG(hist.ABinCount >= 2, "a_bins must be >= 2");
-            int b_bins = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_bins),
-                                               (COLOR_B_MAX - COLOR_B_MIN + 1));
-            PY_ASSERT_TRUE_MSG(b_bins >= 2, "bins must be >= 2");
-            hist.BBinCount = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_b_bins), b_bins);
-            PY_ASSERT_TRUE_MSG(hist.BBinCount >= 2, "b_bins must be >= 2");
-            fb_alloc_mark();
-            hist.LBins = fb_alloc(hist.LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
-            hist.ABins = fb_alloc(hist.ABinCount * sizeof(float), FB_ALLOC_NO_HINT);
-            hist.BBins = fb_alloc(hist.BBinCount * sizeof(float), FB_ALLOC_NO_HINT);
-            imlib_get_histogram(&hist, arg_img, &roi, &thresholds, invert, other);
-            list_free(&thresholds);
-            break;
-        }
-        default: {
-            return MP_OBJ_NULL;
-        }
-    }
 
+// Computes the statistics of the histogram and frees it with fb_alloc_free_till_mark().
+static mp_obj_t py_image_statistics_obj(histogram_t *hist, pixformat_t pixfmt) {
     statistics_t stats;
-    imlib_get_statistics(&stats, arg_img->pixfmt, &hist);
+    imlib_get_statistics(&stats, pixfmt, hist);
     fb_alloc_free_till_mark();
 
     py_statistics_obj_t *o = m_new_obj(py_statistics_obj_t);
     o->base.type = &py_statistics_type;
-    o->pixfmt = arg_img->pixfmt;
+    o->pixfmt = pixfmt;
 
     o->LMean = mp_obj_new_int(stats.LMean);
     o->LMedian = mp_obj_new_int(stats.LMedian);
@@ -3880,8 +4054,217 @@ static mp_obj_t py_image_get_statistics(uint n_args, const mp_obj_t *args, mp_ma
 
     return o;
 }
+
+static mp_obj_t py_image_get_histogram(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
+    image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+
+    list_t thresholds;
+    list_init(&thresholds, sizeof(color_thresholds_list_lnk_data_t));
+    py_helper_keyword_thresholds(n_args, args, 1, kw_args, &thresholds);
+    bool invert = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_invert), false);
+    image_t *other = py_helper_keyword_to_image(n_args, args, 3, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_difference), NULL);
+
+    rectangle_t roi;
+    py_helper_keyword_rectangle_roi(arg_img, n_args, args, 3, kw_args, &roi);
+
+    mp_obj_t thresholds_obj =
+        py_helper_keyword_object(n_args, args, 1, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_thresholds), NULL);
+
+    histogram_t hist;
+    py_image_alloc_histogram(&hist, arg_img->pixfmt, n_args, args, kw_args);
+    imlib_get_histogram(&hist, arg_img, &roi, &thresholds, py_image_thresholds_bitmap(thresholds_obj, arg_img),
+                        invert, other);
+    list_free(&thresholds);
+
+    return py_image_histogram_obj(&hist, arg_img->pixfmt);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_get_histogram_obj, 1, py_image_get_histogram);
+
+static mp_obj_t py_image_get_statistics(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
+    image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_MUTABLE);
+
+    list_t thresholds;
+    list_init(&thresholds, sizeof(color_thresholds_list_lnk_data_t));
+    py_helper_keyword_thresholds(n_args, args, 1, kw_args, &thresholds);
+    bool invert = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_invert), false);
+    image_t *other = py_helper_keyword_to_image(n_args, args, 3, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_difference), NULL);
+
+    rectangle_t roi;
+    py_helper_keyword_rectangle_roi(arg_img, n_args, args, 3, kw_args, &roi);
+
+    mp_obj_t thresholds_obj =
+        py_helper_keyword_object(n_args, args, 1, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_thresholds), NULL);
+
+    histogram_t hist;
+    py_image_alloc_histogram(&hist, arg_img->pixfmt, n_args, args, kw_args);
+    imlib_get_histogram(&hist, arg_img, &roi, &thresholds, py_image_thresholds_bitmap(thresholds_obj, arg_img),
+                        invert, other);
+    list_free(&thresholds);
+
+    return py_image_statistics_obj(&hist, arg_img->pixfmt);
+}
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_get_statistics_obj, 1, py_image_get_statistics);
 
+// Histogram Cache Object //
+typedef struct py_histogram_cache_obj {
+    mp_obj_base_t base;
+    mp_obj_t image;
+    uint32_t writes;
+    histogram_cache_t cache;
+} py_histogram_cache_obj_t;
+
+// The default tile size is doubled until the cache fits in a quarter of the heap.
+#define PY_HISTOGRAM_CACHE_HEAP_DIV 4
+
+static void py_histogram_cache_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
+    py_histogram_cache_obj_t *self = self_in;
+    mp_printf(print, "{\"w\":%d, \"h\":%d, \"tile\":%d, \"bins\":%d, \"size\":%d}",
+              self->cache.img.w, self->cache.img.h, self->cache.tile, self->cache.values,
+              (int) (self->cache.tiles_w * self->cache.tiles_h * self->cache.values * sizeof(uint16_t)));
+}
+
+static void py_histogram_cache_build(py_histogram_cache_obj_t *self, image_t *img) {
+    fb_alloc_mark();
+    imlib_histogram_cache_update(&self->cache, img);
+    fb_alloc_free_till_mark();
+    self->writes = py_image_writes;
+}
+
+// Rebuilds the cache if the pixels may have changed since it was built, so that the tile counts
+// always match the pixels scanned along the ROI border. Buffers exposed by bytearray() can change
+// at any time so the cache is rebuilt for every query on them.
+static void py_histogram_cache_refresh(py_histogram_cache_obj_t *self) {
+    image_t *img = py_helper_arg_to_image(self->image, ARG_IMAGE_UNCOMPRESSED);
+
+    if ((img->w != self->cache.img.w) || (img->h != self->cache.img.h) ||
+        (img->pixfmt != self->cache.img.pixfmt)) {
+        mp_raise_msg(&mp_type_ValueError, MP_ERROR_TEXT("Image size and format must match the cache"));
+    }
+
+    if ((self->writes != py_image_writes) || (img->data != self->cache.img.data) || py_image_is_exposed(img)) {
+        py_histogram_cache_build(self, img);
+    }
+}
+
+static void py_histogram_cache_query(py_histogram_cache_obj_t *self, histogram_t *hist, uint n_args,
+                                     const mp_obj_t *args, mp_map_t *kw_args) {
+    py_histogram_cache_refresh(self);
+
+    list_t thresholds;
+    list_init(&thresholds, sizeof(color_thresholds_list_lnk_data_t));
+    py_helper_keyword_thresholds(n_args, args, 1, kw_args, &thresholds);
+    bool invert = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_invert), false);
+
+    rectangle_t roi;
+    py_helper_keyword_rectangle_roi(&self->cache.img, n_args, args, 3, kw_args, &roi);
+
+    py_image_alloc_histogram(hist, self->cache.img.pixfmt, n_args, args, kw_args);
+    imlib_histogram_cache_get_histogram(hist, &self->cache, &roi, &thresholds, invert);
+    list_free(&thresholds);
+}
+
+static mp_obj_t py_histogram_cache_get_histogram(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
+    py_histogram_cache_obj_t *self = args[0];
+    histogram_t hist;
+    py_histogram_cache_query(self, &hist, n_args, args, kw_args);
+    return py_image_histogram_obj(&hist, self->cache.img.pixfmt);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_histogram_cache_get_histogram_obj, 1, py_histogram_cache_get_histogram);
+
+static mp_obj_t py_histogram_cache_get_statistics(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
+    py_histogram_cache_obj_t *self = args[0];
+    histogram_t hist;
+    py_histogram_cache_query(self, &hist, n_args, args, kw_args);
+    return py_image_statistics_obj(&hist, self->cache.img.pixfmt);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_histogram_cache_get_statistics_obj, 1, py_histogram_cache_get_statistics);
+
+// Rebuilds the cache, optionally for a new image of the same geometry.
+static mp_obj_t py_histogram_cache_update(uint n_args, const mp_obj_t *args) {
+    py_histogram_cache_obj_t *self = args[0];
+
+    if (n_args > 1) {
+        image_t *arg_img = py_helper_arg_to_image(args[1], ARG_IMAGE_UNCOMPRESSED);
+        if ((arg_img->w != self->cache.img.w) || (arg_img->h != self->cache.img.h) ||
+            (arg_img->pixfmt != self->cache.img.pixfmt)) {
+            mp_raise_msg(&mp_type_ValueError, MP_ERROR_TEXT("Image size and format must match the cache"));
+        }
+        self->image = args[1];
+    }
+
+    py_histogram_cache_build(self, py_helper_arg_to_image(self->image, ARG_IMAGE_UNCOMPRESSED));
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(py_histogram_cache_update_obj, 1, 2, py_histogram_cache_update);
+
+STATIC const mp_rom_map_elem_t py_histogram_cache_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_get_hist), MP_ROM_PTR(&py_histogram_cache_get_histogram_obj) },
+    { MP_ROM_QSTR(MP_QSTR_get_histogram), MP_ROM_PTR(&py_histogram_cache_get_histogram_obj) },
+    { MP_ROM_QSTR(MP_QSTR_histogram), MP_ROM_PTR(&py_histogram_cache_get_histogram_obj) },
+    { MP_ROM_QSTR(MP_QSTR_get_stats), MP_ROM_PTR(&py_histogram_cache_get_statistics_obj) },
+    { MP_ROM_QSTR(MP_QSTR_get_statistics), MP_ROM_PTR(&py_histogram_cache_get_statistics_obj) },
+    { MP_ROM_QSTR(MP_QSTR_statistics), MP_ROM_PTR(&py_histogram_cache_get_statistics_obj) },
+    { MP_ROM_QSTR(MP_QSTR_update), MP_ROM_PTR(&py_histogram_cache_update_obj) }
+};
+
+STATIC MP_DEFINE_CONST_DICT(py_histogram_cache_locals_dict, py_histogram_cache_locals_dict_table);
+
+STATIC MP_DEFINE_CONST_OBJ_TYPE(
+    py_histogram_cache_type,
+    MP_QSTR_histogram_cache,
+    MP_TYPE_FLAG_NONE,
+    print, py_histogram_cache_print,
+    locals_dict, &py_histogram_cache_locals_dict
+    );
+
+// Builds a tiled histogram cache of the image. get_histogram() and get_statistics() on the cache
+// return the same results as on the image but only scan the ROI border, which pays off when many
+// ROIs of the same frame are queried. The cache is rebuilt on the next query after the image
+// changes. The bins keywords set the bins kept per tile, fewer bins make the cache smaller but
+// queries for other bin counts then scan the whole ROI.
+static mp_obj_t py_image_get_histogram_cache(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
+    image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_UNCOMPRESSED);
+
+    if ((arg_img->pixfmt != PIXFORMAT_BINARY) && (arg_img->pixfmt != PIXFORMAT_GRAYSCALE) &&
+        (arg_img->pixfmt != PIXFORMAT_RGB565)) {
+        mp_raise_msg(&mp_type_ValueError, MP_ERROR_TEXT("Unsupported pixel format"));
+    }
+
+    // Only the bin counts are needed.
+    histogram_t hist;
+    py_image_alloc_histogram(&hist, arg_img->pixfmt, n_args, args, kw_args);
+    fb_alloc_free_till_mark();
+
+    int tile = py_helper_keyword_int(n_args, args, 1, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_tile), 0);
+
+    if (!tile) {
+        gc_info_t info;
+        gc_info(&info);
+        tile = 16;
+
+        while ((imlib_histogram_cache_size(arg_img, tile, hist.LBinCount, hist.ABinCount, hist.BBinCount) >
+                (info.total / PY_HISTOGRAM_CACHE_HEAP_DIV)) && ((tile * 2 * arg_img->w) <= UINT16_MAX)) {
+            tile *= 2;
+        }
+    }
+
+    PY_ASSERT_TRUE_MSG(tile >= 2, "tile must be >= 2");
+    // Running sums along a tile row are 16-bit (see imlib_histogram_cache_get_histogram()).
+    PY_ASSERT_TRUE_MSG((tile * arg_img->w) <= UINT16_MAX, "tile * width must be <= 65535");
+
+    py_histogram_cache_obj_t *o = m_new_obj(py_histogram_cache_obj_t);
+    o->base.type = &py_histogram_cache_type;
+    o->image = args[0];
+    o->writes = py_image_writes;
+
+    size_t size = imlib_histogram_cache_size(arg_img, tile, hist.LBinCount, hist.ABinCount, hist.BBinCount);
+    fb_alloc_mark();
+    imlib_histogram_cache_init(&o->cache, arg_img, tile, hist.LBinCount, hist.ABinCount, hist.BBinCount, xalloc(size));
+    fb_alloc_free_till_mark();
+    return o;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_get_histogram_cache_obj, 1, py_image_get_histogram_cache);
+
 // Line Object //
 #define py_line_obj_size    8
 typedef struct py_line_obj {
@@ -4635,6 +5018,10 @@ static mp_obj_t py_image_find_blobs(uint n_args, const mp_obj_t *args, mp_map_t
         py_helper_keyword_int(n_args, args, 12, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_x_hist_bins_max), 0);
     unsigned int y_hist_bins_max =
         py_helper_keyword_int(n_args, args, 13, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_y_hist_bins_max), 0);
+    find_blobs_mode_t mode =
+        py_helper_keyword_int(n_args, args, 14, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_mode), FIND_BLOBS_MODE_FLOOD_FILL);
+    PY_ASSERT_TRUE_MSG((mode == FIND_BLOBS_MODE_FLOOD_FILL) || (mode == FIND_BLOBS_MODE_SINGLE_PASS),
+                       "Invalid find_blobs() mode!");
 
     list_t out;
     fb_alloc_mark();
@@ -4644,6 +5031,7 @@ static mp_obj_t py_image_find_blobs(uint n_args, const mp_obj_t *args, mp_map_t
                      x_stride,
                      y_stride,
                      &thresholds,
+                     py_image_thresholds_bitmap(args[1], arg_img),
                      invert,
                      area_threshold,
                      pixels_threshold,
@@ -4654,7 +5042,8 @@ static mp_obj_t py_image_find_blobs(uint n_args, const mp_obj_t *args, mp_map_t
                      py_image_find_blobs_merge_cb,
                      merge_cb,
                      x_hist_bins_max,
-                     y_hist_bins_max);
+                     y_hist_bins_max,
+                     mode);
     fb_alloc_free_till_mark();
     list_free(&thresholds);
 
@@ -4689,10 +5078,12 @@ static mp_obj_t py_image_find_lines(uint n_args, const mp_obj_t *args, mp_map_t
     uint32_t threshold = py_helper_keyword_int(n_args, args, 4, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_threshold), 1000);
     unsigned int theta_margin = py_helper_keyword_int(n_args, args, 5, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_theta_margin), 25);
     unsigned int rho_margin = py_helper_keyword_int(n_args, args, 6, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_rho_margin), 25);
+    unsigned int theta_window =
+        py_helper_keyword_int(n_args, args, 7, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_theta_window), 0);
 
     list_t out;
     fb_alloc_mark();
-    imlib_find_lines(&out, arg_img, &roi, x_stride, y_stride, threshold, theta_margin, rho_margin);
+    imlib_find_lines(&out, arg_img, &roi, x_stride, y_stride, threshold, theta_margin, rho_margin, theta_window);
     fb_alloc_free_till_mark();
 
     mp_obj_list_t *objects_list = mp_obj_new_list(list_size(&out), NULL);
@@ -5008,7 +5399,7 @@ static mp_obj_t py_image_find_rects(uint n_args, const mp_obj_t *args, mp_map_t
 
     list_t out;
     fb_alloc_mark();
-    imlib_find_rects(&out, arg_img, &roi, threshold);
+    imlib_find_rects(&out, arg_img, &roi, threshold, py_image_planes(arg_img));
     fb_alloc_free_till_mark();
 
     mp_obj_list_t *objects_list = mp_obj_new_list(list_size(&out), NULL);
@@ -5045,6 +5436,50 @@ static mp_obj_t py_image_find_rects(uint n_args, const mp_obj_t *args, mp_map_t
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_find_rects_obj, 1, py_image_find_rects);
 #endif // IMLIB_ENABLE_FIND_RECTS
 
+// ROI Tracker Object //
+typedef struct py_roi_tracker_obj {
+    mp_obj_base_t base;
+    roi_tracker_t _cobj;
+} py_roi_tracker_obj_t;
+
+static void py_roi_tracker_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
+    py_roi_tracker_obj_t *self = self_in;
+    mp_printf(print, "{\"interval\":%d, \"expand\":%f, \"frame\":%d, \"tracked\":%d}",
+              self->_cobj.interval, (double) self->_cobj.expand, self->_cobj.frame, self->_cobj.count);
+}
+
+mp_obj_t py_roi_tracker_reset(mp_obj_t self_in) {
+    roi_tracker_reset(&((py_roi_tracker_obj_t *) self_in)->_cobj);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_roi_tracker_reset_obj, py_roi_tracker_reset);
+
+STATIC const mp_rom_map_elem_t py_roi_tracker_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_reset), MP_ROM_PTR(&py_roi_tracker_reset_obj) }
+};
+
+STATIC MP_DEFINE_CONST_DICT(py_roi_tracker_locals_dict, py_roi_tracker_locals_dict_table);
+
+STATIC MP_DEFINE_CONST_OBJ_TYPE(
+    py_roi_tracker_type,
+    MP_QSTR_ROITracker,
+    MP_TYPE_FLAG_NONE,
+    print, py_roi_tracker_print,
+    locals_dict, &py_roi_tracker_locals_dict
+    );
+
+// Returns the tracker passed with the tracker keyword or NULL.
+static roi_tracker_t *py_roi_tracker_keyword(mp_map_t *kw_args) {
+    mp_map_elem_t *kw_arg = mp_map_lookup(kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_tracker), MP_MAP_LOOKUP);
+
+    if ((!kw_arg) || (kw_arg->value == mp_const_none)) {
+        return NULL;
+    }
+
+    PY_ASSERT_TYPE(kw_arg->value, &py_roi_tracker_type);
+    return &((py_roi_tracker_obj_t *) kw_arg->value)->_cobj;
+}
+
 #ifdef IMLIB_ENABLE_QRCODES
 // QRCode Object //
 #define py_qrcode_obj_size    10
@@ -5213,15 +5648,26 @@ STATIC MP_DEFINE_CONST_OBJ_TYPE(
     locals_dict, &py_qrcode_locals_dict
     );
 
+static void py_image_find_qrcodes_cb(list_t *out, image_t *ptr, rectangle_t *roi, void *data) {
+    imlib_find_qrcodes(out, ptr, roi, py_image_planes(ptr));
+}
+
 static mp_obj_t py_image_find_qrcodes(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_image_cobj(args[0]);
 
     rectangle_t roi;
     py_helper_keyword_rectangle_roi(arg_img, n_args, args, 1, kw_args, &roi);
 
+    roi_tracker_t *tracker = py_roi_tracker_keyword(kw_args);
+
     list_t out;
     fb_alloc_mark();
-    imlib_find_qrcodes(&out, arg_img, &roi);
+    if (tracker) {
+        imlib_roi_tracker_find(tracker, &out, arg_img, &roi, offsetof(find_qrcodes_list_lnk_data_t, rect),
+                               py_image_find_qrcodes_cb, NULL);
+    } else {
+        imlib_find_qrcodes(&out, arg_img, &roi, py_image_planes(arg_img));
+    }
     fb_alloc_free_till_mark();
 
     mp_obj_list_t *objects_list = mp_obj_new_list(list_size(&out), NULL);
@@ -5488,15 +5934,31 @@ STATIC MP_DEFINE_CONST_OBJ_TYPE(
     locals_dict, &py_apriltag_locals_dict
     );
 
+typedef struct py_image_find_apriltags_args {
+    apriltag_families_t families;
+    float fx, fy, cx, cy;
+    int quad_decimate;
+} py_image_find_apriltags_args_t;
+
+static void py_image_find_apriltags_cb(list_t *out, image_t *ptr, rectangle_t *roi, void *data) {
+    py_image_find_apriltags_args_t *args = data;
+    imlib_find_apriltags(out, ptr, roi, args->families, args->fx, args->fy, args->cx, args->cy, args->quad_decimate,
+                         py_image_planes(ptr));
+}
+
 static mp_obj_t py_image_find_apriltags(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_image_cobj(args[0]);
 
     rectangle_t roi;
     py_helper_keyword_rectangle_roi(arg_img, n_args, args, 1, kw_args, &roi);
+    // Quads are found on an image decimated by this factor, tags are decoded at full resolution.
+    int quad_decimate = py_helper_keyword_int(n_args, args, 7, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_quad_decimate), 1);
+    PY_ASSERT_TRUE_MSG((1 <= quad_decimate) && (quad_decimate <= 4), "quad_decimate must be between 1 and 4");
 #ifndef IMLIB_ENABLE_HIGH_RES_APRILTAGS
-    PY_ASSERT_TRUE_MSG((roi.w * roi.h) < 65536, "The maximum supported resolution for find_apriltags() is < 64K pixels.");
+    PY_ASSERT_TRUE_MSG(((roi.w / quad_decimate) * (roi.h / quad_decimate)) < 65536,
+                       "The maximum supported resolution for find_apriltags() is < 64K pixels (after quad_decimate).");
 #endif
-    if ((roi.w < 4) || (roi.h < 4)) {
+    if (((roi.w / quad_decimate) < 4) || ((roi.h / quad_decimate) < 4)) {
         return mp_obj_new_list(0, NULL);
     }
 
@@ -5510,9 +5972,18 @@ static mp_obj_t py_image_find_apriltags(uint n_args, const mp_obj_t *args, mp_ma
     // Use the image versus the roi here since the image should be projected from the camera center.
     float cy = py_helper_keyword_float(n_args, args, 6, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_cy), arg_img->h * 0.5);
 
+    roi_tracker_t *tracker = py_roi_tracker_keyword(kw_args);
+
     list_t out;
     fb_alloc_mark();
-    imlib_find_apriltags(&out, arg_img, &roi, families, fx, fy, cx, cy);
+    if (tracker) {
+        py_image_find_apriltags_args_t cb_args = { families, fx, fy, cx, cy, quad_decimate };
+        imlib_roi_tracker_find(tracker, &out, arg_img, &roi, offsetof(find_apriltags_list_lnk_data_t, rect),
+                               py_image_find_apriltags_cb, &cb_args);
+    } else {
+        imlib_find_apriltags(&out, arg_img, &roi, families, fx, fy, cx, cy, quad_decimate,
+                             py_image_planes(arg_img));
+    }
     fb_alloc_free_till_mark();
 
     mp_obj_list_t *objects_list = mp_obj_new_list(list_size(&out), NULL);
@@ -5706,6 +6177,10 @@ STATIC MP_DEFINE_CONST_OBJ_TYPE(
     locals_dict, &py_datamatrix_locals_dict
     );
 
+static void py_image_find_datamatrices_cb(list_t *out, image_t *ptr, rectangle_t *roi, void *data) {
+    imlib_find_datamatrices(out, ptr, roi, *((int *) data), py_image_planes(ptr));
+}
+
 static mp_obj_t py_image_find_datamatrices(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_image_cobj(args[0]);
 
@@ -5714,9 +6189,16 @@ static mp_obj_t py_image_find_datamatrices(uint n_args, const mp_obj_t *args, mp
 
     int effort = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_effort), 200);
 
+    roi_tracker_t *tracker = py_roi_tracker_keyword(kw_args);
+
     list_t out;
     fb_alloc_mark();
-    imlib_find_datamatrices(&out, arg_img, &roi, effort);
+    if (tracker) {
+        imlib_roi_tracker_find(tracker, &out, arg_img, &roi, offsetof(find_datamatrices_list_lnk_data_t, rect),
+                               py_image_find_datamatrices_cb, &effort);
+    } else {
+        imlib_find_datamatrices(&out, arg_img, &roi, effort, py_image_planes(arg_img));
+    }
     fb_alloc_free_till_mark();
 
     mp_obj_list_t *objects_list = mp_obj_new_list(list_size(&out), NULL);
@@ -5893,9 +6375,11 @@ static mp_obj_t py_image_find_barcodes(uint n_args, const mp_obj_t *args, mp_map
     rectangle_t roi;
     py_helper_keyword_rectangle_roi(arg_img, n_args, args, 1, kw_args, &roi);
 
+    bool fast = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_fast), false);
+
     list_t out;
     fb_alloc_mark();
-    imlib_find_barcodes(&out, arg_img, &roi);
+    imlib_find_barcodes(&out, arg_img, &roi, fast, py_image_planes(arg_img));
     fb_alloc_free_till_mark();
 
     mp_obj_list_t *objects_list = mp_obj_new_list(list_size(&out), NULL);
@@ -6084,9 +6568,9 @@ static mp_obj_t py_image_find_template(uint n_args, const mp_obj_t *args, mp_map
     float corr;
     fb_alloc_mark();
     if (search == SEARCH_DS) {
-        corr = imlib_template_match_ds(arg_img, arg_template, &r);
+        corr = imlib_template_match_ds(arg_img, arg_template, &r, py_image_planes(arg_img));
     } else {
-        corr = imlib_template_match_ex(arg_img, arg_template, &roi, step, &r);
+        corr = imlib_template_match_ex(arg_img, arg_template, &roi, step, &r, py_image_planes(arg_img));
     }
     fb_alloc_free_till_mark();
 
@@ -6114,13 +6598,15 @@ static mp_obj_t py_image_find_features(uint n_args, const mp_obj_t *args, mp_map
     rectangle_t roi;
     py_helper_keyword_rectangle_roi(arg_img, n_args, args, 4, kw_args, &roi);
 
+    bool pyramid = py_helper_keyword_int(n_args, args, 5, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_pyramid), false);
+
     // Make sure ROI is bigger than feature size
     PY_ASSERT_TRUE_MSG((roi.w > cascade->window.w && roi.h > cascade->window.h),
                        "Region of interest is smaller than detector window!");
 
     // Detect objects
     fb_alloc_mark();
-    array_t *objects_array = imlib_detect_objects(arg_img, cascade, &roi);
+    array_t *objects_array = imlib_detect_objects(arg_img, cascade, &roi, pyramid);
     fb_alloc_free_till_mark();
 
     // Add detected objects to a new Python list...
@@ -6218,6 +6704,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_find_keypoints_obj, 1, py_image_find_
 #ifdef IMLIB_ENABLE_BINARY_OPS
 static mp_obj_t py_image_find_edges(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_GRAYSCALE);
+    py_image_invalidate_planes(arg_img);
     edge_detector_t edge_type = mp_obj_get_int(args[1]);
 
     rectangle_t roi;
@@ -6257,6 +6744,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_find_edges_obj, 2, py_image_find_edge
 #ifdef IMLIB_ENABLE_HOG
 static mp_obj_t py_image_find_hog(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *arg_img = py_helper_arg_to_image(args[0], ARG_IMAGE_GRAYSCALE);
+    py_image_invalidate_planes(arg_img);
 
     rectangle_t roi;
     py_helper_keyword_rectangle_roi(arg_img, n_args, args, 1, kw_args, &roi);
@@ -6304,6 +6792,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_selective_search_obj, 1, py_image_sel
 #ifdef IMLIB_ENABLE_STEREO_DISPARITY
 static mp_obj_t py_image_stereo_disparity(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     image_t *img = py_helper_arg_to_image(args[0], ARG_IMAGE_GRAYSCALE);
+    py_image_invalidate_planes(img);
 
     if (img->w % 2) {
         mp_raise_msg(&mp_type_ValueError, MP_ERROR_TEXT("Image width must be even!"));
@@ -6364,6 +6853,9 @@ static const mp_rom_map_elem_t locals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_compress_for_ide),    MP_ROM_PTR(&py_image_compress_for_ide_obj)},
     {MP_ROM_QSTR(MP_QSTR_compressed),          MP_ROM_PTR(&py_image_compressed_obj)},
     {MP_ROM_QSTR(MP_QSTR_compressed_for_ide),  MP_ROM_PTR(&py_image_compressed_for_ide_obj)},
+    #if (OMV_JPEG_CODEC_ENABLE == 0)
+    {MP_ROM_QSTR(MP_QSTR_compress_stream),     MP_ROM_PTR(&py_image_compress_stream_obj)},
+    #endif
     {MP_ROM_QSTR(MP_QSTR_jpeg_encode_for_ide), MP_ROM_PTR(&py_image_compress_for_ide_obj)},
     {MP_ROM_QSTR(MP_QSTR_jpeg_encoded_for_ide), MP_ROM_PTR(&py_image_compressed_for_ide_obj)},
     {MP_ROM_QSTR(MP_QSTR_copy),                MP_ROM_PTR(&py_image_copy_obj)},
@@ -6554,6 +7046,7 @@ static const mp_rom_map_elem_t locals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_get_hist),            MP_ROM_PTR(&py_image_get_histogram_obj)},
     {MP_ROM_QSTR(MP_QSTR_get_histogram),       MP_ROM_PTR(&py_image_get_histogram_obj)},
     {MP_ROM_QSTR(MP_QSTR_histogram),           MP_ROM_PTR(&py_image_get_histogram_obj)},
+    {MP_ROM_QSTR(MP_QSTR_get_histogram_cache), MP_ROM_PTR(&py_image_get_histogram_cache_obj)},
     {MP_ROM_QSTR(MP_QSTR_get_stats),           MP_ROM_PTR(&py_image_get_statistics_obj)},
     {MP_ROM_QSTR(MP_QSTR_get_statistics),      MP_ROM_PTR(&py_image_get_statistics_obj)},
     {MP_ROM_QSTR(MP_QSTR_statistics),          MP_ROM_PTR(&py_image_get_statistics_obj)},
@@ -6892,6 +7385,7 @@ mp_obj_t py_image(int w, int h, pixformat_t pixfmt, uint32_t size, void *pixels)
     o->_cobj.size = size;
     o->_cobj.pixfmt = pixfmt;
     o->_cobj.pixels = pixels;
+    py_image_invalidate_planes(&o->_cobj);
     return o;
 }
 
@@ -6899,6 +7393,7 @@ mp_obj_t py_image_from_struct(image_t *img) {
     py_image_obj_t *o = m_new_obj(py_image_obj_t);
     o->base.type = &py_image_type;
     o->_cobj = *img;
+    py_image_invalidate_planes(&o->_cobj);
     return o;
 }
 
@@ -6976,6 +7471,41 @@ mp_obj_t py_image_load_image(uint n_args, const mp_obj_t *pos_args, mp_map_t *kw
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_load_image_obj, 1, py_image_load_image);
 
+mp_obj_t py_image_roi_tracker(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
+    int interval = py_helper_keyword_int(n_args, args, 0, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_interval), 10);
+    PY_ASSERT_TRUE_MSG((0 <= interval) && (interval <= UINT16_MAX), "interval must be between 0 and 65535");
+    float expand = py_helper_keyword_float(n_args, args, 1, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_expand), 0.5f);
+    PY_ASSERT_TRUE_MSG(expand >= 0.0f, "expand must be >= 0");
+
+    py_roi_tracker_obj_t *o = m_new_obj(py_roi_tracker_obj_t);
+    o->base.type = &py_roi_tracker_type;
+    roi_tracker_init(&o->_cobj, interval, expand);
+    return o;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_image_roi_tracker_obj, 0, py_image_roi_tracker);
+
+// Compiles RGB565 thresholds once for binary(), get_histogram(), get_statistics() and find_blobs().
+mp_obj_t py_image_thresholds(mp_obj_t thresholds_obj) {
+    list_t thresholds;
+    list_init(&thresholds, sizeof(color_thresholds_list_lnk_data_t));
+    py_helper_arg_to_thresholds(thresholds_obj, &thresholds);
+    PY_ASSERT_TRUE_MSG(list_size(&thresholds), "thresholds must not be empty");
+
+    // Keep a copy so that the list and the compiled thresholds can't get out of sync.
+    size_t len;
+    mp_obj_t *items;
+    mp_obj_get_array(py_image_thresholds_list(thresholds_obj), &len, &items);
+
+    py_thresholds_obj_t *o = m_new_obj(py_thresholds_obj_t);
+    o->base.type = &py_thresholds_type;
+    o->thresholds = mp_obj_new_tuple(len, items);
+    imlib_color_thresholds_bitmap_init(&o->bitmap, &thresholds,
+                                       xalloc(imlib_color_thresholds_bitmap_size(&thresholds)));
+    list_free(&thresholds);
+    return o;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_image_thresholds_obj, py_image_thresholds);
+
 #ifdef IMLIB_ENABLE_FEATURES
 mp_obj_t py_image_load_cascade(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     cascade_t cascade;
@@ -7263,6 +7793,8 @@ static const mp_rom_map_elem_t globals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_JPEG_SUBSAMPLING_444), MP_ROM_INT(JPEG_SUBSAMPLING_444)},
     {MP_ROM_QSTR(MP_QSTR_JPEG_SUBSAMPLING_422), MP_ROM_INT(JPEG_SUBSAMPLING_422)},
     {MP_ROM_QSTR(MP_QSTR_JPEG_SUBSAMPLING_420), MP_ROM_INT(JPEG_SUBSAMPLING_420)},
+    {MP_ROM_QSTR(MP_QSTR_FIND_BLOBS_FLOOD_FILL),  MP_ROM_INT(FIND_BLOBS_MODE_FLOOD_FILL)},
+    {MP_ROM_QSTR(MP_QSTR_FIND_BLOBS_SINGLE_PASS), MP_ROM_INT(FIND_BLOBS_MODE_SINGLE_PASS)},
     #ifdef IMLIB_FIND_TEMPLATE
     {MP_ROM_QSTR(MP_QSTR_SEARCH_EX),           MP_ROM_INT(SEARCH_EX)},
     {MP_ROM_QSTR(MP_QSTR_SEARCH_DS),           MP_ROM_INT(SEARCH_DS)},
@@ -7323,6 +7855,8 @@ static const mp_rom_map_elem_t globals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_yuv_to_rgb),          MP_ROM_PTR(&py_image_yuv_to_rgb_obj)},
     {MP_ROM_QSTR(MP_QSTR_yuv_to_lab),          MP_ROM_PTR(&py_image_yuv_to_lab_obj)},
     {MP_ROM_QSTR(MP_QSTR_Image),               MP_ROM_PTR(&py_image_load_image_obj)},
+    {MP_ROM_QSTR(MP_QSTR_ROITracker),          MP_ROM_PTR(&py_image_roi_tracker_obj)},
+    {MP_ROM_QSTR(MP_QSTR_Thresholds),          MP_ROM_PTR(&py_image_thresholds_obj)},
     #ifdef IMLIB_ENABLE_FEATURES
     {MP_ROM_QSTR(MP_QSTR_HaarCascade),         MP_ROM_PTR(&py_image_load_cascade_obj)},
     #endif
@@ -7347,4 +7881,5 @@ const mp_obj_module_t image_module = {
     .globals = (mp_obj_t) &globals_dict
 };
 
+MP_REGISTER_ROOT_POINTER(struct image_planes *image_planes);
 MP_REGISTER_MODULE(MP_QSTR_image, image_module);
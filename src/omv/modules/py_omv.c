@@ -14,6 +14,7 @@
 #include "py/obj.h"
 #include "usbdbg.h"
 #include "framebuffer.h"
+#include "fb_alloc.h"
 #include "omv_boardconfig.h"
 
 static mp_obj_t py_omv_version_string() {
@@ -57,6 +58,71 @@ static mp_obj_t py_omv_disable_fb(uint n_args, const mp_obj_t *args) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(py_omv_disable_fb_obj, 0, 1, py_omv_disable_fb);
 
+#if defined(FB_ALLOC_STATS)
+// Returns a dict with the fb_alloc peaks and counters. "allocs" holds a tuple per call site of
+// (address, allocs, bytes, max bytes, live bytes, fast allocs, slow allocs) and "marks" holds a
+// tuple per mark site of (address, frames, peak). Pass reset=True to restart the stats after.
+static mp_obj_t py_omv_fb_alloc_stats(uint n_args, const mp_obj_t *args) {
+    const fb_alloc_stats_t *stats = fb_alloc_stats();
+    mp_obj_t allocs = mp_obj_new_list(0, NULL);
+    mp_obj_t marks = mp_obj_new_list(0, NULL);
+
+    for (int i = 0; i < FB_ALLOC_STATS_SITES; i++) {
+        const fb_alloc_site_stats_t *s = &stats->sites[i];
+        if (!s->site) {
+            break;
+        }
+        if (s->mark) {
+            mp_obj_t tuple[3] = {
+                mp_obj_new_int_from_uint((uintptr_t) s->site),
+                mp_obj_new_int_from_uint(s->allocs),
+                mp_obj_new_int_from_uint(s->frame_peak)
+            };
+            mp_obj_list_append(marks, mp_obj_new_tuple(3, tuple));
+        } else {
+            mp_obj_t tuple[7] = {
+                mp_obj_new_int_from_uint((uintptr_t) s->site),
+                mp_obj_new_int_from_uint(s->allocs),
+                mp_obj_new_int_from_uint(s->bytes),
+                mp_obj_new_int_from_uint(s->max_bytes),
+                mp_obj_new_int_from_uint(s->live_bytes),
+                mp_obj_new_int_from_uint(s->fast_allocs),
+                mp_obj_new_int_from_uint(s->slow_allocs)
+            };
+            mp_obj_list_append(allocs, mp_obj_new_tuple(7, tuple));
+        }
+    }
+
+    mp_obj_t dict = mp_obj_new_dict(0);
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_peak), mp_obj_new_int_from_uint(stats->peak));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_overlay_peak), mp_obj_new_int_from_uint(stats->overlay_peak));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_count), mp_obj_new_int_from_uint(stats->allocs));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_dropped), mp_obj_new_int_from_uint(stats->dropped));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_fails), mp_obj_new_int_from_uint(stats->fails));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_fail_site), mp_obj_new_int_from_uint((uintptr_t) stats->fail_site));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_fail_bytes), mp_obj_new_int_from_uint(stats->fail_bytes));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_allocs), allocs);
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_marks), marks);
+
+    if (n_args && mp_obj_is_true(args[0])) {
+        fb_alloc_stats_reset();
+    }
+
+    return dict;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(py_omv_fb_alloc_stats_obj, 0, 1, py_omv_fb_alloc_stats);
+
+// Prints the stats (e.g. once per frame) and optionally restarts them.
+static mp_obj_t py_omv_fb_alloc_stats_print(uint n_args, const mp_obj_t *args) {
+    fb_alloc_stats_print();
+    if (n_args && mp_obj_is_true(args[0])) {
+        fb_alloc_stats_reset();
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(py_omv_fb_alloc_stats_print_obj, 0, 1, py_omv_fb_alloc_stats_print);
+#endif
+
 static const mp_rom_map_elem_t globals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__),        MP_OBJ_NEW_QSTR(MP_QSTR_omv) },
     { MP_ROM_QSTR(MP_QSTR_version_major),   MP_ROM_INT(FIRMWARE_VERSION_MAJOR) },
@@ -66,7 +132,11 @@ static const mp_rom_map_elem_t globals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_arch),            MP_ROM_PTR(&py_omv_arch_obj) },
     { MP_ROM_QSTR(MP_QSTR_board_type),      MP_ROM_PTR(&py_omv_board_type_obj) },
     { MP_ROM_QSTR(MP_QSTR_board_id),        MP_ROM_PTR(&py_omv_board_id_obj) },
-    { MP_ROM_QSTR(MP_QSTR_disable_fb),      MP_ROM_PTR(&py_omv_disable_fb_obj) }
+    { MP_ROM_QSTR(MP_QSTR_disable_fb),      MP_ROM_PTR(&py_omv_disable_fb_obj) },
+    #if defined(FB_ALLOC_STATS)
+    { MP_ROM_QSTR(MP_QSTR_fb_alloc_stats),  MP_ROM_PTR(&py_omv_fb_alloc_stats_obj) },
+    { MP_ROM_QSTR(MP_QSTR_fb_alloc_stats_print), MP_ROM_PTR(&py_omv_fb_alloc_stats_print_obj) },
+    #endif
 };
 
 STATIC MP_DEFINE_CONST_DICT(globals_dict, globals_dict_table);
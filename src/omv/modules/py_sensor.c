@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include "py/mphal.h"
 #include "py/runtime.h"
+#include "py/objlist.h"
 
 #if MICROPY_PY_SENSOR
 
@@ -128,6 +129,9 @@ static mp_obj_t py_sensor_snapshot(uint n_args, const mp_obj_t *args, mp_map_t *
     if (error != 0) {
         sensor_raise_error(error);
     }
+    // The new frame may be in the same buffer as the last one, and planes of older frames are not
+    // worth keeping on the heap.
+    py_image_free_planes();
     return image;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_sensor_snapshot_obj, 0, py_sensor_snapshot);
@@ -182,6 +186,29 @@ static mp_obj_t py_sensor_get_fb() {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(py_sensor_get_fb_obj, py_sensor_get_fb);
 
+// Returns the current frame as an image that stays valid across snapshot() calls until it is
+// passed to release_fb(). The image points into the frame buffer, no copy is made.
+static mp_obj_t py_sensor_lease_fb() {
+    if (framebuffer_get_depth() < 0) {
+        return mp_const_none;
+    }
+
+    image_t image;
+    framebuffer_init_image(&image);
+
+    PY_ASSERT_TRUE_MSG(framebuffer->n_buffers > 2, "Leasing frames requires 3 or more frame buffers");
+    PY_ASSERT_TRUE_MSG(framebuffer_lease_current_buffer(), "No frame buffers left to lease");
+    return py_image_from_struct(&image);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(py_sensor_lease_fb_obj, py_sensor_lease_fb);
+
+static mp_obj_t py_sensor_release_fb(mp_obj_t img_obj) {
+    image_t *image = py_image_cobj(img_obj);
+    PY_ASSERT_TRUE_MSG(framebuffer_release_buffer(image->pixels) == 0, "Image is not a leased frame buffer");
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_sensor_release_fb_obj, py_sensor_release_fb);
+
 static mp_obj_t py_sensor_get_id() {
     return mp_obj_new_int(sensor_get_id());
 }
@@ -727,6 +754,136 @@ static mp_obj_t py_sensor_set_frame_callback(mp_obj_t frame_callback_obj) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_sensor_set_frame_callback_obj, py_sensor_set_frame_callback);
 
+static mp_obj_t py_sensor_set_line_ops(uint n_args, const mp_obj_t *args, mp_map_t *kw_args) {
+    uint32_t ops = mp_obj_get_int(args[0]) & (SENSOR_LINE_OP_HISTOGRAM | SENSOR_LINE_OP_STATISTICS |
+                                              SENSOR_LINE_OP_THRESHOLD | SENSOR_LINE_OP_DOWNSCALE);
+
+    if (!ops) {
+        sensor_set_line_ops(NULL);
+        MP_STATE_PORT(sensor_line_ops_data) = NULL;
+        return mp_const_none;
+    }
+
+    int threshold[2] = {128, 255};
+    py_helper_keyword_int_array(n_args, args, 1, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_threshold), threshold, 2);
+    int scale = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_scale), 2);
+
+    PY_ASSERT_FALSE_MSG(sensor.transpose, "Line operations are not supported while transposing!");
+    PY_ASSERT_TRUE_MSG((sensor.pixformat == PIXFORMAT_GRAYSCALE) || (sensor.pixformat == PIXFORMAT_RGB565) ||
+                       (sensor.pixformat == PIXFORMAT_BAYER) || (sensor.pixformat == PIXFORMAT_YUV422),
+                       "Line operations are not supported for this pixel format!");
+    PY_ASSERT_TRUE_MSG(MAIN_FB()->u && MAIN_FB()->v, "Frame size is not set!");
+    PY_ASSERT_TRUE_MSG((0 <= threshold[0]) && (threshold[0] <= threshold[1]) && (threshold[1] <= 255),
+                       "Threshold must be 0 <= min <= max <= 255!");
+    PY_ASSERT_TRUE_MSG((1 <= scale) && (scale <= 16), "Scale must be between 1 and 16!");
+
+    uint32_t w = MAIN_FB()->u;
+    uint32_t h = MAIN_FB()->v;
+
+    // Drop the previous operations before allocating new buffers.
+    sensor_set_line_ops(NULL);
+    MP_STATE_PORT(sensor_line_ops_data) = NULL;
+
+    sensor_line_ops_t *line_ops = xalloc0(sizeof(sensor_line_ops_t));
+    line_ops->ops = ops;
+    line_ops->w = w;
+    line_ops->h = h;
+    line_ops->threshold_min = threshold[0];
+    line_ops->threshold_max = threshold[1];
+    line_ops->scale = scale;
+    line_ops->n_results = IM_MIN(framebuffer->n_buffers, SENSOR_LINE_OPS_MAX_BUFFERS);
+
+    if (ops & SENSOR_LINE_OP_DOWNSCALE) {
+        line_ops->downscale_acc = xalloc0(((w / scale) + 1) * sizeof(uint16_t));
+    }
+
+    // One result set per frame buffer so results stay valid while the next frame is captured.
+    for (int i = 0; i < line_ops->n_results; i++) {
+        sensor_line_result_t *result = &line_ops->results[i];
+
+        if (ops & SENSOR_LINE_OP_HISTOGRAM) {
+            result->histogram = xalloc0(256 * sizeof(uint32_t));
+        }
+
+        if (ops & SENSOR_LINE_OP_STATISTICS) {
+            result->stats = xalloc0(h * sizeof(sensor_line_stats_t));
+        }
+
+        if (ops & SENSOR_LINE_OP_THRESHOLD) {
+            result->binary = xalloc0(((w + UINT32_T_MASK) >> UINT32_T_SHIFT) * h * sizeof(uint32_t));
+        }
+
+        if (ops & SENSOR_LINE_OP_DOWNSCALE) {
+            result->downscaled = xalloc0(IM_MAX(w / scale, 1) * IM_MAX(h / scale, 1));
+        }
+    }
+
+    int error = sensor_set_line_ops(line_ops);
+    if (error != 0) {
+        sensor_raise_error(error);
+    }
+
+    MP_STATE_PORT(sensor_line_ops_data) = line_ops;
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_sensor_set_line_ops_obj, 1, py_sensor_set_line_ops);
+
+static mp_obj_t py_sensor_get_line_results() {
+    sensor_line_result_t *result = sensor_get_line_result();
+
+    if (result == NULL) {
+        return mp_const_none;
+    }
+
+    sensor_line_ops_t *line_ops = sensor.line_ops;
+    mp_obj_t histogram = mp_const_none;
+    mp_obj_t stats = mp_const_none;
+    mp_obj_t binary = mp_const_none;
+    mp_obj_t downscaled = mp_const_none;
+
+    if (result->histogram) {
+        histogram = mp_obj_new_list(256, NULL);
+        for (int i = 0; i < 256; i++) {
+            ((mp_obj_list_t *) histogram)->items[i] = mp_obj_new_int(result->histogram[i]);
+        }
+    }
+
+    if (result->stats) {
+        stats = mp_obj_new_list(line_ops->h, NULL);
+        for (int i = 0; i < line_ops->h; i++) {
+            sensor_line_stats_t *line = &result->stats[i];
+            ((mp_obj_list_t *) stats)->items[i] = mp_obj_new_tuple(3, (mp_obj_t []) {
+                mp_obj_new_int(line->sum / line_ops->w),
+                mp_obj_new_int(line->min),
+                mp_obj_new_int(line->max)
+            });
+        }
+    }
+
+    if (result->binary) {
+        image_t image = {
+            .w = line_ops->w,
+            .h = line_ops->h,
+            .pixfmt = PIXFORMAT_BINARY,
+            .data = (uint8_t *) result->binary
+        };
+        binary = py_image_from_struct(&image);
+    }
+
+    if (result->downscaled) {
+        image_t image = {
+            .w = IM_MAX(line_ops->w / line_ops->scale, 1),
+            .h = IM_MAX(line_ops->h / line_ops->scale, 1),
+            .pixfmt = PIXFORMAT_GRAYSCALE,
+            .data = result->downscaled
+        };
+        downscaled = py_image_from_struct(&image);
+    }
+
+    return mp_obj_new_tuple(4, (mp_obj_t []) {histogram, stats, binary, downscaled});
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(py_sensor_get_line_results_obj, py_sensor_get_line_results);
+
 static mp_obj_t py_sensor_ioctl(uint n_args, const mp_obj_t *args) {
     mp_obj_t ret_obj = mp_const_none;
     int request = mp_obj_get_int(args[0]);
@@ -1117,6 +1274,12 @@ STATIC const mp_rom_map_elem_t globals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_TRIPLE_BUFFER),       MP_ROM_INT(3)},
     { MP_ROM_QSTR(MP_QSTR_VIDEO_FIFO),          MP_ROM_INT(4)},
 
+    // Per-line operations
+    { MP_ROM_QSTR(MP_QSTR_LINE_HISTOGRAM),      MP_ROM_INT(SENSOR_LINE_OP_HISTOGRAM)},
+    { MP_ROM_QSTR(MP_QSTR_LINE_STATISTICS),     MP_ROM_INT(SENSOR_LINE_OP_STATISTICS)},
+    { MP_ROM_QSTR(MP_QSTR_LINE_THRESHOLD),      MP_ROM_INT(SENSOR_LINE_OP_THRESHOLD)},
+    { MP_ROM_QSTR(MP_QSTR_LINE_DOWNSCALE),      MP_ROM_INT(SENSOR_LINE_OP_DOWNSCALE)},
+
     // IOCTLs
     { MP_ROM_QSTR(MP_QSTR_IOCTL_SET_READOUT_WINDOW),            MP_ROM_INT(IOCTL_SET_READOUT_WINDOW)},
     { MP_ROM_QSTR(MP_QSTR_IOCTL_GET_READOUT_WINDOW),            MP_ROM_INT(IOCTL_GET_READOUT_WINDOW)},
@@ -1165,6 +1328,8 @@ STATIC const mp_rom_map_elem_t globals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_width),               MP_ROM_PTR(&py_sensor_width_obj) },
     { MP_ROM_QSTR(MP_QSTR_height),              MP_ROM_PTR(&py_sensor_height_obj) },
     { MP_ROM_QSTR(MP_QSTR_get_fb),              MP_ROM_PTR(&py_sensor_get_fb_obj) },
+    { MP_ROM_QSTR(MP_QSTR_lease_fb),            MP_ROM_PTR(&py_sensor_lease_fb_obj) },
+    { MP_ROM_QSTR(MP_QSTR_release_fb),          MP_ROM_PTR(&py_sensor_release_fb_obj) },
     { MP_ROM_QSTR(MP_QSTR_get_id),              MP_ROM_PTR(&py_sensor_get_id_obj) },
     { MP_ROM_QSTR(MP_QSTR_get_frame_available), MP_ROM_PTR(&py_sensor_get_frame_available_obj) },
     { MP_ROM_QSTR(MP_QSTR_alloc_extra_fb),      MP_ROM_PTR(&py_sensor_alloc_extra_fb_obj) },
@@ -1207,6 +1372,8 @@ STATIC const mp_rom_map_elem_t globals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_set_lens_correction), MP_ROM_PTR(&py_sensor_set_lens_correction_obj) },
     { MP_ROM_QSTR(MP_QSTR_set_vsync_callback),  MP_ROM_PTR(&py_sensor_set_vsync_callback_obj) },
     { MP_ROM_QSTR(MP_QSTR_set_frame_callback),  MP_ROM_PTR(&py_sensor_set_frame_callback_obj) },
+    { MP_ROM_QSTR(MP_QSTR_set_line_ops),        MP_ROM_PTR(&py_sensor_set_line_ops_obj) },
+    { MP_ROM_QSTR(MP_QSTR_get_line_results),    MP_ROM_PTR(&py_sensor_get_line_results_obj) },
     { MP_ROM_QSTR(MP_QSTR_ioctl),               MP_ROM_PTR(&py_sensor_ioctl_obj) },
     { MP_ROM_QSTR(MP_QSTR_set_color_palette),   MP_ROM_PTR(&py_sensor_set_color_palette_obj) },
     { MP_ROM_QSTR(MP_QSTR_get_color_palette),   MP_ROM_PTR(&py_sensor_get_color_palette_obj) },
@@ -1220,5 +1387,6 @@ const mp_obj_module_t sensor_module = {
     .globals = (mp_obj_t) &globals_dict,
 };
 
+MP_REGISTER_ROOT_POINTER(void *sensor_line_ops_data);
 MP_REGISTER_MODULE(MP_QSTR_sensor, sensor_module);
 #endif // MICROPY_PY_SENSOR
@@ -13,6 +13,7 @@
 #include "py/obj.h"
 #include "py/objlist.h"
 #include "py/objtuple.h"
+#include "py/objarray.h"
 #include "py/binary.h"
 
 #include "py_helper.h"
@@ -26,6 +27,9 @@
 #define GRAYSCALE_RANGE    ((COLOR_GRAYSCALE_MAX) -(COLOR_GRAYSCALE_MIN))
 #define GRAYSCALE_MID      (((GRAYSCALE_RANGE) +1) / 2)
 
+// Counts py_tf_free_from_fb() calls, which free resident tensor arenas allocated before them.
+static uint32_t py_tf_free_from_fb_count;
+
 void py_tf_alloc_putchar_buffer() {
     py_tf_putchar_buffer = (char *) fb_alloc0(PY_TF_PUTCHAR_BUFFER_LEN + 1, FB_ALLOC_NO_HINT);
     py_tf_putchar_buffer_index = 0;
@@ -154,7 +158,7 @@ MP_DEFINE_CONST_OBJ_TYPE(
 
 static const mp_obj_type_t py_tf_model_type;
 
-STATIC mp_obj_t int_py_tf_load(mp_obj_t path_obj, bool alloc_mode, bool helper_mode) {
+STATIC mp_obj_t int_py_tf_load(mp_obj_t path_obj, bool alloc_mode, bool resident_mode, bool helper_mode) {
     if (!helper_mode) {
         fb_alloc_mark();
     }
@@ -163,6 +167,9 @@ STATIC mp_obj_t int_py_tf_load(mp_obj_t path_obj, bool alloc_mode, bool helper_m
     py_tf_model_obj_t *tf_model = m_new_obj(py_tf_model_obj_t);
     tf_model->base.type = &py_tf_model_type;
     tf_model->model_data = NULL;
+    tf_model->tensor_arena = NULL;
+    tf_model->input = mp_const_none;
+    tf_model->output = mp_const_none;
 
     for (int i = 0; i < MP_ARRAY_SIZE(libtf_builtin_models); i++) {
         const libtf_builtin_model_t *model = &libtf_builtin_models[i];
@@ -205,13 +212,20 @@ STATIC mp_obj_t int_py_tf_load(mp_obj_t path_obj, bool alloc_mode, bool helper_m
         fb_free(); // free py_tf_alloc_putchar_buffer()
     }
 
-    // In this mode we leave the model allocated on the frame buffer.
+    // In resident mode the tensor arena is allocated once here instead of on every call.
+    if ((!helper_mode) && resident_mode) {
+        tf_model->tensor_arena = fb_alloc(tf_model->params.tensor_arena_size,
+                                          FB_ALLOC_PREFER_SPEED | FB_ALLOC_CACHE_ALIGN);
+        tf_model->tensor_arena_generation = py_tf_free_from_fb_count;
+    }
+
+    // In these modes we leave the model and/or tensor arena allocated on the frame buffer.
     // py_tf_free_from_fb() must be called to free the model allocated on the frame buffer.
     // On error everything is cleaned because of fb_alloc_mark().
 
-    if ((!helper_mode) && (!alloc_mode)) {
+    if ((!helper_mode) && (!alloc_mode) && (!resident_mode)) {
         fb_alloc_free_till_mark();
-    } else if ((!helper_mode) && alloc_mode) {
+    } else if (!helper_mode) {
         fb_alloc_mark_permanent(); // tf_model->model_data will not be popped on exception.
     }
 
@@ -219,21 +233,22 @@ STATIC mp_obj_t int_py_tf_load(mp_obj_t path_obj, bool alloc_mode, bool helper_m
 }
 
 STATIC mp_obj_t py_tf_load(uint n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
-    enum { ARG_load_to_fb };
+    enum { ARG_load_to_fb, ARG_resident };
     static const mp_arg_t allowed_args[] = {
         { MP_QSTR_load_to_fb, MP_ARG_INT | MP_ARG_KW_ONLY,  {.u_bool = false } },
+        { MP_QSTR_resident, MP_ARG_INT | MP_ARG_KW_ONLY,  {.u_bool = false } },
     };
 
     // Parse args.
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
-    return int_py_tf_load(pos_args[0], args[ARG_load_to_fb].u_int, false);
+    return int_py_tf_load(pos_args[0], args[ARG_load_to_fb].u_int, args[ARG_resident].u_int, false);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_tf_load_obj, 1, py_tf_load);
 
 STATIC mp_obj_t py_tf_load_builtin_model(mp_obj_t path_obj) {
-    mp_obj_t net = int_py_tf_load(path_obj, false, false);
+    mp_obj_t net = int_py_tf_load(path_obj, false, false, false);
     const char *path = mp_obj_str_get_str(path_obj);
     mp_obj_t labels = mp_obj_new_list(0, NULL);
 
@@ -253,6 +268,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_tf_load_builtin_model_obj, py_tf_load_builti
 
 STATIC mp_obj_t py_tf_free_from_fb() {
     fb_alloc_free_till_mark_past_mark_permanent();
+    py_tf_free_from_fb_count += 1;
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(py_tf_free_from_fb_obj, py_tf_free_from_fb);
@@ -261,8 +277,22 @@ STATIC py_tf_model_obj_t *py_tf_load_alloc(mp_obj_t path_obj) {
     if (MP_OBJ_IS_TYPE(path_obj, &py_tf_model_type)) {
         return (py_tf_model_obj_t *) path_obj;
     } else {
-        return (py_tf_model_obj_t *) int_py_tf_load(path_obj, true, true);
+        return (py_tf_model_obj_t *) int_py_tf_load(path_obj, true, false, true);
+    }
+}
+
+// Returns the resident tensor arena or allocates one on the frame buffer for this call. A resident
+// arena freed by free_from_fb() is dropped and the model allocates its arena per call from then on.
+STATIC uint8_t *py_tf_get_tensor_arena(py_tf_model_obj_t *model) {
+    if (model->tensor_arena && (model->tensor_arena_generation != py_tf_free_from_fb_count)) {
+        model->tensor_arena = NULL;
+    }
+
+    if (model->tensor_arena) {
+        return model->tensor_arena;
     }
+
+    return fb_alloc(model->params.tensor_arena_size, FB_ALLOC_PREFER_SPEED | FB_ALLOC_CACHE_ALIGN);
 }
 
 typedef struct py_tf_input_callback_data {
@@ -275,103 +305,29 @@ STATIC void py_tf_input_callback(void *callback_data,
                                  libtf_parameters_t *params) {
     py_tf_input_callback_data_t *arg = (py_tf_input_callback_data_t *) callback_data;
 
-    // Disable checking input scaling and zero-point. Nets can be all over the place on the input
-    // scaling and zero-point but still work with the code below.
-
-    // if (params->input_datatype == LIBTF_DATATYPE_UINT8) {
-    //     if (fast_roundf(params->input_scale * GRAYSCALE_RANGE) != 1) {
-    //         mp_raise_msg(&mp_type_ValueError, MP_ERROR_TEXT("Expected model input scale to be 1/255!"));
-    //     }
-
-    //     if (params->input_zero_point != 0) {
-    //         mp_raise_msg(&mp_type_ValueError, MP_ERROR_TEXT("Expected model input zero point to be 0!"));
-    //     }
-    // }
-
-    // if (params->input_datatype == LIBTF_DATATYPE_INT8) {
-    //     if (fast_roundf(params->input_scale * GRAYSCALE_RANGE) != 1) {
-    //         mp_raise_msg(&mp_type_ValueError, MP_ERROR_TEXT("Expected model input scale to be 1/255!"));
-    //     }
-
-    //     if (params->input_zero_point != -GRAYSCALE_MID) {
-    //         mp_raise_msg(&mp_type_ValueError, MP_ERROR_TEXT("Expected model input zero point to be -128!"));
-    //     }
-    // }
-
-    int shift = (params->input_datatype == LIBTF_DATATYPE_INT8) ? GRAYSCALE_MID : 0;
-    float fscale = 1.0f / GRAYSCALE_RANGE;
-
-    image_t dst_img;
-    dst_img.w = params->input_width;
-    dst_img.h = params->input_height;
-    dst_img.data = (uint8_t *) model_input;
-
-    if (params->input_channels == 1) {
-        dst_img.pixfmt = PIXFORMAT_GRAYSCALE;
-    } else if (params->input_channels == 3) {
-        dst_img.pixfmt = PIXFORMAT_RGB565;
-    } else {
+    if ((params->input_channels != 1) && (params->input_channels != 3)) {
         mp_raise_msg(&mp_type_ValueError, MP_ERROR_TEXT("Expected model input channels to be 1 or 3!"));
     }
 
-    imlib_draw_image(&dst_img, arg->img, 0, 0, 1.0f, 1.0f, arg->roi,
-                     -1, 256, NULL, NULL, IMAGE_HINT_BILINEAR | IMAGE_HINT_CENTER |
-                     IMAGE_HINT_SCALE_ASPECT_EXPAND | IMAGE_HINT_BLACK_BACKGROUND, NULL, NULL, NULL);
-
-    int size = (params->input_width * params->input_height) - 1; // must be int per countdown loop
-
-    if (params->input_channels == 1) {
-        // GRAYSCALE
-        if (params->input_datatype == LIBTF_DATATYPE_FLOAT) {
-            // convert u8 -> f32
-            uint8_t *model_input_u8 = (uint8_t *) model_input;
-            float *model_input_f32 = (float *) model_input;
-
-            for (; size >= 0; size -= 1) {
-                model_input_f32[size] = model_input_u8[size] * fscale;
-            }
-        } else {
-            if (shift) {
-                // convert u8 -> s8
-                uint8_t *model_input_8 = (uint8_t *) model_input;
-
-                #if (__ARM_ARCH > 6)
-                for (; size >= 3; size -= 4) {
-                    *((uint32_t *) (model_input_8 + size - 3)) ^= 0x80808080;
-                }
-                #endif
-
-                for (; size >= 0; size -= 1) {
-                    model_input_8[size] ^= GRAYSCALE_MID;
-                }
-            }
-        }
-    } else if (params->input_channels == 3) {
-        // RGB888
-        int rgb_size = size * 3; // must be int per countdown loop
+    image_tensor_datatype_t datatype = IMAGE_TENSOR_DATATYPE_FLOAT;
+    float scale = params->input_scale;
+    int zero_point = params->input_zero_point;
 
-        if (params->input_datatype == LIBTF_DATATYPE_FLOAT) {
-            uint16_t *model_input_u16 = (uint16_t *) model_input;
-            float *model_input_f32 = (float *) model_input;
-
-            for (; size >= 0; size -= 1, rgb_size -= 3) {
-                int pixel = model_input_u16[size];
-                model_input_f32[rgb_size] = COLOR_RGB565_TO_R8(pixel) * fscale;
-                model_input_f32[rgb_size + 1] = COLOR_RGB565_TO_G8(pixel) * fscale;
-                model_input_f32[rgb_size + 2] = COLOR_RGB565_TO_B8(pixel) * fscale;
-            }
-        } else {
-            uint16_t *model_input_u16 = (uint16_t *) model_input;
-            uint8_t *model_input_8 = (uint8_t *) model_input;
+    if (params->input_datatype == LIBTF_DATATYPE_UINT8) {
+        datatype = IMAGE_TENSOR_DATATYPE_UINT8;
+    } else if (params->input_datatype == LIBTF_DATATYPE_INT8) {
+        datatype = IMAGE_TENSOR_DATATYPE_INT8;
+    }
 
-            for (; size >= 0; size -= 1, rgb_size -= 3) {
-                int pixel = model_input_u16[size];
-                model_input_8[rgb_size] = COLOR_RGB565_TO_R8(pixel) ^ shift;
-                model_input_8[rgb_size + 1] = COLOR_RGB565_TO_G8(pixel) ^ shift;
-                model_input_8[rgb_size + 2] = COLOR_RGB565_TO_B8(pixel) ^ shift;
-            }
-        }
+    // Models without input quantization parameters get the full 8-bit range.
+    if ((datatype != IMAGE_TENSOR_DATATYPE_FLOAT) && (scale <= 0.0f)) {
+        scale = 1.0f / GRAYSCALE_RANGE;
+        zero_point = (datatype == IMAGE_TENSOR_DATATYPE_INT8) ? -GRAYSCALE_MID : 0;
     }
+
+    // Scales, color converts and quantizes the ROI into the model input in one pass.
+    imlib_draw_image_tensor(model_input, params->input_width, params->input_height, params->input_channels,
+                            datatype, scale, zero_point, arg->img, arg->roi);
 }
 
 STATIC void py_tf_classify_output_callback(void *callback_data,
@@ -451,7 +407,7 @@ STATIC mp_obj_t py_tf_classify(uint n_args, const mp_obj_t *pos_args, mp_map_t *
     py_tf_alloc_putchar_buffer();
 
     py_tf_model_obj_t *model = py_tf_load_alloc(pos_args[0]);
-    uint8_t *tensor_arena = fb_alloc(model->params.tensor_arena_size, FB_ALLOC_PREFER_SPEED | FB_ALLOC_CACHE_ALIGN);
+    uint8_t *tensor_arena = py_tf_get_tensor_arena(model);
 
     mp_obj_t objects_list = mp_obj_new_list(0, NULL);
 
@@ -594,7 +550,7 @@ STATIC mp_obj_t py_tf_segment(uint n_args, const mp_obj_t *pos_args, mp_map_t *k
     py_tf_alloc_putchar_buffer();
 
     py_tf_model_obj_t *model = py_tf_load_alloc(pos_args[0]);
-    uint8_t *tensor_arena = fb_alloc(model->params.tensor_arena_size, FB_ALLOC_PREFER_SPEED | FB_ALLOC_CACHE_ALIGN);
+    uint8_t *tensor_arena = py_tf_get_tensor_arena(model);
 
     py_tf_input_callback_data_t py_tf_input_callback_data;
     py_tf_input_callback_data.img = image;
@@ -639,7 +595,7 @@ STATIC mp_obj_t py_tf_detect(uint n_args, const mp_obj_t *pos_args, mp_map_t *kw
     py_tf_alloc_putchar_buffer();
 
     py_tf_model_obj_t *model = py_tf_load_alloc(pos_args[0]);
-    uint8_t *tensor_arena = fb_alloc(model->params.tensor_arena_size, FB_ALLOC_PREFER_SPEED | FB_ALLOC_CACHE_ALIGN);
+    uint8_t *tensor_arena = py_tf_get_tensor_arena(model);
 
     py_tf_input_callback_data_t py_tf_input_callback_data;
     py_tf_input_callback_data.img = image;
@@ -688,8 +644,8 @@ STATIC mp_obj_t py_tf_detect(uint n_args, const mp_obj_t *pos_args, mp_map_t *kw
 
         list_t out;
         imlib_find_blobs(&out, img, &((rectangle_t) {0, 0, img->w, img->h}), 1, 1,
-                         &thresholds, invert, 1, 1, false, 0,
-                         NULL, NULL, NULL, NULL, 0, 0);
+                         &thresholds, NULL, invert, 1, 1, false, 0,
+                         NULL, NULL, NULL, NULL, 0, 0, FIND_BLOBS_MODE_FLOOD_FILL);
 
         mp_obj_list_t *objects_list = mp_obj_new_list(list_size(&out), NULL);
         for (int j = 0, jj = list_size(&out); j < jj; j++) {
@@ -703,7 +659,7 @@ STATIC mp_obj_t py_tf_detect(uint n_args, const mp_obj_t *pos_args, mp_map_t *kw
             hist.LBins = fb_alloc(hist.LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
             hist.ABins = NULL;
             hist.BBins = NULL;
-            imlib_get_histogram(&hist, img, &lnk_data.rect, &thresholds, invert, NULL);
+            imlib_get_histogram(&hist, img, &lnk_data.rect, &thresholds, NULL, invert, NULL);
 
             statistics_t stats;
             imlib_get_statistics(&stats, img->pixfmt, &hist);
@@ -808,7 +764,7 @@ STATIC mp_obj_t py_tf_regression(mp_obj_t model_obj, mp_obj_t array_obj) {
     py_tf_alloc_putchar_buffer();
 
     py_tf_model_obj_t *model = py_tf_load_alloc(model_obj);
-    uint8_t *tensor_arena = fb_alloc(model->params.tensor_arena_size, FB_ALLOC_PREFER_SPEED | FB_ALLOC_CACHE_ALIGN);
+    uint8_t *tensor_arena = py_tf_get_tensor_arena(model);
 
     mp_obj_t py_tf_classify_output_callback_data;
 
@@ -829,6 +785,90 @@ STATIC mp_obj_t py_tf_regression(mp_obj_t model_obj, mp_obj_t array_obj) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(py_tf_regression_obj, py_tf_regression);
 
+// Returns a writable memoryview over a heap buffer holding a tensor of the given shape.
+STATIC mp_obj_t py_tf_new_tensor(size_t len, libtf_datatype_t datatype) {
+    if (datatype == LIBTF_DATATYPE_FLOAT) {
+        return mp_obj_new_memoryview('f' | MP_OBJ_ARRAY_TYPECODE_FLAG_RW, len, xalloc0(len * sizeof(float)));
+    } else if (datatype == LIBTF_DATATYPE_INT8) {
+        return mp_obj_new_memoryview('b' | MP_OBJ_ARRAY_TYPECODE_FLAG_RW, len, xalloc0(len * sizeof(int8_t)));
+    } else {
+        return mp_obj_new_memoryview('B' | MP_OBJ_ARRAY_TYPECODE_FLAG_RW, len, xalloc0(len * sizeof(uint8_t)));
+    }
+}
+
+// The input and output tensors are allocated once and reused by every invoke() call.
+STATIC void py_tf_alloc_tensors(py_tf_model_obj_t *model) {
+    if (model->input == mp_const_none) {
+        model->input = py_tf_new_tensor(model->params.input_height *
+                                        model->params.input_width *
+                                        model->params.input_channels, model->params.input_datatype);
+    }
+
+    if (model->output == mp_const_none) {
+        model->output = py_tf_new_tensor(model->params.output_height *
+                                         model->params.output_width *
+                                         model->params.output_channels, model->params.output_datatype);
+    }
+}
+
+STATIC void py_tf_invoke_input_callback(void *callback_data,
+                                        void *model_input,
+                                        libtf_parameters_t *params) {
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(((py_tf_model_obj_t *) callback_data)->input, &bufinfo, MP_BUFFER_READ);
+    memcpy(model_input, bufinfo.buf, bufinfo.len);
+}
+
+STATIC void py_tf_invoke_output_callback(void *callback_data,
+                                         void *model_output,
+                                         libtf_parameters_t *params) {
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(((py_tf_model_obj_t *) callback_data)->output, &bufinfo, MP_BUFFER_WRITE);
+    memcpy(bufinfo.buf, model_output, bufinfo.len);
+}
+
+STATIC mp_obj_t py_tf_input_tensor(mp_obj_t self_in) {
+    py_tf_model_obj_t *self = self_in;
+    py_tf_alloc_tensors(self);
+    return self->input;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_tf_input_tensor_obj, py_tf_input_tensor);
+
+STATIC mp_obj_t py_tf_output_tensor(mp_obj_t self_in) {
+    py_tf_model_obj_t *self = self_in;
+    py_tf_alloc_tensors(self);
+    return self->output;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_tf_output_tensor_obj, py_tf_output_tensor);
+
+// Runs the model on input_tensor() and writes the result to output_tensor() without any
+// pre or post processing. With a resident model nothing is allocated per call.
+STATIC mp_obj_t py_tf_invoke(mp_obj_t self_in) {
+    py_tf_model_obj_t *self = self_in;
+    py_tf_alloc_tensors(self);
+
+    fb_alloc_mark();
+    py_tf_alloc_putchar_buffer();
+
+    uint8_t *tensor_arena = py_tf_get_tensor_arena(self);
+
+    if (libtf_invoke(self->model_data,
+                     tensor_arena,
+                     &self->params,
+                     py_tf_invoke_input_callback,
+                     self,
+                     py_tf_invoke_output_callback,
+                     self) != 0) {
+        // Note can't use MP_ERROR_TEXT here.
+        mp_raise_msg(&mp_type_OSError, (mp_rom_error_text_t) py_tf_putchar_buffer);
+    }
+
+    fb_alloc_free_till_mark();
+
+    return self->output;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_tf_invoke_obj, py_tf_invoke);
+
 mp_obj_t py_tf_len(mp_obj_t self_in) {
     return mp_obj_new_int(((py_tf_model_obj_t *) self_in)->model_data_len);
 }
@@ -919,7 +959,10 @@ STATIC const mp_rom_map_elem_t locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_classify),            MP_ROM_PTR(&py_tf_classify_obj) },
     { MP_ROM_QSTR(MP_QSTR_segment),             MP_ROM_PTR(&py_tf_segment_obj) },
     { MP_ROM_QSTR(MP_QSTR_detect),              MP_ROM_PTR(&py_tf_detect_obj) },
-    { MP_ROM_QSTR(MP_QSTR_regression),          MP_ROM_PTR(&py_tf_regression_obj) }
+    { MP_ROM_QSTR(MP_QSTR_regression),          MP_ROM_PTR(&py_tf_regression_obj) },
+    { MP_ROM_QSTR(MP_QSTR_input_tensor),        MP_ROM_PTR(&py_tf_input_tensor_obj) },
+    { MP_ROM_QSTR(MP_QSTR_output_tensor),       MP_ROM_PTR(&py_tf_output_tensor_obj) },
+    { MP_ROM_QSTR(MP_QSTR_invoke),              MP_ROM_PTR(&py_tf_invoke_obj) }
 };
 
 STATIC MP_DEFINE_CONST_DICT(py_tf_locals_dict, locals_dict_table);
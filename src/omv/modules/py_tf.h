@@ -18,6 +18,9 @@ typedef struct py_tf_model_obj {
     unsigned char *model_data;
     unsigned int model_data_len;
     libtf_parameters_t params;
+    unsigned char *tensor_arena; // Resident tensor arena (NULL if allocated per call).
+    uint32_t tensor_arena_generation; // Value of the free_from_fb() count when the arena was allocated.
+    mp_obj_t input, output; // Resident input/output tensors used by invoke().
 } py_tf_model_obj_t;
 
 // Log buffer
@@ -28,6 +28,7 @@
 #include "systick.h"
 #include "modmimxrt.h"
 
+#include "py_image.h"
 #include "py_fir.h"
 #include "py_tv.h"
 
@@ -86,6 +87,7 @@ soft_reset:
     mp_init();
 
     // Initialise low-level sub-systems.
+    py_image_init0();
     py_fir_init0();
     #if MICROPY_PY_TV
     py_tv_init0();
@@ -57,6 +57,9 @@ void sensor_init0() {
 
     // Disable Frame callback.
     sensor_set_frame_callback(NULL);
+
+    // Disable per-line operations.
+    sensor.line_ops = NULL;
 }
 
 int sensor_init() {
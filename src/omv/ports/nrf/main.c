@@ -85,6 +85,7 @@
 #endif
 
 #include "usbdbg.h"
+#include "py_image.h"
 #include "py_audio.h"
 #include "framebuffer.h"
 #include "omv_boardconfig.h"
@@ -173,6 +174,7 @@ soft_reset:
 
     fb_alloc_init0();
     framebuffer_init0();
+    py_image_init0();
 
     #if MICROPY_PY_SENSOR
     sensor_init();
@@ -60,6 +60,7 @@
 #include "sensor.h"
 #include "usbdbg.h"
 #include "tinyusb_debug.h"
+#include "py_image.h"
 #include "py_fir.h"
 #if MICROPY_PY_AUDIO
 #include "py_audio.h"
@@ -174,6 +175,7 @@ soft_reset:
     fb_alloc_init0();
     framebuffer_init0();
 
+    py_image_init0();
     py_fir_init0();
 
     #if MICROPY_PY_SENSOR
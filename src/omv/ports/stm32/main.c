@@ -291,6 +291,7 @@ soft_reset:
 
     // Initialise low-level sub-systems. Here we need to do the very basic
     // things like zeroing out memory and resetting any of the sub-systems.
+    py_image_init0();
     py_fir_init0();
     #if MICROPY_PY_TV
     py_tv_init0();
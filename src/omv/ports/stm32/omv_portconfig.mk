@@ -216,6 +216,7 @@ FIRM_OBJ += $(addprefix $(BUILD)/$(OMV_DIR)/imlib/, \
 	mjpeg.o                     \
 	orb.o                       \
 	phasecorrelation.o          \
+	planes.o                    \
 	point.o                     \
 	pool.o                      \
 	ppm.o                       \
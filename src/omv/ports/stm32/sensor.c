@@ -27,6 +27,8 @@
 #define DMA_LENGTH_ALIGNMENT     (16)
 #define SENSOR_TIMEOUT_MS        (3000)
 #define ARRAY_SIZE(a)            (sizeof(a) / sizeof((a)[0]))
+// MDMA can capture the whole frame without the CPU unless lines are transposed or processed.
+#define MDMA_FULL_OFFLOAD(s)     ((!(s)->transpose) && ((s)->line_ops == NULL))
 
 sensor_t sensor = {};
 static TIM_HandleTypeDef TIMHandle = {};
@@ -112,6 +114,9 @@ void sensor_init0() {
 
     // Disable Frame callback.
     sensor_set_frame_callback(NULL);
+
+    // Disable per-line operations.
+    sensor.line_ops = NULL;
 }
 
 int sensor_init() {
@@ -448,7 +453,7 @@ void DCMI_DMAConvCpltUser(uint32_t addr) {
         // If we're dropping a frame in full offload mode it's safe to disable this interrupt saving
         // ourselves from having to service the DMA complete callback.
         #if defined(OMV_MDMA_CHANNEL_DCMI_0)
-        if (!sensor.transpose) {
+        if (MDMA_FULL_OFFLOAD(&sensor)) {
             HAL_NVIC_DisableIRQ(DMA2_Stream1_IRQn);
         }
         #endif
@@ -517,7 +522,7 @@ void DCMI_DMAConvCpltUser(uint32_t addr) {
     // DCMI_DMAXferCplt in the HAL DCMI driver always calls DCMI_DMAConvCpltUser with the other
     // MAR register. So, we have to fix the address in full MDMA offload mode...
     #if defined(OMV_MDMA_CHANNEL_DCMI_0)
-    if (!sensor.transpose) {
+    if (MDMA_FULL_OFFLOAD(&sensor)) {
         addr = (uint32_t) &_line_buf;
     }
     #endif
@@ -532,8 +537,9 @@ void DCMI_DMAConvCpltUser(uint32_t addr) {
 
     // For all non-JPEG and non-transposed modes we can completely offload image capture to MDMA
     // and we do not need to receive any line interrupts for the rest of the frame until it ends.
+    // Per-line operations need the line interrupts so they also disable the full offload.
     #if defined(OMV_MDMA_CHANNEL_DCMI_0)
-    if (!sensor.transpose) {
+    if (MDMA_FULL_OFFLOAD(&sensor)) {
         // NOTE: We're starting MDMA here because it gives the maximum amount of time before we
         // have to drop the frame if there's no space. If you use the FRAME/VSYNC callbacks then
         // you will have to drop the frame earlier than necessary if there's no space resulting
@@ -725,8 +731,8 @@ int sensor_snapshot(sensor_t *sensor, image_t *image, uint32_t flags) {
             memcpy(&DCMI_MDMA_Handle1.Init, &DCMI_MDMA_Handle0.Init, sizeof(MDMA_InitTypeDef));
             HAL_MDMA_Init(&DCMI_MDMA_Handle0);
 
-            // If we are not transposing the image we can fully offload image capture from the CPU.
-            if (!sensor->transpose) {
+            // If we are not transposing or processing lines we can fully offload image capture from the CPU.
+            if (MDMA_FULL_OFFLOAD(sensor)) {
                 // MDMA will trigger on each TC from DMA and transfer one line to the frame buffer.
                 DCMI_MDMA_Handle1.Init.Request = MDMA_REQUEST_DMA2_Stream1_TC;
                 DCMI_MDMA_Handle1.Init.TransferTriggerMode = MDMA_BLOCK_TRANSFER;
@@ -785,7 +791,7 @@ int sensor_snapshot(sensor_t *sensor, image_t *image, uint32_t flags) {
             }
         #if defined(OMV_MDMA_CHANNEL_DCMI_0)
             // Special transfer mode with MDMA that completely offloads the line capture load.
-        } else if ((sensor->pixformat != PIXFORMAT_JPEG) && (!sensor->transpose)) {
+        } else if ((sensor->pixformat != PIXFORMAT_JPEG) && MDMA_FULL_OFFLOAD(sensor)) {
             // DMA to circular mode writing the same line over and over again.
             ((DMA_Stream_TypeDef *) DMAHandle.Instance)->CR |= DMA_SxCR_CIRC;
             // DCMI will transfer to same line and MDMA will move to final location.
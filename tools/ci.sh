@@ -36,6 +36,15 @@ ci_build_target() {
     mv src/build/bin ${1}
 }
 
+########################################################################################
+# Build and run the host imlib benchmark.
+
+ci_run_imlib_bench() {
+    make -j$(nproc) -C tools/imlib_bench
+    make -C tools/imlib_bench run ARGS="-n 5"
+    make -C tools/imlib_bench test
+}
+
 ########################################################################################
 # Prepare Firmware Packages.
 
@@ -0,0 +1,35 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * imlib benchmark kernels.
+ */
+#ifndef __BENCH_H__
+#define __BENCH_H__
+#include <stdbool.h>
+#include "imlib.h"
+
+#define BENCH_RESULT_LEN    64
+
+// A benchmark kernel. run() is timed over a fresh copy of the input image
+// each iteration and returns false if its output does not match what the
+// unittest scripts expect. It may describe its output in result.
+typedef struct bench {
+    const char *name;
+    const char *path;       // Input image relative to the data directory.
+    pixformat_t pixfmt;     // Input is converted to this format first.
+    bool (*run) (image_t *img, char *result);
+} bench_t;
+
+extern const bench_t bench_kernels[];
+extern const size_t bench_kernels_count;
+extern const char *bench_data_path;
+
+// Loads an image from the data directory and converts it to pixfmt. BAYER and YUV422 images are
+// sampled from the RGB565 version.
+void bench_load_image(image_t *img, const char *path, pixformat_t pixfmt);
+#endif // __BENCH_H__
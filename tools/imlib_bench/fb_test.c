@@ -0,0 +1,281 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Host checks for the frame buffer and fb_alloc.
+ *
+ * Builds imlib/framebuffer.c and alloc/fb_alloc.c as they are on the target, laid out in a
+ * static array in place of the linker defined frame buffer memory, and drives the capture and
+ * read sides of the frame buffer by hand.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "py/runtime.h"
+#include "fb_alloc.h"
+#include "framebuffer.h"
+#include "host.h"
+
+#define FB_TEST_FB_SIZE         (64 * 1024)
+#define FB_TEST_FB_ALLOC_SIZE   (64 * 1024)
+#define FB_TEST_JPEG_SIZE       (sizeof(jpegbuffer_t) + OMV_JPEG_BUF_SIZE)
+#define FB_TEST_W               (64)
+#define FB_TEST_H               (48)
+#define FB_TEST_STR_(x)         #x
+#define FB_TEST_STR(x)          FB_TEST_STR_(x)
+
+char fb_test_memory[FB_TEST_FB_SIZE + FB_TEST_FB_ALLOC_SIZE] __attribute__((aligned(32)));
+char fb_test_jpeg_memory[FB_TEST_JPEG_SIZE] __attribute__((aligned(32)));
+
+// Linker symbols of the frame buffer memory (see stm32fxxx.ld.S).
+__asm__ (
+    ".globl _fb_base, _fb_end, _fballoc, _jpeg_buf\n"
+    ".set _fb_base, fb_test_memory\n"
+    ".set _fb_end, fb_test_memory + " FB_TEST_STR(FB_TEST_FB_SIZE) "\n"
+    ".set _fballoc, fb_test_memory + " FB_TEST_STR(FB_TEST_FB_SIZE + FB_TEST_FB_ALLOC_SIZE) "\n"
+    ".set _jpeg_buf, fb_test_jpeg_memory\n"
+    );
+
+// The frame buffer only uses these to stream frames to the IDE, which is disabled here.
+void mutex_init0(omv_mutex_t *mutex) {
+}
+
+int mutex_try_lock_alternate(omv_mutex_t *mutex, uint32_t tid) {
+    return 0;
+}
+
+void mutex_unlock(omv_mutex_t *mutex, uint32_t tid) {
+}
+
+bool jpeg_compress(image_t *src, image_t *dst, int quality, bool realloc, jpeg_subsampling_t subsampling) {
+    return true;
+}
+
+size_t image_size(image_t *ptr) {
+    return ptr->w * ptr->h * ptr->bpp;
+}
+
+static int fb_test_failures;
+
+#define FB_TEST_CHECK(x)                                                   \
+    do {                                                                   \
+        if (!(x)) {                                                        \
+            printf("    %s:%d: check failed: %s\n", __func__, __LINE__, #x); \
+            fb_test_failures += 1;                                         \
+        }                                                                  \
+    } while (0)
+
+static void fb_test_setup(int32_t n_buffers) {
+    fb_alloc_init0();
+    framebuffer_init0();
+
+    image_t img = { .w = FB_TEST_W, .h = FB_TEST_H, .pixfmt = PIXFORMAT_GRAYSCALE };
+    framebuffer_init_from_image(&img);
+    framebuffer->u = FB_TEST_W;
+    framebuffer->v = FB_TEST_H;
+    framebuffer_set_buffers(n_buffers);
+}
+
+// Captures one frame filled with value like the sensor driver does, returns false if the frame
+// was dropped because there was no free buffer.
+static bool fb_test_capture(uint8_t value) {
+    // First line.
+    vbuffer_t *buffer = framebuffer_get_tail(FB_PEEK);
+
+    if (!buffer) {
+        return false;
+    }
+
+    memset(buffer->data, value, FB_TEST_W * FB_TEST_H);
+    // End of frame.
+    framebuffer_get_tail(FB_NO_FLAGS);
+    return true;
+}
+
+// Reads the next frame like sensor.snapshot() does.
+static bool fb_test_snapshot(image_t *img) {
+    framebuffer_free_current_buffer();
+
+    if (!framebuffer_get_head(FB_NO_FLAGS)) {
+        return false;
+    }
+
+    image_t frame = { .w = FB_TEST_W, .h = FB_TEST_H, .pixfmt = PIXFORMAT_GRAYSCALE };
+    framebuffer_init_from_image(&frame);
+    framebuffer_init_image(img);
+    return true;
+}
+
+static bool fb_test_filled(image_t *img, uint8_t value) {
+    for (int i = 0; i < (FB_TEST_W * FB_TEST_H); i++) {
+        if (img->data[i] != value) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Runs a few capture and snapshot cycles with frame values starting at value.
+static void fb_test_run(uint8_t value, int frames) {
+    image_t img;
+
+    for (int i = 0; i < frames; i++) {
+        fb_test_capture(value + i);
+        fb_test_snapshot(&img);
+    }
+}
+
+// A buffer released and leased again before capture picks up the release stays leased.
+static void fb_test_release_lease() {
+    image_t img;
+    fb_test_setup(3);
+
+    FB_TEST_CHECK(fb_test_capture(1));
+    FB_TEST_CHECK(fb_test_snapshot(&img));
+    FB_TEST_CHECK(framebuffer_lease_current_buffer() != NULL);
+    FB_TEST_CHECK(framebuffer_release_buffer(img.data) == 0);
+    FB_TEST_CHECK(framebuffer_lease_current_buffer() != NULL);
+
+    fb_test_run(2, 8);
+    FB_TEST_CHECK(fb_test_filled(&img, 1));
+
+    // The lease can still be released and the buffer is then reused by capture.
+    FB_TEST_CHECK(framebuffer_release_buffer(img.data) == 0);
+    FB_TEST_CHECK(framebuffer_release_buffer(img.data) != 0);
+    fb_test_run(10, 8);
+    FB_TEST_CHECK(!fb_test_filled(&img, 1));
+}
+
+// Flushing the FIFO keeps leased buffers.
+static void fb_test_flush_lease() {
+    image_t img;
+    fb_test_setup(4);
+
+    FB_TEST_CHECK(fb_test_capture(1));
+    FB_TEST_CHECK(fb_test_snapshot(&img));
+    FB_TEST_CHECK(framebuffer_lease_current_buffer() != NULL);
+
+    framebuffer_flush_buffers(true);
+    fb_test_run(2, 8);
+    FB_TEST_CHECK(fb_test_filled(&img, 1));
+    FB_TEST_CHECK(framebuffer_release_buffer(img.data) == 0);
+}
+
+// Bytes on the fb_alloc stack.
+static uint32_t fb_test_alloc_used() {
+    return (FB_TEST_FB_SIZE + FB_TEST_FB_ALLOC_SIZE) - (fb_alloc_stack_pointer() - fb_test_memory);
+}
+
+static uint32_t fb_test_alloc_live_bytes(const fb_alloc_stats_t *stats) {
+    uint32_t live_bytes = 0;
+
+    for (int i = 0; i < FB_ALLOC_STATS_SITES; i++) {
+        if (!stats->sites[i].mark) {
+            live_bytes += stats->sites[i].live_bytes;
+        }
+    }
+
+    return live_bytes;
+}
+
+// Marks from a single call site, the barrier keeps the call from becoming a tail call which
+// would attribute the mark to the caller.
+static __attribute__((noinline)) void fb_test_alloc_mark() {
+    fb_alloc_mark();
+    __asm__ volatile ("" ::: "memory");
+}
+
+static const fb_alloc_site_stats_t *fb_test_alloc_mark_site(const fb_alloc_stats_t *stats) {
+    for (int i = 0; i < FB_ALLOC_STATS_SITES; i++) {
+        if (stats->sites[i].site && stats->sites[i].mark) {
+            return &stats->sites[i];
+        }
+    }
+
+    return NULL;
+}
+
+// The high-water marks and the bytes held through alloc, mark, free_till_mark and reset. Each
+// block on the stack is preceded by a 4 byte size word and a mark is a lone size word, which the
+// frame peak of the mark does not include.
+static void fb_test_alloc_stats() {
+    fb_test_setup(1);
+    fb_alloc_stats_reset();
+
+    const fb_alloc_stats_t *stats = fb_alloc_stats();
+    uint32_t base = fb_test_alloc_used();
+    FB_TEST_CHECK(stats->peak == base);
+
+    fb_test_alloc_mark();
+    fb_alloc(1000, FB_ALLOC_NO_HINT);
+    fb_alloc(500, FB_ALLOC_NO_HINT);
+    FB_TEST_CHECK(fb_test_alloc_used() == (base + 4 + 1004 + 504));
+    FB_TEST_CHECK(stats->peak == (base + 4 + 1004 + 504));
+    FB_TEST_CHECK(stats->allocs == 2);
+    FB_TEST_CHECK(fb_test_alloc_live_bytes(stats) == 1500);
+
+    fb_alloc_free_till_mark();
+    FB_TEST_CHECK(fb_test_alloc_used() == base);
+    FB_TEST_CHECK(stats->peak == (base + 4 + 1004 + 504));
+    FB_TEST_CHECK(fb_test_alloc_live_bytes(stats) == 0);
+    FB_TEST_CHECK(fb_test_alloc_mark_site(stats) != NULL);
+    FB_TEST_CHECK(fb_test_alloc_mark_site(stats)->frame_peak == (1004 + 504));
+
+    // Reset drops the counters but not the blocks still held.
+    fb_test_alloc_mark();
+    fb_alloc(200, FB_ALLOC_NO_HINT);
+    fb_alloc_stats_reset();
+    FB_TEST_CHECK(stats->peak == (base + 4 + 204));
+    FB_TEST_CHECK(stats->allocs == 0);
+    FB_TEST_CHECK(fb_test_alloc_live_bytes(stats) == 200);
+    FB_TEST_CHECK(fb_test_alloc_mark_site(stats)->frame_peak == 0);
+
+    fb_alloc(100, FB_ALLOC_NO_HINT);
+    FB_TEST_CHECK(stats->peak == (base + 4 + 204 + 104));
+    FB_TEST_CHECK(stats->allocs == 1);
+
+    fb_alloc_free_till_mark();
+    FB_TEST_CHECK(fb_test_alloc_used() == base);
+    FB_TEST_CHECK(stats->peak == (base + 4 + 204 + 104));
+    FB_TEST_CHECK(fb_test_alloc_live_bytes(stats) == 0);
+    FB_TEST_CHECK(fb_test_alloc_mark_site(stats)->frame_peak == (204 + 104));
+}
+
+typedef struct fb_test {
+    const char *name;
+    void (*run) ();
+} fb_test_t;
+
+static const fb_test_t fb_tests[] = {
+    { "framebuffer_release_lease", fb_test_release_lease },
+    { "framebuffer_flush_lease",   fb_test_flush_lease   },
+    { "fb_alloc_stats",            fb_test_alloc_stats   },
+};
+
+int main(int argc, char **argv) {
+    int failed = 0;
+
+    for (size_t i = 0; i < (sizeof(fb_tests) / sizeof(fb_tests[0])); i++) {
+        int failures = fb_test_failures;
+        host_nlr_buf_t nlr;
+
+        if (host_nlr_push(&nlr) == 0) {
+            fb_tests[i].run();
+            host_nlr_pop();
+        } else {
+            printf("    %s\n", host_nlr_msg());
+            fb_test_failures += 1;
+        }
+
+        bool ok = (failures == fb_test_failures);
+        printf("%-32s %s\n", fb_tests[i].name, ok ? "ok" : "FAIL");
+        failed += !ok;
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,38 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Host runtime for the imlib benchmark.
+ */
+#ifndef __HOST_H__
+#define __HOST_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include <setjmp.h>
+
+// Exception frame. mp_raise_msg() unwinds to the innermost pushed frame.
+typedef struct host_nlr_buf {
+    struct host_nlr_buf *prev;
+    jmp_buf jmp;
+} host_nlr_buf_t;
+
+void host_nlr_link(host_nlr_buf_t *buf);
+void host_nlr_pop(void);
+const char *host_nlr_msg(void);
+
+// Returns 0 on push and 1 when an exception was raised.
+#define host_nlr_push(buf)    (host_nlr_link(buf), setjmp((buf)->jmp))
+
+// fb_alloc arena. The peak excludes fb_alloc_all() blocks, which always take
+// whatever is left, host_fb_alloc_used_all() reports if any were taken.
+void host_fb_alloc_init(uint32_t size);
+void host_fb_alloc_reset_peak(void);
+uint32_t host_fb_alloc_peak(void);
+bool host_fb_alloc_used_all(void);
+
+uint64_t host_ticks_us(void);
+#endif // __HOST_H__
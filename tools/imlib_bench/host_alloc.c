@@ -0,0 +1,286 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * fb_alloc and xalloc for the imlib benchmark.
+ *
+ * fb_alloc keeps the same stack discipline as alloc/fb_alloc.c (size words,
+ * marks and permanent flags) over a heap allocated arena, and additionally
+ * tracks the deepest point the stack reached so kernels can report their
+ * peak usage. xalloc is backed by the C heap.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "py/runtime.h"
+#include "fb_alloc.h"
+#include "xalloc.h"
+#include "omv_boardconfig.h"
+#include "omv_common.h"
+#include "imlib.h"
+#include "host.h"
+
+// Marks blocks returned by fb_alloc_all(). The host has no overlay memory
+// so the bit used for FB_OVERLAY_MEMORY_FLAG on the target is free.
+#define FB_ALL_FLAG          0x1
+// fb_alloc_free_till_mark() will not free past this.
+// Use fb_alloc_free_till_mark_permanent() instead.
+#define FB_PERMANENT_FLAG    0x2
+#define FB_FLAGS             (FB_ALL_FLAG | FB_PERMANENT_FLAG)
+
+static char *arena_start;
+static char *arena_end;
+static char *pointer;
+
+// Bytes held by everything except fb_alloc_all() blocks, which always take
+// the whole arena and would otherwise hide the real usage of a kernel.
+static uint32_t used_bytes;
+static uint32_t used_bytes_base;
+static uint32_t used_bytes_peak;
+static bool used_all;
+
+void host_fb_alloc_init(uint32_t size) {
+    free(arena_start);
+    arena_start = malloc(size);
+    if (!arena_start) {
+        fprintf(stderr, "Unable to allocate a %u byte fb_alloc arena\n", (unsigned) size);
+        exit(EXIT_FAILURE);
+    }
+    arena_end = arena_start + size;
+    fb_alloc_init0();
+}
+
+void host_fb_alloc_reset_peak(void) {
+    used_bytes_base = used_bytes;
+    used_bytes_peak = used_bytes;
+    used_all = false;
+}
+
+uint32_t host_fb_alloc_peak(void) {
+    return used_bytes_peak - used_bytes_base;
+}
+
+bool host_fb_alloc_used_all(void) {
+    return used_all;
+}
+
+static void host_fb_alloc_push(uint32_t size) {
+    if (size & FB_ALL_FLAG) {
+        used_all = true;
+    } else {
+        used_bytes += size;
+        used_bytes_peak = IM_MAX(used_bytes_peak, used_bytes);
+    }
+}
+
+static uint32_t host_fb_alloc_pop(uint32_t size) {
+    if (!(size & FB_ALL_FLAG)) {
+        used_bytes -= size & ~FB_FLAGS;
+    }
+    return size & ~FB_FLAGS;
+}
+
+char *fb_alloc_stack_pointer() {
+    return pointer;
+}
+
+NORETURN void fb_alloc_fail() {
+    mp_raise_msg(&mp_type_MemoryError, MP_ERROR_TEXT("Out of fast frame buffer stack memory"));
+}
+
+void fb_alloc_init0() {
+    pointer = arena_end;
+    used_bytes = 0;
+    host_fb_alloc_reset_peak();
+}
+
+uint32_t fb_avail() {
+    uint32_t temp = pointer - arena_start - sizeof(uint32_t);
+    return (temp < sizeof(uint32_t)) ? 0 : temp;
+}
+
+void fb_alloc_mark() {
+    char *new_pointer = pointer - sizeof(uint32_t);
+
+    if (new_pointer < arena_start) {
+        fb_alloc_fail();
+    }
+
+    // A size value of 4 is used as a marker in the alloc stack.
+    *((uint32_t *) new_pointer) = sizeof(uint32_t);
+    pointer = new_pointer;
+    host_fb_alloc_push(sizeof(uint32_t));
+}
+
+static void int_fb_alloc_free_till_mark(bool free_permanent) {
+    while (pointer < arena_end) {
+        uint32_t size = *((uint32_t *) pointer);
+        if ((!free_permanent) && (size & FB_PERMANENT_FLAG)) {
+            return;
+        }
+        size = host_fb_alloc_pop(size);
+        pointer += size;
+        if (size == sizeof(uint32_t)) {
+            break;
+        }
+    }
+}
+
+void fb_alloc_free_till_mark() {
+    int_fb_alloc_free_till_mark(false);
+}
+
+void fb_alloc_mark_permanent() {
+    if (pointer < arena_end) {
+        *((uint32_t *) pointer) |= FB_PERMANENT_FLAG;
+    }
+}
+
+void fb_alloc_free_till_mark_past_mark_permanent() {
+    int_fb_alloc_free_till_mark(true);
+}
+
+// returns null pointer without error if size==0
+void *fb_alloc(uint32_t size, int hints) {
+    if (!size) {
+        return NULL;
+    }
+
+    size = ((size + sizeof(uint32_t) - 1) / sizeof(uint32_t)) * sizeof(uint32_t); // Round Up
+
+    if (hints & FB_ALLOC_CACHE_ALIGN) {
+        size = ((size + OMV_ALLOC_ALIGNMENT - 1) / OMV_ALLOC_ALIGNMENT) * OMV_ALLOC_ALIGNMENT;
+        size += OMV_ALLOC_ALIGNMENT - sizeof(uint32_t);
+    }
+
+    char *result = pointer - size;
+    char *new_pointer = result - sizeof(uint32_t);
+
+    if (new_pointer < arena_start) {
+        fb_alloc_fail();
+    }
+
+    *((uint32_t *) new_pointer) = size + sizeof(uint32_t); // Save size.
+    pointer = new_pointer;
+    host_fb_alloc_push(size + sizeof(uint32_t));
+
+    if (hints & FB_ALLOC_CACHE_ALIGN) {
+        int offset = ((uintptr_t) result) % OMV_ALLOC_ALIGNMENT;
+        if (offset) {
+            result += OMV_ALLOC_ALIGNMENT - offset;
+        }
+    }
+
+    return result;
+}
+
+// returns null pointer without error if passed size==0
+void *fb_alloc0(uint32_t size, int hints) {
+    void *mem = fb_alloc(size, hints);
+    memset(mem, 0, size); // does nothing if size is zero.
+    return mem;
+}
+
+void *fb_alloc_all(uint32_t *size, int hints) {
+    uint32_t temp = pointer - arena_start - sizeof(uint32_t);
+
+    if ((pointer - arena_start) < (2 * sizeof(uint32_t))) {
+        *size = 0;
+        return NULL;
+    }
+
+    *size = (temp / sizeof(uint32_t)) * sizeof(uint32_t); // Round Down
+
+    char *result = pointer - *size;
+    char *new_pointer = result - sizeof(uint32_t);
+
+    *((uint32_t *) new_pointer) = (*size + sizeof(uint32_t)) | FB_ALL_FLAG; // Save size.
+    pointer = new_pointer;
+    host_fb_alloc_push(*((uint32_t *) new_pointer));
+
+    if (hints & FB_ALLOC_CACHE_ALIGN) {
+        int offset = ((uintptr_t) result) % OMV_ALLOC_ALIGNMENT;
+        if (offset) {
+            int inc = OMV_ALLOC_ALIGNMENT - offset;
+            result += inc;
+            *size -= inc;
+        }
+
+        *size = (*size / OMV_ALLOC_ALIGNMENT) * OMV_ALLOC_ALIGNMENT;
+    }
+
+    return result;
+}
+
+// returns null pointer without error if returned size==0
+void *fb_alloc0_all(uint32_t *size, int hints) {
+    void *mem = fb_alloc_all(size, hints);
+    memset(mem, 0, *size); // does nothing if size is zero.
+    return mem;
+}
+
+void fb_free() {
+    if (pointer < arena_end) {
+        uint32_t size = *((uint32_t *) pointer);
+        pointer += host_fb_alloc_pop(size); // Get size and pop.
+    }
+}
+
+void fb_free_all() {
+    while (pointer < arena_end) {
+        uint32_t size = *((uint32_t *) pointer);
+        pointer += host_fb_alloc_pop(size); // Get size and pop.
+    }
+}
+
+NORETURN static void xalloc_fail(uint32_t size) {
+    mp_raise_msg_varg(&mp_type_MemoryError,
+                      MP_ERROR_TEXT("memory allocation failed, allocating %u bytes"), (unsigned) size);
+}
+
+// returns null pointer without error if size==0
+void *xalloc(uint32_t size) {
+    void *mem = size ? malloc(size) : NULL;
+    if (size && (mem == NULL)) {
+        xalloc_fail(size);
+    }
+    return mem;
+}
+
+// returns null pointer without error if size==0
+void *xalloc_try_alloc(uint32_t size) {
+    return size ? malloc(size) : NULL;
+}
+
+// returns null pointer without error if size==0
+void *xalloc0(uint32_t size) {
+    void *mem = size ? calloc(1, size) : NULL;
+    if (size && (mem == NULL)) {
+        xalloc_fail(size);
+    }
+    return mem;
+}
+
+// returns without error if mem==null
+void xfree(void *mem) {
+    free(mem);
+}
+
+// returns null pointer without error if size==0
+// allocs if mem==null and size!=0
+// frees if mem!=null and size==0
+void *xrealloc(void *mem, uint32_t size) {
+    if (!size) {
+        free(mem);
+        return NULL;
+    }
+    mem = realloc(mem, size);
+    if (mem == NULL) {
+        xalloc_fail(size);
+    }
+    return mem;
+}
@@ -0,0 +1,247 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * File utilities for the imlib benchmark (backed by stdio).
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "py/runtime.h"
+#include "file_utils.h"
+
+const char *ffs_strerror(FRESULT res) {
+    static const char *ffs_errors[] = {
+        "Succeeded",
+        "A hard error occurred in the low level disk I/O layer",
+        "Assertion failed",
+        "The physical drive cannot work",
+        "Could not find the file",
+        "Could not find the path",
+        "The path name format is invalid",
+        "Access denied due to prohibited access or directory full",
+        "Access denied due to prohibited access",
+        "The file/directory object is invalid",
+    };
+    return (res < (sizeof(ffs_errors) / sizeof(ffs_errors[0]))) ? ffs_errors[res] : "Unknown error";
+}
+
+NORETURN static void ff_read_fail(FIL *fp) {
+    if (fp) {
+        file_ll_close(fp);
+    }
+    mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("Failed to read requested bytes!"));
+}
+
+NORETURN static void ff_write_fail(FIL *fp) {
+    if (fp) {
+        file_ll_close(fp);
+    }
+    mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("Failed to write requested bytes!"));
+}
+
+NORETURN static void ff_expect_fail(FIL *fp) {
+    if (fp) {
+        file_ll_close(fp);
+    }
+    mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("Unexpected value read!"));
+}
+
+NORETURN void file_raise_format(FIL *fp) {
+    if (fp) {
+        file_ll_close(fp);
+    }
+    mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("Unsupported format!"));
+}
+
+NORETURN void file_raise_corrupted(FIL *fp) {
+    if (fp) {
+        file_ll_close(fp);
+    }
+    mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("File corrupted!"));
+}
+
+NORETURN void file_raise_error(FIL *fp, FRESULT res) {
+    if (fp) {
+        file_ll_close(fp);
+    }
+    mp_raise_msg(&mp_type_OSError, (mp_rom_error_text_t) ffs_strerror(res));
+}
+
+FRESULT file_ll_open(FIL *fp, const TCHAR *path, BYTE mode) {
+    const char *fmode = (mode & FA_WRITE) ? ((mode & FA_READ) ? "w+b" : "wb") : "rb";
+    fp->fp = fopen(path, fmode);
+    if (!fp->fp) {
+        return FR_NO_FILE;
+    }
+    struct stat st;
+    fp->size = fstat(fileno(fp->fp), &st) ? 0 : st.st_size;
+    return FR_OK;
+}
+
+FRESULT file_ll_close(FIL *fp) {
+    if (fp->fp) {
+        fclose(fp->fp);
+        fp->fp = NULL;
+    }
+    return FR_OK;
+}
+
+FRESULT file_ll_read(FIL *fp, void *buff, UINT btr, UINT *br) {
+    *br = fread(buff, 1, btr, fp->fp);
+    return ferror(fp->fp) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT file_ll_write(FIL *fp, const void *buff, UINT btw, UINT *bw) {
+    *bw = fwrite(buff, 1, btw, fp->fp);
+    if (ftell(fp->fp) > fp->size) {
+        fp->size = ftell(fp->fp);
+    }
+    return ferror(fp->fp) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT file_ll_opendir(FF_DIR *dp, const TCHAR *path) {
+    return FR_NO_PATH;
+}
+
+FRESULT file_ll_stat(const TCHAR *path, FILINFO *fno) {
+    struct stat st;
+    if (stat(path, &st)) {
+        return FR_NO_FILE;
+    }
+    if (fno) {
+        fno->fsize = st.st_size;
+        fno->fattrib = 0;
+        strncpy(fno->fname, path, sizeof(fno->fname) - 1);
+        fno->fname[sizeof(fno->fname) - 1] = '\0';
+    }
+    return FR_OK;
+}
+
+FRESULT file_ll_mkdir(const TCHAR *path) {
+    return mkdir(path, 0755) ? FR_DENIED : FR_OK;
+}
+
+FRESULT file_ll_unlink(const TCHAR *path) {
+    return unlink(path) ? FR_NO_FILE : FR_OK;
+}
+
+FRESULT file_ll_rename(const TCHAR *path_old, const TCHAR *path_new) {
+    return rename(path_old, path_new) ? FR_NO_FILE : FR_OK;
+}
+
+FRESULT file_ll_touch(const TCHAR *path) {
+    FIL fp;
+    if (file_ll_stat(path, NULL) != FR_OK) {
+        if (file_ll_open(&fp, path, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK) {
+            file_ll_close(&fp);
+        }
+    }
+    return FR_OK;
+}
+
+// stdio already buffers, so the fb_alloc backed file buffer is not needed.
+void file_buffer_init0() {
+}
+
+void file_buffer_on(FIL *fp) {
+}
+
+void file_buffer_off(FIL *fp) {
+}
+
+void file_open(FIL *fp, const char *path, bool buffered, uint32_t flags) {
+    FRESULT res = file_ll_open(fp, path, flags);
+    if (res != FR_OK) {
+        file_raise_error(NULL, res);
+    }
+}
+
+void file_close(FIL *fp) {
+    file_ll_close(fp);
+}
+
+void file_seek(FIL *fp, UINT offset) {
+    if (fseek(fp->fp, offset, SEEK_SET)) {
+        file_raise_error(fp, FR_DISK_ERR);
+    }
+}
+
+void file_truncate(FIL *fp) {
+    fflush(fp->fp);
+    if (ftruncate(fileno(fp->fp), ftell(fp->fp))) {
+        file_raise_error(fp, FR_DISK_ERR);
+    }
+    fp->size = ftell(fp->fp);
+}
+
+void file_sync(FIL *fp) {
+    fflush(fp->fp);
+}
+
+uint32_t file_tell(FIL *fp) {
+    return ftell(fp->fp);
+}
+
+uint32_t file_size(FIL *fp) {
+    return f_size(fp);
+}
+
+void file_read(FIL *fp, void *data, size_t size) {
+    if (data == NULL) {
+        if (fseek(fp->fp, size, SEEK_CUR)) {
+            ff_read_fail(fp);
+        }
+        return;
+    }
+
+    UINT bytes;
+    FRESULT res = file_ll_read(fp, data, size, &bytes);
+    if (res != FR_OK) {
+        file_raise_error(fp, res);
+    }
+    if (bytes != size) {
+        ff_read_fail(fp);
+    }
+}
+
+void file_write(FIL *fp, const void *data, size_t size) {
+    UINT bytes;
+    FRESULT res = file_ll_write(fp, data, size, &bytes);
+    if (res != FR_OK) {
+        file_raise_error(fp, res);
+    }
+    if (bytes != size) {
+        ff_write_fail(fp);
+    }
+}
+
+void file_write_byte(FIL *fp, uint8_t value) {
+    file_write(fp, &value, 1);
+}
+
+void file_write_short(FIL *fp, uint16_t value) {
+    file_write(fp, &value, 2);
+}
+
+void file_write_long(FIL *fp, uint32_t value) {
+    file_write(fp, &value, 4);
+}
+
+void file_read_check(FIL *fp, const void *data, size_t size) {
+    uint8_t buf[16];
+    while (size) {
+        size_t can_do = (size < sizeof(buf)) ? size : sizeof(buf);
+        file_read(fp, buf, can_do);
+        if (memcmp(buf, data, can_do)) {
+            ff_expect_fail(fp);
+        }
+        data += can_do;
+        size -= can_do;
+    }
+}
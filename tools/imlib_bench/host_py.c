@@ -0,0 +1,134 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * MicroPython runtime stubs for the imlib benchmark.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+#include <math.h>
+#include "arm_math.h"
+#include "py/runtime.h"
+#include "py/mphal.h"
+#include "py/gc.h"
+#include "mpprint.h"
+#include "host.h"
+
+const mp_obj_type_t mp_type_OSError = { "OSError" };
+const mp_obj_type_t mp_type_MemoryError = { "MemoryError" };
+const mp_obj_type_t mp_type_ValueError = { "ValueError" };
+const mp_obj_type_t mp_type_TypeError = { "TypeError" };
+const mp_obj_type_t mp_type_RuntimeError = { "RuntimeError" };
+
+static host_nlr_buf_t *nlr_top = NULL;
+static char nlr_msg[256];
+
+void host_nlr_link(host_nlr_buf_t *buf) {
+    buf->prev = nlr_top;
+    nlr_top = buf;
+}
+
+void host_nlr_pop(void) {
+    if (nlr_top) {
+        nlr_top = nlr_top->prev;
+    }
+}
+
+const char *host_nlr_msg(void) {
+    return nlr_msg;
+}
+
+NORETURN static void host_nlr_jump(void) {
+    host_nlr_buf_t *top = nlr_top;
+    if (!top) {
+        fprintf(stderr, "Unhandled exception: %s\n", nlr_msg);
+        exit(EXIT_FAILURE);
+    }
+    nlr_top = top->prev;
+    longjmp(top->jmp, 1);
+}
+
+NORETURN void mp_raise_msg(const mp_obj_type_t *type, mp_rom_error_text_t msg) {
+    snprintf(nlr_msg, sizeof(nlr_msg), "%s: %s", type->name, msg);
+    host_nlr_jump();
+}
+
+NORETURN void mp_raise_msg_varg(const mp_obj_type_t *type, mp_rom_error_text_t fmt, ...) {
+    int len = snprintf(nlr_msg, sizeof(nlr_msg), "%s: ", type->name);
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(nlr_msg + len, sizeof(nlr_msg) - len, fmt, args);
+    va_end(args);
+    host_nlr_jump();
+}
+
+// The exception object is its message, nlr_jump() raises it.
+mp_obj_t mp_obj_new_exception_msg(const mp_obj_type_t *type, mp_rom_error_text_t msg) {
+    snprintf(nlr_msg, sizeof(nlr_msg), "%s: %s", type->name, msg);
+    return nlr_msg;
+}
+
+NORETURN void nlr_jump(void *val) {
+    host_nlr_jump();
+}
+
+static void host_print_strn(void *data, const char *str, size_t len) {
+    fwrite(str, 1, len, stdout);
+}
+
+const mp_print_t mp_plat_print = { NULL, host_print_strn };
+
+NORETURN void mp_raise_ValueError(mp_rom_error_text_t msg) {
+    mp_raise_msg(&mp_type_ValueError, msg);
+}
+
+NORETURN void mp_raise_OSError(int errcode) {
+    mp_raise_msg_varg(&mp_type_OSError, "%d", errcode);
+}
+
+uint64_t host_ticks_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (((uint64_t) ts.tv_sec) * 1000000) + (ts.tv_nsec / 1000);
+}
+
+mp_uint_t mp_hal_ticks_ms(void) {
+    return host_ticks_us() / 1000;
+}
+
+mp_uint_t mp_hal_ticks_us(void) {
+    return host_ticks_us();
+}
+
+// xalloc() is backed by the C heap on the host, so there is nothing to collect.
+void gc_info(gc_info_t *info) {
+    info->total = 64 * 1024 * 1024;
+    info->used = 0;
+    info->free = info->total;
+    info->max_free = info->total / 16;
+    info->num_1block = 0;
+    info->num_2block = 0;
+    info->max_block = 0;
+}
+
+void gc_collect(void) {
+}
+
+// CMSIS-DSP fast math replacements.
+float32_t arm_sin_f32(float32_t x) {
+    return sinf(x);
+}
+
+float32_t arm_cos_f32(float32_t x) {
+    return cosf(x);
+}
+
+uint32_t rng_randint(uint32_t min, uint32_t max) {
+    return (min == max) ? min : (min + (rand() % (max - min)));
+}
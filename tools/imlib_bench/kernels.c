@@ -0,0 +1,1809 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * imlib benchmark kernels. Parameters and expected results follow the
+ * scripts in scripts/unittest/script where one exists.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "imlib.h"
+#include "fb_alloc.h"
+#include "xalloc.h"
+#include "bench.h"
+
+static void thresholds_add(list_t *thresholds, int l_min, int l_max, int a_min, int a_max, int b_min, int b_max) {
+    color_thresholds_list_lnk_data_t lnk_data = {
+        .LMin = l_min, .LMax = l_max,
+        .AMin = a_min, .AMax = a_max,
+        .BMin = b_min, .BMax = b_max
+    };
+    list_push_back(thresholds, &lnk_data);
+}
+
+static void generic_thresholds(list_t *thresholds) {
+    list_init(thresholds, sizeof(color_thresholds_list_lnk_data_t));
+    thresholds_add(thresholds, 0, 100, 56, 95, 41, 74);         // generic_red_thresholds
+    thresholds_add(thresholds, 0, 100, -128, -22, -128, 99);    // generic_green_thresholds
+    thresholds_add(thresholds, 0, 100, -128, 98, -128, -16);    // generic_blue_thresholds
+}
+
+// Compiled once like a thresholds object held by a script.
+static color_thresholds_bitmap_t *generic_thresholds_bitmap(list_t *thresholds) {
+    static uint32_t data[(3 + 2) * COLOR_THRESHOLDS_BITMAP_WORDS];
+    static color_thresholds_bitmap_t bitmap;
+
+    if (!bitmap.count) {
+        imlib_color_thresholds_bitmap_init(&bitmap, thresholds, data);
+    }
+
+    return &bitmap;
+}
+
+static bool find_blobs_check(image_t *img, char *result, find_blobs_mode_t mode, bool compiled) {
+    list_t thresholds, out;
+    generic_thresholds(&thresholds);
+    color_thresholds_bitmap_t *bitmap = compiled ? generic_thresholds_bitmap(&thresholds) : NULL;
+
+    rectangle_t roi = { 0, 0, img->w, img->h };
+    imlib_find_blobs(&out, img, &roi, 2, 1, &thresholds, bitmap, false, 200, 2000, false, 0,
+                     NULL, NULL, NULL, NULL, 0, 0, mode);
+    list_free(&thresholds);
+
+    static const int expected[3][7] = {
+        { 122, 41, 98, 82, 6260, 168, 82 },
+        { 44, 42, 78, 88, 5158, 80, 84 },
+        { 210, 40, 72, 82, 3986, 248, 77 },
+    };
+
+    bool ok = (list_size(&out) == 3);
+    snprintf(result, BENCH_RESULT_LEN, "%u blobs", (unsigned) list_size(&out));
+
+    for (int i = 0; list_size(&out); i++) {
+        find_blobs_list_lnk_data_t lnk_data;
+        list_pop_front(&out, &lnk_data);
+        if (ok) {
+            int blob[7] = {
+                lnk_data.rect.x, lnk_data.rect.y, lnk_data.rect.w, lnk_data.rect.h,
+                lnk_data.pixels, (int) lnk_data.centroid_x, (int) lnk_data.centroid_y
+            };
+            ok = !memcmp(blob, expected[i], sizeof(blob));
+        }
+    }
+
+    return ok;
+}
+
+static bool bench_find_blobs(image_t *img, char *result) {
+    return find_blobs_check(img, result, FIND_BLOBS_MODE_FLOOD_FILL, false);
+}
+
+static bool bench_find_blobs_single_pass(image_t *img, char *result) {
+    return find_blobs_check(img, result, FIND_BLOBS_MODE_SINGLE_PASS, false);
+}
+
+static bool bench_find_blobs_compiled(image_t *img, char *result) {
+    return find_blobs_check(img, result, FIND_BLOBS_MODE_FLOOD_FILL, true);
+}
+
+static bool bench_find_blobs_single_pass_compiled(image_t *img, char *result) {
+    return find_blobs_check(img, result, FIND_BLOBS_MODE_SINGLE_PASS, true);
+}
+
+static void find_blobs_shapes_fill(image_t *img, int x, int y, int w, int h, uint8_t value) {
+    for (int i = y; i < (y + h); i++) {
+        memset(IMAGE_COMPUTE_GRAYSCALE_PIXEL_ROW_PTR(img, i) + x, value, w);
+    }
+}
+
+// Returns true if both lists hold the same blobs with every field and histogram bin equal. Frees both lists.
+static bool find_blobs_equal(list_t *a, list_t *b) {
+    bool ok = list_size(a) == list_size(b);
+
+    while (list_size(a) && list_size(b)) {
+        find_blobs_list_lnk_data_t x, y;
+        list_pop_front(a, &x);
+        list_pop_front(b, &y);
+        ok = ok && (!memcmp(x.corners, y.corners, sizeof(x.corners))) &&
+             (!memcmp(&x.rect, &y.rect, sizeof(rectangle_t))) &&
+             (x.pixels == y.pixels) && (x.perimeter == y.perimeter) && (x.code == y.code) && (x.count == y.count) &&
+             (x.centroid_x == y.centroid_x) && (x.centroid_y == y.centroid_y) &&
+             (x.rotation == y.rotation) && (x.roundness == y.roundness) &&
+             (x.centroid_x_acc == y.centroid_x_acc) && (x.centroid_y_acc == y.centroid_y_acc) &&
+             (x.rotation_acc_x == y.rotation_acc_x) && (x.rotation_acc_y == y.rotation_acc_y) &&
+             (x.roundness_acc == y.roundness_acc) &&
+             (x.x_hist_bins_count == y.x_hist_bins_count) && (x.y_hist_bins_count == y.y_hist_bins_count) &&
+             ((!x.x_hist_bins_count) || (!memcmp(x.x_hist_bins, y.x_hist_bins, x.x_hist_bins_count * sizeof(uint16_t)))) &&
+             ((!x.y_hist_bins_count) || (!memcmp(x.y_hist_bins, y.y_hist_bins, y.y_hist_bins_count * sizeof(uint16_t))));
+        xfree(x.x_hist_bins);
+        xfree(x.y_hist_bins);
+        xfree(y.x_hist_bins);
+        xfree(y.y_hist_bins);
+    }
+
+    list_free(a);
+    list_free(b);
+    return ok;
+}
+
+// Finds the blobs with mode and with the flood fill and returns true if they are the same.
+static bool find_blobs_compare(image_t *img, rectangle_t *roi, int x_stride, int y_stride, list_t *thresholds,
+                               bool invert, int hist_bins, find_blobs_mode_t mode, size_t *count) {
+    list_t out, ref;
+    imlib_find_blobs(&out, img, roi, x_stride, y_stride, thresholds, NULL, invert, 1, 1, false, 0,
+                     NULL, NULL, NULL, NULL, hist_bins, hist_bins, mode);
+    imlib_find_blobs(&ref, img, roi, x_stride, y_stride, thresholds, NULL, invert, 1, 1, false, 0,
+                     NULL, NULL, NULL, NULL, hist_bins, hist_bins, FIND_BLOBS_MODE_FLOOD_FILL);
+    *count += list_size(&ref);
+    return find_blobs_equal(&out, &ref);
+}
+
+// The perimeter of the flood fill counts some of the pixels above a run again when it returns to the run
+// from a run below. The single pass must count them the same way.
+static bool bench_find_blobs_single_pass_perimeter(image_t *img, char *result) {
+    image_t shapes = { .w = 64, .h = 48, .pixfmt = PIXFORMAT_GRAYSCALE };
+    fb_alloc_mark();
+    shapes.data = fb_alloc0(image_size(&shapes), FB_ALLOC_NO_HINT);
+    find_blobs_shapes_fill(&shapes, 40, 0, 10, 10, 255); // Square on the roi border.
+    find_blobs_shapes_fill(&shapes, 4, 4, 10, 10, 255); // Square.
+    find_blobs_shapes_fill(&shapes, 4, 24, 3, 7, 255); // L.
+    find_blobs_shapes_fill(&shapes, 4, 31, 10, 3, 255);
+    find_blobs_shapes_fill(&shapes, 24, 24, 12, 12, 255); // Ring.
+    find_blobs_shapes_fill(&shapes, 28, 28, 4, 4, 0);
+
+    list_t thresholds, out, ref;
+    list_init(&thresholds, sizeof(color_thresholds_list_lnk_data_t));
+    thresholds_add(&thresholds, 128, 255, 0, 0, 0, 0);
+
+    rectangle_t roi = { 0, 0, shapes.w, shapes.h };
+    imlib_find_blobs(&out, &shapes, &roi, 1, 1, &thresholds, NULL, false, 1, 1, false, 0,
+                     NULL, NULL, NULL, NULL, 0, 0, FIND_BLOBS_MODE_SINGLE_PASS);
+    imlib_find_blobs(&ref, &shapes, &roi, 1, 1, &thresholds, NULL, false, 1, 1, false, 0,
+                     NULL, NULL, NULL, NULL, 0, 0, FIND_BLOBS_MODE_FLOOD_FILL);
+    list_free(&thresholds);
+
+    // Flood fill perimeters of the square on the roi border, the square, the L and the ring.
+    static const int expected[4] = { 48, 44, 42, 70 };
+    bool ok = (list_size(&out) == 4);
+    snprintf(result, BENCH_RESULT_LEN, "%u blobs", (unsigned) list_size(&out));
+
+    list_t *blobs = &ref;
+    size_t i = 0;
+    list_for_each(it, blobs) {
+        find_blobs_list_lnk_data_t *lnk_data = list_get_data(it);
+        ok = ok && (i < 4) && (lnk_data->perimeter == expected[i++]);
+    }
+
+    ok = find_blobs_equal(&out, &ref) && ok;
+    fb_alloc_free_till_mark();
+    return ok;
+}
+
+// Compares the single pass blobs against the flood fill ones for overlapping thresholds, strides that
+// miss blobs, inverted thresholds, an inner roi and histograms.
+static bool bench_find_blobs_single_pass_exact(image_t *img, char *result) {
+    static const int strides[4][2] = { { 1, 1 }, { 2, 1 }, { 4, 3 }, { 3, 2 } };
+    list_t thresholds;
+    list_init(&thresholds, sizeof(color_thresholds_list_lnk_data_t));
+
+    switch (img->pixfmt) {
+        case PIXFORMAT_BINARY: {
+            thresholds_add(&thresholds, 1, 1, 0, 0, 0, 0);
+            thresholds_add(&thresholds, 0, 1, 0, 0, 0, 0);
+            break;
+        }
+        case PIXFORMAT_GRAYSCALE: {
+            thresholds_add(&thresholds, 100, 200, 0, 0, 0, 0);
+            thresholds_add(&thresholds, 150, 255, 0, 0, 0, 0);
+            thresholds_add(&thresholds, 0, 60, 0, 0, 0, 0);
+            thresholds_add(&thresholds, 50, 120, 0, 0, 0, 0);
+            break;
+        }
+        default: {
+            generic_thresholds(&thresholds);
+            thresholds_add(&thresholds, 30, 100, -128, 127, -128, 127);
+            break;
+        }
+    }
+
+    rectangle_t rois[2] = { { 0, 0, img->w, img->h }, { 13, 7, img->w - 40, img->h - 20 } };
+    size_t count = 0;
+    int exact = 0, n = 0;
+
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 2; j++) {
+            for (int invert = 0; invert < 2; invert++, n++) {
+                exact += find_blobs_compare(img, rois + j, strides[i][0], strides[i][1], &thresholds, invert,
+                                            (i & 1) ? 8 : 0, FIND_BLOBS_MODE_SINGLE_PASS, &count);
+            }
+        }
+    }
+
+    list_free(&thresholds);
+    snprintf(result, BENCH_RESULT_LEN, "%d/%d exact %u blobs", exact, n, (unsigned) count);
+    return exact == n;
+}
+
+// Finds the blobs of a binary image dense with blobs, where the single pass skips 32 pixels at a time.
+static bool find_blobs_dense_check(image_t *img, char *result, find_blobs_mode_t mode) {
+    static bool checked[2], exact[2];
+    list_t thresholds, out;
+    list_init(&thresholds, sizeof(color_thresholds_list_lnk_data_t));
+    thresholds_add(&thresholds, 1, 1, 0, 0, 0, 0);
+
+    rectangle_t roi = { 0, 0, img->w, img->h };
+    imlib_find_blobs(&out, img, &roi, 2, 1, &thresholds, NULL, false, 10, 10, false, 0,
+                     NULL, NULL, NULL, NULL, 0, 0, mode);
+    snprintf(result, BENCH_RESULT_LEN, "%u blobs", (unsigned) list_size(&out));
+
+    if (!checked[mode]) {
+        list_t ref;
+        imlib_find_blobs(&ref, img, &roi, 2, 1, &thresholds, NULL, false, 10, 10, false, 0,
+                         NULL, NULL, NULL, NULL, 0, 0, FIND_BLOBS_MODE_FLOOD_FILL);
+        checked[mode] = true;
+        exact[mode] = find_blobs_equal(&out, &ref);
+    }
+
+    list_free(&out);
+    list_free(&thresholds);
+    return exact[mode];
+}
+
+static bool bench_find_blobs_dense(image_t *img, char *result) {
+    return find_blobs_dense_check(img, result, FIND_BLOBS_MODE_FLOOD_FILL);
+}
+
+static bool bench_find_blobs_dense_single_pass(image_t *img, char *result) {
+    return find_blobs_dense_check(img, result, FIND_BLOBS_MODE_SINGLE_PASS);
+}
+
+// A pixel of an earlier threshold next to a blob that no stride sample reaches is outside of the blob
+// for the per threshold passes, which count it in the perimeter, and so for the single pass.
+static bool bench_find_blobs_single_pass_x4(image_t *img, char *result) {
+    image_t shapes = { .w = 64, .h = 48, .pixfmt = PIXFORMAT_GRAYSCALE };
+    fb_alloc_mark();
+    shapes.data = fb_alloc0(image_size(&shapes), FB_ALLOC_NO_HINT);
+    find_blobs_shapes_fill(&shapes, 10, 10, 10, 10, 255);
+    find_blobs_shapes_fill(&shapes, 12, 9, 1, 1, 128); // Not on a sample for an x stride of 4.
+
+    list_t thresholds;
+    list_init(&thresholds, sizeof(color_thresholds_list_lnk_data_t));
+    thresholds_add(&thresholds, 100, 150, 0, 0, 0, 0);
+    thresholds_add(&thresholds, 200, 255, 0, 0, 0, 0);
+
+    rectangle_t roi = { 0, 0, shapes.w, shapes.h };
+    size_t count = 0;
+    bool ok = find_blobs_compare(&shapes, &roi, 1, 1, &thresholds, false, 0, FIND_BLOBS_MODE_SINGLE_PASS, &count) &&
+              find_blobs_compare(&shapes, &roi, 4, 1, &thresholds, false, 0, FIND_BLOBS_MODE_SINGLE_PASS, &count);
+    snprintf(result, BENCH_RESULT_LEN, "%u blobs", (unsigned) count);
+
+    list_free(&thresholds);
+    fb_alloc_free_till_mark();
+    return ok && (count == 3);
+}
+
+// Thresholds for n colors around the A/B plane, which leave out the gray pixels.
+static void find_blobs_colors(list_t *thresholds, int n) {
+    list_init(thresholds, sizeof(color_thresholds_list_lnk_data_t));
+    for (int i = 0; i < n; i++) {
+        int a = fast_roundf(45.0f * cosf((2.0f * M_PI * i) / n));
+        int b = fast_roundf(45.0f * sinf((2.0f * M_PI * i) / n));
+        thresholds_add(thresholds, 0, 100, a - 18, a + 18, b - 18, b + 18);
+    }
+}
+
+// The per threshold passes take about n times as long for n colors while the single pass classifies each
+// pixel once. The first run of the single pass checks it against the flood fill.
+static bool find_blobs_colors_check(image_t *img, char *result, int n, find_blobs_mode_t mode) {
+    static bool checked[9], exact[9];
+    list_t thresholds, out;
+    find_blobs_colors(&thresholds, n);
+
+    rectangle_t roi = { 0, 0, img->w, img->h };
+    imlib_find_blobs(&out, img, &roi, 2, 1, &thresholds, NULL, false, 10, 10, false, 0,
+                     NULL, NULL, NULL, NULL, 0, 0, mode);
+    snprintf(result, BENCH_RESULT_LEN, "%u blobs", (unsigned) list_size(&out));
+    list_free(&out);
+
+    if (mode == FIND_BLOBS_MODE_FLOOD_FILL) {
+        exact[n] = true;
+    } else if (!checked[n]) {
+        size_t count = 0;
+        checked[n] = true;
+        exact[n] = find_blobs_compare(img, &roi, 2, 1, &thresholds, false, 0, mode, &count);
+    }
+
+    list_free(&thresholds);
+    return exact[n];
+}
+
+static bool bench_find_blobs_2_colors(image_t *img, char *result) {
+    return find_blobs_colors_check(img, result, 2, FIND_BLOBS_MODE_FLOOD_FILL);
+}
+
+static bool bench_find_blobs_2_colors_single_pass(image_t *img, char *result) {
+    return find_blobs_colors_check(img, result, 2, FIND_BLOBS_MODE_SINGLE_PASS);
+}
+
+static bool bench_find_blobs_4_colors(image_t *img, char *result) {
+    return find_blobs_colors_check(img, result, 4, FIND_BLOBS_MODE_FLOOD_FILL);
+}
+
+static bool bench_find_blobs_4_colors_single_pass(image_t *img, char *result) {
+    return find_blobs_colors_check(img, result, 4, FIND_BLOBS_MODE_SINGLE_PASS);
+}
+
+static bool bench_find_blobs_8_colors(image_t *img, char *result) {
+    return find_blobs_colors_check(img, result, 8, FIND_BLOBS_MODE_FLOOD_FILL);
+}
+
+static bool bench_find_blobs_8_colors_single_pass(image_t *img, char *result) {
+    return find_blobs_colors_check(img, result, 8, FIND_BLOBS_MODE_SINGLE_PASS);
+}
+
+static bool binary_check(image_t *img, char *result, bool compiled) {
+    static bool checked, exact;
+    list_t thresholds;
+    generic_thresholds(&thresholds);
+    color_thresholds_bitmap_t *bitmap = compiled ? generic_thresholds_bitmap(&thresholds) : NULL;
+
+    image_t out = { .w = img->w, .h = img->h, .pixfmt = PIXFORMAT_BINARY };
+    fb_alloc_mark();
+    out.data = fb_alloc(image_size(&out), FB_ALLOC_NO_HINT);
+    imlib_binary(&out, img, &thresholds, bitmap, false, false, NULL);
+
+    // Both polarities must match the per threshold passes.
+    if (compiled && (!checked)) {
+        checked = exact = true;
+        image_t ref = out;
+        ref.data = fb_alloc(image_size(&ref), FB_ALLOC_NO_HINT);
+
+        for (int invert = 0; invert < 2; invert++) {
+            imlib_binary(&out, img, &thresholds, bitmap, invert, false, NULL);
+            imlib_binary(&ref, img, &thresholds, NULL, invert, false, NULL);
+            exact = exact && (!memcmp(out.data, ref.data, image_size(&out)));
+        }
+    }
+
+    fb_alloc_free_till_mark();
+    list_free(&thresholds);
+    return compiled ? exact : true;
+}
+
+static bool bench_binary(image_t *img, char *result) {
+    return binary_check(img, result, false);
+}
+
+static bool bench_binary_compiled(image_t *img, char *result) {
+    return binary_check(img, result, true);
+}
+
+static bool bench_mean_1(image_t *img, char *result) {
+    imlib_mean_filter(img, 1, false, 0, false, NULL);
+    return true;
+}
+
+static bool bench_mean_2(image_t *img, char *result) {
+    imlib_mean_filter(img, 2, false, 0, false, NULL);
+    return true;
+}
+
+// Fills mask with blocks of set and cleared pixels.
+static void bench_mask_fill(image_t *mask) {
+    for (int y = 0; y < mask->h; y++) {
+        for (int x = 0; x < mask->w; x++) {
+            IMAGE_PUT_BINARY_PIXEL(mask, x, y, ((x / 7) + (y / 5)) & 1);
+        }
+    }
+}
+
+// imlib_median_filter() of filter.c built without the constant time path (see the Makefile).
+void imlib_median_filter_ref(image_t *img, const int ksize, float percentile, bool threshold, int offset, bool invert,
+                             image_t *mask);
+
+// Same bins as hist_median() in filter.c.
+static int bench_median_bin(int *hist, int len, int cutoff) {
+    int i, sum = 0;
+    for (i = 0; (i < len) && (sum < cutoff); i++) {
+        sum += hist[i];
+    }
+    return (uint8_t) (i - 1);
+}
+
+// The sliding histogram path of imlib_median_filter() with int counts. The sliding path counts in
+// uint8_t which wraps for windows of more than 255 pixels (ksize >= 8).
+static void bench_median_brute(image_t *dst, image_t *src, int ksize, float percentile, bool threshold, int offset,
+                               bool invert, image_t *mask) {
+    int cutoff = fast_floorf(percentile * (float) (((ksize * 2) + 1) * ((ksize * 2) + 1)));
+
+    for (int y = 0; y < src->h; y++) {
+        for (int x = 0; x < src->w; x++) {
+            if (mask && (!image_get_mask_pixel(mask, x, y))) {
+                continue;
+            }
+
+            int hist[3][64] = { 0 };
+
+            for (int j = -ksize; j <= ksize; j++) {
+                for (int k = -ksize; k <= ksize; k++) {
+                    int x_k = IM_CLAMP(x + k, 0, (src->w - 1)), y_j = IM_CLAMP(y + j, 0, (src->h - 1));
+
+                    if (src->pixfmt == PIXFORMAT_RGB565) {
+                        int pixel = IMAGE_GET_RGB565_PIXEL(src, x_k, y_j);
+                        hist[0][COLOR_RGB565_TO_R5(pixel)]++;
+                        hist[1][COLOR_RGB565_TO_G6(pixel)]++;
+                        hist[2][COLOR_RGB565_TO_B5(pixel)]++;
+                    } else {
+                        hist[0][IMAGE_GET_GRAYSCALE_PIXEL(src, x_k, y_j) >> 2]++;
+                    }
+                }
+            }
+
+            if (src->pixfmt == PIXFORMAT_RGB565) {
+                int pixel = COLOR_R5_G6_B5_TO_RGB565((uint8_t) bench_median_bin(hist[0], 32, cutoff),
+                                                     (uint8_t) bench_median_bin(hist[1], 64, cutoff),
+                                                     (uint8_t) bench_median_bin(hist[2], 32, cutoff));
+
+                if (threshold) {
+                    bool set = ((COLOR_RGB565_TO_Y(pixel) - offset) <
+                                COLOR_RGB565_TO_Y(IMAGE_GET_RGB565_PIXEL(src, x, y))) ^ invert;
+                    pixel = set ? COLOR_RGB565_BINARY_MAX : COLOR_RGB565_BINARY_MIN;
+                }
+
+                IMAGE_PUT_RGB565_PIXEL(dst, x, y, pixel);
+            } else {
+                uint8_t pixel = bench_median_bin(hist[0], 64, cutoff);
+                pixel <<= 2;
+
+                if (threshold) {
+                    bool set = ((pixel - offset) < IMAGE_GET_GRAYSCALE_PIXEL(src, x, y)) ^ invert;
+                    pixel = set ? COLOR_GRAYSCALE_BINARY_MAX : COLOR_GRAYSCALE_BINARY_MIN;
+                }
+
+                IMAGE_PUT_GRAYSCALE_PIXEL(dst, x, y, pixel);
+            }
+        }
+    }
+}
+
+// The constant time path must give the same output as the sliding histogram path for ksize 1-9,
+// a few percentiles and with threshold and mask, checked on the first run per format. ksize 8 and
+// 9 are checked against bench_median_brute() for the median only.
+static bool median_check(image_t *img, char *result, int ksize) {
+    static bool checked[2], exact[2];
+    static const float percentiles[] = { 0.0f, 0.25f, 0.5f, 0.9f, 1.0f };
+    bool color = img->pixfmt == PIXFORMAT_RGB565;
+
+    if (!checked[color]) {
+        checked[color] = exact[color] = true;
+        fb_alloc_mark();
+        image_t out = *img, ref = *img, mask = { .w = img->w, .h = img->h, .pixfmt = PIXFORMAT_BINARY };
+        out.data = fb_alloc(image_size(img), FB_ALLOC_NO_HINT);
+        ref.data = fb_alloc(image_size(img), FB_ALLOC_NO_HINT);
+        mask.data = fb_alloc(image_size(&mask), FB_ALLOC_NO_HINT);
+        bench_mask_fill(&mask);
+
+        for (int k = 1; k <= 9; k++) {
+            for (int p = 0; p < (sizeof(percentiles) / sizeof(percentiles[0])); p++) {
+                // The brute force reference is slow.
+                if ((k >= 8) && (percentiles[p] != 0.5f)) {
+                    continue;
+                }
+
+                // Plain, threshold, inverted threshold with mask and mask only.
+                for (int i = 0; i < 4; i++) {
+                    bool threshold = (i == 1) || (i == 2);
+                    image_t *m = (i >= 2) ? &mask : NULL;
+                    memcpy(out.data, img->data, image_size(img));
+                    memcpy(ref.data, img->data, image_size(img));
+                    imlib_median_filter(&out, k, percentiles[p], threshold, 4, i == 2, m);
+                    if (k < 8) {
+                        imlib_median_filter_ref(&ref, k, percentiles[p], threshold, 4, i == 2, m);
+                    } else {
+                        bench_median_brute(&ref, img, k, percentiles[p], threshold, 4, i == 2, m);
+                    }
+                    exact[color] = exact[color] && (!memcmp(out.data, ref.data, image_size(img)));
+                }
+            }
+        }
+
+        fb_alloc_free_till_mark();
+    }
+
+    imlib_median_filter(img, ksize, 0.5f, false, 0, false, NULL);
+    return exact[color];
+}
+
+static bool bench_median_1(image_t *img, char *result) {
+    return median_check(img, result, 1);
+}
+
+static bool bench_median_2(image_t *img, char *result) {
+    return median_check(img, result, 2);
+}
+
+static bool bench_median_7(image_t *img, char *result) {
+    return median_check(img, result, 7);
+}
+
+// imlib_erode() and imlib_dilate() of binary.c built without the van Herk/Gil-Werman path (see the
+// Makefile).
+void imlib_erode_ref(image_t *img, int ksize, int threshold, image_t *mask);
+void imlib_dilate_ref(image_t *img, int ksize, int threshold, image_t *mask);
+
+// The van Herk/Gil-Werman path must give the same output as the counting path for ksize 0-9, with
+// and without a mask, on the whole image and on a crop with an odd width where the clamped borders
+// fall inside of the words. Checked on the first run per format.
+static bool morph_check(image_t *img) {
+    static bool checked[2], exact[2];
+    bool binary = img->pixfmt == PIXFORMAT_BINARY;
+
+    if (!checked[binary]) {
+        checked[binary] = exact[binary] = true;
+        fb_alloc_mark();
+        image_t out = *img, ref = *img, mask = { .w = img->w, .h = img->h, .pixfmt = PIXFORMAT_BINARY };
+        out.data = fb_alloc(image_size(img), FB_ALLOC_NO_HINT);
+        ref.data = fb_alloc(image_size(img), FB_ALLOC_NO_HINT);
+        mask.data = fb_alloc(image_size(&mask), FB_ALLOC_NO_HINT);
+        bench_mask_fill(&mask);
+
+        for (int crop = 0; crop < 2; crop++) {
+            image_t src = *img;
+
+            // The crop is a 37x29 image in the same buffers, the pixels are copied one by one below.
+            if (crop) {
+                src.w = out.w = ref.w = mask.w = 37;
+                src.h = out.h = ref.h = mask.h = 29;
+            }
+
+            for (int k = 0; k <= 9; k++) {
+                for (int i = 0; i < 4; i++) {
+                    bool dilate = i & 1;
+                    image_t *m = (i & 2) ? &mask : NULL;
+
+                    for (int y = 0; y < src.h; y++) {
+                        for (int x = 0; x < src.w; x++) {
+                            int pixel = binary ? IMAGE_GET_BINARY_PIXEL(img, x, y) : IMAGE_GET_GRAYSCALE_PIXEL(img, x, y);
+                            if (binary) {
+                                IMAGE_PUT_BINARY_PIXEL(&out, x, y, pixel);
+                                IMAGE_PUT_BINARY_PIXEL(&ref, x, y, pixel);
+                            } else {
+                                IMAGE_PUT_GRAYSCALE_PIXEL(&out, x, y, pixel);
+                                IMAGE_PUT_GRAYSCALE_PIXEL(&ref, x, y, pixel);
+                            }
+                        }
+                    }
+
+                    if (crop) {
+                        bench_mask_fill(&mask);
+                    }
+
+                    if (dilate) {
+                        imlib_dilate(&out, k, 0, m);
+                        imlib_dilate_ref(&ref, k, 0, m);
+                    } else {
+                        imlib_erode(&out, k, 0, m);
+                        imlib_erode_ref(&ref, k, 0, m);
+                    }
+
+                    for (int y = 0; y < src.h; y++) {
+                        for (int x = 0; x < src.w; x++) {
+                            exact[binary] = exact[binary] && (binary ?
+                                (IMAGE_GET_BINARY_PIXEL(&out, x, y) == IMAGE_GET_BINARY_PIXEL(&ref, x, y)) :
+                                (IMAGE_GET_GRAYSCALE_PIXEL(&out, x, y) == IMAGE_GET_GRAYSCALE_PIXEL(&ref, x, y)));
+                        }
+                    }
+                }
+            }
+        }
+
+        fb_alloc_free_till_mark();
+    }
+
+    return exact[binary];
+}
+
+static bool bench_erode_1(image_t *img, char *result) {
+    bool exact = morph_check(img);
+    imlib_erode(img, 1, 8, NULL);
+    return exact;
+}
+
+static bool bench_dilate_1(image_t *img, char *result) {
+    bool exact = morph_check(img);
+    imlib_dilate(img, 1, 0, NULL);
+    return exact;
+}
+
+static bool bench_close_2(image_t *img, char *result) {
+    bool exact = morph_check(img);
+    imlib_close(img, 2, 0, NULL);
+    return exact;
+}
+
+static bool bench_close_5(image_t *img, char *result) {
+    bool exact = morph_check(img);
+    imlib_close(img, 5, 0, NULL);
+    return exact;
+}
+
+// PSNR floors of the q90 encodings in dB, 0.1 dB under what the float quantization gave
+// (38.8, 37.0, 35.6 and 34.6).
+#define JPEG_PSNR_GRAYSCALE       38.7f
+#define JPEG_PSNR_RGB_444         36.9f
+#define JPEG_PSNR_RGB_422         35.5f
+#define JPEG_PSNR_RGB_420         34.5f
+
+// Decodes jpeg and returns its PSNR against img in dB, over the 8-bit expanded channels.
+static float bench_jpeg_psnr(image_t *img, image_t *jpeg) {
+    image_t dec = { .w = img->w, .h = img->h, .pixfmt = img->pixfmt };
+    dec.data = fb_alloc(image_size(&dec), FB_ALLOC_NO_HINT);
+    jpeg_decompress(&dec, jpeg);
+    uint64_t sse = 0, n = 0;
+
+    for (int y = 0; y < img->h; y++) {
+        for (int x = 0; x < img->w; x++) {
+            if (img->pixfmt == PIXFORMAT_GRAYSCALE) {
+                int d = IMAGE_GET_GRAYSCALE_PIXEL(img, x, y) - IMAGE_GET_GRAYSCALE_PIXEL(&dec, x, y);
+                sse += d * d;
+                n += 1;
+            } else {
+                int p0 = IMAGE_GET_RGB565_PIXEL(img, x, y), p1 = IMAGE_GET_RGB565_PIXEL(&dec, x, y);
+                int r = COLOR_RGB565_TO_R8(p0) - COLOR_RGB565_TO_R8(p1);
+                int g = COLOR_RGB565_TO_G8(p0) - COLOR_RGB565_TO_G8(p1);
+                int b = COLOR_RGB565_TO_B8(p0) - COLOR_RGB565_TO_B8(p1);
+                sse += (r * r) + (g * g) + (b * b);
+                n += 3;
+            }
+        }
+    }
+
+    fb_free();
+    return sse ? (10.0f * log10f((255.0f * 255.0f * n) / sse)) : 99.0f;
+}
+
+// The first run also decodes every chroma subsampling and checks that the integer quantization
+// keeps the PSNR above the floor the float quantization met.
+static bool bench_jpeg_compress(image_t *img, char *result) {
+    static const jpeg_subsampling_t subsamplings[] = {
+        JPEG_SUBSAMPLING_444, JPEG_SUBSAMPLING_422, JPEG_SUBSAMPLING_420
+    };
+    static bool checked[2];
+    static float psnr[2][3];
+    bool color = img->is_color, ok = true;
+    image_t dst = {
+        .w = img->w,
+        .h = img->h,
+        .pixfmt = PIXFORMAT_JPEG,
+        .size = image_size(img),
+        .data = fb_alloc(image_size(img), FB_ALLOC_NO_HINT)
+    };
+
+    if (!checked[color]) {
+        checked[color] = true;
+        for (int i = 0; i < (color ? 3 : 1); i++) {
+            dst.size = image_size(img);
+            if (jpeg_compress(img, &dst, 90, false, subsamplings[i])) {
+                psnr[color][i] = 0.0f;
+            } else {
+                psnr[color][i] = bench_jpeg_psnr(img, &dst);
+            }
+        }
+        dst.size = image_size(img);
+    }
+
+    bool overflow = jpeg_compress(img, &dst, 90, false, JPEG_SUBSAMPLING_AUTO);
+    if (color) {
+        snprintf(result, BENCH_RESULT_LEN, "%lu bytes %.1f/%.1f/%.1f dB", (unsigned long) dst.size,
+                 (double) psnr[color][0], (double) psnr[color][1], (double) psnr[color][2]);
+        ok = (psnr[color][0] >= JPEG_PSNR_RGB_444) && (psnr[color][1] >= JPEG_PSNR_RGB_422)
+             && (psnr[color][2] >= JPEG_PSNR_RGB_420);
+    } else {
+        snprintf(result, BENCH_RESULT_LEN, "%lu bytes %.1f dB", (unsigned long) dst.size, (double) psnr[color][0]);
+        ok = psnr[color][0] >= JPEG_PSNR_GRAYSCALE;
+    }
+    fb_free();
+    return ok && (!overflow);
+}
+
+typedef struct bench_jpeg_sink {
+    uint8_t *buf;
+    uint32_t size;
+    int chunks;
+} bench_jpeg_sink_t;
+
+static bool bench_jpeg_sink(void *arg, const uint8_t *data, uint32_t size) {
+    bench_jpeg_sink_t *sink = arg;
+    memcpy(sink->buf + sink->size, data, size);
+    sink->size += size;
+    sink->chunks += 1;
+    return true;
+}
+
+// Decodes the JPEG in buf and compares it against src, which holds the non-streamed encoding.
+static bool bench_jpeg_decode_equal(image_t *img, image_t *src, uint8_t *buf, uint32_t size) {
+    image_t stream = { .w = img->w, .h = img->h, .pixfmt = PIXFORMAT_JPEG, .size = size, .data = buf };
+    image_t dec0 = { .w = img->w, .h = img->h, .pixfmt = img->pixfmt };
+    image_t dec1 = { .w = img->w, .h = img->h, .pixfmt = img->pixfmt };
+    dec0.data = fb_alloc(image_size(&dec0), FB_ALLOC_NO_HINT);
+    dec1.data = fb_alloc(image_size(&dec1), FB_ALLOC_NO_HINT);
+    jpeg_decompress(&dec0, src);
+    jpeg_decompress(&dec1, &stream);
+    bool equal = !memcmp(dec0.data, dec1.data, image_size(&dec0));
+    fb_free();
+    fb_free();
+    return equal;
+}
+
+static bool bench_jpeg_compress_stream(image_t *img, char *result) {
+    static bool verified = false;
+    uint8_t *chunks = fb_alloc(2048, FB_ALLOC_NO_HINT);
+    bench_jpeg_sink_t sink = { .buf = fb_alloc(image_size(img), FB_ALLOC_NO_HINT) };
+    bool aborted = jpeg_compress_stream(img, 90, NULL, JPEG_SUBSAMPLING_AUTO, 1, chunks, 2048, bench_jpeg_sink, &sink);
+    snprintf(result, BENCH_RESULT_LEN, "%lu bytes %d chunks", (unsigned long) sink.size, sink.chunks);
+
+    // The restart markers change the entropy coded data but not the decoded pixels.
+    if ((!aborted) && (!verified)) {
+        image_t dst = {
+            .w = img->w,
+            .h = img->h,
+            .pixfmt = PIXFORMAT_JPEG,
+            .size = image_size(img),
+            .data = fb_alloc(image_size(img), FB_ALLOC_NO_HINT)
+        };
+        verified = (!jpeg_compress(img, &dst, 90, false, JPEG_SUBSAMPLING_AUTO))
+                   && bench_jpeg_decode_equal(img, &dst, sink.buf, sink.size);
+        fb_free();
+        aborted = !verified;
+    }
+
+    fb_free();
+    fb_free();
+    return !aborted;
+}
+
+// Encodes a run of frames against a budget of a third of the q90 size and checks that the rate
+// control settles inside the budget without wasting more than a quarter of it.
+static bool bench_jpeg_compress_rc(image_t *img, char *result) {
+    image_t dst = {
+        .w = img->w,
+        .h = img->h,
+        .pixfmt = PIXFORMAT_JPEG,
+        .size = image_size(img),
+        .data = fb_alloc(image_size(img), FB_ALLOC_NO_HINT)
+    };
+
+    if (jpeg_compress(img, &dst, 90, false, JPEG_SUBSAMPLING_AUTO)) {
+        fb_free();
+        return false;
+    }
+
+    jpeg_rate_control_t rc;
+    jpeg_rate_control_init(&rc, dst.size / 3);
+    bool ok = true;
+
+    for (int i = 0; i < 8; i++) {
+        dst.size = image_size(img);
+        if (jpeg_compress_rc(img, &dst, &rc, false, JPEG_SUBSAMPLING_AUTO)) {
+            ok = false;
+            break;
+        }
+        if (i >= 4) {
+            ok = ok && (dst.size <= rc.target) && (dst.size >= ((rc.target * 3) / 4));
+        }
+    }
+
+    snprintf(result, BENCH_RESULT_LEN, "%lu/%lu bytes q%d",
+             (unsigned long) dst.size, (unsigned long) rc.target, rc.quality);
+    fb_free();
+    return ok;
+}
+
+// jpege.c built with its ARM_MATH_DSP paths (see Makefile).
+bool jpeg_compress_dsp(image_t *src, image_t *dst, int quality, bool realloc, jpeg_subsampling_t subsampling);
+
+// Checks that the DSP paths of the encoder produce the same bytes as the portable paths for
+// every chroma subsampling.
+static bool bench_jpeg_compress_dsp(image_t *img, char *result) {
+    static const jpeg_subsampling_t subsamplings[] = {
+        JPEG_SUBSAMPLING_444, JPEG_SUBSAMPLING_422, JPEG_SUBSAMPLING_420
+    };
+    image_t dst = { .w = img->w, .h = img->h, .pixfmt = PIXFORMAT_JPEG };
+    image_t dsp = { .w = img->w, .h = img->h, .pixfmt = PIXFORMAT_JPEG };
+    uint8_t *dst_data = fb_alloc(image_size(img), FB_ALLOC_NO_HINT);
+    uint8_t *dsp_data = fb_alloc(image_size(img), FB_ALLOC_NO_HINT);
+    int n = img->is_color ? 3 : 1, exact = 0;
+    uint32_t size = 0;
+
+    for (int i = 0; i < n; i++) {
+        dst.size = dsp.size = image_size(img);
+        dst.data = dst_data;
+        dsp.data = dsp_data;
+        bool overflow = jpeg_compress(img, &dst, 90, false, subsamplings[i]);
+        overflow |= jpeg_compress_dsp(img, &dsp, 90, false, subsamplings[i]);
+        if ((!overflow) && (dst.size == dsp.size) && (!memcmp(dst.data, dsp.data, dst.size))) {
+            exact += 1;
+        }
+        size += dst.size;
+    }
+
+    snprintf(result, BENCH_RESULT_LEN, "%d/%d bit-exact %lu bytes", exact, n, (unsigned long) size);
+    fb_free();
+    fb_free();
+    return exact == n;
+}
+
+// Decimated quads are snapped back to full resolution edges, so allow a pixel of slack there.
+static bool find_apriltags_check(image_t *img, char *result, int quad_decimate) {
+    list_t out;
+    rectangle_t roi = { 0, 0, img->w, img->h };
+    imlib_find_apriltags(&out, img, &roi, TAG36H11,
+                         (2.8f / 3.984f) * img->w, (2.8f / 2.952f) * img->h,
+                         img->w * 0.5f, img->h * 0.5f, quad_decimate, NULL);
+
+    bool ok = (list_size(&out) == 1);
+    int tol = (quad_decimate > 1) ? 1 : 0;
+    snprintf(result, BENCH_RESULT_LEN, "%u tags", (unsigned) list_size(&out));
+
+    while (list_size(&out)) {
+        find_apriltags_list_lnk_data_t lnk_data;
+        list_pop_front(&out, &lnk_data);
+        ok = ok && (abs(lnk_data.rect.x - 45) <= tol) && (abs(lnk_data.rect.y - 27) <= tol)
+             && (abs(lnk_data.rect.w - 69) <= tol) && (abs(lnk_data.rect.h - 69) <= tol)
+             && (lnk_data.id == 255) && (lnk_data.family == TAG36H11);
+    }
+
+    return ok;
+}
+
+static bool bench_find_apriltags(image_t *img, char *result) {
+    return find_apriltags_check(img, result, 1);
+}
+
+static bool bench_find_apriltags_decimate_2(image_t *img, char *result) {
+    return find_apriltags_check(img, result, 2);
+}
+
+static void find_apriltags_cb(list_t *out, image_t *ptr, rectangle_t *roi, void *data) {
+    imlib_find_apriltags(out, ptr, roi, TAG36H11, (2.8f / 3.984f) * ptr->w, (2.8f / 2.952f) * ptr->h,
+                         ptr->w * 0.5f, ptr->h * 0.5f, 1, NULL);
+}
+
+// Pastes the tag image into a larger frame (just under the 64K pixel limit) and runs a sequence
+// of frames on it. With a tracker the first frame searches the whole frame and the rest only a
+// window around the tag.
+static bool find_apriltags_sequence(image_t *img, char *result, bool tracked) {
+    int x_offset = 48, y_offset = 60;
+    image_t frame = { .w = img->w + (x_offset * 2), .h = img->h + (y_offset * 2), .pixfmt = PIXFORMAT_GRAYSCALE };
+    frame.data = fb_alloc(image_size(&frame), FB_ALLOC_NO_HINT);
+    memset(frame.data, 128, image_size(&frame));
+    imlib_draw_image(&frame, img, x_offset, y_offset, 1.f, 1.f, NULL, -1, 256, NULL, NULL, 0, NULL, NULL, NULL);
+
+    roi_tracker_t tracker;
+    rectangle_t roi = { 0, 0, frame.w, frame.h };
+    roi_tracker_init(&tracker, 8, 0.25f);
+    bool ok = true;
+
+    for (int i = 0; i < 8; i++) {
+        list_t out;
+        if (tracked) {
+            imlib_roi_tracker_find(&tracker, &out, &frame, &roi, offsetof(find_apriltags_list_lnk_data_t, rect),
+                                   find_apriltags_cb, NULL);
+            ok = ok && (tracker.frame == i);
+        } else {
+            find_apriltags_cb(&out, &frame, &roi, NULL);
+        }
+
+        ok = ok && (list_size(&out) == 1);
+
+        while (list_size(&out)) {
+            find_apriltags_list_lnk_data_t lnk_data;
+            list_pop_front(&out, &lnk_data);
+            ok = ok && (lnk_data.rect.x == (45 + x_offset)) && (lnk_data.rect.y == (27 + y_offset))
+                 && (lnk_data.rect.w == 69) && (lnk_data.rect.h == 69) && (lnk_data.id == 255);
+        }
+    }
+
+    snprintf(result, BENCH_RESULT_LEN, "8 frames %dx%d", frame.w, frame.h);
+    fb_free();
+    return ok;
+}
+
+static bool bench_find_apriltags_sequence(image_t *img, char *result) {
+    return find_apriltags_sequence(img, result, false);
+}
+
+static bool bench_find_apriltags_tracked(image_t *img, char *result) {
+    return find_apriltags_sequence(img, result, true);
+}
+
+static bool find_features_check(image_t *img, char *result, bool pyramid) {
+    static cascade_t cascade;
+    static bool cascade_loaded = false;
+
+    if (!cascade_loaded) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/frontalface.cascade", bench_data_path);
+        if (imlib_load_cascade(&cascade, path) != 0) {
+            return false;
+        }
+        cascade_loaded = true;
+    }
+
+    cascade.threshold = 0.75f;
+    cascade.scale_factor = 1.25f;
+
+    rectangle_t roi = { 0, 0, img->w, img->h };
+    array_t *objects = imlib_detect_objects(img, &cascade, &roi, pyramid);
+
+    static const rectangle_t expected[2] = {
+        { 189, 53, 88, 88 },
+        { 12, 11, 107, 107 },
+    };
+
+    int len = array_length(objects);
+    bool ok = (len == 2);
+    snprintf(result, BENCH_RESULT_LEN, "%d objects", len);
+
+    // The pyramid resamples each level from the previous one, allow a few pixels of drift.
+    int tol = pyramid ? 8 : 0;
+
+    for (int i = 0; ok && (i < 2); i++) {
+        ok = false;
+        for (int j = 0; !ok && (j < len); j++) {
+            rectangle_t *r = array_at(objects, j);
+            ok = (abs(r->x - expected[i].x) <= tol) && (abs(r->y - expected[i].y) <= tol) &&
+                 (abs(r->w - expected[i].w) <= tol) && (abs(r->h - expected[i].h) <= tol);
+        }
+    }
+
+    array_free(objects);
+    return ok;
+}
+
+static bool bench_find_features(image_t *img, char *result) {
+    return find_features_check(img, result, false);
+}
+
+static bool bench_find_features_pyramid(image_t *img, char *result) {
+    return find_features_check(img, result, true);
+}
+
+static bool bench_match_descriptor(image_t *img, char *result) {
+    static array_t *kpts1 = NULL;
+    static array_t *kpts2 = NULL;
+
+    if (kpts1 == NULL) {
+        FIL fp;
+        uint32_t desc_type;
+        char path[256];
+        rectangle_t roi = { 0, 0, img->w, img->h };
+
+        kpts1 = orb_find_keypoints(img, false, 20, 1.5f, 150, CORNER_AGAST, &roi);
+
+        array_alloc(&kpts2, xfree);
+        snprintf(path, sizeof(path), "%s/graffiti.orb", bench_data_path);
+        file_open(&fp, path, false, FA_READ | FA_OPEN_EXISTING);
+        file_read(&fp, &desc_type, sizeof(desc_type));
+        if (orb_load_descriptor(&fp, kpts2) != FR_OK) {
+            return false;
+        }
+        file_close(&fp);
+    }
+
+    // Matching marks the matched keypoints.
+    for (int i = 0; i < array_length(kpts2); i++) {
+        ((kp_t *) array_at(kpts2, i))->matched = 0;
+    }
+
+    int theta = 0;
+    point_t c = {0};
+    rectangle_t r = {0};
+    int *match = fb_alloc(array_length(kpts1) * sizeof(int) * 2, FB_ALLOC_NO_HINT);
+    int count = orb_match_keypoints(kpts1, kpts2, match, 85, &r, &c, &theta);
+    fb_free();
+
+    snprintf(result, BENCH_RESULT_LEN, "%d matches", count);
+    return (c.x == 138) && (c.y == 117) && (r.x == 36) && (r.y == 34) &&
+           (r.w == 251) && (r.h == 167) && (count == 150) && (theta == 0);
+}
+
+static bool bench_phasecorrelate(image_t *img, char *result) {
+    float x, y, rotation, scale, response;
+    rectangle_t roi0 = { 64, 32, 128, 128 };
+    rectangle_t roi1 = { 69, 29, 128, 128 };
+
+    imlib_phasecorrelate(img, img, &roi0, &roi1, false, false, &x, &y, &rotation, &scale, &response);
+
+    snprintf(result, BENCH_RESULT_LEN, "%.2f %.2f %.3f", (double) x, (double) y, (double) response);
+    return (fast_roundf(x) == 5) && (fast_roundf(y) == 3);
+}
+
+// Same arguments and expected results as the find_lines and find_circles unittests.
+static bool bench_find_lines(image_t *img, char *result) {
+    static const int expected[4][8] = {
+        { 22, 0, 22, 119, 119, 8670, 0, 22 },
+        { 0, 39, 159, 39, 159, 8670, 90, 39 },
+        { 57, 0, 57, 119, 119, 8670, 0, 57 },
+        { 0, 75, 159, 75, 159, 10710, 90, 75 },
+    };
+    list_t out;
+    rectangle_t roi = { 0, 0, img->w, img->h };
+    imlib_find_lines(&out, img, &roi, 2, 1, 5000, 25, 25, 0);
+    bool ok = list_size(&out) == 4;
+    snprintf(result, BENCH_RESULT_LEN, "%d lines", (int) list_size(&out));
+
+    for (int i = 0; list_size(&out); i++) {
+        find_lines_list_lnk_data_t lnk_line;
+        list_pop_front(&out, &lnk_line);
+        int line[8] = {
+            lnk_line.line.x1, lnk_line.line.y1, lnk_line.line.x2, lnk_line.line.y2,
+            fast_roundf(fast_sqrtf(((lnk_line.line.x2 - lnk_line.line.x1) * (lnk_line.line.x2 - lnk_line.line.x1)) +
+                                   ((lnk_line.line.y2 - lnk_line.line.y1) * (lnk_line.line.y2 - lnk_line.line.y1)))),
+            lnk_line.magnitude, lnk_line.theta, lnk_line.rho
+        };
+        ok = ok && (i < 4) && (!memcmp(line, expected[i], sizeof(line)));
+    }
+
+    return ok;
+}
+
+// Window voting spreads each edge over neighbouring bins, so allow one bin of slack.
+static bool bench_find_lines_window(image_t *img, char *result) {
+    static const int expected[4][2] = { { 0, 22 }, { 90, 39 }, { 0, 57 }, { 90, 75 } };
+    list_t out;
+    rectangle_t roi = { 0, 0, img->w, img->h };
+    imlib_find_lines(&out, img, &roi, 2, 1, 5000, 25, 25, 1);
+    bool ok = list_size(&out) == 4;
+    snprintf(result, BENCH_RESULT_LEN, "%d lines", (int) list_size(&out));
+
+    while (list_size(&out)) {
+        find_lines_list_lnk_data_t lnk_line;
+        list_pop_front(&out, &lnk_line);
+        bool found = false;
+        for (int i = 0; i < 4; i++) {
+            found = found || ((abs(lnk_line.theta - expected[i][0]) <= 1) && (abs(lnk_line.rho - expected[i][1]) <= 1));
+        }
+        ok = ok && found;
+    }
+
+    return ok;
+}
+
+static bool bench_find_circles(image_t *img, char *result) {
+    list_t out;
+    rectangle_t roi = { 0, 0, img->w, img->h };
+    imlib_find_circles(&out, img, &roi, 2, 1, 5000, 30, 30, 30, 2, IM_MIN(img->w, img->h) / 2, 2);
+    bool ok = list_size(&out) == 1;
+    snprintf(result, BENCH_RESULT_LEN, "%d circles", (int) list_size(&out));
+
+    while (list_size(&out)) {
+        find_circles_list_lnk_data_t lnk_circle;
+        list_pop_front(&out, &lnk_circle);
+        ok = ok && (lnk_circle.p.x == 118) && (lnk_circle.p.y == 56) && (lnk_circle.r == 22)
+             && (lnk_circle.magnitude == 5856);
+    }
+
+    return ok;
+}
+
+static bool find_qrcodes_check(image_t *img, char *result, image_planes_t *planes) {
+    list_t out;
+    rectangle_t roi = { 0, 0, img->w, img->h };
+    imlib_find_qrcodes(&out, img, &roi, planes);
+
+    bool ok = (list_size(&out) == 1);
+    snprintf(result, BENCH_RESULT_LEN, "%u codes", (unsigned) list_size(&out));
+
+    while (list_size(&out)) {
+        find_qrcodes_list_lnk_data_t lnk_data;
+        list_pop_front(&out, &lnk_data);
+        ok = ok && (lnk_data.rect.x == 76) && (lnk_data.rect.y == 36)
+             && (lnk_data.rect.w == 168) && (lnk_data.rect.h == 168)
+             && (lnk_data.payload_len == 17) && !memcmp(lnk_data.payload, "https://openmv.io", 17);
+        xfree(lnk_data.payload);
+    }
+
+    return ok;
+}
+
+static bool bench_find_qrcodes(image_t *img, char *result) {
+    return find_qrcodes_check(img, result, NULL);
+}
+
+static bool find_barcodes_check(image_t *img, char *result, bool fast) {
+    list_t out;
+    rectangle_t roi = { 0, 0, img->w, img->h };
+    imlib_find_barcodes(&out, img, &roi, fast, NULL);
+
+    bool ok = (list_size(&out) == 1);
+    snprintf(result, BENCH_RESULT_LEN, "%u codes", (unsigned) list_size(&out));
+
+    while (list_size(&out)) {
+        find_barcodes_list_lnk_data_t lnk_data;
+        list_pop_front(&out, &lnk_data);
+        ok = ok && (lnk_data.type == BARCODE_CODE128)
+             && (lnk_data.payload_len == 18) && !memcmp(lnk_data.payload, "https://openmv.io/", 18);
+        xfree(lnk_data.payload);
+    }
+
+    return ok;
+}
+
+static bool bench_find_barcodes(image_t *img, char *result) {
+    return find_barcodes_check(img, result, false);
+}
+
+static bool bench_find_barcodes_fast(image_t *img, char *result) {
+    return find_barcodes_check(img, result, true);
+}
+
+// The barcode scaled by 1.25 and rotated by angle degrees (bilinear) in the middle of an 800x600
+// white frame. Built once outside of the timing.
+static image_t *barcode_frame(image_t *frame, image_t *img, float angle) {
+    if (!frame->data) {
+        image_init(frame, 800, 600, PIXFORMAT_GRAYSCALE, 0, NULL);
+        frame->data = xalloc(image_size(frame));
+
+        float c = cosf(IM_DEG2RAD(angle)) / 1.25f, s = sinf(IM_DEG2RAD(angle)) / 1.25f;
+
+        for (int y = 0; y < frame->h; y++) {
+            for (int x = 0; x < frame->w; x++) {
+                float dx = x - (frame->w / 2), dy = y - (frame->h / 2);
+                float sx = (c * dx) + (s * dy) + (img->w / 2);
+                float sy = (c * dy) - (s * dx) + (img->h / 2);
+                int x0 = fast_floorf(sx), y0 = fast_floorf(sy), pixel = 255;
+
+                if ((x0 >= 0) && (x0 < (img->w - 1)) && (y0 >= 0) && (y0 < (img->h - 1))) {
+                    float fx = sx - x0, fy = sy - y0;
+                    uint8_t *p = img->data + (y0 * img->w) + x0;
+                    pixel = fast_roundf(((p[0] * (1 - fx)) + (p[1] * fx)) * (1 - fy)
+                                        + ((p[img->w] * (1 - fx)) + (p[img->w + 1] * fx)) * fy);
+                }
+
+                frame->data[(y * frame->w) + x] = pixel;
+            }
+        }
+    }
+
+    return frame;
+}
+
+static bool bench_find_barcodes_frame(image_t *img, char *result) {
+    static image_t frame;
+    return find_barcodes_check(barcode_frame(&frame, img, 0), result, false);
+}
+
+static bool bench_find_barcodes_frame_fast(image_t *img, char *result) {
+    static image_t frame;
+    return find_barcodes_check(barcode_frame(&frame, img, 0), result, true);
+}
+
+// Horizontal raster scan lines cannot cross all bars of the tilted barcode.
+static bool bench_find_barcodes_tilted_fast(image_t *img, char *result) {
+    static image_t frame;
+    return find_barcodes_check(barcode_frame(&frame, img, 30), result, true);
+}
+
+// Runs the qrcode, datamatrix and barcode detectors on the same frame, each converting the frame
+// to grayscale itself or sharing the grayscale plane of the frame.
+static bool find_codes(image_t *img, char *result, bool shared) {
+    static image_planes_t planes;
+    image_planes_t *p = shared ? &planes : NULL;
+    rectangle_t roi = { 0, 0, img->w, img->h };
+    list_t out;
+
+    // New frame.
+    imlib_planes_invalidate(p, NULL);
+
+    bool ok = find_qrcodes_check(img, result, p);
+
+    fb_alloc_mark();
+    imlib_find_datamatrices(&out, img, &roi, 200, p);
+    fb_alloc_free_till_mark();
+    ok = ok && (list_size(&out) == 0);
+    list_free(&out);
+
+    fb_alloc_mark();
+    imlib_find_barcodes(&out, img, &roi, false, p);
+    fb_alloc_free_till_mark();
+    ok = ok && (list_size(&out) == 0);
+    list_free(&out);
+
+    return ok;
+}
+
+static bool bench_find_codes(image_t *img, char *result) {
+    return find_codes(img, result, false);
+}
+
+static bool bench_find_codes_planes(image_t *img, char *result) {
+    return find_codes(img, result, true);
+}
+
+static bool bench_draw_image_scaled(image_t *img, float scale, image_hint_t hint) {
+    image_t dst;
+    image_init(&dst, fast_floorf(img->w * scale), fast_floorf(img->h * scale), img->pixfmt, 0, NULL);
+    dst.data = fb_alloc(image_size(&dst), FB_ALLOC_NO_HINT);
+    imlib_draw_image(&dst, img, 0, 0, scale, scale, NULL, -1, 256, NULL, NULL, hint, NULL, NULL, NULL);
+    return true;
+}
+
+static bool bench_draw_image_half(image_t *img, char *result) {
+    return bench_draw_image_scaled(img, 0.5f, 0);
+}
+
+static bool bench_draw_image_half_area(image_t *img, char *result) {
+    return bench_draw_image_scaled(img, 0.5f, IMAGE_HINT_AREA);
+}
+
+static bool bench_draw_image_double_bilinear(image_t *img, char *result) {
+    return bench_draw_image_scaled(img, 2.0f, IMAGE_HINT_BILINEAR);
+}
+
+// A 96x96 int8 model input filled from the full image and a 3x3 grid of half size windows,
+// like tf.classify() with scale_mul=0.5 and 50% overlap. nn_input_draw_image is the two pass
+// path (imlib_draw_image() then RGB888 expansion and sign flip) that tf used before.
+#define BENCH_NN_INPUT_SIZE       96
+#define BENCH_NN_INPUT_WINDOWS    10
+
+static void bench_nn_input_roi(image_t *img, int i, rectangle_t *roi) {
+    if (i == 0) {
+        rectangle_init(roi, 0, 0, img->w, img->h);
+    } else {
+        int w = img->w / 2, h = img->h / 2;
+        rectangle_init(roi, (((i - 1) % 3) * w) / 2, (((i - 1) / 3) * h) / 2, w, h);
+    }
+}
+
+static void bench_nn_input_draw_image(image_t *img, int i, int8_t *tensor, int channels) {
+    rectangle_t roi;
+    bench_nn_input_roi(img, i, &roi);
+
+    image_t dst;
+    image_init(&dst, BENCH_NN_INPUT_SIZE, BENCH_NN_INPUT_SIZE,
+               (channels == 1) ? PIXFORMAT_GRAYSCALE : PIXFORMAT_RGB565, 0, tensor);
+    imlib_draw_image(&dst, img, 0, 0, 1.0f, 1.0f, &roi, -1, 256, NULL, NULL,
+                     IMAGE_HINT_BILINEAR | IMAGE_HINT_CENTER | IMAGE_HINT_SCALE_ASPECT_EXPAND |
+                     IMAGE_HINT_BLACK_BACKGROUND, NULL, NULL, NULL);
+
+    int size = (BENCH_NN_INPUT_SIZE * BENCH_NN_INPUT_SIZE) - 1;
+    uint8_t *tensor_8 = (uint8_t *) tensor;
+
+    if (channels == 1) {
+        for (; size >= 0; size -= 1) {
+            tensor_8[size] ^= 0x80;
+        }
+    } else {
+        uint16_t *tensor_16 = (uint16_t *) tensor;
+        for (int rgb_size = size * 3; size >= 0; size -= 1, rgb_size -= 3) {
+            int pixel = tensor_16[size];
+            tensor_8[rgb_size] = COLOR_RGB565_TO_R8(pixel) ^ 0x80;
+            tensor_8[rgb_size + 1] = COLOR_RGB565_TO_G8(pixel) ^ 0x80;
+            tensor_8[rgb_size + 2] = COLOR_RGB565_TO_B8(pixel) ^ 0x80;
+        }
+    }
+}
+
+static void bench_nn_input_tensor(image_t *img, int i, int8_t *tensor, int channels) {
+    rectangle_t roi;
+    bench_nn_input_roi(img, i, &roi);
+    imlib_draw_image_tensor(tensor, BENCH_NN_INPUT_SIZE, BENCH_NN_INPUT_SIZE, channels,
+                            IMAGE_TENSOR_DATATYPE_INT8, 1.0f / 255.0f, -128, img, &roi);
+}
+
+// The fused path rounds once instead of twice and interpolates color in RGB888 instead of
+// truncating to RGB565 first, which moves channels by up to one RGB565 step (8-10 values).
+static int bench_nn_input_max_diff(image_t *img, int channels) {
+    size_t size = BENCH_NN_INPUT_SIZE * BENCH_NN_INPUT_SIZE * channels;
+    int8_t *tensor = fb_alloc(size, FB_ALLOC_NO_HINT);
+    int8_t *ref = fb_alloc(size, FB_ALLOC_NO_HINT);
+    int max_diff = 0;
+
+    for (int i = 0; i < BENCH_NN_INPUT_WINDOWS; i++) {
+        bench_nn_input_tensor(img, i, tensor, channels);
+        bench_nn_input_draw_image(img, i, ref, channels);
+        for (size_t j = 0; j < size; j++) {
+            max_diff = IM_MAX(max_diff, abs(tensor[j] - ref[j]));
+        }
+    }
+
+    fb_free();
+    fb_free();
+    return max_diff;
+}
+
+// BAYER and YUV422 images fill RGB tensors and are checked for grayscale tensors too, which
+// debayer and convert to grayscale instead of RGB565.
+static bool bench_nn_input(image_t *img, char *result, bool fused) {
+    static bool checked[4];
+    static int max_diff[4][2];
+    int id = (img->pixfmt == PIXFORMAT_GRAYSCALE) ? 0 : (img->pixfmt == PIXFORMAT_RGB565) ? 1 :
+             (img->pixfmt == PIXFORMAT_BAYER) ? 2 : 3;
+    int channels = (img->pixfmt == PIXFORMAT_GRAYSCALE) ? 1 : 3;
+    size_t size = BENCH_NN_INPUT_SIZE * BENCH_NN_INPUT_SIZE * channels;
+
+    fb_alloc_mark();
+    int8_t *tensor = fb_alloc(size, FB_ALLOC_NO_HINT);
+
+    for (int i = 0; i < BENCH_NN_INPUT_WINDOWS; i++) {
+        if (fused) {
+            bench_nn_input_tensor(img, i, tensor, channels);
+        } else {
+            bench_nn_input_draw_image(img, i, tensor, channels);
+        }
+    }
+
+    if (fused && !checked[id]) {
+        max_diff[id][channels == 3] = bench_nn_input_max_diff(img, channels);
+
+        if (id >= 2) {
+            max_diff[id][0] = bench_nn_input_max_diff(img, 1);
+        }
+
+        checked[id] = true;
+    }
+
+    if (fused) {
+        snprintf(result, BENCH_RESULT_LEN, "%d windows max diff %d/%d", BENCH_NN_INPUT_WINDOWS,
+                 max_diff[id][0], max_diff[id][1]);
+    } else {
+        snprintf(result, BENCH_RESULT_LEN, "%d windows", BENCH_NN_INPUT_WINDOWS);
+    }
+
+    fb_alloc_free_till_mark();
+    return (max_diff[id][0] <= 1) && (max_diff[id][1] <= 10);
+}
+
+static bool bench_nn_input_draw_image_kernel(image_t *img, char *result) {
+    return bench_nn_input(img, result, false);
+}
+
+static bool bench_nn_input_tensor_kernel(image_t *img, char *result) {
+    return bench_nn_input(img, result, true);
+}
+
+// An 8x8 grid of cells plus a few arbitrary rectangles, like a script calling get_statistics() on
+// grid cells and blob bounding boxes.
+#define BENCH_STATS_ROIS    (64 + 16)
+
+static void bench_stats_roi(image_t *img, int i, rectangle_t *roi) {
+    if (i < 64) {
+        roi->x = ((i % 8) * img->w) / 8;
+        roi->y = ((i / 8) * img->h) / 8;
+        roi->w = ((((i % 8) + 1) * img->w) / 8) - roi->x;
+        roi->h = ((((i / 8) + 1) * img->h) / 8) - roi->y;
+    } else {
+        uint32_t r = (i * 2654435761U) ^ 0x9E3779B9U;
+        roi->x = (r >> 4) % (img->w / 2);
+        roi->y = (r >> 12) % (img->h / 2);
+        roi->w = 1 + ((r >> 20) % (img->w - roi->x));
+        roi->h = 1 + ((r >> 8) % (img->h - roi->y));
+    }
+}
+
+static void bench_stats_alloc(image_t *img, histogram_t *hist) {
+    hist->LBinCount = (img->pixfmt == PIXFORMAT_RGB565) ? (COLOR_L_MAX - COLOR_L_MIN + 1) :
+                      (COLOR_GRAYSCALE_MAX - COLOR_GRAYSCALE_MIN + 1);
+    hist->ABinCount = (img->pixfmt == PIXFORMAT_RGB565) ? (COLOR_A_MAX - COLOR_A_MIN + 1) : 0;
+    hist->BBinCount = (img->pixfmt == PIXFORMAT_RGB565) ? (COLOR_B_MAX - COLOR_B_MIN + 1) : 0;
+    hist->LBins = fb_alloc(hist->LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
+    hist->ABins = hist->ABinCount ? fb_alloc(hist->ABinCount * sizeof(float), FB_ALLOC_NO_HINT) : NULL;
+    hist->BBins = hist->BBinCount ? fb_alloc(hist->BBinCount * sizeof(float), FB_ALLOC_NO_HINT) : NULL;
+}
+
+// Allocates bins bins per channel.
+static void bench_stats_alloc_bins(image_t *img, histogram_t *hist, int bins) {
+    hist->LBinCount = bins;
+    hist->ABinCount = (img->pixfmt == PIXFORMAT_RGB565) ? bins : 0;
+    hist->BBinCount = (img->pixfmt == PIXFORMAT_RGB565) ? bins : 0;
+    hist->LBins = fb_alloc(hist->LBinCount * sizeof(float), FB_ALLOC_NO_HINT);
+    hist->ABins = hist->ABinCount ? fb_alloc(hist->ABinCount * sizeof(float), FB_ALLOC_NO_HINT) : NULL;
+    hist->BBins = hist->BBinCount ? fb_alloc(hist->BBinCount * sizeof(float), FB_ALLOC_NO_HINT) : NULL;
+}
+
+static bool bench_stats_equal(histogram_t *a, histogram_t *b) {
+    return !memcmp(a->LBins, b->LBins, a->LBinCount * sizeof(float)) &&
+           !memcmp(a->ABins, b->ABins, a->ABinCount * sizeof(float)) &&
+           !memcmp(a->BBins, b->BBins, a->BBinCount * sizeof(float));
+}
+
+static bool bench_get_statistics(image_t *img, char *result) {
+    histogram_t hist;
+    fb_alloc_mark();
+    bench_stats_alloc(img, &hist);
+
+    for (int i = 0; i < BENCH_STATS_ROIS; i++) {
+        rectangle_t roi;
+        statistics_t stats;
+        bench_stats_roi(img, i, &roi);
+        imlib_get_histogram(&hist, img, &roi, NULL, NULL, false, NULL);
+        imlib_get_statistics(&stats, img->pixfmt, &hist);
+    }
+
+    snprintf(result, BENCH_RESULT_LEN, "%d rois", BENCH_STATS_ROIS);
+    fb_alloc_free_till_mark();
+    return true;
+}
+
+// Thresholded statistics with and without the compiled thresholds, which must be bit exact.
+static bool get_statistics_thresholds_check(image_t *img, char *result, bool compiled) {
+    static bool checked, exact;
+    list_t thresholds;
+    generic_thresholds(&thresholds);
+    color_thresholds_bitmap_t *bitmap = compiled ? generic_thresholds_bitmap(&thresholds) : NULL;
+    histogram_t hist, ref;
+
+    fb_alloc_mark();
+    bench_stats_alloc(img, &hist);
+
+    for (int i = 0; i < BENCH_STATS_ROIS; i++) {
+        rectangle_t roi;
+        statistics_t stats;
+        bench_stats_roi(img, i, &roi);
+        imlib_get_histogram(&hist, img, &roi, &thresholds, bitmap, false, NULL);
+        imlib_get_statistics(&stats, img->pixfmt, &hist);
+    }
+
+    if (compiled && (!checked)) {
+        checked = exact = true;
+        bench_stats_alloc(img, &ref);
+
+        for (int i = 0; i < BENCH_STATS_ROIS; i++) {
+            rectangle_t roi;
+            bench_stats_roi(img, i, &roi);
+            imlib_get_histogram(&hist, img, &roi, &thresholds, bitmap, false, NULL);
+            imlib_get_histogram(&ref, img, &roi, &thresholds, NULL, false, NULL);
+            exact = exact && bench_stats_equal(&hist, &ref);
+        }
+    }
+
+    snprintf(result, BENCH_RESULT_LEN, "%d rois", BENCH_STATS_ROIS);
+    fb_alloc_free_till_mark();
+    list_free(&thresholds);
+    return compiled ? exact : true;
+}
+
+static bool bench_get_statistics_thresholds(image_t *img, char *result) {
+    return get_statistics_thresholds_check(img, result, false);
+}
+
+static bool bench_get_statistics_compiled(image_t *img, char *result) {
+    return get_statistics_thresholds_check(img, result, true);
+}
+
+// Builds the tiled histogram cache and answers the same queries as bench_get_statistics. The
+// histograms must be bit exact with imlib_get_histogram(), checked on the first run per format.
+// The check also covers a cache of 32 bins per channel queried for 32 bins, and for 16 bins
+// which it can't answer from the tile counts.
+static bool bench_get_statistics_cache(image_t *img, char *result) {
+    static bool checked[2], exact[2];
+    bool color = img->pixfmt == PIXFORMAT_RGB565;
+    histogram_t hist, ref;
+    histogram_cache_t cache;
+
+    fb_alloc_mark();
+    bench_stats_alloc(img, &hist);
+    imlib_histogram_cache_init(&cache, img, 16, 0, 0, 0,
+                               fb_alloc(imlib_histogram_cache_size(img, 16, 0, 0, 0), FB_ALLOC_NO_HINT));
+
+    for (int i = 0; i < BENCH_STATS_ROIS; i++) {
+        rectangle_t roi;
+        statistics_t stats;
+        bench_stats_roi(img, i, &roi);
+        imlib_histogram_cache_get_histogram(&hist, &cache, &roi, NULL, false);
+        imlib_get_statistics(&stats, img->pixfmt, &hist);
+    }
+
+    if (!checked[color]) {
+        checked[color] = exact[color] = true;
+        bench_stats_alloc(img, &ref);
+
+        for (int i = 0; i < BENCH_STATS_ROIS; i++) {
+            rectangle_t roi;
+            bench_stats_roi(img, i, &roi);
+            imlib_histogram_cache_get_histogram(&hist, &cache, &roi, NULL, false);
+            imlib_get_histogram(&ref, img, &roi, NULL, NULL, false, NULL);
+            exact[color] = exact[color] && bench_stats_equal(&hist, &ref);
+        }
+
+        histogram_cache_t binned;
+        imlib_histogram_cache_init(&binned, img, 16, 32, 32, 32,
+                                   fb_alloc(imlib_histogram_cache_size(img, 16, 32, 32, 32), FB_ALLOC_NO_HINT));
+
+        for (int bins = 32; bins >= 16; bins -= 16) {
+            bench_stats_alloc_bins(img, &hist, bins);
+            bench_stats_alloc_bins(img, &ref, bins);
+
+            for (int i = 0; i < BENCH_STATS_ROIS; i++) {
+                rectangle_t roi;
+                bench_stats_roi(img, i, &roi);
+                imlib_histogram_cache_get_histogram(&hist, &binned, &roi, NULL, false);
+                imlib_get_histogram(&ref, img, &roi, NULL, NULL, false, NULL);
+                exact[color] = exact[color] && bench_stats_equal(&hist, &ref);
+            }
+        }
+    }
+
+    snprintf(result, BENCH_RESULT_LEN, "%d rois %lu bytes", BENCH_STATS_ROIS,
+             (unsigned long) imlib_histogram_cache_size(img, 16, 0, 0, 0));
+    fb_alloc_free_till_mark();
+    return exact[color];
+}
+
+// Gaussian blurs as gaussian() in py_image.c builds them. The output is checked against a float
+// reference of the full 2D kernel on the first run per format and kernel size.
+static int bench_gaussian_kernel(int ksize, int *krn) {
+    int n = (ksize * 2) + 1, sum = 0;
+    int pascal[n];
+    pascal[0] = 1;
+
+    for (int i = 0; i < (n - 1); i++) {
+        pascal[i + 1] = (pascal[i] * ((n - 1) - i)) / (i + 1);
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            krn[(i * n) + j] = pascal[i] * pascal[j];
+            sum += krn[(i * n) + j];
+        }
+    }
+
+    return sum;
+}
+
+static int bench_get_channel(image_t *img, int x, int y, int c) {
+    if (img->pixfmt == PIXFORMAT_GRAYSCALE) {
+        return IMAGE_GET_GRAYSCALE_PIXEL(img, x, y);
+    }
+
+    int p = IMAGE_GET_RGB565_PIXEL(img, x, y);
+    return (c == 0) ? COLOR_RGB565_TO_R5(p) : (c == 1) ? COLOR_RGB565_TO_G6(p) : COLOR_RGB565_TO_B5(p);
+}
+
+static int bench_gaussian_diff(image_t *img, image_t *src, int ksize, const int *krn, int sum) {
+    int n = (ksize * 2) + 1, max_diff = 0;
+
+    for (int y = 0; y < img->h; y++) {
+        for (int x = 0; x < img->w; x++) {
+            for (int c = 0; c < ((img->pixfmt == PIXFORMAT_RGB565) ? 3 : 1); c++) {
+                float acc = 0;
+
+                for (int j = 0; j < n; j++) {
+                    for (int i = 0; i < n; i++) {
+                        acc += (float) krn[(j * n) + i] * bench_get_channel(src, IM_CLAMP(x + i - ksize, 0, src->w - 1),
+                                                                            IM_CLAMP(y + j - ksize, 0, src->h - 1), c);
+                    }
+                }
+
+                max_diff = IM_MAX(max_diff, abs(bench_get_channel(img, x, y, c) - (int) (acc / sum)));
+            }
+        }
+    }
+
+    return max_diff;
+}
+
+static bool bench_gaussian(image_t *img, char *result, int ksize) {
+    static bool checked[2][8];
+    static int max_diff[2][8];
+    bool color = img->pixfmt == PIXFORMAT_RGB565;
+    int n = (ksize * 2) + 1;
+
+    fb_alloc_mark();
+    int *krn = fb_alloc(n * n * sizeof(int), FB_ALLOC_NO_HINT);
+    int sum = bench_gaussian_kernel(ksize, krn);
+    image_t src = *img;
+
+    if (!checked[color][ksize]) {
+        src.data = fb_alloc(image_size(img), FB_ALLOC_NO_HINT);
+        memcpy(src.data, img->data, image_size(img));
+    }
+
+    imlib_morph(img, ksize, krn, 1.0f / sum, 0.0f, false, 0, false, NULL);
+
+    if (!checked[color][ksize]) {
+        max_diff[color][ksize] = bench_gaussian_diff(img, &src, ksize, krn, sum);
+        checked[color][ksize] = true;
+    }
+
+    snprintf(result, BENCH_RESULT_LEN, "max diff %d", max_diff[color][ksize]);
+    fb_alloc_free_till_mark();
+    return max_diff[color][ksize] <= 1;
+}
+
+static bool bench_gaussian_1(image_t *img, char *result) {
+    return bench_gaussian(img, result, 1);
+}
+
+static bool bench_gaussian_2(image_t *img, char *result) {
+    return bench_gaussian(img, result, 2);
+}
+
+static bool bench_gaussian_5(image_t *img, char *result) {
+    return bench_gaussian(img, result, 5);
+}
+
+static bool bench_gaussian_7(image_t *img, char *result) {
+    return bench_gaussian(img, result, 7);
+}
+
+// A thresholded separable kernel on a binary image. The thresholded pixel minus the offset is compared
+// unsigned against the source pixel like imlib_morph() does, so a negative value never passes.
+static bool bench_morph_threshold(image_t *img, char *result) {
+    int krn[5 * 5];
+    bench_gaussian_kernel(2, krn);
+    imlib_morph(img, 2, krn, 1.0f / 256, 0.0f, true, 2, false, NULL);
+    bool ok = true;
+
+    for (int y = 0; y < img->h; y++) {
+        for (int x = 0; x < img->w; x++) {
+            ok = ok && (!IMAGE_GET_BINARY_PIXEL(img, x, y));
+        }
+    }
+
+    return ok;
+}
+
+// The grid is an approximation of the exact filter, so the check is on the mean difference
+// between both over the image instead of the max difference. The grid falls back to the exact
+// filter for ksize 2.
+static bool bench_bilateral(image_t *img, char *result, int ksize, bool grid) {
+    static bool checked[2][8];
+    static float mean_diff[2][8];
+    bool color = img->pixfmt == PIXFORMAT_RGB565;
+
+    fb_alloc_mark();
+    image_t ref = *img;
+
+    if (grid && !checked[color][ksize]) {
+        ref.data = fb_alloc(image_size(img), FB_ALLOC_NO_HINT);
+        memcpy(ref.data, img->data, image_size(img));
+        imlib_bilateral_filter(&ref, ksize, 0.1f, 1.0f, false, 0, false, NULL);
+    }
+
+    if (grid) {
+        imlib_bilateral_grid(img, ksize, 0.1f, 1.0f, false, 0, false, NULL);
+    } else {
+        imlib_bilateral_filter(img, ksize, 0.1f, 1.0f, false, 0, false, NULL);
+    }
+
+    if (grid && !checked[color][ksize]) {
+        int64_t diff = 0;
+
+        for (int y = 0; y < img->h; y++) {
+            for (int x = 0; x < img->w; x++) {
+                for (int c = 0; c < (color ? 3 : 1); c++) {
+                    diff += abs(bench_get_channel(img, x, y, c) - bench_get_channel(&ref, x, y, c));
+                }
+            }
+        }
+
+        mean_diff[color][ksize] = diff / (float) (img->w * img->h * (color ? 3 : 1));
+        checked[color][ksize] = true;
+    }
+
+    if (grid) {
+        snprintf(result, BENCH_RESULT_LEN, "mean diff %.2f", (double) mean_diff[color][ksize]);
+    }
+
+    fb_alloc_free_till_mark();
+    return mean_diff[color][ksize] <= (color ? 1.0f : 4.0f);
+}
+
+static bool bench_bilateral_2(image_t *img, char *result) {
+    return bench_bilateral(img, result, 2, false);
+}
+
+static bool bench_bilateral_4(image_t *img, char *result) {
+    return bench_bilateral(img, result, 4, false);
+}
+
+static bool bench_bilateral_grid_2(image_t *img, char *result) {
+    return bench_bilateral(img, result, 2, true);
+}
+
+static bool bench_bilateral_grid_4(image_t *img, char *result) {
+    return bench_bilateral(img, result, 4, true);
+}
+
+const bench_t bench_kernels[] = {
+    { "find_blobs",                 "blobs.ppm",     PIXFORMAT_RGB565,    bench_find_blobs                 },
+    { "find_blobs_single_pass",     "blobs.ppm",     PIXFORMAT_RGB565,    bench_find_blobs_single_pass     },
+    { "find_blobs_compiled",        "blobs.ppm",     PIXFORMAT_RGB565,    bench_find_blobs_compiled        },
+    { "find_blobs_single_pass_compiled", "blobs.ppm", PIXFORMAT_RGB565,   bench_find_blobs_single_pass_compiled },
+    { "find_blobs_2_colors",        "blobs.ppm",     PIXFORMAT_RGB565,    bench_find_blobs_2_colors        },
+    { "find_blobs_2_colors_single_pass", "blobs.ppm", PIXFORMAT_RGB565,   bench_find_blobs_2_colors_single_pass },
+    { "find_blobs_4_colors",        "blobs.ppm",     PIXFORMAT_RGB565,    bench_find_blobs_4_colors        },
+    { "find_blobs_4_colors_single_pass", "blobs.ppm", PIXFORMAT_RGB565,   bench_find_blobs_4_colors_single_pass },
+    { "find_blobs_8_colors",        "blobs.ppm",     PIXFORMAT_RGB565,    bench_find_blobs_8_colors        },
+    { "find_blobs_8_colors_single_pass", "blobs.ppm", PIXFORMAT_RGB565,   bench_find_blobs_8_colors_single_pass },
+    { "find_blobs_single_pass_perimeter", "dennis.pgm", PIXFORMAT_GRAYSCALE, bench_find_blobs_single_pass_perimeter },
+    { "find_blobs_single_pass_exact", "blobs.ppm",   PIXFORMAT_RGB565,    bench_find_blobs_single_pass_exact },
+    { "find_blobs_single_pass_exact", "dennis.pgm",  PIXFORMAT_GRAYSCALE, bench_find_blobs_single_pass_exact },
+    { "find_blobs_single_pass_exact", "shapes.ppm",  PIXFORMAT_BINARY,    bench_find_blobs_single_pass_exact },
+    { "find_blobs_single_pass_x4",  "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_find_blobs_single_pass_x4  },
+    { "find_blobs_dense",           "dennis.pgm",    PIXFORMAT_BINARY,    bench_find_blobs_dense           },
+    { "find_blobs_dense_single_pass", "dennis.pgm",  PIXFORMAT_BINARY,    bench_find_blobs_dense_single_pass },
+    { "binary",                     "blobs.ppm",     PIXFORMAT_RGB565,    bench_binary                     },
+    { "binary_compiled",            "blobs.ppm",     PIXFORMAT_RGB565,    bench_binary_compiled            },
+    { "mean_k1",                    "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_mean_1                     },
+    { "mean_k1",                    "blobs.ppm",     PIXFORMAT_RGB565,    bench_mean_1                     },
+    { "mean_k2",                    "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_mean_2                     },
+    { "median_k1",                  "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_median_1                   },
+    { "median_k1",                  "blobs.ppm",     PIXFORMAT_RGB565,    bench_median_1                   },
+    { "median_k2",                  "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_median_2                   },
+    { "median_k7",                  "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_median_7                   },
+    { "median_k7",                  "blobs.ppm",     PIXFORMAT_RGB565,    bench_median_7                   },
+    { "gaussian_k1",                "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_gaussian_1                 },
+    { "gaussian_k2",                "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_gaussian_2                 },
+    { "gaussian_k2",                "blobs.ppm",     PIXFORMAT_RGB565,    bench_gaussian_2                 },
+    { "gaussian_k5",                "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_gaussian_5                 },
+    { "gaussian_k7",                "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_gaussian_7                 },
+    { "gaussian_k7",                "blobs.ppm",     PIXFORMAT_RGB565,    bench_gaussian_7                 },
+    { "morph_threshold_k2",         "shapes.ppm",    PIXFORMAT_BINARY,    bench_morph_threshold            },
+    { "bilateral_k2",               "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_bilateral_2                },
+    { "bilateral_k2",               "blobs.ppm",     PIXFORMAT_RGB565,    bench_bilateral_2                },
+    { "bilateral_k4",               "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_bilateral_4                },
+    { "bilateral_grid_k2",          "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_bilateral_grid_2           },
+    { "bilateral_grid_k2",          "blobs.ppm",     PIXFORMAT_RGB565,    bench_bilateral_grid_2           },
+    { "bilateral_grid_k4",          "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_bilateral_grid_4           },
+    { "erode_k1",                   "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_erode_1                    },
+    { "erode_k1",                   "shapes.ppm",    PIXFORMAT_BINARY,    bench_erode_1                    },
+    { "dilate_k1",                  "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_dilate_1                   },
+    { "dilate_k1",                  "shapes.ppm",    PIXFORMAT_BINARY,    bench_dilate_1                   },
+    { "close_k2",                   "shapes.ppm",    PIXFORMAT_BINARY,    bench_close_2                    },
+    { "close_k5",                   "shapes.ppm",    PIXFORMAT_BINARY,    bench_close_5                    },
+    { "close_k5",                   "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_close_5                    },
+    { "get_statistics",             "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_get_statistics             },
+    { "get_statistics",             "blobs.ppm",     PIXFORMAT_RGB565,    bench_get_statistics             },
+    { "get_statistics_cache",       "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_get_statistics_cache       },
+    { "get_statistics_cache",       "blobs.ppm",     PIXFORMAT_RGB565,    bench_get_statistics_cache       },
+    { "get_statistics_thresholds",  "blobs.ppm",     PIXFORMAT_RGB565,    bench_get_statistics_thresholds  },
+    { "get_statistics_compiled",    "blobs.ppm",     PIXFORMAT_RGB565,    bench_get_statistics_compiled    },
+    { "jpeg_compress_q90",          "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_jpeg_compress              },
+    { "jpeg_compress_q90",          "blobs.ppm",     PIXFORMAT_RGB565,    bench_jpeg_compress              },
+    { "jpeg_compress_stream_q90",   "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_jpeg_compress_stream       },
+    { "jpeg_compress_stream_q90",   "blobs.ppm",     PIXFORMAT_RGB565,    bench_jpeg_compress_stream       },
+    { "jpeg_compress_rc",           "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_jpeg_compress_rc           },
+    { "jpeg_compress_rc",           "blobs.ppm",     PIXFORMAT_RGB565,    bench_jpeg_compress_rc           },
+    { "jpeg_compress_dsp",          "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_jpeg_compress_dsp          },
+    { "jpeg_compress_dsp",          "blobs.ppm",     PIXFORMAT_RGB565,    bench_jpeg_compress_dsp          },
+    { "find_apriltags",             "apriltags.pgm", PIXFORMAT_GRAYSCALE, bench_find_apriltags             },
+    { "find_apriltags_decimate_2",  "apriltags.pgm", PIXFORMAT_GRAYSCALE, bench_find_apriltags_decimate_2  },
+    { "find_apriltags_sequence",    "apriltags.pgm", PIXFORMAT_GRAYSCALE, bench_find_apriltags_sequence    },
+    { "find_apriltags_tracked",     "apriltags.pgm", PIXFORMAT_GRAYSCALE, bench_find_apriltags_tracked     },
+    { "find_features",              "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_find_features              },
+    { "find_features_pyramid",      "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_find_features_pyramid      },
+    { "match_descriptor",           "graffiti.pgm",  PIXFORMAT_GRAYSCALE, bench_match_descriptor           },
+    { "phasecorrelate",             "graffiti.pgm",  PIXFORMAT_GRAYSCALE, bench_phasecorrelate             },
+    { "find_lines",                 "shapes.ppm",    PIXFORMAT_RGB565,    bench_find_lines                 },
+    { "find_lines_window",          "shapes.ppm",    PIXFORMAT_RGB565,    bench_find_lines_window          },
+    { "find_circles",               "shapes.ppm",    PIXFORMAT_RGB565,    bench_find_circles               },
+    { "find_qrcodes",               "qrcode.pgm",    PIXFORMAT_GRAYSCALE, bench_find_qrcodes               },
+    { "find_barcodes",              "barcode.pgm",   PIXFORMAT_GRAYSCALE, bench_find_barcodes              },
+    { "find_barcodes_fast",         "barcode.pgm",   PIXFORMAT_GRAYSCALE, bench_find_barcodes_fast         },
+    { "find_barcodes_frame",        "barcode.pgm",   PIXFORMAT_GRAYSCALE, bench_find_barcodes_frame        },
+    { "find_barcodes_frame_fast",   "barcode.pgm",   PIXFORMAT_GRAYSCALE, bench_find_barcodes_frame_fast   },
+    { "find_barcodes_tilted_fast",  "barcode.pgm",   PIXFORMAT_GRAYSCALE, bench_find_barcodes_tilted_fast  },
+    { "find_codes",                 "qrcode.pgm",    PIXFORMAT_RGB565,    bench_find_codes                 },
+    { "find_codes_planes",          "qrcode.pgm",    PIXFORMAT_RGB565,    bench_find_codes_planes          },
+    { "draw_image_0.5x",            "blobs.ppm",     PIXFORMAT_RGB565,    bench_draw_image_half            },
+    { "draw_image_0.5x_area",       "blobs.ppm",     PIXFORMAT_RGB565,    bench_draw_image_half_area       },
+    { "draw_image_2x_bilinear",     "blobs.ppm",     PIXFORMAT_RGB565,    bench_draw_image_double_bilinear },
+    { "nn_input_draw_image",        "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_nn_input_draw_image_kernel },
+    { "nn_input_draw_image",        "blobs.ppm",     PIXFORMAT_RGB565,    bench_nn_input_draw_image_kernel },
+    { "nn_input_draw_image",        "blobs.ppm",     PIXFORMAT_BAYER,     bench_nn_input_draw_image_kernel },
+    { "nn_input_draw_image",        "blobs.ppm",     PIXFORMAT_YUV422,    bench_nn_input_draw_image_kernel },
+    { "nn_input_tensor",            "dennis.pgm",    PIXFORMAT_GRAYSCALE, bench_nn_input_tensor_kernel     },
+    { "nn_input_tensor",            "blobs.ppm",     PIXFORMAT_RGB565,    bench_nn_input_tensor_kernel     },
+    { "nn_input_tensor",            "blobs.ppm",     PIXFORMAT_BAYER,     bench_nn_input_tensor_kernel     },
+    { "nn_input_tensor",            "blobs.ppm",     PIXFORMAT_YUV422,    bench_nn_input_tensor_kernel     },
+};
+
+const size_t bench_kernels_count = sizeof(bench_kernels) / sizeof(bench_kernels[0]);
@@ -0,0 +1,205 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Host-side imlib benchmark. Runs each kernel over the unittest images and
+ * reports throughput in megapixels per second and fb_alloc peak usage.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "imlib.h"
+#include "fb_alloc.h"
+#include "xalloc.h"
+#include "host.h"
+#include "bench.h"
+
+const char *bench_data_path = "../../scripts/unittest/data";
+
+static const char *pixfmt_name(pixformat_t pixfmt) {
+    switch (pixfmt) {
+        case PIXFORMAT_BINARY:
+            return "BINARY";
+        case PIXFORMAT_GRAYSCALE:
+            return "GRAYSCALE";
+        case PIXFORMAT_RGB565:
+            return "RGB565";
+        case PIXFORMAT_BAYER:
+            return "BAYER";
+        case PIXFORMAT_YUV422:
+            return "YUV422";
+        default:
+            return "OTHER";
+    }
+}
+
+// Samples a BAYER (BGGR) or YUV422 image out of an RGB565 one like a sensor would output it.
+static void bench_sample_image(image_t *img, image_t *rgb, pixformat_t pixfmt) {
+    image_init(img, rgb->w, rgb->h, pixfmt, 0, NULL);
+    img->data = xalloc0(image_size(img));
+
+    for (int y = 0; y < rgb->h; y++) {
+        for (int x = 0; x < rgb->w; x++) {
+            int pixel = IMAGE_GET_RGB565_PIXEL(rgb, x, y);
+
+            if (pixfmt == PIXFORMAT_BAYER) {
+                int value = (y & 1) ?
+                            ((x & 1) ? COLOR_RGB565_TO_R8(pixel) : COLOR_RGB565_TO_G8(pixel)) :
+                            ((x & 1) ? COLOR_RGB565_TO_G8(pixel) : COLOR_RGB565_TO_B8(pixel));
+                img->data[(y * img->w) + x] = value;
+            } else {
+                // The chroma byte of even pixels is the one imlib_deyuv_line() adds to red.
+                int chroma = (x & 1) ? COLOR_RGB565_TO_U(pixel) : COLOR_RGB565_TO_V(pixel);
+                ((uint16_t *) img->data)[(y * img->w) + x] = COLOR_RGB565_TO_Y(pixel) | ((chroma + 128) << 8);
+            }
+        }
+    }
+}
+
+void bench_load_image(image_t *img, const char *path, pixformat_t pixfmt) {
+    if ((pixfmt == PIXFORMAT_BAYER) || (pixfmt == PIXFORMAT_YUV422)) {
+        image_t rgb;
+        bench_load_image(&rgb, path, PIXFORMAT_RGB565);
+        bench_sample_image(img, &rgb, pixfmt);
+        xfree(rgb.data);
+        return;
+    }
+
+    char full_path[512];
+    snprintf(full_path, sizeof(full_path), "%s/%s", bench_data_path, path);
+
+    image_t src = { 0 };
+    imlib_load_image(&src, full_path);
+
+    if (src.pixfmt == pixfmt) {
+        *img = src;
+        return;
+    }
+
+    image_init(img, src.w, src.h, pixfmt, 0, NULL);
+    img->data = xalloc0(image_size(img));
+    fb_alloc_mark();
+    imlib_draw_image(img, &src, 0, 0, 1.f, 1.f, NULL, -1, 256, NULL, NULL, 0, NULL, NULL, NULL);
+    fb_alloc_free_till_mark();
+    xfree(src.data);
+}
+
+static bool bench_run(const bench_t *bench, int iterations, bool verbose) {
+    image_t src, img;
+    char result[BENCH_RESULT_LEN] = "";
+    bool passed = false;
+    uint64_t elapsed = 0;
+    uint32_t peak = 0;
+    bool used_all = false;
+
+    host_nlr_buf_t nlr;
+    if (host_nlr_push(&nlr) == 0) {
+        bench_load_image(&src, bench->path, bench->pixfmt);
+        host_nlr_pop();
+    } else {
+        printf("%-28s %s\n", bench->name, host_nlr_msg());
+        return false;
+    }
+
+    img = src;
+    img.data = xalloc(image_size(&src));
+
+    for (int i = -1; i < iterations; i++) {
+        memcpy(img.data, src.data, image_size(&src));
+        fb_alloc_mark();
+        host_fb_alloc_reset_peak();
+        if (host_nlr_push(&nlr) == 0) {
+            uint64_t start = host_ticks_us();
+            bool ok = bench->run(&img, result);
+            uint64_t end = host_ticks_us();
+            host_nlr_pop();
+            // The first run is a warm up run used to check the output.
+            if (i < 0) {
+                passed = ok;
+            } else {
+                elapsed += end - start;
+            }
+        } else {
+            snprintf(result, sizeof(result), "%s", host_nlr_msg());
+            passed = false;
+            iterations = 0;
+        }
+        peak = IM_MAX(peak, host_fb_alloc_peak());
+        used_all |= host_fb_alloc_used_all();
+        fb_alloc_free_till_mark();
+    }
+
+    double ms = iterations ? (elapsed / 1000.0) / iterations : 0.0;
+    double mps = elapsed ? (((double) src.w * src.h * iterations) / elapsed) : 0.0;
+
+    printf("%-28s %-10s %4ldx%-4ld %9.3f %9.2f %10lu%-4s  %-4s %s\n",
+           bench->name, pixfmt_name(bench->pixfmt), (long) src.w, (long) src.h,
+           ms, mps, (unsigned long) peak, used_all ? "+all" : "", passed ? "ok" : "FAIL", verbose ? result : "");
+
+    xfree(img.data);
+    xfree(src.data);
+    return passed;
+}
+
+static void usage(const char *argv0) {
+    printf("usage: %s [-n iterations] [-d data_path] [-s fb_alloc_size] [-v] [kernel_name_prefix...]\n", argv0);
+    printf("kernels:\n");
+    for (size_t i = 0; i < bench_kernels_count; i++) {
+        printf("    %s\n", bench_kernels[i].name);
+    }
+}
+
+int main(int argc, char **argv) {
+    int iterations = 10;
+    uint32_t fb_size = OMV_HOST_FB_ALLOC_SIZE;
+    bool verbose = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:d:s:vh")) != -1) {
+        switch (opt) {
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            case 'd':
+                bench_data_path = optarg;
+                break;
+            case 's':
+                fb_size = strtoul(optarg, NULL, 0);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    host_fb_alloc_init(fb_size);
+    imlib_init_all();
+
+    printf("%-28s %-10s %-9s %9s %9s %14s  %s\n",
+           "kernel", "pixfmt", "size", "ms/iter", "MP/s", "fb_peak", "check");
+
+    int failed = 0;
+    for (size_t i = 0; i < bench_kernels_count; i++) {
+        const bench_t *bench = &bench_kernels[i];
+        bool selected = (optind == argc);
+        for (int j = optind; j < argc; j++) {
+            if (!strncmp(bench->name, argv[j], strlen(argv[j]))) {
+                selected = true;
+            }
+        }
+        if (selected && !bench_run(bench, iterations, verbose)) {
+            failed++;
+        }
+    }
+
+    imlib_deinit_all();
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,60 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Minimal FatFs shim for host builds (backed by stdio).
+ */
+#ifndef __HOST_FF_H__
+#define __HOST_FF_H__
+#include <stdio.h>
+#include <stdint.h>
+
+typedef char TCHAR;
+typedef uint8_t BYTE;
+typedef unsigned int UINT;
+typedef uint32_t FSIZE_t;
+
+typedef enum {
+    FR_OK = 0,
+    FR_DISK_ERR,
+    FR_INT_ERR,
+    FR_NOT_READY,
+    FR_NO_FILE,
+    FR_NO_PATH,
+    FR_INVALID_NAME,
+    FR_DENIED,
+    FR_EXIST,
+    FR_INVALID_OBJECT,
+} FRESULT;
+
+typedef struct {
+    FILE *fp;
+    FSIZE_t size;
+} FIL;
+
+typedef struct {
+    void *dp;
+} FF_DIR;
+
+typedef struct {
+    FSIZE_t fsize;
+    BYTE fattrib;
+    TCHAR fname[256];
+} FILINFO;
+
+#define FA_READ             0x01
+#define FA_WRITE            0x02
+#define FA_OPEN_EXISTING    0x00
+#define FA_CREATE_NEW       0x04
+#define FA_CREATE_ALWAYS    0x08
+#define FA_OPEN_ALWAYS      0x10
+#define FA_OPEN_APPEND      0x30
+
+#define f_size(fil)         ((fil)->size)
+#define f_tell(fil)         ((FSIZE_t) ftell((fil)->fp))
+#define f_eof(fil)          (f_tell(fil) >= f_size(fil))
+#endif // __HOST_FF_H__
@@ -0,0 +1,68 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Host MCU header (replaces CMSIS_MCU_H). This file is force-included
+ * before every translation unit so that the few CMSIS intrinsics which
+ * are implemented in ARM assembly without a C fallback can be replaced.
+ * When ARM_MATH_DSP is defined the SIMD intrinsics used by imlib's DSP
+ * code paths are emulated too, so that they can be checked on the host.
+ */
+#ifndef __HOST_MCU_H__
+#define __HOST_MCU_H__
+#include <stdint.h>
+#include "cmsis_compiler.h"
+
+static inline uint32_t host_rev16(uint32_t value) {
+    return ((value & 0xFF00FF00UL) >> 8) | ((value & 0x00FF00FFUL) << 8);
+}
+
+#undef __REV16
+#define __REV16(x)    host_rev16(x)
+
+#if defined(ARM_MATH_DSP)
+static inline uint32_t __SADD16(uint32_t op1, uint32_t op2) {
+    return ((op1 & 0xFFFF0000UL) + (op2 & 0xFFFF0000UL)) | ((op1 + op2) & 0xFFFFUL);
+}
+
+static inline uint32_t __SMUAD(uint32_t op1, uint32_t op2) {
+    return (((int16_t) op1) * ((int16_t) op2)) + (((int16_t) (op1 >> 16)) * ((int16_t) (op2 >> 16)));
+}
+
+static inline uint32_t __SMUADX(uint32_t op1, uint32_t op2) {
+    return (((int16_t) op1) * ((int16_t) (op2 >> 16))) + (((int16_t) (op1 >> 16)) * ((int16_t) op2));
+}
+
+static inline uint32_t __SHADD8(uint32_t op1, uint32_t op2) {
+    uint32_t result = 0;
+    for (int i = 0; i < 32; i += 8) {
+        result |= ((uint32_t) (((((int8_t) (op1 >> i)) + ((int8_t) (op2 >> i))) >> 1) & 0xFF)) << i;
+    }
+    return result;
+}
+
+static inline uint32_t __UHADD8(uint32_t op1, uint32_t op2) {
+    uint32_t result = 0;
+    for (int i = 0; i < 32; i += 8) {
+        result |= (((((op1 >> i) & 0xFF) + ((op2 >> i) & 0xFF)) >> 1) & 0xFF) << i;
+    }
+    return result;
+}
+
+static inline uint32_t __UXTB16(uint32_t op1) {
+    return op1 & 0x00FF00FFUL;
+}
+
+static inline uint32_t __UXTB16_RORn(uint32_t op1, uint32_t rotate) {
+    return ((op1 >> rotate) | (op1 << (32 - rotate))) & 0x00FF00FFUL;
+}
+
+#define __PKHBT(ARG1, ARG2, ARG3)    ((((uint32_t) (ARG1)) & 0x0000FFFFUL) | (((uint32_t) (ARG2)) << (ARG3)))
+#define __PKHTB(ARG1, ARG2, ARG3)    ((((uint32_t) (ARG1)) & 0xFFFF0000UL) | \
+                                      (((uint32_t) (((int32_t) (ARG2)) >> (ARG3))) & 0x0000FFFFUL))
+#endif // defined(ARM_MATH_DSP)
+#endif // __HOST_MCU_H__
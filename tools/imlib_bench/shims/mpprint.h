@@ -0,0 +1,22 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Minimal MicroPython print shim for host builds.
+ */
+#ifndef __HOST_MPPRINT_H__
+#define __HOST_MPPRINT_H__
+#include "py/obj.h"
+
+typedef struct _mp_print_t {
+    void *data;
+    void (*print_strn) (void *data, const char *str, size_t len);
+} mp_print_t;
+
+extern const mp_print_t mp_plat_print;
+#define MP_PYTHON_PRINTER    (&mp_plat_print)
+#endif // __HOST_MPPRINT_H__
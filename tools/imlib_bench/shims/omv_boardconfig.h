@@ -0,0 +1,33 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Host board configuration for the imlib benchmark.
+ */
+#ifndef __OMV_BOARDCONFIG_H__
+#define __OMV_BOARDCONFIG_H__
+
+// Architecture info
+#define OMV_BOARD_ARCH                        "HOST"
+#define OMV_BOARD_TYPE                        "HOST"
+
+// JPEG configuration (software codec only).
+#define OMV_JPEG_CODEC_ENABLE                 (0)
+#define OMV_JPEG_QUALITY_LOW                  (50)
+#define OMV_JPEG_QUALITY_HIGH                 (90)
+#define OMV_JPEG_QUALITY_THRESHOLD            (320 * 240 * 2)
+#define OMV_JPEG_BUF_SIZE                     (32 * 1024)
+
+// UMM heap block size
+#define OMV_UMM_BLOCK_SIZE                    16
+
+// Emulated frame buffer / fb_alloc stack size.
+#ifndef OMV_HOST_FB_ALLOC_SIZE
+#define OMV_HOST_FB_ALLOC_SIZE                (4 * 1024 * 1024)
+#endif
+
+#endif //__OMV_BOARDCONFIG_H__
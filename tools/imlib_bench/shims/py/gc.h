@@ -0,0 +1,27 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Minimal MicroPython GC shim for host builds.
+ */
+#ifndef __HOST_PY_GC_H__
+#define __HOST_PY_GC_H__
+#include "py/obj.h"
+
+typedef struct _gc_info_t {
+    size_t total;
+    size_t used;
+    size_t free;
+    size_t max_free;
+    size_t num_1block;
+    size_t num_2block;
+    size_t max_block;
+} gc_info_t;
+
+void gc_info(gc_info_t *info);
+void gc_collect(void);
+#endif // __HOST_PY_GC_H__
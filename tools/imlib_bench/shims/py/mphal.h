@@ -0,0 +1,17 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Minimal MicroPython HAL shim for host builds.
+ */
+#ifndef __HOST_PY_MPHAL_H__
+#define __HOST_PY_MPHAL_H__
+#include "py/obj.h"
+
+mp_uint_t mp_hal_ticks_ms(void);
+mp_uint_t mp_hal_ticks_us(void);
+#endif // __HOST_PY_MPHAL_H__
@@ -0,0 +1,16 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Minimal MicroPython nlr shim for host builds.
+ */
+#ifndef __HOST_PY_NLR_H__
+#define __HOST_PY_NLR_H__
+#include "py/runtime.h"
+
+NORETURN void nlr_jump(void *val);
+#endif // __HOST_PY_NLR_H__
@@ -0,0 +1,40 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Minimal MicroPython object shim for host builds.
+ */
+#ifndef __HOST_PY_OBJ_H__
+#define __HOST_PY_OBJ_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define NORETURN                 __attribute__((noreturn))
+#define MP_WEAK                  __attribute__((weak))
+#define MP_ERROR_TEXT(x)         (x)
+
+typedef uintptr_t mp_uint_t;
+typedef intptr_t mp_int_t;
+typedef const char *mp_rom_error_text_t;
+typedef void *mp_obj_t;
+
+#define MP_OBJ_TO_PTR(o)         ((void *) (o))
+
+typedef struct _mp_obj_type_t {
+    const char *name;
+} mp_obj_type_t;
+
+extern const mp_obj_type_t mp_type_OSError;
+extern const mp_obj_type_t mp_type_MemoryError;
+extern const mp_obj_type_t mp_type_ValueError;
+extern const mp_obj_type_t mp_type_TypeError;
+extern const mp_obj_type_t mp_type_RuntimeError;
+
+// Exception objects are only ever raised with nlr_jump().
+mp_obj_t mp_obj_new_exception_msg(const mp_obj_type_t *type, mp_rom_error_text_t msg);
+#endif // __HOST_PY_OBJ_H__
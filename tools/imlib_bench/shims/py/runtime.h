@@ -0,0 +1,20 @@
+/*
+ * This file is part of the OpenMV project.
+ *
+ * Copyright (c) 2013-2024 Ibrahim Abdelkader <iabdalkader@openmv.io>
+ * Copyright (c) 2013-2024 Kwabena W. Agyeman <kwagyeman@openmv.io>
+ *
+ * This work is licensed under the MIT license, see the file LICENSE for details.
+ *
+ * Minimal MicroPython runtime shim for host builds.
+ */
+#ifndef __HOST_PY_RUNTIME_H__
+#define __HOST_PY_RUNTIME_H__
+#include "py/obj.h"
+
+// Exceptions unwind to the innermost host_nlr_push() frame.
+NORETURN void mp_raise_msg(const mp_obj_type_t *type, mp_rom_error_text_t msg);
+NORETURN void mp_raise_msg_varg(const mp_obj_type_t *type, mp_rom_error_text_t fmt, ...);
+NORETURN void mp_raise_ValueError(mp_rom_error_text_t msg);
+NORETURN void mp_raise_OSError(int errcode);
+#endif // __HOST_PY_RUNTIME_H__